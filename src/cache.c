@@ -0,0 +1,525 @@
+#include "cache.h"
+
+static bool valid_shard_hash(const char *shard_hash)
+{
+    // the hash is used as the file name, nothing else may be in it
+    if (!shard_hash || strlen(shard_hash) != RIPEMD160_DIGEST_SIZE * 2) {
+        return false;
+    }
+
+    for (const char *c = shard_hash; *c; c++) {
+        if (!((*c >= '0' && *c <= '9') || (*c >= 'a' && *c <= 'f'))) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static uint32_t shard_hash_bucket(const char *shard_hash)
+{
+    // fnv-1a
+    uint32_t hash = 2166136261u;
+    for (const char *c = shard_hash; *c; c++) {
+        hash ^= (uint8_t)*c;
+        hash *= 16777619u;
+    }
+
+    return hash % STORJ_SHARD_CACHE_BUCKETS;
+}
+
+static char *shard_cache_file(shard_cache_t *cache, const char *name)
+{
+    size_t len = strlen(cache->path) + 1 + strlen(name) + 1;
+    char *path = calloc(len, sizeof(char));
+    if (!path) {
+        return NULL;
+    }
+
+    snprintf(path, len, "%s%c%s", cache->path, separator(), name);
+
+    return path;
+}
+
+static shard_cache_entry_t *find_entry(shard_cache_t *cache,
+                                       const char *shard_hash)
+{
+    shard_cache_entry_t *entry = cache->buckets[shard_hash_bucket(shard_hash)];
+    while (entry) {
+        if (strcmp(entry->shard_hash, shard_hash) == 0) {
+            return entry;
+        }
+        entry = entry->next;
+    }
+
+    return NULL;
+}
+
+static void lru_remove(shard_cache_t *cache, shard_cache_entry_t *entry)
+{
+    if (entry->lru_prev) {
+        entry->lru_prev->lru_next = entry->lru_next;
+    } else {
+        cache->lru_head = entry->lru_next;
+    }
+
+    if (entry->lru_next) {
+        entry->lru_next->lru_prev = entry->lru_prev;
+    } else {
+        cache->lru_tail = entry->lru_prev;
+    }
+
+    entry->lru_prev = NULL;
+    entry->lru_next = NULL;
+}
+
+static void lru_insert(shard_cache_t *cache, shard_cache_entry_t *entry)
+{
+    // entries are kept in order of their last use
+    shard_cache_entry_t *next = cache->lru_head;
+    while (next && next->used > entry->used) {
+        next = next->lru_next;
+    }
+
+    entry->lru_next = next;
+    if (next) {
+        entry->lru_prev = next->lru_prev;
+        next->lru_prev = entry;
+    } else {
+        entry->lru_prev = cache->lru_tail;
+        cache->lru_tail = entry;
+    }
+
+    if (entry->lru_prev) {
+        entry->lru_prev->lru_next = entry;
+    } else {
+        cache->lru_head = entry;
+    }
+}
+
+static void touch_entry(shard_cache_t *cache, shard_cache_entry_t *entry)
+{
+    lru_remove(cache, entry);
+    entry->used = get_time_milliseconds();
+    lru_insert(cache, entry);
+}
+
+static shard_cache_entry_t *add_entry(shard_cache_t *cache,
+                                      const char *shard_hash,
+                                      uint64_t size,
+                                      uint64_t used)
+{
+    shard_cache_entry_t *entry = calloc(1, sizeof(shard_cache_entry_t));
+    if (!entry) {
+        return NULL;
+    }
+
+    entry->shard_hash = strdup(shard_hash);
+    if (!entry->shard_hash) {
+        free(entry);
+        return NULL;
+    }
+
+    entry->size = size;
+    entry->used = used;
+
+    uint32_t bucket = shard_hash_bucket(shard_hash);
+    entry->next = cache->buckets[bucket];
+    cache->buckets[bucket] = entry;
+
+    lru_insert(cache, entry);
+
+    cache->total_bytes += size;
+    cache->total_entries += 1;
+
+    return entry;
+}
+
+static void remove_entry(shard_cache_t *cache, shard_cache_entry_t *entry)
+{
+    shard_cache_entry_t **link = &cache->buckets[shard_hash_bucket(entry->shard_hash)];
+    while (*link && *link != entry) {
+        link = &(*link)->next;
+    }
+    if (*link) {
+        *link = entry->next;
+    }
+
+    lru_remove(cache, entry);
+
+    cache->total_bytes -= entry->size;
+    cache->total_entries -= 1;
+
+    // the file is removed as well, readers that have it open may finish
+    char *path = shard_cache_file(cache, entry->shard_hash);
+    if (path) {
+        unlink(path);
+        free(path);
+    }
+
+    free(entry->shard_hash);
+    free(entry);
+}
+
+static void evict_entries(shard_cache_t *cache)
+{
+    while (cache->total_bytes > cache->max_bytes && cache->lru_tail) {
+        remove_entry(cache, cache->lru_tail);
+    }
+}
+
+static void load_entries(shard_cache_t *cache, uv_loop_t *loop)
+{
+    uv_fs_t scan_req;
+    if (uv_fs_scandir(loop, &scan_req, cache->path, 0, NULL) < 0) {
+        uv_fs_req_cleanup(&scan_req);
+        return;
+    }
+
+    uv_dirent_t dirent;
+    while (uv_fs_scandir_next(&scan_req, &dirent) != UV_EOF) {
+        if (dirent.type != UV_DIRENT_FILE && dirent.type != UV_DIRENT_UNKNOWN) {
+            continue;
+        }
+
+        char *path = shard_cache_file(cache, dirent.name);
+        if (!path) {
+            break;
+        }
+
+        // the temporary files of a previous run were never completed
+        if (!valid_shard_hash(dirent.name)) {
+            size_t len = strlen(dirent.name);
+            if (len > 4 && strcmp(dirent.name + len - 4, ".tmp") == 0) {
+                unlink(path);
+            }
+            free(path);
+            continue;
+        }
+
+        uv_fs_t stat_req;
+        if (uv_fs_stat(loop, &stat_req, path, NULL) == 0) {
+            uv_stat_t *st = &stat_req.statbuf;
+            uint64_t used = st->st_mtim.tv_sec * 1000LL +
+                st->st_mtim.tv_nsec / 1000000;
+            add_entry(cache, dirent.name, st->st_size, used);
+        }
+        uv_fs_req_cleanup(&stat_req);
+
+        free(path);
+    }
+
+    uv_fs_req_cleanup(&scan_req);
+}
+
+shard_cache_t *shard_cache_new(uv_loop_t *loop,
+                               const char *path,
+                               uint64_t max_bytes)
+{
+    shard_cache_t *cache = calloc(1, sizeof(shard_cache_t));
+    if (!cache) {
+        return NULL;
+    }
+
+    cache->path = strdup(path);
+    if (!cache->path) {
+        free(cache);
+        return NULL;
+    }
+
+    size_t path_len = strlen(cache->path);
+    if (path_len > 1 && cache->path[path_len - 1] == separator()) {
+        cache->path[path_len - 1] = '\0';
+    }
+
+    if (uv_mutex_init(&cache->lock)) {
+        free(cache->path);
+        free(cache);
+        return NULL;
+    }
+
+    cache->max_bytes = max_bytes;
+
+    uv_fs_t mkdir_req;
+    int status = uv_fs_mkdir(loop, &mkdir_req, cache->path, 0700, NULL);
+    uv_fs_req_cleanup(&mkdir_req);
+    if (status && status != UV_EEXIST) {
+        shard_cache_destroy(cache);
+        return NULL;
+    }
+
+    load_entries(cache, loop);
+    evict_entries(cache);
+
+    return cache;
+}
+
+void shard_cache_destroy(shard_cache_t *cache)
+{
+    if (!cache) {
+        return;
+    }
+
+    shard_cache_entry_t *entry = cache->lru_head;
+    while (entry) {
+        shard_cache_entry_t *next = entry->lru_next;
+        free(entry->shard_hash);
+        free(entry);
+        entry = next;
+    }
+
+    uv_mutex_destroy(&cache->lock);
+    free(cache->path);
+    free(cache);
+}
+
+bool shard_cache_contains(shard_cache_t *cache,
+                          const char *shard_hash,
+                          uint64_t size)
+{
+    if (!valid_shard_hash(shard_hash)) {
+        return false;
+    }
+
+    uv_mutex_lock(&cache->lock);
+    shard_cache_entry_t *entry = find_entry(cache, shard_hash);
+    bool found = entry && entry->size == size;
+    uv_mutex_unlock(&cache->lock);
+
+    return found;
+}
+
+int shard_cache_read(shard_cache_t *cache,
+                     const char *shard_hash,
+                     uint64_t size,
+                     FILE *destination,
+                     uint64_t position,
+                     uint8_t *data)
+{
+    if (!valid_shard_hash(shard_hash)) {
+        return STORJ_FILE_READ_ERROR;
+    }
+
+    uv_mutex_lock(&cache->lock);
+    shard_cache_entry_t *entry = find_entry(cache, shard_hash);
+    bool found = entry && entry->size == size;
+    if (found) {
+        touch_entry(cache, entry);
+    }
+    uv_mutex_unlock(&cache->lock);
+
+    if (!found) {
+        return STORJ_FILE_READ_ERROR;
+    }
+
+    int status = 0;
+    uint8_t *buffer = NULL;
+    FILE *fp = NULL;
+
+    char *path = shard_cache_file(cache, shard_hash);
+    if (!path) {
+        status = STORJ_MEMORY_ERROR;
+        goto clean_variables;
+    }
+
+    if (!data) {
+        size_t buffer_size = (size < STORJ_SHARD_CACHE_BUFFER_SIZE) ?
+            size : STORJ_SHARD_CACHE_BUFFER_SIZE;
+        buffer = malloc(buffer_size ? buffer_size : 1);
+        if (!buffer) {
+            status = STORJ_MEMORY_ERROR;
+            goto clean_variables;
+        }
+    }
+
+    fp = fopen(path, "rb");
+    if (!fp) {
+        status = STORJ_FILE_READ_ERROR;
+        goto clean_variables;
+    }
+
+    // the shard is verified the same way as when fetched from a farmer
+    struct sha256_ctx sha256_ctx;
+    sha256_init(&sha256_ctx);
+
+    uint64_t total_read = 0;
+    while (total_read < size) {
+        size_t length = size - total_read;
+        if (length > STORJ_SHARD_CACHE_BUFFER_SIZE) {
+            length = STORJ_SHARD_CACHE_BUFFER_SIZE;
+        }
+
+        uint8_t *chunk = data ? data + total_read : buffer;
+
+        if (fread(chunk, 1, length, fp) != length) {
+            status = STORJ_FILE_READ_ERROR;
+            goto clean_variables;
+        }
+
+        sha256_update(&sha256_ctx, length, chunk);
+
+        if (destination &&
+            pwrite(fileno(destination), chunk, length,
+                   position + total_read) != (ssize_t)length) {
+            status = STORJ_FILE_WRITE_ERROR;
+            goto clean_variables;
+        }
+
+        total_read += length;
+    }
+
+    uint8_t hash_sha256[SHA256_DIGEST_SIZE];
+    sha256_digest(&sha256_ctx, SHA256_DIGEST_SIZE, hash_sha256);
+
+    struct ripemd160_ctx rctx;
+    ripemd160_init(&rctx);
+    ripemd160_update(&rctx, SHA256_DIGEST_SIZE, hash_sha256);
+
+    uint8_t hash_rmd160[RIPEMD160_DIGEST_SIZE];
+    ripemd160_digest(&rctx, RIPEMD160_DIGEST_SIZE, hash_rmd160);
+
+    char hash[RIPEMD160_DIGEST_SIZE * 2 + 1];
+    for (unsigned i = 0; i < RIPEMD160_DIGEST_SIZE; i++) {
+        sprintf(&hash[i*2], "%02x", hash_rmd160[i]);
+    }
+
+    if (strcmp(shard_hash, hash) != 0) {
+        status = STORJ_FILE_INTEGRITY_ERROR;
+    }
+
+clean_variables:
+    if (fp) {
+        fclose(fp);
+    }
+
+    // a shard that can't be read is downloaded and cached again
+    if (status == STORJ_FILE_READ_ERROR || status == STORJ_FILE_INTEGRITY_ERROR) {
+        uv_mutex_lock(&cache->lock);
+        entry = find_entry(cache, shard_hash);
+        if (entry) {
+            remove_entry(cache, entry);
+        }
+        uv_mutex_unlock(&cache->lock);
+    }
+
+    free(buffer);
+    free(path);
+
+    return status;
+}
+
+int shard_cache_write(shard_cache_t *cache,
+                      const char *shard_hash,
+                      uint64_t size,
+                      FILE *source,
+                      uint64_t position,
+                      const uint8_t *data)
+{
+    // shards larger than the cache are not kept
+    if (!valid_shard_hash(shard_hash) || size > cache->max_bytes) {
+        return 0;
+    }
+
+    uv_mutex_lock(&cache->lock);
+    shard_cache_entry_t *entry = find_entry(cache, shard_hash);
+    if (entry) {
+        touch_entry(cache, entry);
+    }
+    cache->writes += 1;
+    uint32_t write_id = cache->writes;
+    uv_mutex_unlock(&cache->lock);
+
+    if (entry) {
+        return 0;
+    }
+
+    int status = 0;
+    uint8_t *buffer = NULL;
+    FILE *fp = NULL;
+    char *tmp_path = NULL;
+
+    char *path = shard_cache_file(cache, shard_hash);
+    if (!path) {
+        status = STORJ_MEMORY_ERROR;
+        goto clean_variables;
+    }
+
+    // the same shard may be written by more than one download at once
+    size_t tmp_len = strlen(path) + 16;
+    tmp_path = calloc(tmp_len, sizeof(char));
+    if (!tmp_path) {
+        status = STORJ_MEMORY_ERROR;
+        goto clean_variables;
+    }
+    snprintf(tmp_path, tmp_len, "%s.%u.tmp", path, write_id);
+
+    if (!data) {
+        buffer = malloc(STORJ_SHARD_CACHE_BUFFER_SIZE);
+        if (!buffer) {
+            status = STORJ_MEMORY_ERROR;
+            goto clean_variables;
+        }
+    }
+
+    fp = fopen(tmp_path, "wb");
+    if (!fp) {
+        status = STORJ_FILE_WRITE_ERROR;
+        goto clean_variables;
+    }
+
+    uint64_t total_written = 0;
+    while (total_written < size) {
+        size_t length = size - total_written;
+        if (length > STORJ_SHARD_CACHE_BUFFER_SIZE) {
+            length = STORJ_SHARD_CACHE_BUFFER_SIZE;
+        }
+
+        const uint8_t *chunk = buffer;
+        if (data) {
+            chunk = data + total_written;
+        } else if (pread(fileno(source), buffer, length,
+                         position + total_written) != (ssize_t)length) {
+            status = STORJ_FILE_READ_ERROR;
+            goto clean_variables;
+        }
+
+        if (fwrite(chunk, 1, length, fp) != length) {
+            status = STORJ_FILE_WRITE_ERROR;
+            goto clean_variables;
+        }
+
+        total_written += length;
+    }
+
+    int close_status = fclose(fp);
+    fp = NULL;
+    if (close_status || rename(tmp_path, path)) {
+        status = STORJ_FILE_WRITE_ERROR;
+        goto clean_variables;
+    }
+
+    uv_mutex_lock(&cache->lock);
+    entry = find_entry(cache, shard_hash);
+    if (entry) {
+        touch_entry(cache, entry);
+    } else if (!add_entry(cache, shard_hash, size, get_time_milliseconds())) {
+        status = STORJ_MEMORY_ERROR;
+    }
+    evict_entries(cache);
+    uv_mutex_unlock(&cache->lock);
+
+clean_variables:
+    if (fp) {
+        fclose(fp);
+    }
+
+    if (status && tmp_path) {
+        unlink(tmp_path);
+    }
+
+    free(buffer);
+    free(tmp_path);
+    free(path);
+
+    return status;
+}
@@ -0,0 +1,131 @@
+/**
+ * @file cache.h
+ * @brief Storj local shard cache.
+ *
+ * Keeps the encrypted shards of downloaded files in a directory, named by
+ * their hash, so that files downloaded again are read from the disk
+ * instead of the farmers. The cache is bounded in size, and the least
+ * recently used shards are removed first.
+ */
+#ifndef STORJ_CACHE_H
+#define STORJ_CACHE_H
+
+#include "storj.h"
+#include "utils.h"
+#include "crypto.h"
+
+#define STORJ_SHARD_CACHE_BUCKETS 256
+#define STORJ_SHARD_CACHE_BUFFER_SIZE 1048576
+// Directory of the cache under the tmp path when none is given
+#define STORJ_SHARD_CACHE_DIR "storj-shards"
+
+/** @brief A shard kept in the cache */
+typedef struct storj_shard_cache_entry {
+    char *shard_hash;
+    uint64_t size;
+    /* milliseconds of the last use, only to order the entries on load */
+    uint64_t used;
+    struct storj_shard_cache_entry *next;
+    /* in order of use, the most recently used first */
+    struct storj_shard_cache_entry *lru_prev;
+    struct storj_shard_cache_entry *lru_next;
+} shard_cache_entry_t;
+
+/** @brief The shards of a cache directory, which may be used from any
+ * thread.
+ *
+ * Only the index is guarded by the lock, shards are read and written
+ * without holding it. New shards are written to a temporary file and
+ * renamed once complete.
+ */
+typedef struct storj_shard_cache {
+    uv_mutex_t lock;
+    char *path;
+    uint64_t max_bytes;
+    uint64_t total_bytes;
+    uint32_t total_entries;
+    /* counter for the names of temporary files */
+    uint32_t writes;
+    shard_cache_entry_t *buckets[STORJ_SHARD_CACHE_BUCKETS];
+    shard_cache_entry_t *lru_head;
+    shard_cache_entry_t *lru_tail;
+} shard_cache_t;
+
+/**
+ * @brief Open a shard cache directory, creating it when missing
+ *
+ * The shards already in the directory are kept, and removed in the order
+ * they were last used if beyond the size of the cache.
+ *
+ * @param[in] loop The event loop used to list the directory
+ * @param[in] path The path of the directory
+ * @param[in] max_bytes The most bytes of shards kept
+ * @return A new cache or NULL on failure
+ */
+shard_cache_t *shard_cache_new(uv_loop_t *loop,
+                               const char *path,
+                               uint64_t max_bytes);
+
+/**
+ * @brief Cleanup a shard cache, the shards are kept in the directory
+ *
+ * @param[in] cache The shard cache, with no transfers using it
+ */
+void shard_cache_destroy(shard_cache_t *cache);
+
+/**
+ * @brief Check if a shard is in the cache
+ *
+ * @param[in] cache The shard cache
+ * @param[in] shard_hash The hash of the shard
+ * @param[in] size The size of the shard
+ * @return true if the shard may be read from the cache
+ */
+bool shard_cache_contains(shard_cache_t *cache,
+                          const char *shard_hash,
+                          uint64_t size);
+
+/**
+ * @brief Read and verify a shard from the cache
+ *
+ * The shard is read into memory, or else into the destination at the
+ * position. A shard that doesn't match its hash is removed.
+ *
+ * @param[in] cache The shard cache
+ * @param[in] shard_hash The hash of the shard
+ * @param[in] size The size of the shard
+ * @param[in] destination The file to write the shard to, or NULL
+ * @param[in] position The position of the shard in the destination
+ * @param[out] data The memory for the shard, or NULL
+ * @return A non-zero error value on failure and 0 on success.
+ */
+int shard_cache_read(shard_cache_t *cache,
+                     const char *shard_hash,
+                     uint64_t size,
+                     FILE *destination,
+                     uint64_t position,
+                     uint8_t *data);
+
+/**
+ * @brief Add a verified shard to the cache
+ *
+ * The shard is copied from memory, or else from the source at the
+ * position, and the least recently used shards are removed to make room
+ * for it.
+ *
+ * @param[in] cache The shard cache
+ * @param[in] shard_hash The hash of the shard
+ * @param[in] size The size of the shard
+ * @param[in] source The file to copy the shard from, or NULL
+ * @param[in] position The position of the shard in the source
+ * @param[in] data The shard in memory, or NULL
+ * @return A non-zero error value on failure and 0 on success.
+ */
+int shard_cache_write(shard_cache_t *cache,
+                      const char *shard_hash,
+                      uint64_t size,
+                      FILE *source,
+                      uint64_t position,
+                      const uint8_t *data);
+
+#endif /* STORJ_CACHE_H */
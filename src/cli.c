@@ -80,7 +80,26 @@ extern int errno;
     "(e.g. https://api.storj.io)\n"                                     \
     "  STORJ_BRIDGE_USER             bridge username\n"                 \
     "  STORJ_BRIDGE_PASS             bridge password\n"                 \
-    "  STORJ_ENCRYPTION_KEY          file encryption key\n\n"
+    "  STORJ_ENCRYPTION_KEY          file encryption key\n"            \
+    "  STORJ_MAX_SHARDS              max shards in flight for all files\n" \
+    "  STORJ_MAX_BYTES_IN_FLIGHT     max shard bytes in flight "        \
+    "for all files\n"                                                  \
+    "  STORJ_POINTER_WINDOW          pages of shard pointers requested " \
+    "ahead\n"                                                          \
+    "  STORJ_HEDGE                   download parity shards only for "  \
+    "slow shards (0 or 1)\n"                                           \
+    "  STORJ_FARMER_CACHE            file to remember slow farmers in\n" \
+    "  STORJ_STREAM                  download files in order with "    \
+    "bounded memory (0 or 1)\n"                                       \
+    "  STORJ_ADAPTIVE_CONCURRENCY    tune the shards in flight of each " \
+    "file (0 or 1)\n"                                                  \
+    "  STORJ_MIN_CONCURRENCY         fewest shards in flight when tuned\n" \
+    "  STORJ_MAX_CONCURRENCY         most shards in flight when tuned\n" \
+    "  STORJ_SHARD_SIZE_POLICY       choose shard sizes by file size "  \
+    "(default) or upload time (throughput)\n"                        \
+    "  STORJ_SHARD_CACHE_SIZE        max bytes of downloaded shards kept " \
+    "for repeat downloads\n"                                           \
+    "  STORJ_SHARD_CACHE             directory to keep the shards in\n\n"
 
 
 #define CLI_VERSION "libstorj-2.0.0-beta2"
@@ -1073,6 +1092,41 @@ int main(int argc, char **argv)
             goto end_program;
         }
 
+        // share a budget of transfers between all of the files
+        storj_transfer_limits_t limits = {
+            .max_shards = 0,
+            .max_bytes = 0
+        };
+
+        char *max_shards = getenv("STORJ_MAX_SHARDS");
+        if (max_shards) {
+            limits.max_shards = strtoul(max_shards, NULL, 10);
+        }
+
+        char *max_bytes = getenv("STORJ_MAX_BYTES_IN_FLIGHT");
+        if (max_bytes) {
+            limits.max_bytes = strtoull(max_bytes, NULL, 10);
+        }
+
+        if (storj_env_set_transfer_limits(env, &limits)) {
+            status = 1;
+            goto end_program;
+        }
+
+        // remember slow and unreachable farmers between runs
+        char *farmer_cache = getenv("STORJ_FARMER_CACHE");
+        if (farmer_cache && storj_env_set_farmer_cache(env, farmer_cache)) {
+            printf("Unable to load farmer cache: %s\n", farmer_cache);
+        }
+
+        // serve repeat downloads from the disk
+        char *shard_cache_size = getenv("STORJ_SHARD_CACHE_SIZE");
+        if (shard_cache_size && strtoull(shard_cache_size, NULL, 10) > 0 &&
+            storj_env_set_shard_cache(env, getenv("STORJ_SHARD_CACHE"),
+                                      strtoull(shard_cache_size, NULL, 10))) {
+            printf("Unable to open shard cache\n");
+        }
+
         cli_api = malloc(sizeof(cli_api_t));
 
         if (!cli_api) {
@@ -1140,7 +1194,7 @@ int main(int argc, char **argv)
                 goto end_program;
             }
 
-            storj_bridge_list_files(env, bucket_id, cli_api, list_files_callback);
+            cli_list_files_pages(cli_api, bucket_id);
         } else if ((strcmp(command, "add-bucket") == 0) || (strcmp(command, "mkbkt") == 0x00)) {
             char *bucket_name = argv[command_index + 1];
 
@@ -1549,18 +1603,17 @@ int main(int argc, char **argv)
 
     // run all queued events
     if (uv_run(env->loop, UV_RUN_DEFAULT)) {
-        uv_loop_close(env->loop);
-
-        // cleanup
-        storj_destroy_env(env);
-
         status = 1;
         goto end_program;
     }
 
 end_program:
     if (env) {
+        uv_loop_t *loop = env->loop;
         storj_destroy_env(env);
+
+        // release the handles closed by the environment
+        uv_run(loop, UV_RUN_NOWAIT);
     }
     if (user) {
         free(user);
@@ -1,4 +1,5 @@
 #include "cli_callback.h"
+#include "scheduler.h"
 #include <dirent.h>
 
 //#define debug_enable
@@ -175,6 +176,65 @@ static void close_signal(uv_handle_t *handle)
     ((void)0);
 }
 
+/** @brief A file of an upload or download command in flight */
+typedef struct {
+    cli_api_t *cli_api;
+    uv_signal_t *sig;
+    char *file_name;
+} cli_file_t;
+
+static void free_signal(uv_handle_t *handle)
+{
+    free(handle);
+}
+
+static void free_cli_file(cli_file_t *file)
+{
+    // the signal handler has already closed a canceled transfer
+    if (!uv_is_closing((uv_handle_t *)file->sig)) {
+        uv_signal_stop(file->sig);
+        uv_close((uv_handle_t *)file->sig, free_signal);
+    }
+    free(file->file_name);
+    free(file);
+}
+
+/*
+ * Get the number of files of a multi-file command transferred at once,
+ * every file needs at least one shard of the transfer limits
+ */
+static int files_in_flight_limit(storj_env_t *env)
+{
+    int limit = CLI_FILES_IN_FLIGHT;
+    transfer_scheduler_t *scheduler = env->scheduler;
+
+    if (scheduler && scheduler->max_shards > 0 &&
+        scheduler->max_shards < (uint32_t)limit) {
+        limit = scheduler->max_shards;
+    }
+
+    return limit;
+}
+
+/* progress bars of files transferred at once would overwrite each other */
+static bool show_file_progress(cli_api_t *cli_api)
+{
+    return cli_api->total_files <= 1 ||
+        files_in_flight_limit(cli_api->env) == 1;
+}
+
+/*
+ * Start the next files of a multi-file command, or continue with the
+ * next command once none of its files are in flight
+ */
+static void queue_next_file_req(cli_api_t *cli_api)
+{
+    if (cli_api->xfer_count < cli_api->total_files ||
+        cli_api->files_in_flight == 0) {
+        queue_next_cmd_req(cli_api);
+    }
+}
+
 static void file_progress(double progress,
                           uint64_t downloaded_bytes,
                           uint64_t total_bytes,
@@ -259,15 +319,29 @@ static int upload_file(storj_env_t *env, char *bucket_id, const char *file_path,
     char *push_frame_limit = getenv("STORJ_PUSH_FRAME_LIMIT");
     char *push_shard_limit = getenv("STORJ_PUSH_SHARD_LIMIT");
     char *rs = getenv("STORJ_REED_SOLOMON");
+    char *single_pass = getenv("STORJ_SINGLE_PASS");
+    char *resume = getenv("STORJ_RESUME");
+    char *adaptive = getenv("STORJ_ADAPTIVE_CONCURRENCY");
+    char *min_concurrency = getenv("STORJ_MIN_CONCURRENCY");
+    char *max_concurrency = getenv("STORJ_MAX_CONCURRENCY");
+    char *shard_size_policy = getenv("STORJ_SHARD_SIZE_POLICY");
 
     storj_upload_opts_t upload_opts = {
         .prepare_frame_limit = (prepare_frame_limit) ? atoi(prepare_frame_limit) : 1,
         .push_frame_limit = (push_frame_limit) ? atoi(push_frame_limit) : 64,
         .push_shard_limit = (push_shard_limit) ? atoi(push_shard_limit) : 64,
         .rs = (!rs) ? true : (strcmp(rs, "false") == 0) ? false : true,
+        .single_pass = (single_pass && strcmp(single_pass, "true") == 0),
+        .resume = (resume && strcmp(resume, "true") == 0),
         .bucket_id = bucket_id,
         .file_name = file_name,
-        .fd = fd
+        .fd = fd,
+        .adaptive_concurrency = (adaptive) ? atoi(adaptive) != 0 : false,
+        .min_concurrency = (min_concurrency) ? atoi(min_concurrency) : 0,
+        .max_concurrency = (max_concurrency) ? atoi(max_concurrency) : 0,
+        .shard_size_policy = (shard_size_policy &&
+                              strcmp(shard_size_policy, "throughput") == 0) ?
+            storj_shard_size_throughput : storj_shard_size_default
     };
 
     uv_signal_t *sig = malloc(sizeof(uv_signal_t));
@@ -301,19 +375,24 @@ static int upload_file(storj_env_t *env, char *bucket_id, const char *file_path,
 
 static void upload_files_complete(int status, storj_file_meta_t *file, void *handle)
 {
-    cli_api_t *cli_api = handle;
+    cli_file_t *upload = handle;
+    cli_api_t *cli_api = upload->cli_api;
     cli_api->rcvd_cmd_resp = "upload-files-resp";
 
     printf("\n");
     if (status != 0) {
-        printf("[%s][%d]Upload failure: %s\n",
-               __FUNCTION__, __LINE__, storj_strerror(status));
+        printf("[%s][%d]Upload failure: %s: %s\n",
+               __FUNCTION__, __LINE__, upload->file_name,
+               storj_strerror(status));
+        cli_api->error_status = status;
     } else {
         printf("Upload Success! File ID: %s\n", file->id);
         storj_free_uploaded_file_info(file);
     }
 
-    queue_next_cmd_req(cli_api);
+    free_cli_file(upload);
+    cli_api->files_in_flight--;
+    queue_next_file_req(cli_api);
 }
 
 static int upload_files(storj_env_t *env, char *bucket_id, const char *file_path, void *handle)
@@ -331,61 +410,89 @@ static int upload_files(storj_env_t *env, char *bucket_id, const char *file_path
            cli_api->xfer_count, cli_api->total_files, file_path);
 
     /* replace the dir with __ */
-    char *s = strstr(cli_api->src_file, cli_api->file_path);
+    char *s = strstr(file_path, cli_api->file_path);
     char *start = s + strlen(cli_api->file_path);
     char tmp_dir[256];
     start = replace_char(start, '/', '_');
     memset(tmp_dir, 0x00, sizeof(tmp_dir));
     strcat(tmp_dir, cli_api->file_path);
     strcat(tmp_dir, start);
-    cli_api->dst_file = tmp_dir;
 
-    const char *file_name = get_filename_separator(cli_api->dst_file);
+    const char *file_name = get_filename_separator(tmp_dir);
 
     if (!file_name) {
         file_name = file_path;
     }
     printf(" %s\n", file_name);
 
+    // the name is used until the upload is done
+    cli_file_t *upload = calloc(1, sizeof(cli_file_t));
+    if (!upload) {
+        fclose(fd);
+        return 1;
+    }
+    upload->cli_api = cli_api;
+    upload->file_name = strdup(file_name);
+    upload->sig = malloc(sizeof(uv_signal_t));
+    if (!upload->file_name || !upload->sig) {
+        free(upload->file_name);
+        free(upload->sig);
+        free(upload);
+        fclose(fd);
+        return 1;
+    }
+
     // Upload opts env variables:
     char *prepare_frame_limit = getenv("STORJ_PREPARE_FRAME_LIMIT");
     char *push_frame_limit = getenv("STORJ_PUSH_FRAME_LIMIT");
     char *push_shard_limit = getenv("STORJ_PUSH_SHARD_LIMIT");
     char *rs = getenv("STORJ_REED_SOLOMON");
+    char *single_pass = getenv("STORJ_SINGLE_PASS");
+    char *resume = getenv("STORJ_RESUME");
+    char *adaptive = getenv("STORJ_ADAPTIVE_CONCURRENCY");
+    char *min_concurrency = getenv("STORJ_MIN_CONCURRENCY");
+    char *max_concurrency = getenv("STORJ_MAX_CONCURRENCY");
+    char *shard_size_policy = getenv("STORJ_SHARD_SIZE_POLICY");
 
     storj_upload_opts_t upload_opts = {
         .prepare_frame_limit = (prepare_frame_limit) ? atoi(prepare_frame_limit) : 1,
         .push_frame_limit = (push_frame_limit) ? atoi(push_frame_limit) : 64,
         .push_shard_limit = (push_shard_limit) ? atoi(push_shard_limit) : 64,
         .rs = (!rs) ? true : (strcmp(rs, "false") == 0) ? false : true,
+        .single_pass = (single_pass && strcmp(single_pass, "true") == 0),
+        .resume = (resume && strcmp(resume, "true") == 0),
         .bucket_id = bucket_id,
-        .file_name = file_name,
-        .fd = fd
+        .file_name = upload->file_name,
+        .fd = fd,
+        .adaptive_concurrency = (adaptive) ? atoi(adaptive) != 0 : false,
+        .min_concurrency = (min_concurrency) ? atoi(min_concurrency) : 0,
+        .max_concurrency = (max_concurrency) ? atoi(max_concurrency) : 0,
+        .shard_size_policy = (shard_size_policy &&
+                              strcmp(shard_size_policy, "throughput") == 0) ?
+            storj_shard_size_throughput : storj_shard_size_default
     };
 
-    uv_signal_t *sig = malloc(sizeof(uv_signal_t));
-    if (!sig) {
-        return 1;
-    }
-    uv_signal_init(env->loop, sig);
-    uv_signal_start(sig, upload_signal_handler, SIGINT);
+    uv_signal_init(env->loop, upload->sig);
+    uv_signal_start(upload->sig, upload_signal_handler, SIGINT);
 
     storj_progress_cb progress_cb = (storj_progress_cb)noop;
-    if (env->log_options->level == 0) {
+    if (env->log_options->level == 0 && show_file_progress(cli_api)) {
         progress_cb = file_progress;
     }
 
     storj_upload_state_t *state = storj_bridge_store_file(env,
                                                           &upload_opts,
-                                                          handle,
+                                                          upload,
                                                           progress_cb,
                                                           upload_files_complete);
 
     if (!state) {
+        free_cli_file(upload);
         return 1;
     }
 
-    sig->data = state;
+    upload->sig->data = state;
+    cli_api->files_in_flight++;
 
     return state->error_status;
 }
@@ -461,28 +568,35 @@ static void verify_upload_files(void *handle)
 
 static void download_file_complete(int status, FILE *fd, void *handle)
 {
-    cli_api_t *cli_api = handle;
+    cli_file_t *download = handle;
+    cli_api_t *cli_api = download->cli_api;
     cli_api->rcvd_cmd_resp = "download-file-resp";
 
-    printf("\n");
+    // keep messages out of a file streamed to stdout
+    FILE *out = (fd == stdout) ? stderr : stdout;
+
+    fprintf(out, "\n");
     fclose(fd);
     if (status) {
         // TODO send to stderr
         switch(status) {
             case STORJ_FILE_DECRYPTION_ERROR:
-                printf("Unable to properly decrypt file, please check " \
-                       "that the correct encryption key was " \
-                       "imported correctly.\n\n");
+                fprintf(out, "Unable to properly decrypt file, please " \
+                        "check that the correct encryption key was " \
+                        "imported correctly.\n\n");
                 break;
             default:
-                printf("[%s][%d]Download failure: %s\n",
-                       __FUNCTION__, __LINE__, storj_strerror(status));
+                fprintf(out, "[%s][%d]Download failure: %s\n",
+                        __FUNCTION__, __LINE__, storj_strerror(status));
         }
+        cli_api->error_status = status;
     } else {
-        printf("Download Success!\n");
+        fprintf(out, "Download Success!\n");
     }
 
-    queue_next_cmd_req(cli_api);
+    free_cli_file(download);
+    cli_api->files_in_flight--;
+    queue_next_file_req(cli_api);
 }
 
 static void download_signal_handler(uv_signal_t *req, int signum)
@@ -498,9 +612,15 @@ static void download_signal_handler(uv_signal_t *req, int signum)
 static int download_file(storj_env_t *env, char *bucket_id,
                          char *file_id, char *path, void *handle)
 {
+    cli_api_t *cli_api = handle;
     FILE *fd = NULL;
+    char *resume = getenv("STORJ_RESUME");
+    bool resume_download = (path && resume && strcmp(resume, "true") == 0);
 
-    if (path) {
+    if (resume_download && access(path, F_OK) != -1) {
+        // Keep the shards of a previous attempt in the file
+        fd = fopen(path, "r+");
+    } else if (path) {
         char user_input[BUFSIZ];
         memset(user_input, '\0', BUFSIZ);
 
@@ -514,9 +634,8 @@ static int download_file(storj_env_t *env, char *bucket_id,
 
             if (strcmp(user_input, "n") == 0) {
                 printf("\nCanceled overwriting of [%s].\n", path);
-                cli_api_t *cli_api = handle;
                 cli_api->rcvd_cmd_resp = "download-file-resp";
-                queue_next_cmd_req(cli_api);
+                queue_next_file_req(cli_api);
                 return 1;
             }
 
@@ -534,23 +653,60 @@ static int download_file(storj_env_t *env, char *bucket_id,
         return 1;
     }
 
-    uv_signal_t *sig = malloc(sizeof(uv_signal_t));
-    uv_signal_init(env->loop, sig);
-    uv_signal_start(sig, download_signal_handler, SIGINT);
+    cli_file_t *download = calloc(1, sizeof(cli_file_t));
+    if (!download) {
+        fclose(fd);
+        return 1;
+    }
+    download->cli_api = cli_api;
+    download->sig = malloc(sizeof(uv_signal_t));
+    if (!download->sig) {
+        free(download);
+        fclose(fd);
+        return 1;
+    }
+    uv_signal_init(env->loop, download->sig);
+    uv_signal_start(download->sig, download_signal_handler, SIGINT);
 
     storj_progress_cb progress_cb = (storj_progress_cb)noop;
-    if (path && env->log_options->level == 0) {
+    if (path && env->log_options->level == 0 && show_file_progress(cli_api)) {
         progress_cb = file_progress;
     }
 
-    storj_download_state_t *state = storj_bridge_resolve_file(env, bucket_id,
-                                                              file_id, fd, handle,
-                                                              progress_cb,
-                                                              download_file_complete);
+    char *pointer_window = getenv("STORJ_POINTER_WINDOW");
+    char *hedge = getenv("STORJ_HEDGE");
+    char *stream = getenv("STORJ_STREAM");
+    char *adaptive = getenv("STORJ_ADAPTIVE_CONCURRENCY");
+    char *min_concurrency = getenv("STORJ_MIN_CONCURRENCY");
+    char *max_concurrency = getenv("STORJ_MAX_CONCURRENCY");
+
+    storj_download_opts_t download_opts = {
+        .bucket_id = bucket_id,
+        .file_id = file_id,
+        .destination = fd,
+        .resume = resume_download,
+        .pointer_window = (pointer_window) ? atoi(pointer_window) : 0,
+        .hedge = (hedge) ? atoi(hedge) != 0 : false,
+        // stdout can only be written in order
+        .stream = (!path || (stream && atoi(stream) != 0)),
+        .write_cb = NULL,
+        .stream_window = 0,
+        .adaptive_concurrency = (adaptive) ? atoi(adaptive) != 0 : false,
+        .min_concurrency = (min_concurrency) ? atoi(min_concurrency) : 0,
+        .max_concurrency = (max_concurrency) ? atoi(max_concurrency) : 0
+    };
+
+    storj_download_state_t *state = storj_bridge_resolve_file_opts(env,
+                                                                   &download_opts,
+                                                                   download,
+                                                                   progress_cb,
+                                                                   download_file_complete);
     if (!state) {
+        free_cli_file(download);
         return 1;
     }
-    sig->data = state;
+    download->sig->data = state;
+    cli_api->files_in_flight++;
 
     return state->error_status;
 }
@@ -800,23 +956,30 @@ void list_files_callback(uv_work_t *work_req, int status)
         printf("Request failed with status code: %i\n", req->status_code);
     }
 
-    if (req->total_files == 0) {
+    if (req->total_files == 0 && cli_api->total_files == 0) {
         printf("No files for bucket.\n");
         goto cleanup;
     }
 
-    cli_api->files = malloc(sizeof(storj_file_meta_t) * req->total_files);
+    storj_file_meta_t *files = realloc(cli_api->files, sizeof(storj_file_meta_t) *
+                                       (cli_api->total_files + req->total_files));
+    if (!files) {
+        printf("Unable to list files, out of memory.\n");
+        goto cleanup;
+    }
+    cli_api->files = files;
 
     for (int i = 0; i < req->total_files; i++) {
 
         storj_file_meta_t *file = &req->files[i];
+        storj_file_meta_t *listed = &cli_api->files[cli_api->total_files + i];
 
-        cli_api->files[i].id = strdup(file->id);
-        cli_api->files[i].size = file->size;
-        cli_api->files[i].filename = strdup(file->id);
-        cli_api->files[i].decrypted = file->decrypted;
-        cli_api->files[i].mimetype = strdup(file->mimetype);
-        cli_api->files[i].created = strdup(file->created);
+        listed->id = strdup(file->id);
+        listed->size = file->size;
+        listed->filename = strdup(file->id);
+        listed->decrypted = file->decrypted;
+        listed->mimetype = strdup(file->mimetype);
+        listed->created = strdup(file->created);
 
         printf("ID: %s \tSize: %" PRIu64 " bytes \tDecrypted: %s \tType: %s \tCreated: %s \tName: %s\n",
                file->id,
@@ -828,7 +991,19 @@ void list_files_callback(uv_work_t *work_req, int status)
     }
 
 
-    cli_api->total_files = req->total_files;
+    cli_api->total_files += req->total_files;
+
+    // request the next page before releasing the marker of this one
+    if (req->next_marker) {
+        if (storj_bridge_list_files_page(cli_api->env, req->bucket_id,
+                                         req->next_marker,
+                                         CLI_LIST_FILES_PAGE_SIZE,
+                                         cli_api, list_files_callback)) {
+            printf("Unable to list the next page of files.\n");
+        }
+        goto cleanup;
+    }
+
     cli_api->xfer_count = 0;
     queue_next_cmd_req(cli_api);
 
@@ -838,6 +1013,16 @@ void list_files_callback(uv_work_t *work_req, int status)
     free(work_req);
 }
 
+int cli_list_files_pages(cli_api_t *cli_api, const char *bucket_id)
+{
+    cli_api->files = NULL;
+    cli_api->total_files = 0;
+
+    return storj_bridge_list_files_page(cli_api->env, bucket_id, NULL,
+                                        CLI_LIST_FILES_PAGE_SIZE,
+                                        cli_api, list_files_callback);
+}
+
 void queue_next_cmd_req(cli_api_t *cli_api)
 {
     void *handle = cli_api->handle;
@@ -869,8 +1054,7 @@ void queue_next_cmd_req(cli_api_t *cli_api)
                 cli_api->final_cmd_req = NULL;
                 cli_api->excp_cmd_resp = "list-files-resp";
 
-                storj_bridge_list_files(cli_api->env, cli_api->bucket_id,
-                                        cli_api, list_files_callback);
+                cli_list_files_pages(cli_api, cli_api->bucket_id);
             } else if ((cli_api->next_cmd_req != NULL) &&
                      (strcmp(cli_api->next_cmd_req, "remove-bucket-req") == 0x00)) {
                 cli_api->curr_cmd_req  = cli_api->next_cmd_req;
@@ -927,39 +1111,47 @@ void queue_next_cmd_req(cli_api_t *cli_api)
                 cli_api->curr_cmd_req  = cli_api->next_cmd_req;
                 cli_api->excp_cmd_resp = "upload-files-resp";
 
+                if (cli_api->xfer_count >= cli_api->total_files) {
+                    printf("[%s][%d] Invalid xfer counts\n", __FUNCTION__, __LINE__);
+                    exit(0);
+                }
+
                 FILE *file = fopen(cli_api->src_list, "r");
 
-                char line[256][256];
+                if (file == NULL) {
+                    printf("[%s][%d]Invalid file path: %s\n",
+                           __FUNCTION__, __LINE__, cli_api->src_list);
+                    exit(0);
+                }
+
+                char line[256];
                 char *temp;
                 int i = 0x00;
+                int limit = files_in_flight_limit(cli_api->env);
                 memset(line, 0x00, sizeof(line));
 
-                if (file != NULL) {
-                    while ((fgets(line[i],sizeof(line), file)!= NULL)) {/* read a line from a file */
-                        temp = strrchr(line[i], '\n');
-                        if (temp) *temp = '\0';
-                        cli_api->src_file = line[i];
-                        i++;
-                        if (i >= cli_api->xfer_count) {
-                            break;
-                        }
+                /* start the files after those already started */
+                while ((cli_api->xfer_count < cli_api->total_files) &&
+                       (cli_api->files_in_flight < limit) &&
+                       (fgets(line, sizeof(line), file) != NULL)) {
+                    if (i++ < cli_api->xfer_count) {
+                        continue;
                     }
-                }
-                fclose(file);
 
-                if (cli_api->xfer_count < cli_api->total_files) {
+                    temp = strrchr(line, '\n');
+                    if (temp) *temp = '\0';
+                    cli_api->src_file = line;
+
                     /* is it the last file ? */
                     if (cli_api->xfer_count == cli_api->total_files - 1) {
                         cli_api->next_cmd_req  = cli_api->final_cmd_req;
                         cli_api->final_cmd_req = NULL;
                     }
 
-                    upload_files(cli_api->env, cli_api->bucket_id, cli_api->src_file, cli_api);
                     cli_api->xfer_count++;
-                } else {
-                    printf("[%s][%d] Invalid xfer counts\n", __FUNCTION__, __LINE__);
-                    exit(0);
+                    upload_files(cli_api->env, cli_api->bucket_id, cli_api->src_file, cli_api);
                 }
+                fclose(file);
             } else if ((cli_api->next_cmd_req != NULL) &&
                      (strcmp(cli_api->next_cmd_req, "download-file-req") == 0x00)) {
                 cli_api->curr_cmd_req  = cli_api->next_cmd_req;
@@ -974,9 +1166,15 @@ void queue_next_cmd_req(cli_api_t *cli_api)
                 cli_api->curr_cmd_req  = cli_api->next_cmd_req;
                 cli_api->excp_cmd_resp = "download-file-resp";
 
-                FILE *file = stdout;
+                if (cli_api->xfer_count >= cli_api->total_files) {
+                    printf("[%s][%d] Invalid xfer counts\n", __FUNCTION__, __LINE__);
+                    exit(0);
+                }
 
-                if (cli_api->xfer_count < cli_api->total_files) {
+                int limit = files_in_flight_limit(cli_api->env);
+
+                while ((cli_api->xfer_count < cli_api->total_files) &&
+                       (cli_api->files_in_flight < limit)) {
 
                     storj_file_meta_t *file = &cli_api->files[cli_api->xfer_count];
 
@@ -986,9 +1184,6 @@ void queue_next_cmd_req(cli_api_t *cli_api)
                         cli_api->final_cmd_req = NULL;
                     }
 
-                    memset(cli_api->file_id, 0x00, sizeof(file->id));
-                    strcpy(cli_api->file_id, file->id);
-
                     char temp_path[1024];
 
                     strcpy(temp_path, cli_api->file_path);
@@ -998,12 +1193,10 @@ void queue_next_cmd_req(cli_api_t *cli_api)
                     strcat(temp_path, file->filename);
 
                     cli_api->xfer_count++;
-                    download_file(cli_api->env, cli_api->bucket_id, cli_api->file_id, temp_path, cli_api);
-
                     fprintf(stdout,"*****[%d:%d] downloading file to: %s *****\n", cli_api->xfer_count, cli_api->total_files, temp_path);
-                } else {
-                    printf("[%s][%d] Invalid xfer counts\n", __FUNCTION__, __LINE__);
-                    exit(0);
+
+                    /* the id of the listed file is kept until the download is done */
+                    download_file(cli_api->env, cli_api->bucket_id, (char *)file->id, temp_path, cli_api);
                 }
 
             } else {
@@ -1011,6 +1204,11 @@ void queue_next_cmd_req(cli_api_t *cli_api)
                 printf("[%s][%d] **** ALL CLEAN & DONE  *****\n", __FUNCTION__, __LINE__);
                 #endif
 
+                if (cli_api->done_cb) {
+                    cli_api->done_cb(cli_api);
+                    return;
+                }
+
                 exit(0);
             }
         } else {
@@ -21,6 +21,9 @@ extern "C" {
 #define CLI_UNKNOWN_FILE_ATTR     0x03
 #define CLI_UPLOAD_FILE_LOG_ERR   0x04
 
+#define CLI_LIST_FILES_PAGE_SIZE  1000
+#define CLI_FILES_IN_FLIGHT       4
+
 /**
  * @brief A Structure for passing the User's Application info to
  *        Storj API.
@@ -40,6 +43,7 @@ typedef struct cli_api {
     char *dst_file;      /**< next file ready to upload */
     int  xfer_count;     /**< # of files xferred (up/down) */
     int  total_files;    /**< total files to upload */
+    int  files_in_flight; /**< # of files being xferred at once */
     char *last_cmd_req;  /**< last command requested */
     char *curr_cmd_req;  /**< cli curr command requested */
     char *next_cmd_req;  /**< cli curr command requested */
@@ -49,6 +53,7 @@ typedef struct cli_api {
     int  error_status;   /**< command response/error status */
     storj_log_levels_t *log;
     void *handle;
+    void (*done_cb)(struct cli_api *cli_api); /**< called instead of exit */
 } cli_api_t;
 
 /**
@@ -101,6 +106,16 @@ int cli_get_bucket_id(cli_api_t *cli_api);
  */
 int cli_list_files(cli_api_t *cli_api);
 
+/**
+ * @brief Function to list the files of a bucket id page by page,
+ *        printing each page as it arrives
+ *
+ * @param[in] cli_api The cli api struct
+ * @param[in] bucket_id The bucket id
+ * @return A non-zero error value on failure and 0 on success.
+ */
+int cli_list_files_pages(cli_api_t *cli_api, const char *bucket_id);
+
 /**
  * @brief Function to remove a given bucket name 
  * 
@@ -0,0 +1,161 @@
+#include "codecs.h"
+
+codec_cache_t *codec_cache_new()
+{
+    codec_cache_t *cache = calloc(1, sizeof(codec_cache_t));
+    if (!cache) {
+        return NULL;
+    }
+
+    if (uv_mutex_init(&cache->lock)) {
+        free(cache);
+        return NULL;
+    }
+
+    // initialized once here rather than by every transfer
+    fec_init();
+
+    return cache;
+}
+
+void codec_cache_destroy(codec_cache_t *cache)
+{
+    if (!cache) {
+        return;
+    }
+
+    codec_entry_t *codec = cache->codecs;
+    while (codec) {
+        codec_entry_t *next_codec = codec->next;
+
+        decoder_entry_t *entry = codec->decoders;
+        while (entry) {
+            decoder_entry_t *next = entry->next;
+            reed_solomon_decoder_release(entry->decoder);
+            free(entry->marks);
+            free(entry);
+            entry = next;
+        }
+
+        reed_solomon_release(codec->rs);
+        free(codec);
+        codec = next_codec;
+    }
+
+    uv_mutex_destroy(&cache->lock);
+    free(cache);
+}
+
+reed_solomon *codec_cache_get(codec_cache_t *cache,
+                              int data_shards,
+                              int parity_shards)
+{
+    reed_solomon *rs = NULL;
+
+    uv_mutex_lock(&cache->lock);
+
+    codec_entry_t *codec = cache->codecs;
+    while (codec && (codec->rs->data_shards != data_shards ||
+                     codec->rs->parity_shards != parity_shards)) {
+        codec = codec->next;
+    }
+
+    if (!codec) {
+        codec = calloc(1, sizeof(codec_entry_t));
+        if (!codec) {
+            goto cleanup;
+        }
+
+        codec->rs = reed_solomon_new(data_shards, parity_shards);
+        if (!codec->rs) {
+            free(codec);
+            goto cleanup;
+        }
+
+        codec->next = cache->codecs;
+        cache->codecs = codec;
+    }
+
+    rs = codec->rs;
+
+cleanup:
+    uv_mutex_unlock(&cache->lock);
+
+    return rs;
+}
+
+reed_solomon_decoder *codec_cache_get_decoder(codec_cache_t *cache,
+                                              reed_solomon *rs,
+                                              uint8_t *marks,
+                                              bool *owned)
+{
+    reed_solomon_decoder *decoder = NULL;
+    *owned = false;
+
+    // marks are compared as 0 or 1
+    uint8_t key[DATA_SHARDS_MAX];
+    for (int i = 0; i < rs->shards; i++) {
+        key[i] = marks[i] ? 1 : 0;
+    }
+
+    uv_mutex_lock(&cache->lock);
+
+    codec_entry_t *codec = cache->codecs;
+    while (codec && codec->rs != rs) {
+        codec = codec->next;
+    }
+
+    if (!codec) {
+        goto cleanup;
+    }
+
+    decoder_entry_t *entry = codec->decoders;
+    while (entry && memcmp(entry->marks, key, rs->shards) != 0) {
+        entry = entry->next;
+    }
+
+    if (entry) {
+        decoder = entry->decoder;
+        goto cleanup;
+    }
+
+    decoder = reed_solomon_decoder_new(rs, key);
+    if (!decoder) {
+        goto cleanup;
+    }
+
+    if (codec->total_decoders >= STORJ_CODEC_CACHE_DECODERS) {
+        *owned = true;
+        goto cleanup;
+    }
+
+    entry = calloc(1, sizeof(decoder_entry_t));
+    if (!entry) {
+        *owned = true;
+        goto cleanup;
+    }
+
+    entry->marks = malloc(rs->shards);
+    if (!entry->marks) {
+        free(entry);
+        *owned = true;
+        goto cleanup;
+    }
+
+    memcpy(entry->marks, key, rs->shards);
+    entry->decoder = decoder;
+    entry->next = codec->decoders;
+    codec->decoders = entry;
+    codec->total_decoders += 1;
+
+cleanup:
+    uv_mutex_unlock(&cache->lock);
+
+    if (!codec) {
+        // a codec that isn't from the cache
+        decoder = reed_solomon_decoder_new(rs, key);
+        *owned = decoder != NULL;
+    }
+
+    return decoder;
+}
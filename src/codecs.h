@@ -0,0 +1,87 @@
+/**
+ * @file codecs.h
+ * @brief Storj Reed-Solomon codec cache.
+ *
+ * Files of an environment mostly share the same shard geometry, and the
+ * shards lost from them the same patterns. The codecs for each geometry,
+ * and the decoders for each pattern of missing shards, are created once
+ * and kept for all transfers of the environment.
+ */
+#ifndef STORJ_CODECS_H
+#define STORJ_CODECS_H
+
+#include "storj.h"
+#include "rs.h"
+
+// Decoders kept for each geometry, others are created for each use
+#define STORJ_CODEC_CACHE_DECODERS 64
+
+/** @brief A decoder for one pattern of missing shards */
+typedef struct storj_decoder_entry {
+    uint8_t *marks;
+    reed_solomon_decoder *decoder;
+    struct storj_decoder_entry *next;
+} decoder_entry_t;
+
+/** @brief A codec for one geometry and its decoders */
+typedef struct storj_codec_entry {
+    reed_solomon *rs;
+    decoder_entry_t *decoders;
+    uint32_t total_decoders;
+    struct storj_codec_entry *next;
+} codec_entry_t;
+
+/** @brief The codecs of an environment, which may be used from any thread.
+ *
+ * The codecs and decoders are not modified once created, and are only
+ * freed with the cache, so they can be used without holding the lock.
+ */
+typedef struct storj_codec_cache {
+    uv_mutex_t lock;
+    codec_entry_t *codecs;
+} codec_cache_t;
+
+/**
+ * @brief Create an empty codec cache
+ *
+ * @return A new cache or NULL on failure
+ */
+codec_cache_t *codec_cache_new();
+
+/**
+ * @brief Free a codec cache and all of its codecs and decoders
+ *
+ * @param[in] cache The codec cache, with no transfers using it
+ */
+void codec_cache_destroy(codec_cache_t *cache);
+
+/**
+ * @brief Get the codec for a geometry
+ *
+ * @param[in] cache The codec cache
+ * @param[in] data_shards The total number of data shards
+ * @param[in] parity_shards The total number of parity shards
+ * @return The codec, owned by the cache, or NULL on failure
+ */
+reed_solomon *codec_cache_get(codec_cache_t *cache,
+                              int data_shards,
+                              int parity_shards);
+
+/**
+ * @brief Get the decoder for a pattern of missing shards
+ *
+ * When the cache already has STORJ_CODEC_CACHE_DECODERS decoders for the
+ * codec, a decoder is created that must be freed by the caller.
+ *
+ * @param[in] cache The codec cache
+ * @param[in] rs A codec from the cache
+ * @param[in] marks An array of rs->shards with 1 used to mark missing shards
+ * @param[out] owned If the decoder must be freed by the caller
+ * @return The decoder or NULL if the shards can't be repaired
+ */
+reed_solomon_decoder *codec_cache_get_decoder(codec_cache_t *cache,
+                                              reed_solomon *rs,
+                                              uint8_t *marks,
+                                              bool *owned);
+
+#endif /* STORJ_CODECS_H */
@@ -1,5 +1,11 @@
 #include "crypto.h"
 
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define STORJ_SHA_NI 1
+#include <cpuid.h>
+#include <immintrin.h>
+#endif
+
 int ripemd160sha256_as_string(uint8_t *data, uint64_t data_size, char *digest)
 {
     uint8_t *ripemd160_digest = calloc(RIPEMD160_DIGEST_SIZE, sizeof(char));
@@ -89,127 +95,242 @@ int double_ripemd160sha256_as_string(uint8_t *data, uint64_t data_size,
     return 0;
 }
 
-int generate_bucket_key(const char *mnemonic, const char *bucket_id,
-                        char **bucket_key)
+static int derive_bucket_keys(const char *seed, const char *bucket_id,
+                              storj_bucket_keys_t *keys)
+{
+    char *bucket_key = keys->bucket_key;
+    int status = get_deterministic_key(seed, 128, bucket_id, &bucket_key);
+    if (status) {
+        return status;
+    }
+    keys->bucket_key[DETERMINISTIC_KEY_SIZE] = '\0';
+
+    uint8_t *bucket_key_raw = str2hex(DETERMINISTIC_KEY_SIZE, keys->bucket_key);
+    if (!bucket_key_raw) {
+        return 1;
+    }
+    memcpy(keys->bucket_key_raw, bucket_key_raw, DETERMINISTIC_KEY_HEX_SIZE);
+    memset_zero(bucket_key_raw, DETERMINISTIC_KEY_HEX_SIZE);
+    free(bucket_key_raw);
+
+    // Get encryption key with first half of hmac w/ magic
+    struct hmac_sha512_ctx ctx1;
+    hmac_sha512_set_key(&ctx1, SHA256_DIGEST_SIZE, keys->bucket_key_raw);
+    hmac_sha512_update(&ctx1, SHA256_DIGEST_SIZE, BUCKET_META_MAGIC);
+    hmac_sha512_digest(&ctx1, SHA256_DIGEST_SIZE, keys->name_key);
+    memset_zero(&ctx1, sizeof(ctx1));
+
+    return 0;
+}
+
+static char *derive_seed(const char *mnemonic)
 {
-    int status = 0;
     char *seed = calloc(128 + 1, sizeof(char));
     if (!seed) {
-        status = 1;
-        goto cleanup;
+        return NULL;
     }
     mnemonic_to_seed(mnemonic, "", &seed);
     seed[128] = '\0';
 
-    status = get_deterministic_key(seed, 128, bucket_id, bucket_key);
-
-cleanup:
-
-    if (seed) {
-        memset_zero(seed, 128 + 1);
-        free(seed);
-    }
+    return seed;
+}
 
-    return status;
+static void free_seed(char *seed)
+{
+    memset_zero(seed, 128 + 1);
+    free(seed);
 }
 
-int generate_file_key(const char *mnemonic, const char *bucket_id,
-                      const char *index, char **file_key)
+/* Copies the keys of a bucket into keys, to be zeroed by the caller */
+static int get_bucket_keys(storj_key_cache_t *cache, const char *mnemonic,
+                           const char *bucket_id, storj_bucket_keys_t *keys)
 {
     int status = 0;
-    char *bucket_key = calloc(DETERMINISTIC_KEY_SIZE + 1, sizeof(char));
-    if (!bucket_key) {
-        status = 1;
-        goto cleanup;
+
+    memset(keys, 0, sizeof(storj_bucket_keys_t));
+
+    if (!cache) {
+        char *seed = derive_seed(mnemonic);
+        if (!seed) {
+            return 1;
+        }
+        status = derive_bucket_keys(seed, bucket_id, keys);
+        free_seed(seed);
+        return status;
     }
 
-    status = generate_bucket_key(mnemonic, bucket_id, &bucket_key);
-    if (status) {
-        goto cleanup;
+    uv_mutex_lock(&cache->lock);
+
+    storj_bucket_keys_t *entry = cache->buckets;
+    while (entry && strcmp(entry->bucket_id, bucket_id) != 0) {
+        entry = entry->next;
     }
-    bucket_key[DETERMINISTIC_KEY_SIZE] = '\0';
 
-    get_deterministic_key(bucket_key, 64, index, file_key);
+    if (!entry) {
+        if (!cache->seed) {
+            cache->seed = derive_seed(mnemonic);
+            if (!cache->seed) {
+                status = 1;
+                goto cleanup;
+            }
+        }
 
-cleanup:
+        entry = calloc(1, sizeof(storj_bucket_keys_t));
+        if (!entry) {
+            status = 1;
+            goto cleanup;
+        }
+
+        entry->bucket_id = strdup(bucket_id);
+        if (!entry->bucket_id) {
+            free(entry);
+            entry = NULL;
+            status = 1;
+            goto cleanup;
+        }
+
+        status = derive_bucket_keys(cache->seed, bucket_id, entry);
+        if (status) {
+            free(entry->bucket_id);
+            memset_zero(entry, sizeof(storj_bucket_keys_t));
+            free(entry);
+            entry = NULL;
+            goto cleanup;
+        }
 
-    if (bucket_key) {
-        memset_zero(bucket_key, DETERMINISTIC_KEY_SIZE + 1);
-        free(bucket_key);
+        entry->next = cache->buckets;
+        cache->buckets = entry;
     }
 
+    memcpy(keys, entry, sizeof(storj_bucket_keys_t));
+    keys->bucket_id = NULL;
+    keys->next = NULL;
+
+cleanup:
+    uv_mutex_unlock(&cache->lock);
+
     return status;
 }
 
-int decrypt_bucket_name(const char *mnemonic, const char *encrypted_name, char **decrypted_name) {
-    return decrypt_file_name(mnemonic, BUCKET_NAME_MAGIC, encrypted_name, decrypted_name);
+storj_key_cache_t *key_cache_new()
+{
+    storj_key_cache_t *cache = calloc(1, sizeof(storj_key_cache_t));
+    if (!cache) {
+        return NULL;
+    }
+
+    if (uv_mutex_init(&cache->lock)) {
+        free(cache);
+        return NULL;
+    }
+
+    return cache;
 }
 
-int decrypt_file_name(const char *mnemonic, const char* bucket_id,
-                      const char *encrypted_name, char **decrypted_name) {
-    int status = 0;
+void key_cache_destroy(storj_key_cache_t *cache)
+{
+    if (!cache) {
+        return;
+    }
 
-    // Derive a key based on the bucket id
-    char *bucket_key_as_str = calloc(DETERMINISTIC_KEY_SIZE + 1, sizeof(char));
-    generate_bucket_key(mnemonic, bucket_id, &bucket_key_as_str);
+    if (cache->seed) {
+        free_seed(cache->seed);
+    }
 
-    uint8_t *bucket_key = str2hex(strlen(bucket_key_as_str), bucket_key_as_str);
-    if (!bucket_key) {
-        status = 1;
-        goto cleanup;
+    storj_bucket_keys_t *entry = cache->buckets;
+    while (entry) {
+        storj_bucket_keys_t *next = entry->next;
+        free(entry->bucket_id);
+        memset_zero(entry, sizeof(storj_bucket_keys_t));
+        free(entry);
+        entry = next;
     }
 
-    // Get encryption key with first half of hmac w/ magic
-    struct hmac_sha512_ctx ctx1;
-    hmac_sha512_set_key(&ctx1, SHA256_DIGEST_SIZE, bucket_key);
-    hmac_sha512_update(&ctx1, SHA256_DIGEST_SIZE, BUCKET_META_MAGIC);
-    uint8_t key[SHA256_DIGEST_SIZE];
-    hmac_sha512_digest(&ctx1, SHA256_DIGEST_SIZE, key);
+    uv_mutex_destroy(&cache->lock);
+    free(cache);
+}
 
-    status = decrypt_meta(encrypted_name, key, decrypted_name);
+int generate_bucket_key_cached(storj_key_cache_t *cache, const char *mnemonic,
+                               const char *bucket_id, char **bucket_key)
+{
+    storj_bucket_keys_t keys;
+    int status = get_bucket_keys(cache, mnemonic, bucket_id, &keys);
+    if (!status) {
+        memcpy(*bucket_key, keys.bucket_key, DETERMINISTIC_KEY_SIZE);
+    }
+    memset_zero(&keys, sizeof(keys));
 
-cleanup:
+    return status;
+}
+
+int generate_bucket_key(const char *mnemonic, const char *bucket_id,
+                        char **bucket_key)
+{
+    return generate_bucket_key_cached(NULL, mnemonic, bucket_id, bucket_key);
+}
 
-    if (bucket_key) {
-        memset_zero(bucket_key, BASE16_DECODE_LENGTH(strlen(bucket_key_as_str)) + 1);
-        free(bucket_key);
+int generate_file_key_cached(storj_key_cache_t *cache, const char *mnemonic,
+                             const char *bucket_id, const char *index,
+                             char **file_key)
+{
+    storj_bucket_keys_t keys;
+    int status = get_bucket_keys(cache, mnemonic, bucket_id, &keys);
+    if (!status) {
+        get_deterministic_key(keys.bucket_key, 64, index, file_key);
     }
-    if (bucket_key_as_str) {
-        memset_zero(bucket_key_as_str, DETERMINISTIC_KEY_SIZE + 1);
-        free(bucket_key_as_str);
+    memset_zero(&keys, sizeof(keys));
+
+    return status;
+}
+
+int generate_file_key(const char *mnemonic, const char *bucket_id,
+                      const char *index, char **file_key)
+{
+    return generate_file_key_cached(NULL, mnemonic, bucket_id, index, file_key);
+}
+
+int decrypt_bucket_name(const char *mnemonic, const char *encrypted_name, char **decrypted_name) {
+    return decrypt_file_name(mnemonic, BUCKET_NAME_MAGIC, encrypted_name, decrypted_name);
+}
+
+int decrypt_file_name_cached(storj_key_cache_t *cache, const char *mnemonic,
+                             const char *bucket_id,
+                             const char *encrypted_name,
+                             char **decrypted_name) {
+    // Derive a key based on the bucket id
+    storj_bucket_keys_t keys;
+    int status = get_bucket_keys(cache, mnemonic, bucket_id, &keys);
+    if (!status) {
+        status = decrypt_meta(encrypted_name, keys.name_key, decrypted_name);
     }
+    memset_zero(&keys, sizeof(keys));
 
     return status;
 }
 
+int decrypt_file_name(const char *mnemonic, const char* bucket_id,
+                      const char *encrypted_name, char **decrypted_name) {
+    return decrypt_file_name_cached(NULL, mnemonic, bucket_id, encrypted_name,
+                                    decrypted_name);
+}
+
 int encrypt_bucket_name(const char *mnemonic, const char *bucket_name, char **encrypted_name) {
     return encrypt_file_name(mnemonic, BUCKET_NAME_MAGIC, bucket_name, encrypted_name);
 }
 
-int encrypt_file_name(const char *mnemonic, const char* bucket_id,
-                      const char *file_name, char **encrypted_name) {
-    int status = 0;
-
+int encrypt_file_name_cached(storj_key_cache_t *cache, const char *mnemonic,
+                             const char *bucket_id, const char *file_name,
+                             char **encrypted_name) {
     // Derive a key based on the bucket id
-    char *bucket_key_as_str = calloc(DETERMINISTIC_KEY_SIZE + 1, sizeof(char));
-    generate_bucket_key(mnemonic, bucket_id, &bucket_key_as_str);
-
-    uint8_t *bucket_key = str2hex(strlen(bucket_key_as_str), bucket_key_as_str);
-    if (!bucket_key) {
-        status = 1;
+    storj_bucket_keys_t keys;
+    int status = get_bucket_keys(cache, mnemonic, bucket_id, &keys);
+    if (status) {
         goto cleanup;
     }
 
-    // Get encryption key with first half of hmac w/ magic
-    struct hmac_sha512_ctx ctx1;
-    hmac_sha512_set_key(&ctx1, SHA256_DIGEST_SIZE, bucket_key);
-    hmac_sha512_update(&ctx1, SHA256_DIGEST_SIZE, BUCKET_META_MAGIC);
-    uint8_t key[SHA256_DIGEST_SIZE];
-    hmac_sha512_digest(&ctx1, SHA256_DIGEST_SIZE, key);
-
     // Generate the synthetic iv with first half of hmac w/ bucket and filename
     struct hmac_sha512_ctx ctx2;
-    hmac_sha512_set_key(&ctx2, SHA256_DIGEST_SIZE, bucket_key);
+    hmac_sha512_set_key(&ctx2, SHA256_DIGEST_SIZE, keys.bucket_key_raw);
     if (strcmp(bucket_id, BUCKET_NAME_MAGIC)) {
         hmac_sha512_update(&ctx2, strlen(bucket_id), (uint8_t *) bucket_id);
     }
@@ -217,22 +338,20 @@ int encrypt_file_name(const char *mnemonic, const char* bucket_id,
     uint8_t iv[SHA256_DIGEST_SIZE];
     hmac_sha512_digest(&ctx2, SHA256_DIGEST_SIZE, iv);
 
-    status = encrypt_meta(file_name, key, iv, encrypted_name);
+    status = encrypt_meta(file_name, keys.name_key, iv, encrypted_name);
 
 cleanup:
-
-    if (bucket_key) {
-        memset_zero(bucket_key, BASE16_DECODE_LENGTH(strlen(bucket_key_as_str)) + 1);
-        free(bucket_key);
-    }
-    if (bucket_key_as_str) {
-        memset_zero(bucket_key_as_str, DETERMINISTIC_KEY_SIZE + 1);
-        free(bucket_key_as_str);
-    }
+    memset_zero(&keys, sizeof(keys));
 
     return status;
 }
 
+int encrypt_file_name(const char *mnemonic, const char* bucket_id,
+                      const char *file_name, char **encrypted_name) {
+    return encrypt_file_name_cached(NULL, mnemonic, bucket_id, file_name,
+                                    encrypted_name);
+}
+
 int get_deterministic_key(const char *key, int key_len,
                           const char *id, char **buffer)
 {
@@ -322,6 +441,348 @@ void pbkdf2_hmac_sha512 (
     SHA512_DIGEST_SIZE, iterations, salt_length, salt, length, dst);
 }
 
+static const uint32_t sha256_k[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5,
+    0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+    0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc,
+    0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7,
+    0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+    0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3,
+    0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5,
+    0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+    0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+static const uint32_t sha256_h0[8] = {
+    0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+    0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+};
+
+#define SHA256_ROTR(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+
+static void sha256_schedule(uint32_t *w, const uint8_t *block)
+{
+    for (int t = 0; t < 16; t++) {
+        w[t] = ((uint32_t)block[t * 4] << 24) |
+            ((uint32_t)block[t * 4 + 1] << 16) |
+            ((uint32_t)block[t * 4 + 2] << 8) |
+            (uint32_t)block[t * 4 + 3];
+    }
+
+    for (int t = 16; t < 64; t++) {
+        uint32_t s0 = SHA256_ROTR(w[t - 15], 7) ^
+            SHA256_ROTR(w[t - 15], 18) ^ (w[t - 15] >> 3);
+        uint32_t s1 = SHA256_ROTR(w[t - 2], 17) ^
+            SHA256_ROTR(w[t - 2], 19) ^ (w[t - 2] >> 10);
+        w[t] = w[t - 16] + s0 + w[t - 7] + s1;
+    }
+}
+
+/*
+ * Compress the same block into every lane. The loop over the lanes is
+ * innermost with a constant bound, so the compiler can keep the lanes in
+ * vector registers.
+ */
+static void sha256_compress_lanes_generic(uint32_t state[][8],
+                                          const uint8_t *block)
+{
+    uint32_t w[64];
+    sha256_schedule(w, block);
+
+    uint32_t a[STORJ_SHA256_LANES], b[STORJ_SHA256_LANES];
+    uint32_t c[STORJ_SHA256_LANES], d[STORJ_SHA256_LANES];
+    uint32_t e[STORJ_SHA256_LANES], f[STORJ_SHA256_LANES];
+    uint32_t g[STORJ_SHA256_LANES], h[STORJ_SHA256_LANES];
+
+    for (int l = 0; l < STORJ_SHA256_LANES; l++) {
+        a[l] = state[l][0];
+        b[l] = state[l][1];
+        c[l] = state[l][2];
+        d[l] = state[l][3];
+        e[l] = state[l][4];
+        f[l] = state[l][5];
+        g[l] = state[l][6];
+        h[l] = state[l][7];
+    }
+
+    for (int t = 0; t < 64; t++) {
+        uint32_t kw = sha256_k[t] + w[t];
+
+        for (int l = 0; l < STORJ_SHA256_LANES; l++) {
+            uint32_t s1 = SHA256_ROTR(e[l], 6) ^ SHA256_ROTR(e[l], 11) ^
+                SHA256_ROTR(e[l], 25);
+            uint32_t ch = (e[l] & f[l]) ^ (~e[l] & g[l]);
+            uint32_t t1 = h[l] + s1 + ch + kw;
+            uint32_t s0 = SHA256_ROTR(a[l], 2) ^ SHA256_ROTR(a[l], 13) ^
+                SHA256_ROTR(a[l], 22);
+            uint32_t maj = (a[l] & b[l]) ^ (a[l] & c[l]) ^ (b[l] & c[l]);
+
+            h[l] = g[l];
+            g[l] = f[l];
+            f[l] = e[l];
+            e[l] = d[l] + t1;
+            d[l] = c[l];
+            c[l] = b[l];
+            b[l] = a[l];
+            a[l] = t1 + s0 + maj;
+        }
+    }
+
+    for (int l = 0; l < STORJ_SHA256_LANES; l++) {
+        state[l][0] += a[l];
+        state[l][1] += b[l];
+        state[l][2] += c[l];
+        state[l][3] += d[l];
+        state[l][4] += e[l];
+        state[l][5] += f[l];
+        state[l][6] += g[l];
+        state[l][7] += h[l];
+    }
+}
+
+#ifdef STORJ_SHA_NI
+static bool sha_ni_supported()
+{
+    unsigned int eax, ebx, ecx, edx;
+
+    if (__get_cpuid_max(0, NULL) < 7) {
+        return false;
+    }
+
+    __cpuid(1, eax, ebx, ecx, edx);
+    if (!(ecx & bit_SSSE3) || !(ecx & bit_SSE4_1)) {
+        return false;
+    }
+
+    __cpuid_count(7, 0, eax, ebx, ecx, edx);
+
+    // the sha extensions
+    return (ebx & (1 << 29)) != 0;
+}
+
+/*
+ * The same as sha256_compress_lanes_generic with the sha extensions. The
+ * message schedule is expanded once, and the rounds of the lanes are
+ * interleaved to hide the latency of each round.
+ */
+__attribute__((target("sha,sse4.1,ssse3")))
+static void sha256_compress_lanes_sha_ni(uint32_t state[][8],
+                                         const uint8_t *block)
+{
+    const __m128i mask = _mm_set_epi64x(0x0c0d0e0f08090a0bULL,
+                                        0x0405060700010203ULL);
+    __m128i w[16];
+
+    for (int i = 0; i < 4; i++) {
+        w[i] = _mm_loadu_si128((const __m128i *)(block + i * 16));
+        w[i] = _mm_shuffle_epi8(w[i], mask);
+    }
+
+    for (int i = 4; i < 16; i++) {
+        __m128i t = _mm_sha256msg1_epu32(w[i - 4], w[i - 3]);
+        t = _mm_add_epi32(t, _mm_alignr_epi8(w[i - 1], w[i - 2], 4));
+        w[i] = _mm_sha256msg2_epu32(t, w[i - 1]);
+    }
+
+    for (int i = 0; i < 16; i++) {
+        w[i] = _mm_add_epi32(w[i],
+                             _mm_loadu_si128((const __m128i *)&sha256_k[i * 4]));
+    }
+
+    // the state of each lane as ABEF and CDGH
+    __m128i abef[STORJ_SHA256_LANES], cdgh[STORJ_SHA256_LANES];
+    __m128i abef_save[STORJ_SHA256_LANES], cdgh_save[STORJ_SHA256_LANES];
+
+    for (int l = 0; l < STORJ_SHA256_LANES; l++) {
+        __m128i cdab = _mm_loadu_si128((const __m128i *)&state[l][0]);
+        __m128i efgh = _mm_loadu_si128((const __m128i *)&state[l][4]);
+        cdab = _mm_shuffle_epi32(cdab, 0xB1);
+        efgh = _mm_shuffle_epi32(efgh, 0x1B);
+
+        abef[l] = _mm_alignr_epi8(cdab, efgh, 8);
+        cdgh[l] = _mm_blend_epi16(efgh, cdab, 0xF0);
+        abef_save[l] = abef[l];
+        cdgh_save[l] = cdgh[l];
+    }
+
+    for (int i = 0; i < 16; i++) {
+        __m128i low = w[i];
+        __m128i high = _mm_shuffle_epi32(w[i], 0x0E);
+
+        for (int l = 0; l < STORJ_SHA256_LANES; l++) {
+            cdgh[l] = _mm_sha256rnds2_epu32(cdgh[l], abef[l], low);
+        }
+        for (int l = 0; l < STORJ_SHA256_LANES; l++) {
+            abef[l] = _mm_sha256rnds2_epu32(abef[l], cdgh[l], high);
+        }
+    }
+
+    for (int l = 0; l < STORJ_SHA256_LANES; l++) {
+        __m128i feba = _mm_add_epi32(abef[l], abef_save[l]);
+        __m128i dchg = _mm_add_epi32(cdgh[l], cdgh_save[l]);
+        feba = _mm_shuffle_epi32(feba, 0x1B);
+        dchg = _mm_shuffle_epi32(dchg, 0xB1);
+
+        _mm_storeu_si128((__m128i *)&state[l][0],
+                         _mm_blend_epi16(feba, dchg, 0xF0));
+        _mm_storeu_si128((__m128i *)&state[l][4],
+                         _mm_alignr_epi8(dchg, feba, 8));
+    }
+}
+#endif
+
+static void sha256_compress_lanes(sha256_lanes_ctx_t *ctx,
+                                  uint32_t state[][8],
+                                  const uint8_t *block)
+{
+#ifdef STORJ_SHA_NI
+    if (ctx->sha_ni) {
+        sha256_compress_lanes_sha_ni(state, block);
+        return;
+    }
+#endif
+    sha256_compress_lanes_generic(state, block);
+}
+
+/* Compress a block of each lane, which differ by their prefixes */
+static void sha256_compress_distinct(sha256_lanes_ctx_t *ctx)
+{
+    uint32_t lane_state[STORJ_SHA256_LANES][8];
+
+    for (unsigned int l = 0; l < ctx->lanes; l++) {
+        memcpy(lane_state, ctx->state, sizeof(lane_state));
+        sha256_compress_lanes(ctx, lane_state, ctx->block[l]);
+        memcpy(ctx->state[l], lane_state[l], sizeof(ctx->state[l]));
+    }
+}
+
+static void sha256_lanes_buffer(sha256_lanes_ctx_t *ctx, size_t length,
+                                const uint8_t *data)
+{
+    unsigned int lanes = ctx->distinct ? ctx->lanes : 1;
+    for (unsigned int l = 0; l < lanes; l++) {
+        memcpy(ctx->block[l] + ctx->index, data, length);
+    }
+    ctx->index += length;
+
+    if (ctx->index == SHA256_BLOCK_SIZE) {
+        if (ctx->distinct) {
+            sha256_compress_distinct(ctx);
+        } else {
+            sha256_compress_lanes(ctx, ctx->state, ctx->block[0]);
+        }
+        ctx->count += 1;
+        ctx->index = 0;
+        ctx->distinct = false;
+    }
+}
+
+int sha256_lanes_init(sha256_lanes_ctx_t *ctx,
+                      unsigned int lanes,
+                      const uint8_t **prefixes,
+                      size_t prefix_length)
+{
+    if (lanes == 0 || lanes > STORJ_SHA256_LANES) {
+        return 1;
+    }
+
+    memset(ctx, 0, sizeof(sha256_lanes_ctx_t));
+    ctx->lanes = lanes;
+#ifdef STORJ_SHA_NI
+    ctx->sha_ni = sha_ni_supported();
+#endif
+
+    for (int l = 0; l < STORJ_SHA256_LANES; l++) {
+        memcpy(ctx->state[l], sha256_h0, sizeof(sha256_h0));
+    }
+
+    // the prefixes are buffered a block at a time in every lane
+    size_t position = 0;
+    while (position < prefix_length) {
+        size_t length = SHA256_BLOCK_SIZE - ctx->index;
+        if (length > prefix_length - position) {
+            length = prefix_length - position;
+        }
+
+        for (unsigned int l = 0; l < lanes; l++) {
+            memcpy(ctx->block[l] + ctx->index, prefixes[l] + position, length);
+        }
+        ctx->index += length;
+        ctx->distinct = true;
+        position += length;
+
+        if (ctx->index == SHA256_BLOCK_SIZE) {
+            sha256_compress_distinct(ctx);
+            ctx->count += 1;
+            ctx->index = 0;
+            ctx->distinct = false;
+        }
+    }
+
+    return 0;
+}
+
+void sha256_lanes_update(sha256_lanes_ctx_t *ctx, size_t length,
+                         const uint8_t *data)
+{
+    if (ctx->index > 0) {
+        size_t fill = SHA256_BLOCK_SIZE - ctx->index;
+        if (fill > length) {
+            fill = length;
+        }
+        sha256_lanes_buffer(ctx, fill, data);
+        data += fill;
+        length -= fill;
+    }
+
+    // whole blocks are the same in every lane
+    while (length >= SHA256_BLOCK_SIZE) {
+        sha256_compress_lanes(ctx, ctx->state, data);
+        ctx->count += 1;
+        data += SHA256_BLOCK_SIZE;
+        length -= SHA256_BLOCK_SIZE;
+    }
+
+    if (length > 0) {
+        sha256_lanes_buffer(ctx, length, data);
+    }
+}
+
+void sha256_lanes_digest(sha256_lanes_ctx_t *ctx,
+                         uint8_t digests[][SHA256_DIGEST_SIZE])
+{
+    uint64_t bits = (ctx->count * SHA256_BLOCK_SIZE + ctx->index) * 8;
+
+    uint8_t padding[SHA256_BLOCK_SIZE * 2];
+    memset(padding, 0, sizeof(padding));
+    padding[0] = 0x80;
+
+    size_t length = (ctx->index < 56) ?
+        56 - ctx->index : SHA256_BLOCK_SIZE + 56 - ctx->index;
+
+    for (int i = 0; i < 8; i++) {
+        padding[length + i] = (uint8_t)(bits >> (56 - i * 8));
+    }
+
+    sha256_lanes_update(ctx, length + 8, padding);
+
+    for (unsigned int l = 0; l < ctx->lanes; l++) {
+        for (int i = 0; i < 8; i++) {
+            digests[l][i * 4] = (uint8_t)(ctx->state[l][i] >> 24);
+            digests[l][i * 4 + 1] = (uint8_t)(ctx->state[l][i] >> 16);
+            digests[l][i * 4 + 2] = (uint8_t)(ctx->state[l][i] >> 8);
+            digests[l][i * 4 + 3] = (uint8_t)ctx->state[l][i];
+        }
+    }
+}
+
 int increment_ctr_aes_iv(uint8_t *iv, uint64_t bytes_position)
 {
     if (bytes_position % AES_BLOCK_SIZE != 0) {
@@ -329,15 +790,40 @@ int increment_ctr_aes_iv(uint8_t *iv, uint64_t bytes_position)
     }
 
     uint64_t times = bytes_position / AES_BLOCK_SIZE;
+    unsigned int carry = 0;
+
+    // Add the block count to the big endian counter instead of
+    // incrementing it once per block
+    for (int i = AES_BLOCK_SIZE - 1; i >= 0 && (times || carry); i--) {
+        unsigned int sum = iv[i] + (times & 0xff) + carry;
+        iv[i] = sum & 0xff;
+        carry = sum >> 8;
+        times >>= 8;
+    }
 
-    while (times) {
-        unsigned int i = AES_BLOCK_SIZE - 1;
-        if (++(iv)[i] == 0) {
-            while (i > 0 && ++(iv)[--i] == 0);
-        }
-        times--;
+    return 0;
+}
+
+int ctr_crypt_segment(const uint8_t *key, const uint8_t *iv,
+                      uint64_t position, size_t length,
+                      uint8_t *dst, const uint8_t *src)
+{
+    uint8_t ctr[AES_BLOCK_SIZE];
+    memcpy(ctr, iv, AES_BLOCK_SIZE);
+
+    if (increment_ctr_aes_iv(ctr, position)) {
+        return 1;
     }
 
+    struct aes256_ctx ctx;
+    aes256_set_encrypt_key(&ctx, key);
+
+    ctr_crypt(&ctx, (nettle_cipher_func *)aes256_encrypt,
+              AES_BLOCK_SIZE, ctr, length, dst, src);
+
+    memset_zero(&ctx, sizeof(struct aes256_ctx));
+    memset_zero(ctr, AES_BLOCK_SIZE);
+
     return 0;
 }
 
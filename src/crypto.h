@@ -15,16 +15,43 @@
 #include <nettle/ctr.h>
 #include <nettle/gcm.h>
 #include <nettle/base64.h>
+#include <uv.h>
 
 #include "bip39.h"
 #include "utils.h"
 
 #define DETERMINISTIC_KEY_SIZE 64
 #define DETERMINISTIC_KEY_HEX_SIZE 32
+// Bytes of a file encrypted or decrypted by one worker
+#define STORJ_CRYPT_SEGMENT_SIZE 16777216 // 16Mb
+// Bytes read and written at a time within a segment
+#define STORJ_CRYPT_BUFFER_SIZE 1048576 // 1Mb
 #define BUCKET_NAME_MAGIC "398734aab3c4c30c9f22590e83a95f7e43556a45fc2b3060e0c39fde31f50272"
 
 static const uint8_t BUCKET_META_MAGIC[32] = {66,150,71,16,50,114,88,160,163,35,154,65,162,213,226,215,70,138,57,61,52,19,210,170,38,164,162,200,86,201,2,81};
 
+/** @brief Keys derived for a bucket, or for bucket names with the magic id
+ */
+typedef struct storj_bucket_keys {
+    char *bucket_id;
+    char bucket_key[DETERMINISTIC_KEY_SIZE + 1];
+    uint8_t bucket_key_raw[DETERMINISTIC_KEY_HEX_SIZE];
+    uint8_t name_key[SHA256_DIGEST_SIZE];
+    struct storj_bucket_keys *next;
+} storj_bucket_keys_t;
+
+/** @brief A cache of the seed and bucket keys derived from a mnemonic.
+ *
+ * Deriving the seed runs 2048 rounds of PBKDF2-HMAC-SHA512, so it is only
+ * done once per environment. The cache may be used from any thread and is
+ * only valid for the mnemonic of the first lookup.
+ */
+typedef struct storj_key_cache {
+    uv_mutex_t lock;
+    char *seed;
+    storj_bucket_keys_t *buckets;
+} storj_key_cache_t;
+
 int sha256_of_str(const uint8_t *str, int str_len, uint8_t *digest);
 
 int sha512_of_str(const uint8_t *str, int str_len, uint8_t *digest);
@@ -46,6 +73,82 @@ void pbkdf2_hmac_sha512(unsigned key_length,
                         unsigned salt_length, const uint8_t *salt,
                         unsigned length, uint8_t *dst);
 
+/**
+ * @brief Create an empty key cache
+ *
+ * @return A new key cache or NULL on failure
+ */
+storj_key_cache_t *key_cache_new();
+
+/**
+ * @brief Zero out and free all keys of a cache
+ *
+ * @param[in] cache The key cache
+ */
+void key_cache_destroy(storj_key_cache_t *cache);
+
+/**
+ * @brief Generate a bucket's key, using the cache when available
+ *
+ * @param[in] cache The key cache or NULL to always derive the key
+ * @param[in] mnemonic Character array of the mnemonic
+ * @param[in] bucket_id Character array of bucket id
+ * @param[out] bucket_key 64 byte character array that is the bucket's key
+ * @return A non-zero error value on failure and 0 on success.
+ */
+int generate_bucket_key_cached(storj_key_cache_t *cache,
+                               const char *mnemonic,
+                               const char *bucket_id,
+                               char **bucket_key);
+
+/**
+ * @brief Generate a file's key, using the cache when available
+ *
+ * @param[in] cache The key cache or NULL to always derive the key
+ * @param[in] mnemonic Character array of the mnemonic
+ * @param[in] bucket_id Character array of bucket id
+ * @param[in] index Character array of index
+ * @param[out] file_key 64 byte character array that is the file's key
+ * @return A non-zero error value on failure and 0 on success.
+ */
+int generate_file_key_cached(storj_key_cache_t *cache,
+                             const char *mnemonic,
+                             const char *bucket_id,
+                             const char *index,
+                             char **file_key);
+
+/**
+ * @brief Decrypt a file name, using the cache when available
+ *
+ * @param[in] cache The key cache or NULL to always derive the key
+ * @param[in] mnemonic Character array of the mnemonic
+ * @param[in] bucket_id Character array of bucket id
+ * @param[in] encrypted_name Character array of the encrypted name
+ * @param[out] decrypted_name Character array of the decrypted name
+ * @return A non-zero error value on failure and 0 on success.
+ */
+int decrypt_file_name_cached(storj_key_cache_t *cache,
+                             const char *mnemonic,
+                             const char *bucket_id,
+                             const char *encrypted_name,
+                             char **decrypted_name);
+
+/**
+ * @brief Encrypt a file name, using the cache when available
+ *
+ * @param[in] cache The key cache or NULL to always derive the key
+ * @param[in] mnemonic Character array of the mnemonic
+ * @param[in] bucket_id Character array of bucket id
+ * @param[in] file_name Character array of the file name
+ * @param[out] encrypted_name Character array of the encrypted name
+ * @return A non-zero error value on failure and 0 on success.
+ */
+int encrypt_file_name_cached(storj_key_cache_t *cache,
+                             const char *mnemonic,
+                             const char *bucket_id,
+                             const char *file_name,
+                             char **encrypted_name);
+
 /**
  * @brief Generate a bucket's key
  *
@@ -134,6 +237,60 @@ int encrypt_file_name(const char *mnemonic,
 int get_deterministic_key(const char *key, int key_len,
                           const char *id, char **buffer);
 
+#define STORJ_SHA256_LANES 4
+
+/** @brief SHA-256 of the same data after a different prefix in each lane
+ *
+ * All of the prefixes have the same length, so the lanes are aligned to
+ * the same blocks. After the first block the lanes share the expanded
+ * message schedule, and the rounds of the lanes are interleaved so that
+ * they run in parallel instead of waiting on one dependency chain. The
+ * sha extensions of x86 processors are used when they are available.
+ */
+typedef struct {
+    uint32_t state[STORJ_SHA256_LANES][8];
+    uint8_t block[STORJ_SHA256_LANES][SHA256_BLOCK_SIZE];
+    unsigned int lanes;
+    unsigned int index;
+    uint64_t count;
+    /* the buffered block has bytes of the prefixes */
+    bool distinct;
+    bool sha_ni;
+} sha256_lanes_ctx_t;
+
+/**
+ * @brief Start the SHA-256 of lanes with a prefix each
+ *
+ * @param[out] ctx The lanes context
+ * @param[in] lanes The number of lanes, at most STORJ_SHA256_LANES
+ * @param[in] prefixes The prefix of each lane
+ * @param[in] prefix_length The length of every prefix
+ * @return A non-zero value on failure
+ */
+int sha256_lanes_init(sha256_lanes_ctx_t *ctx,
+                      unsigned int lanes,
+                      const uint8_t **prefixes,
+                      size_t prefix_length);
+
+/**
+ * @brief Hash the same data in all of the lanes
+ *
+ * @param[in] ctx The lanes context
+ * @param[in] length The length of the data
+ * @param[in] data The data
+ */
+void sha256_lanes_update(sha256_lanes_ctx_t *ctx, size_t length,
+                         const uint8_t *data);
+
+/**
+ * @brief Finish the SHA-256 of all of the lanes
+ *
+ * @param[in] ctx The lanes context, which can't be updated after
+ * @param[out] digests A SHA256_DIGEST_SIZE digest for each lane
+ */
+void sha256_lanes_digest(sha256_lanes_ctx_t *ctx,
+                         uint8_t digests[][SHA256_DIGEST_SIZE]);
+
 /**
  * @brief Increment the iv for ctr decryption/encryption
  *
@@ -149,6 +306,25 @@ int get_deterministic_key(const char *key, int key_len,
  */
 int increment_ctr_aes_iv(uint8_t *iv, uint64_t bytes_position);
 
+/**
+ * @brief Encrypt or decrypt a segment of data with AES-256-CTR
+ *
+ * The counter of the segment is derived from the iv and the position of
+ * the segment, so that the segments of a file can be processed out of
+ * order and concurrently. The iv is not modified.
+ *
+ * @param[in] key The 32 byte key
+ * @param[in] iv The 16 byte iv at the start of the file
+ * @param[in] position The position of the segment, a multiple of 16
+ * @param[in] length The length of the segment
+ * @param[out] dst The destination, which may be the same as src
+ * @param[in] src The source data
+ * @return A non-zero value on failure
+ */
+int ctr_crypt_segment(const uint8_t *key, const uint8_t *iv,
+                      uint64_t position, size_t length,
+                      uint8_t *dst, const uint8_t *src);
+
 /**
  * @brief Will derive an encryption key from passhrase
  *
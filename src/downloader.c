@@ -9,8 +9,18 @@ static void free_exchange_report(storj_exchange_report_t *report)
     free(report);
 }
 
+static void free_hedge_timer(uv_handle_t *handle)
+{
+    free(handle);
+}
+
 static void free_download_state(storj_download_state_t *state)
 {
+    if (farmer_table_save(state->env->farmers)) {
+        state->log->warn(state->env->log_options, state->handle,
+                         "Unable to save farmer table");
+    }
+
     for (int i = 0; i < state->total_pointers; i++) {
         storj_pointer_t *pointer = &state->pointers[i];
 
@@ -18,10 +28,13 @@ static void free_download_state(storj_download_state_t *state)
         free(pointer->shard_hash);
         free(pointer->farmer_id);
         free(pointer->farmer_address);
+        free(pointer->shard_data);
 
         free_exchange_report(pointer->report);
     }
 
+    free_stream_recover(state);
+
     if (state->excluded_farmer_ids) {
         free(state->excluded_farmer_ids);
     }
@@ -48,6 +61,26 @@ static void free_download_state(storj_download_state_t *state)
         free((char *)state->hmac);
     }
 
+    if (state->journal_path) {
+        free(state->journal_path);
+    }
+
+    if (state->journal_entries) {
+        free(state->journal_entries);
+    }
+
+    transfer_slot_free(state->transfer_slot);
+
+    if (state->hedge_timer) {
+        uv_timer_stop(state->hedge_timer);
+        uv_close((uv_handle_t *)state->hedge_timer, free_hedge_timer);
+    }
+
+    if (state->pointer_pages) {
+        clear_pointer_pages(state);
+        free(state->pointer_pages);
+    }
+
     free(state->pointers);
     free(state);
 }
@@ -87,9 +120,10 @@ static void request_replace_pointer(uv_work_t *work)
     char query_args[BUFSIZ];
     memset(query_args, '\0', BUFSIZ);
     snprintf(query_args, BUFSIZ,
-             "?limit=1&skip=%i&exclude=%s",
+             "?limit=%"PRIu32"&skip=%"PRIu32"&exclude=%s",
+             req->total_pointers,
              req->pointer_index,
-             req->excluded_farmer_ids);
+             req->excluded_farmer_ids ? req->excluded_farmer_ids : "");
 
     int path_len = 9 + strlen(req->bucket_id) + 7 +
         strlen(req->file_id) + strlen(query_args);
@@ -200,6 +234,12 @@ static void set_pointer_from_json(storj_download_state_t *state,
 
     if (is_replaced) {
         p->replace_count += 1;
+
+        // the replaced shard is counted again once it has its new size
+        if (pointer_counted(state, p)) {
+            state->total_bytes -= p->size;
+            state->downloaded_bytes -= p->downloaded_size;
+        }
     } else {
         p->replace_count = 0;
     }
@@ -230,7 +270,9 @@ static void set_pointer_from_json(storj_download_state_t *state,
         free(p->shard_hash);
         free(p->farmer_address);
         free(p->farmer_id);
+        free(p->shard_data);
     }
+    p->shard_data = NULL;
     if (token) {
         p->token = strdup(token);
     } else {
@@ -279,6 +321,7 @@ static void set_pointer_from_json(storj_download_state_t *state,
     p->report->message = STORJ_REPORT_DOWNLOAD_ERROR;
 
     p->work = NULL;
+    p->cache_fill = false;
 
     if (!state->shard_size) {
         // TODO make sure all except last shard is the same size
@@ -288,6 +331,261 @@ static void set_pointer_from_json(storj_download_state_t *state,
                           "Shard size set to %" PRIu64,
                           state->shard_size);
     };
+
+    if (pointer_counted(state, p)) {
+        state->total_bytes += p->size;
+    }
+
+    // Skip shards that are already in the destination of a resumed download
+    if (!is_replaced && p->status == POINTER_CREATED &&
+        is_journal_shard(state, p)) {
+        state->log->info(state->env->log_options,
+                         state->handle,
+                         "Resuming with downloaded shard: %s",
+                         p->shard_hash);
+        p->status = POINTER_DOWNLOADED;
+        set_downloaded_size(state, p, p->size);
+    }
+}
+
+static char *download_journal_path(storj_download_state_t *state)
+{
+    const char *tmp_folder = state->env->tmp_path;
+    int tmp_folder_len = strlen(tmp_folder);
+    if (tmp_folder[tmp_folder_len - 1] == separator()) {
+        tmp_folder_len -= 1;
+    }
+
+    // hash the bucket and file id for filesystem use
+    struct sha256_ctx ctx;
+    uint8_t digest[SHA256_DIGEST_SIZE];
+    sha256_init(&ctx);
+    sha256_update(&ctx, strlen(state->bucket_id), (uint8_t *)state->bucket_id);
+    sha256_update(&ctx, strlen(state->file_id), (uint8_t *)state->file_id);
+    sha256_digest(&ctx, SHA256_DIGEST_SIZE, digest);
+
+    char *digest_encoded = hex2str(SHA256_DIGEST_SIZE, digest);
+    if (!digest_encoded) {
+        return NULL;
+    }
+
+    char *path = calloc(tmp_folder_len + 1 + strlen(digest_encoded) + 10,
+                        sizeof(char));
+    if (path) {
+        sprintf(path, "%.*s%c%s.download", tmp_folder_len, tmp_folder,
+                separator(), digest_encoded);
+    }
+
+    free(digest_encoded);
+    return path;
+}
+
+static bool verify_journal_entry(int fd, download_journal_entry_t *entry)
+{
+    struct sha256_ctx sha_ctx;
+    sha256_init(&sha_ctx);
+
+    uint8_t buffer[AES_BLOCK_SIZE * 256];
+    uint64_t total_read = 0;
+
+    while (total_read < entry->size) {
+        uint64_t remain = entry->size - total_read;
+        size_t length = (remain < sizeof(buffer)) ? remain : sizeof(buffer);
+
+        ssize_t read_bytes = pread(fd, buffer, length,
+                                   entry->offset + total_read);
+        if (read_bytes <= 0) {
+            return false;
+        }
+
+        sha256_update(&sha_ctx, read_bytes, buffer);
+        total_read += read_bytes;
+    }
+
+    uint8_t hash_sha256[SHA256_DIGEST_SIZE];
+    sha256_digest(&sha_ctx, SHA256_DIGEST_SIZE, hash_sha256);
+
+    struct ripemd160_ctx rctx;
+    ripemd160_init(&rctx);
+    ripemd160_update(&rctx, SHA256_DIGEST_SIZE, hash_sha256);
+
+    uint8_t hash_rmd160[RIPEMD160_DIGEST_SIZE];
+    ripemd160_digest(&rctx, RIPEMD160_DIGEST_SIZE, hash_rmd160);
+
+    char *hash = hex2str(RIPEMD160_DIGEST_SIZE, hash_rmd160);
+    if (!hash) {
+        return false;
+    }
+
+    bool valid = (strcmp(hash, entry->hash) == 0);
+    free(hash);
+
+    return valid;
+}
+
+/*
+ * The journal lists the shards that have been written to the destination.
+ * Each shard is hashed again from the destination, as the file may have
+ * changed since, and the journal is rewritten with the shards that match.
+ */
+static void load_download_journal(uv_work_t *work)
+{
+    download_journal_req_t *req = work->data;
+    unsigned int version = 0;
+    download_journal_entry_t entry;
+
+    // A journal that does not exist yet is created with its header
+    FILE *journal = fopen(req->journal_path, "r");
+    if (journal &&
+        fscanf(journal, "storj-download-journal %u\n", &version) == 1 &&
+        version == STORJ_DOWNLOAD_JOURNAL_VERSION) {
+
+        // A line that was not completely written is not used
+        while (fscanf(journal, "shard %"SCNu32" %"SCNu64" %"SCNu64" %40s\n",
+                      &entry.index, &entry.offset, &entry.size,
+                      entry.hash) == 4) {
+
+            if (strlen(entry.hash) != RIPEMD160_DIGEST_SIZE * 2 ||
+                !verify_journal_entry(req->fd, &entry)) {
+                continue;
+            }
+
+            download_journal_entry_t *entries =
+                realloc(req->entries, (req->total_entries + 1) *
+                        sizeof(download_journal_entry_t));
+            if (!entries) {
+                req->error_status = STORJ_MEMORY_ERROR;
+                break;
+            }
+            req->entries = entries;
+            req->entries[req->total_entries] = entry;
+            req->total_entries += 1;
+        }
+    }
+
+    if (journal) {
+        fclose(journal);
+    }
+
+    if (req->error_status) {
+        return;
+    }
+
+    journal = fopen(req->journal_path, "w");
+    if (!journal) {
+        return;
+    }
+
+    fprintf(journal, "storj-download-journal %u\n",
+            STORJ_DOWNLOAD_JOURNAL_VERSION);
+
+    for (int i = 0; i < req->total_entries; i++) {
+        download_journal_entry_t *valid = &req->entries[i];
+        fprintf(journal, "shard %"PRIu32" %"PRIu64" %"PRIu64" %s\n",
+                valid->index, valid->offset, valid->size, valid->hash);
+    }
+
+    fclose(journal);
+}
+
+static void after_load_download_journal(uv_work_t *work, int status)
+{
+    download_journal_req_t *req = work->data;
+    storj_download_state_t *state = req->state;
+
+    state->pending_work_count--;
+    state->journal_loaded = true;
+
+    if (status != 0) {
+        state->error_status = STORJ_QUEUE_ERROR;
+    } else if (req->error_status) {
+        state->error_status = req->error_status;
+    } else {
+        state->log->info(state->env->log_options, state->handle,
+                         "Resuming download with %i downloaded shards",
+                         req->total_entries);
+
+        state->journal_entries = req->entries;
+        state->total_journal_entries = req->total_entries;
+        req->entries = NULL;
+    }
+
+    queue_next_work(state);
+
+    free(req->entries);
+    free(req);
+    free(work);
+}
+
+static void queue_load_download_journal(storj_download_state_t *state)
+{
+    if (state->pending_work_count > 0) {
+        return;
+    }
+
+    download_journal_req_t *req = malloc(sizeof(download_journal_req_t));
+    if (!req) {
+        state->error_status = STORJ_MEMORY_ERROR;
+        return;
+    }
+
+    req->journal_path = state->journal_path;
+    req->fd = fileno(state->destination);
+    req->entries = NULL;
+    req->total_entries = 0;
+    req->error_status = 0;
+    req->state = state;
+
+    uv_work_t *work = malloc(sizeof(uv_work_t));
+    if (!work) {
+        free(req);
+        state->error_status = STORJ_MEMORY_ERROR;
+        return;
+    }
+    work->data = req;
+
+    state->pending_work_count++;
+    int status = uv_queue_work(state->env->loop, (uv_work_t*) work,
+                               load_download_journal,
+                               after_load_download_journal);
+    if (status) {
+        state->error_status = STORJ_QUEUE_ERROR;
+    }
+}
+
+static bool is_journal_shard(storj_download_state_t *state,
+                             storj_pointer_t *pointer)
+{
+    for (int i = 0; i < state->total_journal_entries; i++) {
+        download_journal_entry_t *entry = &state->journal_entries[i];
+
+        if (entry->index == pointer->index &&
+            entry->offset == pointer->index * state->shard_size &&
+            entry->size == pointer->size &&
+            strcmp(entry->hash, pointer->shard_hash) == 0) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static void append_download_journal(storj_download_state_t *state,
+                                    storj_pointer_t *pointer)
+{
+    FILE *journal = fopen(state->journal_path, "a");
+    if (!journal) {
+        state->log->warn(state->env->log_options, state->handle,
+                         "Unable to write download journal: %s",
+                         state->journal_path);
+        return;
+    }
+
+    fprintf(journal, "shard %"PRIu32" %"PRIu64" %"PRIu64" %s\n",
+            pointer->index, pointer->index * state->shard_size,
+            pointer->size, pointer->shard_hash);
+
+    fclose(journal);
 }
 
 static void append_pointers_to_state(storj_download_state_t *state,
@@ -305,16 +603,13 @@ static void append_pointers_to_state(storj_download_state_t *state,
         int prev_total_pointers = state->total_pointers;
         int total_pointers = state->total_pointers + length;
 
-        if (state->total_pointers > 0) {
-            state->pointers = realloc(state->pointers,
-                                      total_pointers * sizeof(storj_pointer_t));
-        } else {
-            state->pointers = malloc(length * sizeof(storj_pointer_t) * 100);
-        }
-        if (!state->pointers) {
+        storj_pointer_t *pointers =
+            realloc(state->pointers, total_pointers * sizeof(storj_pointer_t));
+        if (!pointers) {
             state->error_status = STORJ_MEMORY_ERROR;
             return;
         }
+        state->pointers = pointers;
 
         state->total_pointers = total_pointers;
         state->total_shards = total_pointers;
@@ -338,13 +633,58 @@ static void append_pointers_to_state(storj_download_state_t *state,
 
 }
 
+static void clear_pointer_pages(storj_download_state_t *state)
+{
+    for (int i = 0; i < state->pointer_window; i++) {
+        pointer_page_t *page = &state->pointer_pages[i];
+        if (page->response) {
+            json_object_put(page->response);
+        }
+        page->response = NULL;
+        page->requesting = false;
+    }
+}
+
+/*
+ * Add the pages that have been received in order, and move the window
+ * of requested pages forward
+ */
+static void append_pointer_pages(storj_download_state_t *state)
+{
+    while (!state->pointers_completed && state->pointer_pages[0].response) {
+        struct json_object *res = state->pointer_pages[0].response;
+
+        memmove(&state->pointer_pages[0], &state->pointer_pages[1],
+                (state->pointer_window - 1) * sizeof(pointer_page_t));
+        state->pointer_pages[state->pointer_window - 1].response = NULL;
+        state->pointer_pages[state->pointer_window - 1].requesting = false;
+
+        int length = json_object_array_length(res);
+
+        append_pointers_to_state(state, res);
+        json_object_put(res);
+
+        if (state->error_status) {
+            return;
+        }
+
+        if (state->pointers_completed) {
+            clear_pointer_pages(state);
+        } else if (length < STORJ_POINTER_PAGE_SIZE) {
+            // the pages after a short page were requested at the wrong
+            // position, so they are requested again
+            state->pointer_page_generation += 1;
+            clear_pointer_pages(state);
+        }
+    }
+}
+
 static void after_request_pointers(uv_work_t *work, int status)
 {
     json_request_download_t *req = work->data;
     storj_download_state_t *state = req->state;
 
     state->pending_work_count--;
-    state->requesting_pointers = false;
 
     if (req->response) {
         state->log->debug(state->env->log_options, state->handle,
@@ -352,6 +692,22 @@ static void after_request_pointers(uv_work_t *work, int status)
                           json_object_to_json_string(req->response));
     }
 
+    if (req->generation != state->pointer_page_generation ||
+        state->pointers_completed) {
+        // the page is no longer needed
+        goto clean_variables;
+    }
+
+    uint32_t page_index = (req->skip - state->total_pointers) /
+        STORJ_POINTER_PAGE_SIZE;
+    if (req->skip < state->total_pointers ||
+        page_index >= state->pointer_window) {
+        goto clean_variables;
+    }
+
+    pointer_page_t *page = &state->pointer_pages[page_index];
+    page->requesting = false;
+
     if (status != 0)  {
 
         state->error_status = STORJ_BRIDGE_POINTER_ERROR;
@@ -379,9 +735,11 @@ static void after_request_pointers(uv_work_t *work, int status)
     } else if (!json_object_is_type(req->response, json_type_array)) {
         state->error_status = STORJ_BRIDGE_JSON_ERROR;
     } else {
-        append_pointers_to_state(state, req->response);
+        page->response = json_object_get(req->response);
+        append_pointer_pages(state);
     }
 
+clean_variables:
     queue_next_work(state);
 
     if (req->response) {
@@ -392,13 +750,23 @@ static void after_request_pointers(uv_work_t *work, int status)
     free(work);
 }
 
+static void set_replaced_pointers_status(storj_download_state_t *state,
+                                         json_request_replace_pointer_t *req,
+                                         uint32_t first,
+                                         int status)
+{
+    for (uint32_t i = first; i < req->total_pointers; i++) {
+        state->pointers[req->pointer_index + i].status = status;
+    }
+}
+
 static void after_request_replace_pointer(uv_work_t *work, int status)
 {
     json_request_replace_pointer_t *req = work->data;
     storj_download_state_t *state = req->state;
 
     state->pending_work_count--;
-    state->requesting_pointers = false;
+    state->replacing_pointers -= 1;
 
     state->log->debug(state->env->log_options, state->handle,
                       "Finished request replace pointer %i - JSON Response: %s",
@@ -420,10 +788,11 @@ static void after_request_replace_pointer(uv_work_t *work, int status)
     } else if (req->status_code != 200) {
 
         if (req->status_code > 0 && req->status_code < 500) {
-            state->pointers[req->pointer_index].status = POINTER_MISSING;
+            set_replaced_pointers_status(state, req, 0, POINTER_MISSING);
         } else {
             // Update status so that it will be retried
-            state->pointers[req->pointer_index].status = POINTER_ERROR_REPORTED;
+            set_replaced_pointers_status(state, req, 0,
+                                         POINTER_ERROR_REPORTED);
             state->pointer_fail_count += 1;
         }
 
@@ -434,158 +803,174 @@ static void after_request_replace_pointer(uv_work_t *work, int status)
         if (state->pointer_fail_count >= STORJ_MAX_POINTER_TRIES) {
             // Skip retrying mark as missing
             state->pointer_fail_count = 0;
-            state->pointers[req->pointer_index].status = POINTER_MISSING;
+            set_replaced_pointers_status(state, req, 0, POINTER_MISSING);
         }
 
     } else if (!json_object_is_type(req->response, json_type_array)) {
         state->error_status = STORJ_BRIDGE_JSON_ERROR;
     } else {
-        struct json_object *json = json_object_array_get_idx(req->response, 0);
+        uint32_t length = json_object_array_length(req->response);
+        if (length > req->total_pointers) {
+            length = req->total_pointers;
+        }
 
-        set_pointer_from_json(state,
-                              &state->pointers[req->pointer_index],
-                              json,
-                              true);
+        for (uint32_t i = 0; i < length; i++) {
+            uint32_t pointer_index = req->pointer_index + i;
+            struct json_object *json =
+                json_object_array_get_idx(req->response, i);
 
-        if (state->pointers[req->pointer_index].index != req->pointer_index) {
+            set_pointer_from_json(state,
+                                  &state->pointers[pointer_index],
+                                  json,
+                                  true);
 
-            state->log->error(state->env->log_options,
-                              state->handle,
-                              "Replacement shard index %i does not match %i",
-                              state->pointers[req->pointer_index].index,
-                              req->pointer_index);
+            if (state->pointers[pointer_index].index != pointer_index) {
 
-            state->error_status = STORJ_BRIDGE_JSON_ERROR;
+                state->log->error(state->env->log_options,
+                                  state->handle,
+                                  "Replacement shard index %i does not match %i",
+                                  state->pointers[pointer_index].index,
+                                  pointer_index);
+
+                state->error_status = STORJ_BRIDGE_JSON_ERROR;
+            }
         }
+
+        // pointers without a replacement may still be recovered
+        set_replaced_pointers_status(state, req, length, POINTER_MISSING);
     }
 
     queue_next_work(state);
 
     json_object_put(req->response);
+    free(req->excluded_farmer_ids);
     free(work->data);
     free(work);
 }
 
-static void queue_request_pointers(storj_download_state_t *state)
+static int add_excluded_farmer_id(storj_download_state_t *state,
+                                  const char *farmer_id)
 {
-    if (state->requesting_pointers || state->canceled) {
-        return;
-    }
+    // exclude this farmer id from future requests
+    state->log->debug(state->env->log_options,
+                      state->handle,
+                      "Adding farmer_id %s to excluded list",
+                      farmer_id);
 
-    // queue request to replace pointer if any pointers have failure
-    for (int i = 0; i < state->total_pointers; i++) {
+    if (!state->excluded_farmer_ids) {
+        state->excluded_farmer_ids = calloc(42, sizeof(char));
+        if (!state->excluded_farmer_ids) {
+            return 1;
+        }
+        strcat(state->excluded_farmer_ids, farmer_id);
+    } else {
+        state->excluded_farmer_ids =
+            realloc(state->excluded_farmer_ids,
+                    strlen(state->excluded_farmer_ids) + 42);
+        if (!state->excluded_farmer_ids) {
+            return 1;
+        }
+        strcat(state->excluded_farmer_ids, ",");
+        strcat(state->excluded_farmer_ids, farmer_id);
+    }
 
-        storj_pointer_t *pointer = &state->pointers[i];
+    return 0;
+}
 
-        if (pointer->replace_count >= STORJ_DEFAULT_MIRRORS) {
-            state->log->warn(state->env->log_options,
-                             state->handle,
-                             "Unable to download shard %s at index %i",
-                             pointer->shard_hash,
-                             pointer->index);
-            pointer->replace_count = 0;
-            pointer->status = POINTER_MISSING;
+static void queue_request_replace_pointers(storj_download_state_t *state,
+                                           uint32_t pointer_index,
+                                           uint32_t total_pointers)
+{
+    for (uint32_t i = 0; i < total_pointers; i++) {
+        storj_pointer_t *pointer = &state->pointers[pointer_index + i];
+        if (add_excluded_farmer_id(state, pointer->report->farmer_id)) {
+            state->error_status = STORJ_MEMORY_ERROR;
             return;
         }
+    }
 
-        if (pointer->status == POINTER_ERROR_REPORTED) {
-
-            // exclude this farmer id from future requests
-            state->log->debug(state->env->log_options,
-                              state->handle,
-                              "Adding farmer_id %s to excluded list",
-                              pointer->report->farmer_id);
-
-            if (!state->excluded_farmer_ids) {
-                state->excluded_farmer_ids = calloc(42, sizeof(char));
-                if (!state->excluded_farmer_ids) {
-                    state->error_status = STORJ_MEMORY_ERROR;
-                    return;
-                }
-                strcat(state->excluded_farmer_ids, pointer->report->farmer_id);
-            } else {
-                state->excluded_farmer_ids =
-                    realloc(state->excluded_farmer_ids,
-                            strlen(state->excluded_farmer_ids) + 42);
-                if (!state->excluded_farmer_ids) {
-                    state->error_status = STORJ_MEMORY_ERROR;
-                    return;
-                }
-                strcat(state->excluded_farmer_ids, ",");
-                strcat(state->excluded_farmer_ids, pointer->report->farmer_id);
-            }
-
-            json_request_replace_pointer_t *req =
-                malloc(sizeof(json_request_replace_pointer_t));
-            if (!req) {
-                state->error_status = STORJ_MEMORY_ERROR;
-                return;
-            }
-
-            req->pointer_index = i;
-
-            req->http_options = state->env->http_options;
-            req->options = state->env->bridge_options;
-            req->bucket_id = state->bucket_id;
-            req->file_id = state->file_id;
-            req->state = state;
-            req->excluded_farmer_ids = state->excluded_farmer_ids;
-            req->error_status = 0;
-            req->response = NULL;
-            req->status_code = 0;
+    json_request_replace_pointer_t *req =
+        malloc(sizeof(json_request_replace_pointer_t));
+    if (!req) {
+        state->error_status = STORJ_MEMORY_ERROR;
+        return;
+    }
 
-            uv_work_t *work = malloc(sizeof(uv_work_t));
-            if (!work) {
-                state->error_status = STORJ_MEMORY_ERROR;
-                return;
-            }
-            work->data = req;
+    req->pointer_index = pointer_index;
+    req->total_pointers = total_pointers;
 
-            state->log->info(state->env->log_options,
-                             state->handle,
-                             "Requesting replacement pointer at index: %i",
-                             req->pointer_index);
+    req->http_options = state->env->http_options;
+    req->options = state->env->bridge_options;
+    req->bucket_id = state->bucket_id;
+    req->file_id = state->file_id;
+    req->state = state;
+    req->excluded_farmer_ids = strdup(state->excluded_farmer_ids);
+    req->error_status = 0;
+    req->response = NULL;
+    req->status_code = 0;
 
-            state->pending_work_count++;
-            int status = uv_queue_work(state->env->loop,
-                                       (uv_work_t*) work,
-                                       request_replace_pointer,
-                                       after_request_replace_pointer);
+    if (!req->excluded_farmer_ids) {
+        free(req);
+        state->error_status = STORJ_MEMORY_ERROR;
+        return;
+    }
 
-            if (status) {
-                state->error_status = STORJ_QUEUE_ERROR;
-                return;
-            }
+    uv_work_t *work = malloc(sizeof(uv_work_t));
+    if (!work) {
+        free(req->excluded_farmer_ids);
+        free(req);
+        state->error_status = STORJ_MEMORY_ERROR;
+        return;
+    }
+    work->data = req;
 
-            pointer->status = POINTER_BEING_REPLACED;
+    state->log->info(state->env->log_options,
+                     state->handle,
+                     "Requesting %i replacement pointers at index: %i",
+                     req->total_pointers,
+                     req->pointer_index);
 
-            // we're done until the next pass
-            state->requesting_pointers = true;
-            return;
-        }
+    state->pending_work_count++;
+    int status = uv_queue_work(state->env->loop,
+                               (uv_work_t*) work,
+                               request_replace_pointer,
+                               after_request_replace_pointer);
 
+    if (status) {
+        state->error_status = STORJ_QUEUE_ERROR;
+        return;
     }
 
-    // only request the next set of pointers if we're not finished
-    if (state->pointers_completed) {
-        return;
+    state->replacing_pointers += 1;
+
+    for (uint32_t i = 0; i < total_pointers; i++) {
+        state->pointers[pointer_index + i].status = POINTER_BEING_REPLACED;
     }
+}
 
+static void queue_request_pointer_page(storj_download_state_t *state,
+                                       uint32_t page_index)
+{
     json_request_download_t *req = malloc(sizeof(json_request_download_t));
     if (!req) {
         state->error_status = STORJ_MEMORY_ERROR;
         return;
     }
 
+    req->skip = state->total_pointers + page_index * STORJ_POINTER_PAGE_SIZE;
+    req->generation = state->pointer_page_generation;
+
     char query_args[BUFSIZ];
     memset(query_args, '\0', BUFSIZ);
-    snprintf(query_args, BUFSIZ, "?limit=3&skip=%d", state->total_pointers);
+    snprintf(query_args, BUFSIZ, "?limit=%d&skip=%"PRIu32,
+             STORJ_POINTER_PAGE_SIZE, req->skip);
 
     int path_len = 9 + strlen(state->bucket_id) + 7 +
         strlen(state->file_id) + strlen(query_args);
 
     char *path = calloc(path_len + 1, sizeof(char));
     if (!path) {
+        free(req);
         state->error_status = STORJ_MEMORY_ERROR;
         return;
     }
@@ -601,11 +986,15 @@ static void queue_request_pointers(storj_download_state_t *state)
     req->path = path;
     req->body = NULL;
     req->auth = true;
+    req->response = NULL;
+    req->status_code = 0;
 
     req->state = state;
 
     uv_work_t *work = malloc(sizeof(uv_work_t));
     if (!work) {
+        free(path);
+        free(req);
         state->error_status = STORJ_MEMORY_ERROR;
         return;
     }
@@ -613,7 +1002,8 @@ static void queue_request_pointers(storj_download_state_t *state)
 
     state->log->info(state->env->log_options,
                      state->handle,
-                     "Requesting next set of pointers, total pointers: %i",
+                     "Requesting pointers at: %"PRIu32", total pointers: %i",
+                     req->skip,
                      state->total_pointers);
 
     state->pending_work_count++;
@@ -625,59 +1015,124 @@ static void queue_request_pointers(storj_download_state_t *state)
         return;
     }
 
-    state->requesting_pointers = true;
+    state->pointer_pages[page_index].requesting = true;
 }
 
-static void request_shard(uv_work_t *work)
+static void queue_request_pointers(storj_download_state_t *state)
 {
-    shard_request_download_t *req = work->data;
+    if (state->canceled) {
+        return;
+    }
 
-    int status_code;
-    int write_code = 0;
+    // queue requests to replace pointers that have failed, with one
+    // request for consecutive pointers
+    int i = 0;
+    while (i < state->total_pointers &&
+           state->replacing_pointers < state->pointer_window) {
 
-    req->start = get_time_milliseconds();
+        storj_pointer_t *pointer = &state->pointers[i];
 
-    uint64_t file_position = req->pointer_index * req->state->shard_size;
+        if (pointer->replace_count >= STORJ_DEFAULT_MIRRORS) {
+            state->log->warn(state->env->log_options,
+                             state->handle,
+                             "Unable to download shard %s at index %i",
+                             pointer->shard_hash,
+                             pointer->index);
+            pointer->replace_count = 0;
+            pointer->status = POINTER_MISSING;
+            i++;
+            continue;
+        }
 
-    int error_status = fetch_shard(req->http_options,
-                                   req->farmer_id,
-                                   req->farmer_proto,
-                                   req->farmer_host,
-                                   req->farmer_port,
-                                   req->shard_hash,
-                                   req->shard_total_bytes,
-                                   req->token,
-                                   req->state->destination,
-                                   file_position,
-                                   &status_code,
-                                   &write_code,
-                                   &req->progress_handle,
-                                   req->canceled);
+        if (pointer->status != POINTER_ERROR_REPORTED) {
+            i++;
+            continue;
+        }
 
-    req->end = get_time_milliseconds();
+        int total = 1;
+        while (i + total < state->total_pointers &&
+               total < STORJ_POINTER_PAGE_SIZE &&
+               state->pointers[i + total].status == POINTER_ERROR_REPORTED &&
+               state->pointers[i + total].replace_count < STORJ_DEFAULT_MIRRORS) {
+            total++;
+        }
 
-    if (write_code != 0) {
-        req->state->log->error(req->state->env->log_options, req->state->handle,
-                        "Put shard read error: %i", write_code);
+        queue_request_replace_pointers(state, i, total);
+        if (state->error_status) {
+            return;
+        }
+
+        i += total;
     }
 
-    if (error_status) {
-        req->error_status = error_status;
-    } else if (status_code != 200) {
-        switch(status_code) {
-            case 401:
-            case 403:
-                req->error_status = STORJ_FARMER_AUTH_ERROR;
-                break;
-            case 504:
-                req->error_status = STORJ_FARMER_TIMEOUT_ERROR;
-                break;
-            default:
-                req->error_status = STORJ_FARMER_REQUEST_ERROR;
+    // only request the next set of pointers if we're not finished
+    if (state->pointers_completed) {
+        return;
+    }
+
+    // keep a window of pages requested ahead, so that shards of a page
+    // are downloaded while the next pages are requested
+    for (uint32_t page = 0; page < state->pointer_window; page++) {
+        if (state->pointer_pages[page].requesting ||
+            state->pointer_pages[page].response) {
+            continue;
         }
+
+        queue_request_pointer_page(state, page);
+        if (state->error_status) {
+            return;
+        }
+    }
+}
+
+static int request_shard(uv_work_t *work)
+{
+    shard_request_download_t *req = work->data;
+
+    req->start = get_time_milliseconds();
+
+    uint64_t file_position = req->pointer_index * req->state->shard_size;
+
+    http_transfer_t *transfer = NULL;
+
+    if (req->shard_data) {
+        transfer = fetch_shard_data_transfer_new(req->http_options,
+                                                 req->farmer_id,
+                                                 req->farmer_proto,
+                                                 req->farmer_host,
+                                                 req->farmer_port,
+                                                 req->shard_hash,
+                                                 req->shard_total_bytes,
+                                                 req->token,
+                                                 req->shard_data,
+                                                 &req->progress_handle,
+                                                 req->canceled);
     } else {
-        req->error_status = 0;
+        transfer = fetch_shard_transfer_new(req->http_options,
+                                            req->farmer_id,
+                                            req->farmer_proto,
+                                            req->farmer_host,
+                                            req->farmer_port,
+                                            req->shard_hash,
+                                            req->shard_total_bytes,
+                                            req->token,
+                                            req->state->destination,
+                                            file_position,
+                                            &req->progress_handle,
+                                            req->canceled);
+    }
+
+    if (!transfer) {
+        return STORJ_MEMORY_ERROR;
     }
+
+    if (http_multi_add(req->state->env->http_multi, transfer,
+                       after_request_shard, work)) {
+        http_transfer_free(transfer);
+        return STORJ_QUEUE_ERROR;
+    }
+
+    return 0;
 }
 
 static void free_request_shard_work(uv_handle_t *progress_handle)
@@ -704,17 +1159,34 @@ static uint64_t calculate_data_filesize(storj_download_state_t *state)
     return total_bytes;
 }
 
-static void report_progress(storj_download_state_t *state)
+static bool pointer_counted(storj_download_state_t *state,
+                            storj_pointer_t *pointer)
 {
-    uint64_t downloaded_bytes = 0;
-    uint64_t total_bytes = 0;
+    // only the shards covering a range are downloaded
+    return !state->range ||
+        (!pointer->parity && range_contains_shard(state, pointer->index));
+}
 
-    for (int i = 0; i < state->total_pointers; i++) {
+static void set_downloaded_size(storj_download_state_t *state,
+                                storj_pointer_t *pointer,
+                                uint64_t downloaded_size)
+{
+    if (pointer_counted(state, pointer)) {
+        state->downloaded_bytes -= pointer->downloaded_size;
+        state->downloaded_bytes += downloaded_size;
+    }
 
-        storj_pointer_t *pointer = &state->pointers[i];
+    pointer->downloaded_size = downloaded_size;
+}
 
-        downloaded_bytes += pointer->downloaded_size;
-        total_bytes += pointer->size;
+static void report_progress(storj_download_state_t *state)
+{
+    uint64_t downloaded_bytes = state->downloaded_bytes;
+    uint64_t total_bytes = state->total_bytes;
+
+    if (!progress_meter_update(&state->progress_meter,
+                               downloaded_bytes, total_bytes)) {
+        return;
     }
 
     double total_progress = (double)downloaded_bytes / (double)total_bytes;
@@ -725,13 +1197,41 @@ static void report_progress(storj_download_state_t *state)
                        state->handle);
 }
 
-static void after_request_shard(uv_work_t *work, int status)
+static void after_request_shard(http_transfer_t *transfer)
 {
+    uv_work_t *work = transfer->data;
     shard_request_download_t *req = work->data;
 
+    req->end = get_time_milliseconds();
+
+    if (transfer->io_code != 0) {
+        req->state->log->error(req->state->env->log_options, req->state->handle,
+                        "Fetch shard write error: %i", transfer->io_code);
+    }
+
+    if (transfer->error_status) {
+        req->error_status = transfer->error_status;
+    } else if (transfer->status_code != 200) {
+        switch(transfer->status_code) {
+            case 401:
+            case 403:
+                req->error_status = STORJ_FARMER_AUTH_ERROR;
+                break;
+            case 504:
+                req->error_status = STORJ_FARMER_TIMEOUT_ERROR;
+                break;
+            default:
+                req->error_status = STORJ_FARMER_REQUEST_ERROR;
+        }
+    } else {
+        req->error_status = 0;
+    }
+
     req->state->pending_work_count--;
     req->state->resolving_shards -= 1;
 
+    transfer_slot_release(req->state->transfer_slot, req->shard_total_bytes);
+
     uv_handle_t *progress_handle = (uv_handle_t *) &req->progress_handle;
 
     // free the download progress
@@ -743,10 +1243,38 @@ static void after_request_shard(uv_work_t *work, int status)
     // update the pointer status
     storj_pointer_t *pointer = &req->state->pointers[req->pointer_index];
 
-    pointer->report->start = req->start;
-    pointer->report->end = req->end;
+    if (!req->abandoned) {
+        metrics_shard(&req->state->env->metrics, false, pointer->farmer_id,
+                      req->shard_hash,
+                      req->error_status ? 0 : pointer->size,
+                      req->start, req->end, pointer->replace_count,
+                      req->error_status);
+    }
+
+    if (req->abandoned && !req->state->canceled) {
 
-    if (req->error_status) {
+        // the shard is recovered from the others instead
+        req->state->log->info(req->state->env->log_options,
+                              req->state->handle,
+                              "Stopped downloading slow shard: %s",
+                              req->shard_hash);
+
+        pointer->status = POINTER_MISSING;
+
+        free(pointer->shard_data);
+        pointer->shard_data = NULL;
+
+    } else if (req->error_status) {
+
+        free(pointer->shard_data);
+        pointer->shard_data = NULL;
+
+        farmer_table_record(req->state->env->farmers, pointer->farmer_id,
+                            0, 0, false);
+        concurrency_record(&req->state->concurrency, 0, req->start, false);
+
+        pointer->report->start = req->start;
+        pointer->report->end = req->end;
 
         req->state->log->warn(req->state->env->log_options,
                               req->state->handle,
@@ -772,12 +1300,32 @@ static void after_request_shard(uv_work_t *work, int status)
                               "Finished downloading shard: %s",
                               req->shard_hash);
 
+        farmer_table_record(req->state->env->farmers, pointer->farmer_id,
+                            pointer->size, req->end - req->start, true);
+        concurrency_record(&req->state->concurrency, pointer->size,
+                           req->start, true);
+
+        pointer->report->start = req->start;
+        pointer->report->end = req->end;
         pointer->report->code = STORJ_REPORT_SUCCESS;
         pointer->report->message = STORJ_REPORT_SHARD_DOWNLOADED;
         pointer->status = POINTER_DOWNLOADED;
 
         // Make sure the downloaded size is updated
-        pointer->downloaded_size = pointer->size;
+        set_downloaded_size(req->state, pointer, pointer->size);
+
+        // shards in memory are cached as they are written
+        if (req->state->env->shard_cache) {
+            if (req->state->stream) {
+                pointer->cache_fill = true;
+            } else {
+                queue_write_cached_shard(req->state, pointer);
+            }
+        }
+
+        if (req->state->journal_path) {
+            append_download_journal(req->state, pointer);
+        }
 
         report_progress(req->state);
 
@@ -795,228 +1343,536 @@ static void progress_request_shard(uv_async_t* async)
 
     storj_download_state_t *state = progress->state;
 
-    state->pointers[progress->pointer_index].downloaded_size = progress->bytes;
+    // shards downloaded again to decode a lost shard were already counted
+    if (state->stream_recovering &&
+        progress->pointer_index < state->stream_position) {
+        return;
+    }
+
+    set_downloaded_size(state, &state->pointers[progress->pointer_index],
+                        progress->bytes);
 
     report_progress(state);
 }
 
-static void queue_request_shards(storj_download_state_t *state)
+static void read_cached_shard(uv_work_t *work)
 {
-    if (state->canceled) {
-        return;
-    }
-
-    int i = 0;
-
-    while (state->resolving_shards < state->download_max_concurrency &&
-           i < state->total_pointers) {
+    shard_request_download_t *req = work->data;
+    storj_download_state_t *state = req->state;
 
-        storj_pointer_t *pointer = &state->pointers[i];
+    req->error_status = shard_cache_read(state->env->shard_cache,
+                                         req->shard_hash,
+                                         req->shard_total_bytes,
+                                         req->shard_data ? NULL : state->destination,
+                                         req->byte_position,
+                                         req->shard_data);
+}
 
-        if (pointer->status == POINTER_CREATED) {
-            shard_request_download_t *req = malloc(sizeof(shard_request_download_t));
-            if (!req) {
-                state->error_status = STORJ_MEMORY_ERROR;
-                return;
-            }
+static void after_read_cached_shard(uv_work_t *work, int status)
+{
+    shard_request_download_t *req = work->data;
+    storj_download_state_t *state = req->state;
 
-            req->http_options = state->env->http_options;
-            req->farmer_id = pointer->farmer_id;
-            req->farmer_proto = "http";
-            req->farmer_host = pointer->farmer_address;
-            req->farmer_port = pointer->farmer_port;
-            req->shard_hash = pointer->shard_hash;
-            req->shard_total_bytes = pointer->size;
-            req->byte_position = state->shard_size * i;
-            req->token = pointer->token;
-            req->error_status = 0;
+    state->pending_work_count--;
+    state->resolving_shards -= 1;
 
-            req->pointer_index = pointer->index;
+    storj_pointer_t *pointer = &state->pointers[req->pointer_index];
+    pointer->work = NULL;
 
-            req->state = state;
-            req->canceled = &state->canceled;
+    if (status != 0) {
+        state->error_status = STORJ_QUEUE_ERROR;
+    } else if (req->abandoned && !state->canceled) {
+        pointer->status = POINTER_MISSING;
 
-            uv_work_t *work = malloc(sizeof(uv_work_t));
-            if (!work) {
-                state->error_status = STORJ_MEMORY_ERROR;
-                return;
-            }
+        free(pointer->shard_data);
+        pointer->shard_data = NULL;
 
-            work->data = req;
+    } else if (req->error_status == STORJ_FILE_READ_ERROR ||
+               req->error_status == STORJ_FILE_INTEGRITY_ERROR) {
 
-            state->resolving_shards += 1;
-            pointer->status = POINTER_BEING_DOWNLOADED;
-            pointer->work = work;
+        // the shard has been removed from the cache, and is downloaded
+        // from the farmer instead
+        state->log->info(state->env->log_options, state->handle,
+                         "Unable to read shard from cache: %s",
+                         req->shard_hash);
 
-            state->log->info(state->env->log_options,
-                             state->handle,
-                             "Queue request shard: %s",
-                             req->shard_hash);
+        pointer->status = POINTER_CREATED;
 
-            // setup download progress reporting
-            shard_download_progress_t *progress =
-                malloc(sizeof(shard_download_progress_t));
-            if (!progress) {
-                state->error_status = STORJ_MEMORY_ERROR;
-                return;
-            }
+        free(pointer->shard_data);
+        pointer->shard_data = NULL;
 
-            progress->pointer_index = pointer->index;
-            progress->bytes = 0;
-            progress->state = state;
+    } else if (req->error_status) {
+        state->error_status = req->error_status;
+    } else {
+        state->log->info(state->env->log_options, state->handle,
+                         "Read shard from cache: %s", req->shard_hash);
 
-            req->progress_handle.data = progress;
+        pointer->status = POINTER_DOWNLOADED;
+        pointer->cache_fill = false;
 
-            uv_async_init(state->env->loop, &req->progress_handle,
-                          progress_request_shard);
+        set_downloaded_size(state, pointer, pointer->size);
 
-            // queue download
-            state->pending_work_count++;
-            int status = uv_queue_work(state->env->loop, (uv_work_t*) work,
-                                       request_shard, after_request_shard);
-            if (status) {
-                state->error_status = STORJ_QUEUE_ERROR;
-                return;
-            }
+        if (state->journal_path) {
+            append_download_journal(state, pointer);
         }
 
-        i++;
+        report_progress(state);
     }
-}
 
-static void send_exchange_report(uv_work_t *work)
-{
-    shard_send_report_t *req = work->data;
-    storj_download_state_t *state = req->state;
+    free(req);
+    free(work);
 
-    struct json_object *body = json_object_new_object();
+    queue_next_work(state);
+}
 
-    json_object_object_add(body, "dataHash",
-                           json_object_new_string(req->report->data_hash));
+static void queue_read_cached_shard(storj_download_state_t *state,
+                                    storj_pointer_t *pointer)
+{
+    uv_work_t *work = malloc(sizeof(uv_work_t));
+    if (!work) {
+        state->error_status = STORJ_MEMORY_ERROR;
+        return;
+    }
 
-    json_object_object_add(body, "reporterId",
-                           json_object_new_string(req->report->reporter_id));
+    shard_request_download_t *req = calloc(1, sizeof(shard_request_download_t));
+    if (!req) {
+        free(work);
+        state->error_status = STORJ_MEMORY_ERROR;
+        return;
+    }
 
-    json_object_object_add(body, "farmerId",
-                           json_object_new_string(req->report->farmer_id));
+    // a whole shard is kept for decoding lost shards from it
+    if (state->stream) {
+        free(pointer->shard_data);
+        pointer->shard_data = calloc(state->shard_size, sizeof(uint8_t));
+        if (!pointer->shard_data) {
+            free(req);
+            free(work);
+            state->error_status = STORJ_MEMORY_ERROR;
+            return;
+        }
+        req->shard_data = pointer->shard_data;
+    }
 
-    json_object_object_add(body, "clientId",
-                           json_object_new_string(req->report->client_id));
+    req->shard_hash = pointer->shard_hash;
+    req->shard_total_bytes = pointer->size;
+    req->byte_position = pointer->index * state->shard_size;
+    req->pointer_index = pointer->index;
+    req->start = get_time_milliseconds();
+    req->state = state;
+    req->abandoned = false;
+    req->canceled = &req->abandoned;
 
-    json_object_object_add(body, "exchangeStart",
-                           json_object_new_int64(req->report->start));
+    work->data = req;
 
-    json_object_object_add(body, "exchangeEnd",
-                           json_object_new_int64(req->report->end));
+    state->resolving_shards += 1;
+    pointer->status = POINTER_BEING_DOWNLOADED;
+    pointer->work = work;
 
-    json_object_object_add(body, "exchangeResultCode",
-                           json_object_new_int(req->report->code));
+    state->pending_work_count++;
+    int status = uv_queue_work(state->env->loop, work,
+                               read_cached_shard, after_read_cached_shard);
+    if (status) {
+        state->pending_work_count--;
+        state->resolving_shards -= 1;
+        pointer->status = POINTER_CREATED;
+        pointer->work = NULL;
+        free(req);
+        free(work);
+        state->error_status = STORJ_QUEUE_ERROR;
+    }
+}
 
-    json_object_object_add(body, "exchangeResultMessage",
-                           json_object_new_string(req->report->message));
+static void write_cached_shard(uv_work_t *work)
+{
+    shard_request_download_t *req = work->data;
+    storj_download_state_t *state = req->state;
 
-    int status_code = 0;
+    req->error_status = shard_cache_write(state->env->shard_cache,
+                                          req->shard_hash,
+                                          req->shard_total_bytes,
+                                          state->destination,
+                                          req->byte_position,
+                                          NULL);
+}
 
-    // there should be an empty object in response
-    struct json_object *response = NULL;
-    int request_status = fetch_json(req->http_options,
-                                    req->options, "POST",
-                                    "/reports/exchanges", body,
-                                    true, &response, &status_code);
+static void after_write_cached_shard(uv_work_t *work, int status)
+{
+    shard_request_download_t *req = work->data;
+    storj_download_state_t *state = req->state;
 
+    state->pending_work_count--;
+    state->caching_shards -= 1;
 
-    if (request_status) {
+    // the download doesn't depend on the cache
+    if (status != 0 || req->error_status) {
         state->log->warn(state->env->log_options, state->handle,
-                         "Send exchange report error: %i", request_status);
+                         "Unable to add shard to cache: %s",
+                         req->shard_hash);
     }
 
-    req->status_code = status_code;
+    free(req);
+    free(work);
 
-    // free all memory for body and response
-    if (response) {
-        json_object_put(response);
-    }
-    json_object_put(body);
+    queue_next_work(state);
 }
 
-static void after_send_exchange_report(uv_work_t *work, int status)
+static void queue_write_cached_shard(storj_download_state_t *state,
+                                     storj_pointer_t *pointer)
 {
-    shard_send_report_t *req = work->data;
+    uv_work_t *work = malloc(sizeof(uv_work_t));
+    if (!work) {
+        return;
+    }
 
-    req->state->pending_work_count--;
+    shard_request_download_t *req = calloc(1, sizeof(shard_request_download_t));
+    if (!req) {
+        free(work);
+        return;
+    }
 
-    // set status so that this pointer can be replaced
-    if (req->report->send_count >= STORJ_MAX_REPORT_TRIES ||
-        req->status_code == 201) {
+    req->shard_hash = pointer->shard_hash;
+    req->shard_total_bytes = pointer->size;
+    req->byte_position = pointer->index * state->shard_size;
+    req->pointer_index = pointer->index;
+    req->state = state;
 
-        storj_pointer_t *pointer = &req->state->pointers[req->pointer_index];
+    work->data = req;
 
-        if (pointer->status == POINTER_ERROR) {
-            pointer->status = POINTER_ERROR_REPORTED;
-        }
+    // the shards are copied from the destination before it is decrypted
+    state->pending_work_count++;
+    state->caching_shards += 1;
+    int status = uv_queue_work(state->env->loop, work,
+                               write_cached_shard, after_write_cached_shard);
+    if (status) {
+        state->pending_work_count--;
+        state->caching_shards -= 1;
+        free(req);
+        free(work);
     }
+}
 
-    if (req->status_code == 201) {
-        // set the status so that this pointer can be replaced
-        req->report->send_status = 2; // report has been sent
-    } else {
-        req->report->send_status = 0; // reset report back to unsent
-    }
+static int compare_durations(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *)a;
+    uint64_t y = *(const uint64_t *)b;
 
-    queue_next_work(req->state);
+    return (x > y) - (x < y);
+}
 
-    free(work->data);
-    free(work);
+/*
+ * Count the data shards that will need a parity shard, which are those
+ * that can't be downloaded, and those that have been downloading for
+ * longer than the median shard of this file by the lag factor
+ */
+static uint32_t lagging_data_shards(storj_download_state_t *state)
+{
+    uint64_t *durations = malloc(state->total_pointers * sizeof(uint64_t));
+    if (!durations) {
+        return 0;
+    }
+
+    uint32_t total_durations = 0;
+    for (int i = 0; i < state->total_pointers; i++) {
+        storj_pointer_t *pointer = &state->pointers[i];
+        if (pointer->status == POINTER_DOWNLOADED &&
+            pointer->report->end > pointer->report->start &&
+            pointer->report->start > 0) {
+            durations[total_durations] =
+                pointer->report->end - pointer->report->start;
+            total_durations += 1;
+        }
+    }
+
+    uint64_t median = 0;
+    if (total_durations > 0) {
+        qsort(durations, total_durations, sizeof(uint64_t),
+              compare_durations);
+        median = durations[total_durations / 2];
+    }
+    free(durations);
+
+    uint64_t now = get_time_milliseconds();
+    uint32_t lagging = 0;
 
+    for (int i = 0; i < state->total_pointers; i++) {
+        storj_pointer_t *pointer = &state->pointers[i];
+        if (pointer->parity) {
+            continue;
+        }
+
+        switch (pointer->status) {
+            case POINTER_MISSING:
+            case POINTER_ERROR:
+            case POINTER_ERROR_REPORTED:
+            case POINTER_BEING_REPLACED:
+                lagging += 1;
+                break;
+            case POINTER_BEING_DOWNLOADED: {
+                shard_request_download_t *req = pointer->work->data;
+                if (median > 0 && req->start > 0 &&
+                    now - req->start > median * STORJ_HEDGE_LAG_FACTOR) {
+                    lagging += 1;
+                }
+                break;
+            }
+            default:
+                break;
+        }
+    }
+
+    return lagging;
 }
 
-static void queue_send_exchange_reports(storj_download_state_t *state)
+/*
+ * Once enough shards have been downloaded to recover the file, stop the
+ * shards that are still downloading and skip those not started
+ */
+static void abandon_slow_shards(storj_download_state_t *state)
 {
+    if (!state->hedge || !state->rs || !state->pointers_completed ||
+        state->replacing_pointers > 0 || state->recovering_shards) {
+        return;
+    }
 
-    if (state->canceled) {
+    uint32_t data_shards = state->total_pointers - state->total_parity_pointers;
+    uint32_t downloaded = 0;
+
+    for (int i = 0; i < state->total_pointers; i++) {
+        if (state->pointers[i].status == POINTER_DOWNLOADED) {
+            downloaded += 1;
+        }
+    }
+
+    if (downloaded < data_shards) {
         return;
     }
 
     for (int i = 0; i < state->total_pointers; i++) {
+        storj_pointer_t *pointer = &state->pointers[i];
+
+        switch (pointer->status) {
+            case POINTER_BEING_DOWNLOADED: {
+                shard_request_download_t *req = pointer->work->data;
+                req->abandoned = true;
+                break;
+            }
+            case POINTER_CREATED:
+            case POINTER_ERROR:
+            case POINTER_ERROR_REPORTED:
+                pointer->status = POINTER_MISSING;
+                break;
+            default:
+                break;
+        }
+    }
+}
+
+static void hedge_download(uv_timer_t *timer)
+{
+    // look for shards that lag behind even when no transfer has finished
+    queue_next_work(timer->data);
+}
+
+static void queue_request_shards(storj_download_state_t *state)
+{
+    if (state->canceled) {
+        return;
+    }
+
+    // parity shards are only downloaded for the data shards that lag
+    // behind when hedging
+    bool hedge = state->hedge && state->rs;
+    uint32_t parity_wanted = 0;
+    uint32_t parity_active = 0;
+
+    if (hedge) {
+        parity_wanted = lagging_data_shards(state);
+
+        for (int i = 0; i < state->total_pointers; i++) {
+            storj_pointer_t *pointer = &state->pointers[i];
+            if (pointer->parity &&
+                (pointer->status == POINTER_BEING_DOWNLOADED ||
+                 pointer->status == POINTER_DOWNLOADED)) {
+                parity_active += 1;
+            }
+        }
+    }
+
+    int i = 0;
+
+    while (state->resolving_shards < state->download_max_concurrency &&
+           i < state->total_pointers) {
 
         storj_pointer_t *pointer = &state->pointers[i];
 
-        if (pointer->report->send_status < 1 &&
-            pointer->report->send_count < STORJ_MAX_REPORT_TRIES &&
-            pointer->report->start > 0 &&
-            pointer->report->end > 0) {
+        if (pointer->status == POINTER_CREATED && state->stream &&
+            !stream_shard_wanted(state, pointer)) {
+            i++;
+            continue;
+        }
 
-            uv_work_t *work = malloc(sizeof(uv_work_t));
-            if (!work) {
-                state->error_status = STORJ_MEMORY_ERROR;
+        if (pointer->status == POINTER_CREATED && hedge && pointer->parity) {
+            if (parity_active >= parity_wanted) {
+                i++;
+                continue;
+            }
+            parity_active += 1;
+        }
+
+        // shards in the cache are read from the disk, apart from the
+        // shards in flight of the environment
+        if (pointer->status == POINTER_CREATED && state->env->shard_cache &&
+            shard_cache_contains(state->env->shard_cache, pointer->shard_hash,
+                                 pointer->size)) {
+            queue_read_cached_shard(state, pointer);
+            if (state->error_status) {
+                return;
+            }
+            i++;
+            continue;
+        }
+
+        if (pointer->status == POINTER_CREATED) {
+            // wait to be woken when other files are using the budget
+            if (!transfer_slot_acquire(state->transfer_slot, pointer->size)) {
                 return;
             }
 
-            shard_send_report_t *req = malloc(sizeof(shard_send_report_t));
+            shard_request_download_t *req = malloc(sizeof(shard_request_download_t));
             if (!req) {
+                transfer_slot_release(state->transfer_slot, pointer->size);
                 state->error_status = STORJ_MEMORY_ERROR;
                 return;
             }
 
             req->http_options = state->env->http_options;
-            req->options = state->env->bridge_options;
-            req->status_code = 0;
-            req->report = pointer->report;
-            req->report->send_status = 1; // being reported
-            req->report->send_count += 1;
+            req->farmer_id = pointer->farmer_id;
+            req->farmer_proto = "http";
+            req->farmer_host = pointer->farmer_address;
+            req->farmer_port = pointer->farmer_port;
+            req->shard_hash = pointer->shard_hash;
+            req->shard_total_bytes = pointer->size;
+            req->byte_position = state->shard_size * i;
+            req->token = pointer->token;
+            req->error_status = 0;
+            req->shard_data = NULL;
+
+            req->pointer_index = pointer->index;
+
+            // a whole shard is kept for decoding lost shards from it
+            if (state->stream) {
+                free(pointer->shard_data);
+                pointer->shard_data = calloc(state->shard_size, sizeof(uint8_t));
+                if (!pointer->shard_data) {
+                    free(req);
+                    transfer_slot_release(state->transfer_slot, pointer->size);
+                    state->error_status = STORJ_MEMORY_ERROR;
+                    return;
+                }
+                req->shard_data = pointer->shard_data;
+            }
+
             req->state = state;
-            req->pointer_index = i;
+            req->abandoned = false;
+            req->canceled = &req->abandoned;
+
+            uv_work_t *work = malloc(sizeof(uv_work_t));
+            if (!work) {
+                free(req);
+                transfer_slot_release(state->transfer_slot, pointer->size);
+                state->error_status = STORJ_MEMORY_ERROR;
+                return;
+            }
 
             work->data = req;
 
+            state->resolving_shards += 1;
+            pointer->status = POINTER_BEING_DOWNLOADED;
+            pointer->work = work;
+
+            state->log->info(state->env->log_options,
+                             state->handle,
+                             "Queue request shard: %s",
+                             req->shard_hash);
+
+            // setup download progress reporting
+            shard_download_progress_t *progress =
+                malloc(sizeof(shard_download_progress_t));
+            if (!progress) {
+                free(req);
+                free(work);
+                state->resolving_shards -= 1;
+                pointer->status = POINTER_CREATED;
+                pointer->work = NULL;
+                transfer_slot_release(state->transfer_slot, pointer->size);
+                state->error_status = STORJ_MEMORY_ERROR;
+                return;
+            }
+
+            progress->pointer_index = pointer->index;
+            progress->bytes = 0;
+            progress->state = state;
+
+            req->progress_handle.data = progress;
+
+            uv_async_init(state->env->loop, &req->progress_handle,
+                          progress_request_shard);
+
+            // start download on the event loop
             state->pending_work_count++;
-            int status = uv_queue_work(state->env->loop, (uv_work_t*) work,
-                                       send_exchange_report,
-                                       after_send_exchange_report);
+            int status = request_shard(work);
             if (status) {
-                state->error_status = STORJ_QUEUE_ERROR;
+                // undo the request, the work is freed once the progress
+                // is closed
+                state->pending_work_count--;
+                state->resolving_shards -= 1;
+                pointer->status = POINTER_CREATED;
+                pointer->work = NULL;
+                transfer_slot_release(state->transfer_slot, pointer->size);
+
+                free(progress);
+                req->progress_handle.data = work;
+                uv_close((uv_handle_t *)&req->progress_handle,
+                         free_request_shard_work);
+
+                state->error_status = status;
+                return;
+            }
+        }
+
+        i++;
+    }
+}
+
+static void queue_send_exchange_reports(storj_download_state_t *state)
+{
+
+    if (state->canceled) {
+        return;
+    }
+
+    for (int i = 0; i < state->total_pointers; i++) {
+
+        storj_pointer_t *pointer = &state->pointers[i];
+
+        if (pointer->report->send_status < 1 &&
+            pointer->report->start > 0 &&
+            pointer->report->end > 0) {
+
+            // the report is copied and sent apart from the download,
+            // which does not wait for it
+            if (report_queue_add(state->env->reports, pointer->report)) {
+                state->error_status = STORJ_MEMORY_ERROR;
                 return;
             }
+
+            pointer->report->send_status = 2; // report has been queued
+
+            // set status so that this pointer can be replaced
+            if (pointer->status == POINTER_ERROR) {
+                pointer->status = POINTER_ERROR_REPORTED;
+            }
         }
     }
 }
@@ -1032,9 +1888,10 @@ static void determine_decryption_key_v1(storj_download_state_t *state)
         goto cleanup;
     }
 
-    if (generate_file_key(state->env->encrypt_options->mnemonic,
-                          state->bucket_id,
-                          state->info->index, &file_key_as_str)) {
+    if (generate_file_key_cached(state->env->encrypt_options->key_cache,
+                                 state->env->encrypt_options->mnemonic,
+                                 state->bucket_id,
+                                 state->info->index, &file_key_as_str)) {
         state->error_status = STORJ_MEMORY_ERROR;
         goto cleanup;
     }
@@ -1080,9 +1937,10 @@ static void determine_decryption_key_v0(storj_download_state_t *state)
         return;
     }
 
-    if (generate_file_key(state->env->encrypt_options->mnemonic,
-                          state->bucket_id,
-                          state->file_id, &file_key)) {
+    if (generate_file_key_cached(state->env->encrypt_options->key_cache,
+                                 state->env->encrypt_options->mnemonic,
+                                 state->bucket_id,
+                                 state->file_id, &file_key)) {
         state->error_status = STORJ_MEMORY_ERROR;
         return;
     }
@@ -1449,7 +2307,7 @@ static bool can_recover_shards(storj_download_state_t *state)
     return true;
 }
 
-static void after_recover_shards(uv_work_t *work, int status)
+static void after_finish_recover_shards(uv_work_t *work, int status)
 {
     file_request_recover_t *req = work->data;
     storj_download_state_t *state = req->state;
@@ -1458,6 +2316,10 @@ static void after_recover_shards(uv_work_t *work, int status)
     state->recovering_shards = false;
     state->truncated = true;
 
+    metrics_phase(&state->env->metrics, STORJ_PHASE_RECOVER_SHARDS,
+                  req->filesize, req->start,
+                  status ? STORJ_QUEUE_ERROR : req->error_status);
+
     if (status != 0) {
         req->state->error_status = STORJ_QUEUE_ERROR;
     } else if (req->error_status) {
@@ -1472,288 +2334,1184 @@ static void after_recover_shards(uv_work_t *work, int status)
 
     queue_next_work(state);
 
-    memset_zero(req->decrypt_key, SHA256_DIGEST_SIZE);
-    free(req->decrypt_key);
+    if (req->decrypt_key) {
+        memset_zero(req->decrypt_key, SHA256_DIGEST_SIZE);
+        free(req->decrypt_key);
+    }
 
-    memset_zero(req->decrypt_ctr, AES_BLOCK_SIZE);
-    free(req->decrypt_ctr);
+    if (req->decrypt_ctr) {
+        memset_zero(req->decrypt_ctr, AES_BLOCK_SIZE);
+        free(req->decrypt_ctr);
+    }
 
     free(req->zilch);
     free(req);
     free(work);
 }
 
-static void recover_shards(uv_work_t *work)
+static void finish_recover_shards(uv_work_t *work)
 {
     file_request_recover_t *req = work->data;
-    storj_download_state_t *state = req->state;
-    reed_solomon* rs = NULL;
-    uint8_t *data_map = NULL;
-    uint8_t **data_blocks = NULL;
-    uint8_t **fec_blocks = NULL;
-
     int error = 0;
 
-    struct aes256_ctx ctx;
-    uint64_t bytes_decrypted = 0;
-    size_t len = AES_BLOCK_SIZE * 8;
+    if (req->data_map) {
+        error = unmap_file(req->data_map, req->filesize);
+        if (error) {
+            req->error_status = STORJ_UNMAPPING_ERROR;
+        }
+    }
+
+    if (req->data_blocks) {
+        free(req->data_blocks);
+    }
+
+    if (req->fec_blocks) {
+        free(req->fec_blocks);
+    }
+
+    // the codec is owned by the cache
+    if (req->decoder && req->decoder_owned) {
+        reed_solomon_decoder_release(req->decoder);
+    }
 
-    // Make sure that the file is the correct size before recovering
-    // shards in case that the last shard is the one being recovered.
 #ifdef _WIN32
 
-    HANDLE prefile = (HANDLE)_get_osfhandle(req->fd);
-    if (prefile == INVALID_HANDLE_VALUE) {
+    HANDLE file = (HANDLE)_get_osfhandle(req->fd);
+    if (file == INVALID_HANDLE_VALUE) {
         req->error_status = STORJ_FILE_RESIZE_ERROR;
         return;
     }
 
-    LARGE_INTEGER presize;
-    presize.HighPart = (uint32_t)((req->filesize & 0xFFFFFFFF00000000LL) >> 32);
-    presize.LowPart = (uint32_t)(req->filesize & 0xFFFFFFFFLL);
+    LARGE_INTEGER size;
+    size.HighPart = (uint32_t)((req->data_filesize & 0xFFFFFFFF00000000LL) >> 32);
+    size.LowPart = (uint32_t)(req->data_filesize & 0xFFFFFFFFLL);
 
-    if (!SetFilePointerEx(prefile, presize, 0, FILE_BEGIN)) {
+    if (!SetFilePointerEx(file, size, 0, FILE_BEGIN)) {
         req->error_status = STORJ_FILE_RESIZE_ERROR;
         return;
     }
 
-    if (!SetEndOfFile(prefile)) {
+    if (!SetEndOfFile(file)) {
         req->error_status = STORJ_FILE_RESIZE_ERROR;
         return;
     }
 
-#else
-    if (ftruncate(req->fd, req->filesize)) {
-        // errno for more details
-        req->error_status = STORJ_FILE_RESIZE_ERROR;
-    }
-#endif
+#else
+    if (ftruncate(req->fd, req->data_filesize)) {
+        // errno for more details
+        req->error_status = STORJ_FILE_RESIZE_ERROR;
+    }
+#endif
+
+}
+
+static void queue_finish_recover_shards(file_request_recover_t *req)
+{
+    storj_download_state_t *state = req->state;
+
+    uv_work_t *work = malloc(sizeof(uv_work_t));
+    if (!work) {
+        state->error_status = STORJ_MEMORY_ERROR;
+        return;
+    }
+
+    work->data = req;
+
+    state->pending_work_count++;
+    int status = uv_queue_work(state->env->loop, (uv_work_t*) work,
+                               finish_recover_shards,
+                               after_finish_recover_shards);
+
+    if (status) {
+        state->error_status = STORJ_QUEUE_ERROR;
+    }
+}
+
+static void after_decrypt_file_segment(uv_work_t *work, int status)
+{
+    file_request_recover_stripe_t *segment_req = work->data;
+    file_request_recover_t *req = segment_req->recover_req;
+
+    req->state->pending_work_count--;
+
+    if (status != 0) {
+        req->error_status = STORJ_QUEUE_ERROR;
+    } else if (segment_req->error_status) {
+        req->error_status = segment_req->error_status;
+    }
+
+    req->completed_segments += 1;
+
+    // All of the segments are joined before unmapping the file
+    if (req->completed_segments == req->total_segments) {
+        queue_finish_recover_shards(req);
+    }
+
+    free(segment_req);
+    free(work);
+}
+
+static void decrypt_file_segment(uv_work_t *work)
+{
+    file_request_recover_stripe_t *segment_req = work->data;
+    file_request_recover_t *req = segment_req->recover_req;
+
+    if (ctr_crypt_segment(req->decrypt_key, req->decrypt_ctr,
+                          segment_req->offset, segment_req->length,
+                          req->data_map + segment_req->offset,
+                          req->data_map + segment_req->offset)) {
+        segment_req->error_status = STORJ_FILE_DECRYPTION_ERROR;
+    }
+}
+
+static void queue_decrypt_file_segments(file_request_recover_t *req)
+{
+    storj_download_state_t *state = req->state;
+
+    req->total_segments = 0;
+    req->completed_segments = 0;
+
+    uint64_t offset = 0;
+    while (!req->error_status && req->data_map && req->decrypt_key &&
+           offset < req->data_filesize) {
+        uint64_t length = req->data_filesize - offset;
+        if (length > STORJ_CRYPT_SEGMENT_SIZE) {
+            length = STORJ_CRYPT_SEGMENT_SIZE;
+        }
+
+        uv_work_t *work = malloc(sizeof(uv_work_t));
+        file_request_recover_stripe_t *segment_req =
+            malloc(sizeof(file_request_recover_stripe_t));
+        if (!work || !segment_req) {
+            free(work);
+            free(segment_req);
+            req->error_status = STORJ_MEMORY_ERROR;
+            break;
+        }
+
+        segment_req->recover_req = req;
+        segment_req->offset = offset;
+        segment_req->length = length;
+        segment_req->error_status = 0;
+        work->data = segment_req;
+
+        int status = uv_queue_work(state->env->loop, (uv_work_t*) work,
+                                   decrypt_file_segment,
+                                   after_decrypt_file_segment);
+        if (status) {
+            free(work);
+            free(segment_req);
+            req->error_status = STORJ_QUEUE_ERROR;
+            break;
+        }
+
+        state->pending_work_count++;
+        req->total_segments += 1;
+        offset += length;
+    }
+
+    // Nothing left to join, continue with unmapping the file
+    if (req->total_segments == 0) {
+        queue_finish_recover_shards(req);
+    }
+}
+
+static void after_recover_shards_stripe(uv_work_t *work, int status)
+{
+    file_request_recover_stripe_t *stripe_req = work->data;
+    file_request_recover_t *req = stripe_req->recover_req;
+
+    req->state->pending_work_count--;
+
+    if (status != 0) {
+        req->error_status = STORJ_QUEUE_ERROR;
+    } else if (stripe_req->error_status) {
+        req->error_status = stripe_req->error_status;
+    }
+
+    req->completed_stripes += 1;
+
+    // All of the stripes are joined before decrypting the file, or adding
+    // the next input of a stream
+    if (req->completed_stripes == req->total_stripes) {
+        if (req->stream) {
+            after_add_stream_input(req);
+        } else {
+            queue_decrypt_file_segments(req);
+        }
+    }
+
+    free(stripe_req);
+    free(work);
+}
+
+static void recover_shards_stripe(uv_work_t *work)
+{
+    file_request_recover_stripe_t *stripe_req = work->data;
+    file_request_recover_t *req = stripe_req->recover_req;
+    int error = 0;
+
+    if (req->stream) {
+        error = reed_solomon_decoder_add_stripe(req->rs, req->decoder,
+                                                req->input,
+                                                req->input_block,
+                                                req->erased_blocks,
+                                                req->shard_size,
+                                                req->data_filesize,
+                                                stripe_req->offset,
+                                                stripe_req->length);
+    } else {
+        error = reed_solomon_decoder_reconstruct_stripe(req->rs, req->decoder,
+                                                        req->data_blocks,
+                                                        req->fec_blocks,
+                                                        req->shard_size,
+                                                        req->data_filesize,
+                                                        stripe_req->offset,
+                                                        stripe_req->length);
+    }
+
+    if (error) {
+        stripe_req->error_status = STORJ_FILE_RECOVER_ERROR;
+    }
+}
+
+static void queue_recover_shards_stripes(file_request_recover_t *req)
+{
+    storj_download_state_t *state = req->state;
+
+    req->stripe_size = determine_stripe_size(req->shard_size);
+    req->total_stripes = 0;
+    req->completed_stripes = 0;
+
+    uint64_t offset = 0;
+    while (offset < req->shard_size) {
+        uint64_t length = req->shard_size - offset;
+        if (length > req->stripe_size) {
+            length = req->stripe_size;
+        }
+
+        uv_work_t *work = malloc(sizeof(uv_work_t));
+        file_request_recover_stripe_t *stripe_req =
+            malloc(sizeof(file_request_recover_stripe_t));
+        if (!work || !stripe_req) {
+            free(work);
+            free(stripe_req);
+            req->error_status = STORJ_MEMORY_ERROR;
+            break;
+        }
+
+        stripe_req->recover_req = req;
+        stripe_req->offset = offset;
+        stripe_req->length = length;
+        stripe_req->error_status = 0;
+        work->data = stripe_req;
+
+        int status = uv_queue_work(state->env->loop, (uv_work_t*) work,
+                                   recover_shards_stripe,
+                                   after_recover_shards_stripe);
+        if (status) {
+            free(work);
+            free(stripe_req);
+            req->error_status = STORJ_QUEUE_ERROR;
+            break;
+        }
+
+        state->pending_work_count++;
+        req->total_stripes += 1;
+        offset += length;
+    }
+
+    // Nothing left to join, continue with the decryption
+    if (req->total_stripes == 0) {
+        if (req->stream) {
+            after_add_stream_input(req);
+        } else {
+            queue_decrypt_file_segments(req);
+        }
+    }
+}
+
+static void after_recover_shards(uv_work_t *work, int status)
+{
+    file_request_recover_t *req = work->data;
+    storj_download_state_t *state = req->state;
+
+    state->pending_work_count--;
+
+    if (status != 0) {
+        req->error_status = STORJ_QUEUE_ERROR;
+    }
+
+    if (req->error_status || !req->has_missing) {
+        queue_decrypt_file_segments(req);
+    } else {
+        state->log->debug(state->env->log_options, state->handle,
+                          "Recovering shards, data_shards: %i, "            \
+                          "parity_shards: %i, shard_size: %" PRIu64 ", "    \
+                          "file_size: %" PRIu64,
+                          req->data_shards,
+                          req->parity_shards,
+                          req->shard_size,
+                          req->data_filesize);
+
+        queue_recover_shards_stripes(req);
+    }
+
+    free(work);
+}
+
+static void recover_shards(uv_work_t *work)
+{
+    file_request_recover_t *req = work->data;
+
+    req->start = metrics_now(&req->state->env->metrics);
+
+    int error = 0;
+
+    // Make sure that the file is the correct size before recovering
+    // shards in case that the last shard is the one being recovered.
+#ifdef _WIN32
+
+    HANDLE prefile = (HANDLE)_get_osfhandle(req->fd);
+    if (prefile == INVALID_HANDLE_VALUE) {
+        req->error_status = STORJ_FILE_RESIZE_ERROR;
+        return;
+    }
+
+    LARGE_INTEGER presize;
+    presize.HighPart = (uint32_t)((req->filesize & 0xFFFFFFFF00000000LL) >> 32);
+    presize.LowPart = (uint32_t)(req->filesize & 0xFFFFFFFFLL);
+
+    if (!SetFilePointerEx(prefile, presize, 0, FILE_BEGIN)) {
+        req->error_status = STORJ_FILE_RESIZE_ERROR;
+        return;
+    }
+
+    if (!SetEndOfFile(prefile)) {
+        req->error_status = STORJ_FILE_RESIZE_ERROR;
+        return;
+    }
+
+#else
+    if (ftruncate(req->fd, req->filesize)) {
+        // errno for more details
+        req->error_status = STORJ_FILE_RESIZE_ERROR;
+    }
+#endif
+
+    error = map_file(req->fd, req->filesize, &req->data_map, false);
+    if (error) {
+        req->error_status = STORJ_MAPPING_ERROR;
+        return;
+    }
+
+    if (!req->has_missing) {
+        return;
+    }
+
+    codec_cache_t *codecs = req->state->env->codecs;
+
+    req->rs = codec_cache_get(codecs, req->data_shards, req->parity_shards);
+    if (!req->rs) {
+        req->error_status = STORJ_MEMORY_ERROR;
+        return;
+    }
+
+    // the decode matrix is shared by all of the stripes
+    req->decoder = codec_cache_get_decoder(codecs, req->rs, req->zilch,
+                                           &req->decoder_owned);
+    if (!req->decoder) {
+        req->error_status = STORJ_FILE_RECOVER_ERROR;
+        return;
+    }
+
+    req->data_blocks = (uint8_t**)malloc(req->data_shards * sizeof(uint8_t *));
+    if (!req->data_blocks) {
+        req->error_status = STORJ_MEMORY_ERROR;
+        return;
+    }
+
+    req->fec_blocks = (uint8_t**)malloc(req->parity_shards * sizeof(uint8_t *));
+    if (!req->fec_blocks) {
+        req->error_status = STORJ_MEMORY_ERROR;
+        return;
+    }
+
+    for (int i = 0; i < req->data_shards; i++) {
+        req->data_blocks[i] = req->data_map + i * req->shard_size;
+    }
+
+    for (int i = 0; i < req->parity_shards; i++) {
+        req->fec_blocks[i] = req->data_map + (req->data_shards + i) * req->shard_size;
+    }
+}
+
+static void queue_recover_shards(storj_download_state_t *state)
+{
+    if (!state->recovering_shards && state->pointers_completed &&
+        !state->caching_shards) {
+
+        int total_missing = 0;
+        bool has_missing = false;
+        bool is_ready = true;
+
+        uint8_t *zilch = (uint8_t *)calloc(1, state->total_pointers);
+
+        for (int i = 0; i < state->total_pointers; i++) {
+            storj_pointer_t *pointer = &state->pointers[i];
+            if (pointer->status == POINTER_MISSING) {
+                total_missing += 1;
+                has_missing = true;
+                zilch[i] = 1;
+            }
+
+            if (pointer->status != POINTER_MISSING &&
+                pointer->status != POINTER_DOWNLOADED) {
+                is_ready = false;
+                state->log->debug(state->env->log_options,
+                                  state->handle,
+                                  "Pointer %i not ready with status: %i",
+                                  i, pointer->status);
+
+            }
+        }
+
+        if (!is_ready) {
+            free(zilch);
+            return;
+        }
+
+        state->log->info(state->env->log_options,
+                         state->handle,
+                         "Queuing recovery of %i of %i shards",
+                         total_missing, state->total_shards);
+
+        file_request_recover_t *req = calloc(1, sizeof(file_request_recover_t));
+        if (!req) {
+            state->error_status = STORJ_MEMORY_ERROR;
+            return;
+        }
+
+        uv_work_t *work = malloc(sizeof(uv_work_t));
+        if (!work) {
+            state->error_status = STORJ_MEMORY_ERROR;
+            return;
+        }
+
+        req->fd = fileno(state->destination);
+        req->filesize = state->shard_size * state->total_pointers;
+        req->data_filesize = calculate_data_filesize(state);
+        req->data_shards = state->total_pointers - state->total_parity_pointers;
+        req->parity_shards = state->total_parity_pointers;
+        req->shard_size = state->shard_size;
+        req->zilch = zilch;
+        req->has_missing = has_missing;
+
+        if (state->decrypt_key && state->decrypt_ctr) {
+            req->decrypt_key = calloc(SHA256_DIGEST_SIZE, sizeof(uint8_t));
+            if (!req->decrypt_key) {
+                state->error_status = STORJ_MEMORY_ERROR;
+                return;
+            }
+            req->decrypt_ctr = calloc(AES_BLOCK_SIZE, sizeof(uint8_t));
+            if (!req->decrypt_ctr) {
+                state->error_status = STORJ_MEMORY_ERROR;
+                return;
+            }
+            memcpy(req->decrypt_key, state->decrypt_key, SHA256_DIGEST_SIZE);
+            memcpy(req->decrypt_ctr, state->decrypt_ctr, AES_BLOCK_SIZE);
+
+            increment_ctr_aes_iv(req->decrypt_ctr, 0);
+        } else {
+            req->decrypt_key = NULL;
+            req->decrypt_ctr = NULL;
+        }
+
+        req->state = state;
+        req->error_status = 0;
+
+        work->data = req;
+
+        state->pending_work_count++;
+        int status = uv_queue_work(state->env->loop, (uv_work_t*) work,
+                                   recover_shards, after_recover_shards);
+
+        if (status) {
+            state->error_status = STORJ_QUEUE_ERROR;
+            return;
+        }
+
+        state->recovering_shards = true;
+    }
+}
+
+static bool range_contains_shard(storj_download_state_t *state,
+                                 uint32_t index)
+{
+    if (!state->range) {
+        return true;
+    }
+
+    if (!state->shard_size) {
+        return false;
+    }
+
+    uint64_t start = index * state->shard_size;
+
+    if (start + state->shard_size <= state->range_offset) {
+        return false;
+    }
+
+    return !state->range_length ||
+        start < state->range_offset + state->range_length;
+}
+
+static uint32_t stream_end_position(storj_download_state_t *state)
+{
+    uint32_t data_shards = state->total_pointers - state->total_parity_pointers;
+
+    if (!state->range || !state->range_length || !state->shard_size) {
+        return data_shards;
+    }
+
+    uint64_t end = state->range_offset + state->range_length;
+    uint64_t end_position = (end + state->shard_size - 1) / state->shard_size;
+
+    return end_position < data_shards ? end_position : data_shards;
+}
+
+static bool in_stream_window(storj_download_state_t *state,
+                             storj_pointer_t *pointer)
+{
+    return !pointer->parity && range_contains_shard(state, pointer->index) &&
+        pointer->index >= state->stream_position &&
+        pointer->index < state->stream_position + state->stream_window;
+}
+
+/*
+ * If the shard is an input for decoding the lost shards of the window that
+ * has not been added yet
+ */
+static bool is_stream_input(storj_download_state_t *state, uint32_t index)
+{
+    file_request_recover_t *req = state->stream_recover;
+
+    if (!req || !req->decoder_ready) {
+        return false;
+    }
+
+    for (int i = 0; i < req->data_shards; i++) {
+        if (req->decoder->input_blocks[i] == index) {
+            return !req->inputs_added[i];
+        }
+    }
+
+    return false;
+}
+
+static uint32_t count_stream_inputs(storj_download_state_t *state)
+{
+    uint32_t total = 0;
+
+    for (int i = 0; i < state->total_pointers; i++) {
+        storj_pointer_t *pointer = &state->pointers[i];
+        if ((pointer->status == POINTER_BEING_DOWNLOADED ||
+             pointer->status == POINTER_DOWNLOADED) &&
+            !in_stream_window(state, pointer) &&
+            is_stream_input(state, i)) {
+            total += 1;
+        }
+    }
+
+    return total;
+}
+
+static bool stream_shard_wanted(storj_download_state_t *state,
+                                storj_pointer_t *pointer)
+{
+    if (in_stream_window(state, pointer)) {
+        return true;
+    }
+
+    // the inputs for decoding lost shards that are not in the window are
+    // held in memory until they are added, as many as the window
+    return is_stream_input(state, pointer->index) &&
+        count_stream_inputs(state) < state->stream_window;
+}
+
+static uint32_t stream_window_end(storj_download_state_t *state)
+{
+    uint32_t end_position = stream_end_position(state);
+    uint32_t window_end = state->stream_position + state->stream_window;
+
+    return window_end < end_position ? window_end : end_position;
+}
+
+static bool has_missing_data_shard(storj_download_state_t *state)
+{
+    uint32_t window_end = stream_window_end(state);
+
+    for (int i = state->stream_position; i < window_end; i++) {
+        storj_pointer_t *pointer = &state->pointers[i];
+        if (!pointer->parity && pointer->status == POINTER_MISSING) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void skip_range_shards(storj_download_state_t *state)
+{
+    if (!state->range || !state->shard_size || state->stream_recovering) {
+        return;
+    }
+
+    // the shards before the range are finished without downloading them
+    while (state->stream_position < state->total_pointers) {
+        storj_pointer_t *pointer = &state->pointers[state->stream_position];
+
+        if (pointer->parity ||
+            range_contains_shard(state, state->stream_position)) {
+            break;
+        }
+
+        if (pointer->status != POINTER_FINISHED) {
+            pointer->status = POINTER_FINISHED;
+            state->completed_shards += 1;
+        }
+
+        state->stream_position += 1;
+    }
+}
+
+static void write_stream_shard(uv_work_t *work)
+{
+    shard_request_stream_t *req = work->data;
+
+    // the shard is cached as downloaded, before it is decrypted in place
+    if (req->cache) {
+        shard_cache_write(req->cache, req->shard_hash, req->shard_size,
+                          NULL, 0, req->shard_data);
+    }
+
+    if (req->decrypt_key) {
+        struct aes256_ctx ctx;
+        aes256_set_encrypt_key(&ctx, req->decrypt_key);
+
+        ctr_crypt(&ctx, (nettle_cipher_func *)aes256_encrypt,
+                  AES_BLOCK_SIZE, req->decrypt_ctr,
+                  req->length, req->shard_data, req->shard_data);
+
+        memset_zero(&ctx, sizeof(struct aes256_ctx));
+    }
+
+    uint8_t *data = req->shard_data + req->offset;
+    size_t length = req->length - req->offset;
+
+    if (req->write_cb) {
+        if (req->write_cb(data, length, req->handle)) {
+            req->error_status = STORJ_FILE_WRITE_ERROR;
+        }
+        return;
+    }
+
+    // the destination is written in order, so that it may be a pipe
+    if (fwrite(data, 1, length, req->destination) != length ||
+        fflush(req->destination)) {
+        req->error_status = STORJ_FILE_WRITE_ERROR;
+    }
+}
+
+static void after_write_stream_shard(uv_work_t *work, int status)
+{
+    shard_request_stream_t *req = work->data;
+    storj_download_state_t *state = req->state;
+
+    state->pending_work_count--;
+    state->stream_writing = false;
+
+    storj_pointer_t *pointer = &state->pointers[req->pointer_index];
+
+    if (status != 0) {
+        state->error_status = STORJ_QUEUE_ERROR;
+    } else if (req->error_status) {
+        state->error_status = req->error_status;
+    } else {
+        free(pointer->shard_data);
+        pointer->shard_data = NULL;
+        pointer->status = POINTER_FINISHED;
+        state->completed_shards += 1;
+        state->stream_position += 1;
+    }
+
+    memset_zero(req->decrypt_ctr, AES_BLOCK_SIZE);
+    free(req);
+    free(work);
+
+    queue_next_work(state);
+}
+
+static void queue_write_stream_shard(storj_download_state_t *state)
+{
+    if (state->stream_writing || state->stream_position >= state->total_pointers ||
+        !range_contains_shard(state, state->stream_position)) {
+        return;
+    }
+
+    storj_pointer_t *pointer = &state->pointers[state->stream_position];
+    if (pointer->parity || pointer->status != POINTER_DOWNLOADED ||
+        !pointer->shard_data) {
+        return;
+    }
+
+    // a shard is decrypted as it is written, so an input for decoding lost
+    // shards is written once it has been added
+    file_request_recover_t *recover = state->stream_recover;
+    if (recover && (!recover->decoder_ready ||
+                    is_stream_input(state, state->stream_position))) {
+        return;
+    }
+
+    uv_work_t *work = malloc(sizeof(uv_work_t));
+    if (!work) {
+        state->error_status = STORJ_MEMORY_ERROR;
+        return;
+    }
+
+    shard_request_stream_t *req = malloc(sizeof(shard_request_stream_t));
+    if (!req) {
+        free(work);
+        state->error_status = STORJ_MEMORY_ERROR;
+        return;
+    }
+
+    req->shard_data = pointer->shard_data;
+    req->length = pointer->size;
+    req->offset = 0;
+    req->destination = state->destination;
+    req->write_cb = state->write_cb;
+    req->handle = state->handle;
+    req->pointer_index = state->stream_position;
+    req->cache = pointer->cache_fill ? state->env->shard_cache : NULL;
+    req->shard_hash = pointer->shard_hash;
+    req->shard_size = pointer->size;
+    req->error_status = 0;
+    req->state = state;
+
+    if (state->decrypt_key && state->decrypt_ctr) {
+        req->decrypt_key = state->decrypt_key;
+        memcpy(req->decrypt_ctr, state->decrypt_ctr, AES_BLOCK_SIZE);
+        increment_ctr_aes_iv(req->decrypt_ctr,
+                             state->stream_position * state->shard_size);
+    } else {
+        req->decrypt_key = NULL;
+    }
+
+    // only the part of the shard within the range is written, the
+    // decryption starts from the shard so the counter stays aligned
+    if (state->range) {
+        uint64_t shard_start = state->stream_position * state->shard_size;
+
+        if (state->range_offset > shard_start) {
+            req->offset = state->range_offset - shard_start;
+        }
+
+        if (state->range_length &&
+            state->range_offset + state->range_length < shard_start + req->length) {
+            req->length = state->range_offset + state->range_length - shard_start;
+        }
+    }
+
+    work->data = req;
+
+    state->pending_work_count++;
+    int status = uv_queue_work(state->env->loop, (uv_work_t*) work,
+                               write_stream_shard, after_write_stream_shard);
+    if (status) {
+        state->pending_work_count--;
+        free(req);
+        free(work);
+        state->error_status = STORJ_QUEUE_ERROR;
+        return;
+    }
+
+    state->stream_writing = true;
+}
+
+static void free_stream_recover(storj_download_state_t *state)
+{
+    file_request_recover_t *req = state->stream_recover;
+    if (!req) {
+        return;
+    }
+
+    // the codec is owned by the cache
+    if (req->decoder && req->decoder_owned) {
+        reed_solomon_decoder_release(req->decoder);
+    }
+
+    free(req->erased_blocks);
+    free(req->inputs_added);
+    free(req->zilch);
+    free(req);
+
+    state->stream_recover = NULL;
+    state->stream_recovering = false;
+}
+
+/*
+ * Start again once another input is lost, the decoded shards are only
+ * valid with the inputs of the decoder.
+ */
+static void abort_stream_recover(storj_download_state_t *state)
+{
+    file_request_recover_t *req = state->stream_recover;
+
+    state->log->warn(state->env->log_options, state->handle,
+                     "Lost an input for decoding shards of streamed " \
+                     "download, decoding again");
+
+    for (int i = 0; req->erased_blocks && i < req->decoder->nr_erased; i++) {
+        if (req->erased_blocks[i]) {
+            storj_pointer_t *pointer =
+                &state->pointers[req->decoder->erased_blocks[i]];
+            free(pointer->shard_data);
+            pointer->shard_data = NULL;
+        }
+    }
+
+    // the inputs that were written are downloaded again if still needed
+    for (int i = 0; i < state->stream_position; i++) {
+        storj_pointer_t *pointer = &state->pointers[i];
+        if (pointer->status == POINTER_DOWNLOADED) {
+            free(pointer->shard_data);
+            pointer->shard_data = NULL;
+            pointer->status = POINTER_CREATED;
+        }
+    }
+
+    free_stream_recover(state);
+}
+
+static void finish_stream_recover(storj_download_state_t *state)
+{
+    file_request_recover_t *req = state->stream_recover;
+
+    // the lost shards of the window are now in memory to be written
+    for (int i = 0; i < req->decoder->nr_erased; i++) {
+        if (req->erased_blocks[i]) {
+            storj_pointer_t *pointer =
+                &state->pointers[req->decoder->erased_blocks[i]];
+            pointer->status = POINTER_DOWNLOADED;
+            set_downloaded_size(state, pointer, pointer->size);
+        }
+    }
+
+    state->log->info(state->env->log_options, state->handle,
+                     "Decoded lost shards of streamed download");
+
+    free_stream_recover(state);
+}
+
+static void after_add_stream_input(file_request_recover_t *req)
+{
+    storj_download_state_t *state = req->state;
+
+    req->adding = false;
+
+    if (req->error_status) {
+        state->error_status = req->error_status;
+        queue_next_work(state);
+        return;
+    }
+
+    uint32_t index = req->decoder->input_blocks[req->input];
+    storj_pointer_t *pointer = &state->pointers[index];
 
-    error = map_file(req->fd, req->filesize, &data_map, false);
-    if (error) {
-        req->error_status = STORJ_MAPPING_ERROR;
-        goto finish;
+    req->inputs_added[req->input] = true;
+    req->total_inputs_added += 1;
+
+    // data shards in the window are kept to be written, the others are
+    // downloaded again if they are needed
+    if (!in_stream_window(state, pointer)) {
+        free(pointer->shard_data);
+        pointer->shard_data = NULL;
+
+        if (!pointer->parity && index < state->stream_position) {
+            pointer->status = POINTER_FINISHED;
+            state->completed_shards += 1;
+        } else {
+            pointer->status = POINTER_CREATED;
+        }
     }
 
-    if (!req->has_missing) {
-        goto decrypt;
+    if (req->total_inputs_added == req->data_shards) {
+        finish_stream_recover(state);
     }
 
-    fec_init();
+    queue_next_work(state);
+}
 
-    rs = reed_solomon_new(req->data_shards, req->parity_shards);
-    if (!rs) {
-        req->error_status = STORJ_MEMORY_ERROR;
-        goto finish;
-    }
+static void queue_add_stream_inputs(storj_download_state_t *state)
+{
+    file_request_recover_t *req = state->stream_recover;
 
-    data_blocks = (uint8_t**)malloc(req->data_shards * sizeof(uint8_t *));
-    if (!data_blocks) {
-        req->error_status = STORJ_MEMORY_ERROR;
-        goto finish;
+    if (!req->decoder_ready || req->adding) {
+        return;
     }
 
-    fec_blocks = (uint8_t**)malloc(req->parity_shards * sizeof(uint8_t *));
-    if (!fec_blocks) {
-        req->error_status = STORJ_MEMORY_ERROR;
-        goto finish;
+    for (int i = 0; i < req->data_shards; i++) {
+        storj_pointer_t *pointer =
+            &state->pointers[req->decoder->input_blocks[i]];
+        if (!req->inputs_added[i] && pointer->status == POINTER_MISSING) {
+            abort_stream_recover(state);
+            return;
+        }
     }
 
+    // the stripes of one input are added at a time, into the same memory
     for (int i = 0; i < req->data_shards; i++) {
-        data_blocks[i] = data_map + i * req->shard_size;
-    }
+        storj_pointer_t *pointer =
+            &state->pointers[req->decoder->input_blocks[i]];
+        if (req->inputs_added[i] || pointer->status != POINTER_DOWNLOADED ||
+            !pointer->shard_data) {
+            continue;
+        }
 
-    for (int i = 0; i < req->parity_shards; i++) {
-        fec_blocks[i] = data_map + (req->data_shards + i) * req->shard_size;
+        req->input = i;
+        req->input_block = pointer->shard_data;
+        req->adding = true;
+
+        queue_recover_shards_stripes(req);
+        return;
     }
+}
 
-    uint32_t total_shards = req->data_shards + req->parity_shards;
+static void create_stream_decoder(uv_work_t *work)
+{
+    file_request_recover_t *req = work->data;
+    codec_cache_t *codecs = req->state->env->codecs;
 
-    state->log->debug(state->env->log_options, state->handle,
-                      "Recovering shards, data_shards: %i, "            \
-                      "parity_shards: %i, shard_size: %" PRIu64 ", "    \
-                      "file_size: %" PRIu64,
-                      req->data_shards,
-                      req->parity_shards,
-                      req->shard_size,
-                      req->data_filesize);
-
-    error = reed_solomon_reconstruct(rs, data_blocks, fec_blocks,
-                                     req->zilch, total_shards,
-                                     req->shard_size, req->data_filesize);
+    req->rs = codec_cache_get(codecs, req->data_shards, req->parity_shards);
+    if (!req->rs) {
+        req->error_status = STORJ_MEMORY_ERROR;
+        return;
+    }
 
-    if (error) {
+    req->decoder = codec_cache_get_decoder(codecs, req->rs, req->zilch,
+                                           &req->decoder_owned);
+    if (!req->decoder) {
         req->error_status = STORJ_FILE_RECOVER_ERROR;
-        goto finish;
     }
+}
 
+static void after_create_stream_decoder(uv_work_t *work, int status)
+{
+    file_request_recover_t *req = work->data;
+    storj_download_state_t *state = req->state;
 
-decrypt:
+    state->pending_work_count--;
+    free(work);
 
-    aes256_set_encrypt_key(&ctx, req->decrypt_key);
+    if (status != 0) {
+        state->error_status = STORJ_QUEUE_ERROR;
+    } else if (req->error_status) {
+        state->error_status = req->error_status;
+    }
 
-    while (bytes_decrypted < req->data_filesize) {
+    if (state->error_status) {
+        queue_next_work(state);
+        return;
+    }
 
-        if (bytes_decrypted + len > req->data_filesize) {
-            len = req->data_filesize - bytes_decrypted;
-        }
+    req->erased_blocks = calloc(req->decoder->nr_erased ?
+                                req->decoder->nr_erased : 1,
+                                sizeof(uint8_t *));
+    if (!req->erased_blocks) {
+        state->error_status = STORJ_MEMORY_ERROR;
+        queue_next_work(state);
+        return;
+    }
 
-        ctr_crypt(&ctx, (nettle_cipher_func *)aes256_encrypt,
-                  AES_BLOCK_SIZE, req->decrypt_ctr,
-                  len,
-                  (uint8_t *)data_map + bytes_decrypted,
-                  (uint8_t *)data_map + bytes_decrypted);
+    // only the lost shards of the window are decoded, into memory of
+    // their own
+    uint32_t window_end = stream_window_end(state);
 
-        bytes_decrypted += len;
-    }
+    for (int i = 0; i < req->decoder->nr_erased; i++) {
+        uint32_t index = req->decoder->erased_blocks[i];
+        storj_pointer_t *pointer = &state->pointers[index];
 
-finish:
-    if (data_map) {
-        error = unmap_file(data_map, req->filesize);
-        if (error) {
-            req->error_status = STORJ_UNMAPPING_ERROR;
+        if (pointer->status != POINTER_MISSING ||
+            index < state->stream_position || index >= window_end) {
+            continue;
         }
-    }
 
-    if (data_blocks) {
-        free(data_blocks);
+        pointer->shard_data = calloc(req->shard_size, sizeof(uint8_t));
+        if (!pointer->shard_data) {
+            state->error_status = STORJ_MEMORY_ERROR;
+            queue_next_work(state);
+            return;
+        }
+        req->erased_blocks[i] = pointer->shard_data;
     }
 
-    if (fec_blocks) {
-        free(fec_blocks);
+    // the inputs that were written are downloaded again
+    for (int i = 0; i < req->data_shards; i++) {
+        storj_pointer_t *pointer =
+            &state->pointers[req->decoder->input_blocks[i]];
+        if (pointer->status == POINTER_FINISHED) {
+            pointer->status = POINTER_CREATED;
+            state->completed_shards -= 1;
+        }
     }
 
-    if (rs) {
-        reed_solomon_release(rs);
-    }
+    req->decoder_ready = true;
 
-#ifdef _WIN32
+    queue_next_work(state);
+}
 
-    HANDLE file = (HANDLE)_get_osfhandle(req->fd);
-    if (file == INVALID_HANDLE_VALUE) {
-        req->error_status = STORJ_FILE_RESIZE_ERROR;
+/*
+ * Any data shards of the shards can decode the lost shards, stripe by
+ * stripe. The inputs are added to the lost shards of the window one at a
+ * time as they are downloaded, so that only the window is in memory.
+ */
+static void queue_stream_recover(storj_download_state_t *state)
+{
+    uint32_t data_shards = state->total_pointers - state->total_parity_pointers;
+    uint32_t available = 0;
+
+    file_request_recover_t *req = calloc(1, sizeof(file_request_recover_t));
+    uv_work_t *work = malloc(sizeof(uv_work_t));
+    if (!req || !work) {
+        free(req);
+        free(work);
+        state->error_status = STORJ_MEMORY_ERROR;
         return;
     }
 
-    LARGE_INTEGER size;
-    size.HighPart = (uint32_t)((req->data_filesize & 0xFFFFFFFF00000000LL) >> 32);
-    size.LowPart = (uint32_t)(req->data_filesize & 0xFFFFFFFFLL);
+    req->stream = true;
+    req->data_shards = data_shards;
+    req->parity_shards = state->total_parity_pointers;
+    req->shard_size = state->shard_size;
+    req->data_filesize = calculate_data_filesize(state);
+    req->state = state;
+    req->zilch = calloc(state->total_pointers, sizeof(uint8_t));
+    req->inputs_added = calloc(data_shards, sizeof(bool));
+    state->stream_recover = req;
+    state->stream_recovering = true;
 
-    if (!SetFilePointerEx(file, size, 0, FILE_BEGIN)) {
-        req->error_status = STORJ_FILE_RESIZE_ERROR;
+    if (!req->zilch || !req->inputs_added) {
+        free(work);
+        state->error_status = STORJ_MEMORY_ERROR;
         return;
     }
 
-    if (!SetEndOfFile(file)) {
-        req->error_status = STORJ_FILE_RESIZE_ERROR;
-        return;
+    for (int i = 0; i < state->total_pointers; i++) {
+        if (state->pointers[i].status == POINTER_MISSING) {
+            req->zilch[i] = 1;
+        } else {
+            available += 1;
+        }
     }
 
-#else
-    if (ftruncate(req->fd, req->data_filesize)) {
-        // errno for more details
-        req->error_status = STORJ_FILE_RESIZE_ERROR;
+    // the shards that were written would be downloaded again, and the data
+    // shards after the window twice, so other shards are used if there
+    // are enough
+    for (int i = 0; i < data_shards && available > data_shards; i++) {
+        if (!req->zilch[i] &&
+            state->pointers[i].status == POINTER_FINISHED) {
+            req->zilch[i] = 1;
+            available -= 1;
+        }
     }
-#endif
 
+    uint32_t window_end = stream_window_end(state);
+    for (int i = data_shards - 1;
+         i >= (int)window_end && available > data_shards; i--) {
+        if (!req->zilch[i]) {
+            req->zilch[i] = 1;
+            available -= 1;
+        }
+    }
+
+    state->log->warn(state->env->log_options, state->handle,
+                     "Lost a shard of streamed download, decoding it");
+
+    work->data = req;
+
+    state->pending_work_count++;
+    int status = uv_queue_work(state->env->loop, (uv_work_t*) work,
+                               create_stream_decoder,
+                               after_create_stream_decoder);
+    if (status) {
+        state->pending_work_count--;
+        free(work);
+        state->error_status = STORJ_QUEUE_ERROR;
+    }
 }
 
-static void queue_recover_shards(storj_download_state_t *state)
+static void queue_stream_shards(storj_download_state_t *state)
 {
-    if (!state->recovering_shards && state->pointers_completed) {
+    skip_range_shards(state);
 
-        int total_missing = 0;
-        bool has_missing = false;
-        bool is_ready = true;
+    if (!state->pointers_completed) {
+        queue_write_stream_shard(state);
+        return;
+    }
 
-        uint8_t *zilch = (uint8_t *)calloc(1, state->total_pointers);
+    // every data shard of the file or range has been written
+    if (state->stream_position >= stream_end_position(state)) {
+        if (state->pending_work_count > 0) {
+            return;
+        }
 
         for (int i = 0; i < state->total_pointers; i++) {
             storj_pointer_t *pointer = &state->pointers[i];
-            if (pointer->status == POINTER_MISSING) {
-                total_missing += 1;
-                has_missing = true;
-                zilch[i] = 1;
-            }
-
-            if (pointer->status != POINTER_MISSING &&
-                pointer->status != POINTER_DOWNLOADED) {
-                is_ready = false;
-                state->log->debug(state->env->log_options,
-                                  state->handle,
-                                  "Pointer %i not ready with status: %i",
-                                  i, pointer->status);
-
+            free(pointer->shard_data);
+            pointer->shard_data = NULL;
+            if (pointer->status != POINTER_FINISHED) {
+                pointer->status = POINTER_FINISHED;
+                state->completed_shards += 1;
             }
         }
 
-        if (!is_ready) {
-            free(zilch);
-            return;
-        }
-
-        state->log->info(state->env->log_options,
-                         state->handle,
-                         "Queuing recovery of %i of %i shards",
-                         total_missing, state->total_shards);
-
-        file_request_recover_t *req = malloc(sizeof(file_request_recover_t));
-        if (!req) {
-            state->error_status = STORJ_MEMORY_ERROR;
-            return;
-        }
+        state->truncated = true;
+        return;
+    }
 
-        uv_work_t *work = malloc(sizeof(uv_work_t));
-        if (!work) {
-            state->error_status = STORJ_MEMORY_ERROR;
+    // A lost data shard in the window is decoded from the other shards,
+    // once the shard being written has been decrypted
+    if (state->rs && !state->stream_recovering && !state->stream_writing &&
+        has_missing_data_shard(state)) {
+        queue_stream_recover(state);
+        if (state->error_status) {
             return;
         }
+    }
 
-        req->fd = fileno(state->destination);
-        req->filesize = state->shard_size * state->total_pointers;
-        req->data_filesize = calculate_data_filesize(state);
-        req->data_shards = state->total_pointers - state->total_parity_pointers;
-        req->parity_shards = state->total_parity_pointers;
-        req->shard_size = state->shard_size;
-        req->zilch = zilch;
-        req->has_missing = has_missing;
-
-        if (state->decrypt_key && state->decrypt_ctr) {
-            req->decrypt_key = calloc(SHA256_DIGEST_SIZE, sizeof(uint8_t));
-            if (!req->decrypt_key) {
-                state->error_status = STORJ_MEMORY_ERROR;
-                return;
-            }
-            req->decrypt_ctr = calloc(AES_BLOCK_SIZE, sizeof(uint8_t));
-            if (!req->decrypt_ctr) {
-                state->error_status = STORJ_MEMORY_ERROR;
-                return;
-            }
-            memcpy(req->decrypt_key, state->decrypt_key, SHA256_DIGEST_SIZE);
-            memcpy(req->decrypt_ctr, state->decrypt_ctr, AES_BLOCK_SIZE);
-
-            increment_ctr_aes_iv(req->decrypt_ctr, 0);
-        } else {
-            req->decrypt_key = NULL;
-            req->decrypt_ctr = NULL;
-        }
+    if (state->stream_recovering) {
+        queue_add_stream_inputs(state);
+    }
 
-        req->state = state;
-        req->error_status = 0;
+    queue_write_stream_shard(state);
+}
 
-        work->data = req;
+static void wake_download_state(void *data)
+{
+    queue_next_work(data);
+}
 
-        state->pending_work_count++;
-        int status = uv_queue_work(state->env->loop, (uv_work_t*) work,
-                                   recover_shards, after_recover_shards);
+static void update_concurrency(storj_download_state_t *state)
+{
+    if (!concurrency_update(&state->concurrency, get_time_milliseconds())) {
+        return;
+    }
 
-        if (status) {
-            state->error_status = STORJ_QUEUE_ERROR;
-            return;
-        }
+    state->download_max_concurrency = state->concurrency.limit;
 
-        state->recovering_shards = true;
-    }
+    state->log->debug(state->env->log_options, state->handle,
+                      "Download concurrency: %d",
+                      state->download_max_concurrency);
 }
 
 static void queue_next_work(storj_download_state_t *state)
@@ -1796,6 +3554,11 @@ static void queue_next_work(storj_download_state_t *state)
                                  ", missing hmac from file info.");
             }
 
+            // The journal is kept to resume a failed or canceled download
+            if (state->journal_path && !state->error_status) {
+                unlink(state->journal_path);
+            }
+
             state->finished = true;
             state->finished_cb(state->error_status, state->destination, state->handle);
 
@@ -1806,6 +3569,14 @@ static void queue_next_work(storj_download_state_t *state)
         goto finish_up;
     }
 
+    update_concurrency(state);
+
+    // Find the shards of a previous attempt before requesting pointers
+    if (state->journal_path && !state->journal_loaded) {
+        queue_load_download_journal(state);
+        goto finish_up;
+    }
+
     queue_request_pointers(state);
 
     if (!state->info) {
@@ -1815,7 +3586,30 @@ static void queue_next_work(storj_download_state_t *state)
     if (state->info) {
         queue_request_shards(state);
 
-        if (state->rs) {
+        // a request that failed to start has no work to finish the download
+        if (state->error_status) {
+            queue_next_work(state);
+            return;
+        }
+
+        if (state->stream) {
+            if (state->rs ? !can_recover_shards(state) :
+                has_missing_shard(state)) {
+                state->error_status = STORJ_FILE_SHARD_MISSING_ERROR;
+                queue_next_work(state);
+                return;
+            }
+
+            queue_stream_shards(state);
+
+            // the last shard has been written
+            if (state->truncated) {
+                queue_next_work(state);
+                return;
+            }
+        } else if (state->rs) {
+            abandon_slow_shards(state);
+
             if (can_recover_shards(state)) {
                 queue_recover_shards(state);
             } else {
@@ -1852,26 +3646,24 @@ STORJ_API int storj_bridge_resolve_file_cancel(storj_download_state_t *state)
     state->canceled = true;
     state->error_status = STORJ_TRANSFER_CANCELED;
 
-    // loop over all pointers, and cancel any that are queued to be downloaded
-    // any downloads that are in-progress will monitor the state->canceled
-    // status and exit when set to true
+    // downloads that are in-progress on the event loop will monitor the
+    // canceled status of their request and abort when set to true
     for (int i = 0; i < state->total_pointers; i++) {
         storj_pointer_t *pointer = &state->pointers[i];
         if (pointer->status == POINTER_BEING_DOWNLOADED) {
-            uv_cancel((uv_req_t *)pointer->work);
+            shard_request_download_t *req = pointer->work->data;
+            req->abandoned = true;
         }
     }
 
     return 0;
 }
 
-STORJ_API storj_download_state_t *storj_bridge_resolve_file(storj_env_t *env,
-                                                            const char *bucket_id,
-                                                            const char *file_id,
-                                                            FILE *destination,
-                                                            void *handle,
-                                                            storj_progress_cb progress_cb,
-                                                            storj_finished_download_cb finished_cb)
+STORJ_API storj_download_state_t *storj_bridge_resolve_file_opts(storj_env_t *env,
+                                                                 storj_download_opts_t *opts,
+                                                                 void *handle,
+                                                                 storj_progress_cb progress_cb,
+                                                                 storj_finished_download_cb finished_cb)
 {
     storj_download_state_t *state = malloc(sizeof(storj_download_state_t));
     if (!state) {
@@ -1880,20 +3672,27 @@ STORJ_API storj_download_state_t *storj_bridge_resolve_file(storj_env_t *env,
 
     // setup download state
     state->total_bytes = 0;
+    state->downloaded_bytes = 0;
+    memset(&state->progress_meter, 0, sizeof(storj_progress_meter_t));
+    state->progress_meter.interval = opts->progress_interval;
     state->info = NULL;
     state->requesting_info = false;
     state->info_fail_count = 0;
     state->env = env;
-    state->file_id = file_id;
-    state->bucket_id = bucket_id;
-    state->destination = destination;
+    state->file_id = opts->file_id;
+    state->bucket_id = opts->bucket_id;
+    state->destination = opts->destination;
     state->progress_cb = progress_cb;
     state->finished_cb = finished_cb;
     state->finished = false;
     state->total_shards = 0;
-    state->download_max_concurrency = STORJ_DOWNLOAD_CONCURRENCY;
+    concurrency_init(&state->concurrency, opts->adaptive_concurrency,
+                     STORJ_DOWNLOAD_CONCURRENCY, opts->min_concurrency,
+                     opts->max_concurrency);
+    state->download_max_concurrency = state->concurrency.limit;
     state->completed_shards = 0;
     state->resolving_shards = 0;
+    state->caching_shards = 0;
     state->total_pointers = 0;
     state->total_parity_pointers = 0;
     state->rs = false;
@@ -1902,11 +3701,30 @@ STORJ_API storj_download_state_t *storj_bridge_resolve_file(storj_env_t *env,
     state->pointers = NULL;
     state->pointers_completed = false;
     state->pointer_fail_count = 0;
-    state->requesting_pointers = false;
+    state->pointer_pages = NULL;
+    state->pointer_window = (opts->pointer_window > 0) ?
+        opts->pointer_window : STORJ_POINTER_WINDOW;
+    state->pointer_page_generation = 0;
+    state->replacing_pointers = 0;
+    state->hedge = opts->hedge && !opts->stream && !opts->range;
+    state->hedge_timer = NULL;
+    // a range is streamed from the first shard covering it
+    state->stream = opts->stream || opts->range;
+    state->write_cb = opts->write_cb;
+    state->stream_window = opts->stream_window ?
+        opts->stream_window : STORJ_STREAM_WINDOW;
+    state->stream_position = 0;
+    state->stream_writing = false;
+    state->stream_recovering = false;
+    state->stream_recover = NULL;
+    state->range = opts->range;
+    state->range_offset = opts->range_offset;
+    state->range_length = opts->range_length;
     state->error_status = STORJ_TRANSFER_OK;
     state->writing = false;
     state->shard_size = 0;
-    state->excluded_farmer_ids = NULL;
+    // avoid the farmers already known to be slow or unreachable
+    state->excluded_farmer_ids = farmer_table_exclude_list(env->farmers);
     state->hmac = NULL;
     state->pending_work_count = 0;
     state->canceled = false;
@@ -1914,9 +3732,112 @@ STORJ_API storj_download_state_t *storj_bridge_resolve_file(storj_env_t *env,
     state->handle = handle;
     state->decrypt_key = NULL;
     state->decrypt_ctr = NULL;
+    // a stream can't be rewritten to resume it
+    state->resume = opts->resume && !opts->stream && !opts->range;
+    state->journal_loaded = false;
+    state->journal_path = NULL;
+    state->journal_entries = NULL;
+    state->total_journal_entries = 0;
+
+    state->pointer_pages = calloc(state->pointer_window,
+                                  sizeof(pointer_page_t));
+    if (!state->pointer_pages) {
+        free(state);
+        return NULL;
+    }
+
+    state->transfer_slot = transfer_slot_new(env->scheduler,
+                                             wake_download_state,
+                                             state);
+    if (!state->transfer_slot) {
+        free(state->pointer_pages);
+        free(state);
+        return NULL;
+    }
+
+    if (state->resume && env->tmp_path) {
+        state->journal_path = download_journal_path(state);
+        if (!state->journal_path) {
+            transfer_slot_free(state->transfer_slot);
+            free(state->pointer_pages);
+            free(state);
+            return NULL;
+        }
+    }
+
+    if (state->hedge) {
+        state->hedge_timer = malloc(sizeof(uv_timer_t));
+        if (!state->hedge_timer) {
+            transfer_slot_free(state->transfer_slot);
+            free(state->journal_path);
+            free(state->pointer_pages);
+            free(state);
+            return NULL;
+        }
+        uv_timer_init(env->loop, state->hedge_timer);
+        state->hedge_timer->data = state;
+        uv_timer_start(state->hedge_timer, hedge_download,
+                       STORJ_HEDGE_INTERVAL, STORJ_HEDGE_INTERVAL);
+    }
 
     // start download
     queue_next_work(state);
 
     return state;
 }
+
+STORJ_API storj_download_state_t *storj_bridge_resolve_file(storj_env_t *env,
+                                                            const char *bucket_id,
+                                                            const char *file_id,
+                                                            FILE *destination,
+                                                            void *handle,
+                                                            storj_progress_cb progress_cb,
+                                                            storj_finished_download_cb finished_cb)
+{
+    storj_download_opts_t opts = {
+        .bucket_id = bucket_id,
+        .file_id = file_id,
+        .destination = destination,
+        .resume = false,
+        .pointer_window = 0,
+        .hedge = false,
+        .stream = false,
+        .write_cb = NULL,
+        .stream_window = 0,
+        .range = false,
+        .range_offset = 0,
+        .range_length = 0
+    };
+
+    return storj_bridge_resolve_file_opts(env, &opts, handle,
+                                          progress_cb, finished_cb);
+}
+
+STORJ_API storj_download_state_t *storj_bridge_resolve_file_range(storj_env_t *env,
+                                                                  const char *bucket_id,
+                                                                  const char *file_id,
+                                                                  FILE *destination,
+                                                                  uint64_t offset,
+                                                                  uint64_t length,
+                                                                  void *handle,
+                                                                  storj_progress_cb progress_cb,
+                                                                  storj_finished_download_cb finished_cb)
+{
+    storj_download_opts_t opts = {
+        .bucket_id = bucket_id,
+        .file_id = file_id,
+        .destination = destination,
+        .resume = false,
+        .pointer_window = 0,
+        .hedge = false,
+        .stream = true,
+        .write_cb = NULL,
+        .stream_window = 0,
+        .range = true,
+        .range_offset = offset,
+        .range_length = length
+    };
+
+    return storj_bridge_resolve_file_opts(env, &opts, handle,
+                                          progress_cb, finished_cb);
+}
@@ -12,14 +12,25 @@
 #include "utils.h"
 #include "crypto.h"
 #include "rs.h"
+#include "scheduler.h"
+#include "reports.h"
+#include "farmers.h"
+#include "codecs.h"
+#include "cache.h"
+#include "metrics.h"
 
 #define STORJ_DOWNLOAD_CONCURRENCY 24
 #define STORJ_DOWNLOAD_WRITESYNC_CONCURRENCY 4
 #define STORJ_DEFAULT_MIRRORS 5
-#define STORJ_MAX_REPORT_TRIES 2
 #define STORJ_MAX_TOKEN_TRIES 6
 #define STORJ_MAX_POINTER_TRIES 6
+#define STORJ_POINTER_PAGE_SIZE 3
+#define STORJ_POINTER_WINDOW 4
+#define STORJ_HEDGE_INTERVAL 1000
+#define STORJ_HEDGE_LAG_FACTOR 2
+#define STORJ_STREAM_WINDOW 4
 #define STORJ_MAX_INFO_TRIES 6
+#define STORJ_DOWNLOAD_JOURNAL_VERSION 1
 
 /** @brief Enumerable that defines that status of a pointer
  *
@@ -53,7 +64,7 @@ typedef struct {
 } shard_request_write_t;
 
 /** @brief A structure for repairing shards from parity shards */
-typedef struct {
+typedef struct storj_file_recover {
     int fd;
     uint64_t filesize;
     uint64_t data_filesize;
@@ -67,8 +78,65 @@ typedef struct {
     /* state should not be modified in worker threads */
     storj_download_state_t *state;
     int error_status;
+
+    // Shared by the stripe workers, only modified before and after them
+    reed_solomon *rs;
+    reed_solomon_decoder *decoder;
+    bool decoder_owned;
+    uint8_t *data_map;
+    uint8_t **data_blocks;
+    uint8_t **fec_blocks;
+    uint64_t stripe_size;
+    uint32_t total_stripes;
+    uint32_t completed_stripes;
+    uint32_t total_segments;
+    uint32_t completed_segments;
+    uint64_t start;
+
+    // Set for a streamed download, of which the lost shards in the window
+    // are decoded in memory, adding the stripes of one input at a time
+    bool stream;
+    bool decoder_ready;
+    bool adding;
+    uint32_t input;
+    uint8_t *input_block;
+    /* the memory of each erased block of the decoder, or NULL */
+    uint8_t **erased_blocks;
+    bool *inputs_added;
+    uint32_t total_inputs_added;
 } file_request_recover_t;
 
+/** @brief A structure for repairing a column stripe of every shard, or
+ * decrypting a segment of the file once it has been repaired */
+typedef struct {
+    /* recover request should not be modified in worker threads */
+    file_request_recover_t *recover_req;
+    uint64_t offset;
+    uint64_t length;
+    int error_status;
+} file_request_recover_stripe_t;
+
+/** @brief A structure for writing a shard of a streamed download */
+typedef struct {
+    uint8_t *shard_data;
+    /* the bytes decrypted, of which those from offset are written */
+    uint64_t length;
+    uint64_t offset;
+    uint8_t *decrypt_key;
+    uint8_t decrypt_ctr[AES_BLOCK_SIZE];
+    FILE *destination;
+    storj_download_write_cb write_cb;
+    void *handle;
+    uint32_t pointer_index;
+    /* the cache to add the shard to before it is decrypted, or NULL */
+    shard_cache_t *cache;
+    char *shard_hash;
+    uint64_t shard_size;
+    int error_status;
+    /* state should not be modified in worker threads */
+    storj_download_state_t *state;
+} shard_request_stream_t;
+
 /** @brief A structure for sharing data with worker threads for downloading
  * shards from farmers.
  */
@@ -86,24 +154,38 @@ typedef struct {
     uint64_t shard_total_bytes;
     uv_async_t progress_handle;
     uint64_t byte_position;
+    /* memory for the shard of a streamed download, or NULL to write it to
+     * the destination */
+    uint8_t *shard_data;
     /* state should not be modified in worker threads */
     storj_download_state_t *state;
     int error_status;
+    // Set when the download is canceled, or the shard is no longer needed
+    bool abandoned;
     bool *canceled;
 } shard_request_download_t;
 
-/** @brief A structure for sharing data with worker threads for sending
- * exchange reports to the bridge.
+/** @brief A shard that has been downloaded to the destination
+ */
+typedef struct download_journal_entry {
+    uint32_t index;
+    uint64_t offset;
+    uint64_t size;
+    char hash[RIPEMD160_DIGEST_SIZE * 2 + 1];
+} download_journal_entry_t;
+
+/** @brief A structure for loading the journal of a resumed download, the
+ * shards in the journal are verified against the destination.
  */
 typedef struct {
-    uint32_t pointer_index;
-    storj_http_options_t *http_options;
-    storj_bridge_options_t *options;
-    int status_code;
-    storj_exchange_report_t *report;
+    char *journal_path;
+    int fd;
+    download_journal_entry_t *entries;
+    uint32_t total_entries;
+    int error_status;
     /* state should not be modified in worker threads */
     storj_download_state_t *state;
-} shard_send_report_t;
+} download_journal_req_t;
 
 typedef struct {
     storj_http_options_t *http_options;
@@ -123,9 +205,12 @@ typedef struct {
 typedef struct {
     storj_http_options_t *http_options;
     storj_bridge_options_t *options;
+    // The first of consecutive pointers replaced by one request
     uint32_t pointer_index;
+    uint32_t total_pointers;
     const char *bucket_id;
     const char *file_id;
+    // A copy, the list of the state grows while requests are made
     char *excluded_farmer_ids;
     /* state should not be modified in worker threads */
     storj_download_state_t *state;
@@ -148,8 +233,23 @@ typedef struct {
     /* state should not be modified in worker threads */
     storj_download_state_t *state;
     int status_code;
+    // The position of a page of pointers
+    uint32_t skip;
+    uint32_t generation;
 } json_request_download_t;
 
+/** @brief A page of pointers that has been requested
+ *
+ * Pages are requested ahead of the ones that have been received, and a
+ * response is kept until the pages before it have been added to the
+ * state. Pages requested before a short page was received are from an
+ * older generation, and are ignored.
+ */
+typedef struct storj_pointer_page {
+    bool requesting;
+    struct json_object *response;
+} pointer_page_t;
+
 /** @brief A method that determines the next work necessary to download a file
  *
  * This method is called after each individual work is complete, and will
@@ -158,6 +258,44 @@ typedef struct {
  *
  * This method should only be called with in the main loop thread.
  */
+static void update_concurrency(storj_download_state_t *state);
 static void queue_next_work(storj_download_state_t *state);
+static void wake_download_state(void *data);
+
+static void clear_pointer_pages(storj_download_state_t *state);
+
+static uint32_t lagging_data_shards(storj_download_state_t *state);
+static void abandon_slow_shards(storj_download_state_t *state);
+
+static void after_request_shard(http_transfer_t *transfer);
+
+static void queue_read_cached_shard(storj_download_state_t *state,
+                                    storj_pointer_t *pointer);
+static void queue_write_cached_shard(storj_download_state_t *state,
+                                     storj_pointer_t *pointer);
+
+static bool range_contains_shard(storj_download_state_t *state,
+                                 uint32_t index);
+static bool pointer_counted(storj_download_state_t *state,
+                            storj_pointer_t *pointer);
+static void set_downloaded_size(storj_download_state_t *state,
+                                storj_pointer_t *pointer,
+                                uint64_t downloaded_size);
+static bool stream_shard_wanted(storj_download_state_t *state,
+                                storj_pointer_t *pointer);
+static void queue_stream_shards(storj_download_state_t *state);
+
+static void queue_recover_shards_stripes(file_request_recover_t *req);
+static void queue_finish_recover_shards(file_request_recover_t *req);
+static void queue_decrypt_file_segments(file_request_recover_t *req);
+static void after_add_stream_input(file_request_recover_t *req);
+static void free_stream_recover(storj_download_state_t *state);
+
+static char *download_journal_path(storj_download_state_t *state);
+static void queue_load_download_journal(storj_download_state_t *state);
+static bool is_journal_shard(storj_download_state_t *state,
+                             storj_pointer_t *pointer);
+static void append_download_journal(storj_download_state_t *state,
+                                    storj_pointer_t *pointer);
 
 #endif /* STORJ_DOWNLOADER_H */
@@ -0,0 +1,280 @@
+#include "farmers.h"
+#include "utils.h"
+
+static uint32_t node_id_bucket(const char *node_id)
+{
+    // fnv-1a
+    uint32_t hash = 2166136261u;
+    for (const char *c = node_id; *c; c++) {
+        hash ^= (uint8_t)*c;
+        hash *= 16777619u;
+    }
+
+    return hash % STORJ_FARMER_TABLE_BUCKETS;
+}
+
+farmer_table_t *farmer_table_new()
+{
+    return calloc(1, sizeof(farmer_table_t));
+}
+
+void farmer_table_destroy(farmer_table_t *table)
+{
+    if (!table) {
+        return;
+    }
+
+    for (int i = 0; i < STORJ_FARMER_TABLE_BUCKETS; i++) {
+        farmer_stats_t *stats = table->buckets[i];
+        while (stats) {
+            farmer_stats_t *next = stats->next;
+            free(stats->node_id);
+            free(stats);
+            stats = next;
+        }
+    }
+
+    free(table->path);
+    free(table);
+}
+
+farmer_stats_t *farmer_table_get(farmer_table_t *table, const char *node_id)
+{
+    if (!node_id) {
+        return NULL;
+    }
+
+    farmer_stats_t *stats = table->buckets[node_id_bucket(node_id)];
+    while (stats) {
+        if (strcmp(stats->node_id, node_id) == 0) {
+            return stats;
+        }
+        stats = stats->next;
+    }
+
+    return NULL;
+}
+
+static farmer_stats_t *farmer_table_add(farmer_table_t *table,
+                                        const char *node_id)
+{
+    farmer_stats_t *stats = farmer_table_get(table, node_id);
+
+    if (!stats) {
+        stats = calloc(1, sizeof(farmer_stats_t));
+        if (!stats) {
+            return NULL;
+        }
+
+        stats->node_id = strdup(node_id);
+        if (!stats->node_id) {
+            free(stats);
+            return NULL;
+        }
+
+        uint32_t bucket = node_id_bucket(node_id);
+        stats->next = table->buckets[bucket];
+        table->buckets[bucket] = stats;
+        table->total_farmers += 1;
+    }
+
+    return stats;
+}
+
+int farmer_table_record(farmer_table_t *table,
+                        const char *node_id,
+                        uint64_t bytes,
+                        uint64_t duration,
+                        bool success)
+{
+    if (!node_id || !strlen(node_id)) {
+        return 0;
+    }
+
+    farmer_stats_t *stats = farmer_table_add(table, node_id);
+    if (!stats) {
+        return STORJ_MEMORY_ERROR;
+    }
+
+    stats->updated = get_time_milliseconds();
+
+    if (!success) {
+        stats->failures += 1;
+        stats->consecutive_failures += 1;
+        return 0;
+    }
+
+    stats->consecutive_failures = 0;
+    stats->successes += 1;
+
+    if (bytes < STORJ_FARMER_MIN_SAMPLE_SIZE) {
+        return 0;
+    }
+
+    double throughput = (double)bytes / (double)(duration > 0 ? duration : 1);
+
+    // recent transfers weigh more than older ones
+    if (stats->samples == 0) {
+        stats->throughput = throughput;
+    } else {
+        stats->throughput = stats->throughput * 0.75 + throughput * 0.25;
+    }
+
+    stats->samples += 1;
+
+    return 0;
+}
+
+bool farmer_stats_excluded(farmer_stats_t *stats, uint64_t now)
+{
+    if (now > stats->updated &&
+        now - stats->updated > STORJ_FARMER_EXCLUDE_TIME) {
+        return false;
+    }
+
+    if (stats->consecutive_failures >= STORJ_FARMER_MAX_FAILURES) {
+        return true;
+    }
+
+    return stats->samples > 0 &&
+        stats->throughput < STORJ_FARMER_MIN_THROUGHPUT;
+}
+
+char *farmer_table_exclude_list(farmer_table_t *table)
+{
+    uint64_t now = get_time_milliseconds();
+    size_t len = 0;
+
+    for (int i = 0; i < STORJ_FARMER_TABLE_BUCKETS; i++) {
+        for (farmer_stats_t *s = table->buckets[i]; s; s = s->next) {
+            if (farmer_stats_excluded(s, now)) {
+                len += strlen(s->node_id) + 1;
+            }
+        }
+    }
+
+    if (len == 0) {
+        return NULL;
+    }
+
+    char *list = calloc(len, sizeof(char));
+    if (!list) {
+        return NULL;
+    }
+
+    for (int i = 0; i < STORJ_FARMER_TABLE_BUCKETS; i++) {
+        for (farmer_stats_t *s = table->buckets[i]; s; s = s->next) {
+            if (farmer_stats_excluded(s, now)) {
+                if (list[0]) {
+                    strcat(list, ",");
+                }
+                strcat(list, s->node_id);
+            }
+        }
+    }
+
+    return list;
+}
+
+int farmer_table_load(farmer_table_t *table, const char *path)
+{
+    free(table->path);
+    table->path = strdup(path);
+    if (!table->path) {
+        return STORJ_MEMORY_ERROR;
+    }
+
+    if (access(path, F_OK) != 0) {
+        return 0;
+    }
+
+    json_object *farmers = json_object_from_file(path);
+    if (!farmers || !json_object_is_type(farmers, json_type_array)) {
+        json_object_put(farmers);
+        return 1;
+    }
+
+    int status = 0;
+    int length = json_object_array_length(farmers);
+
+    for (int i = 0; i < length; i++) {
+        json_object *farmer = json_object_array_get_idx(farmers, i);
+
+        struct json_object *node_id_value;
+        if (!json_object_object_get_ex(farmer, "nodeID", &node_id_value)) {
+            continue;
+        }
+
+        farmer_stats_t *stats =
+            farmer_table_add(table, json_object_get_string(node_id_value));
+        if (!stats) {
+            status = STORJ_MEMORY_ERROR;
+            break;
+        }
+
+        struct json_object *value;
+        if (json_object_object_get_ex(farmer, "throughput", &value)) {
+            stats->throughput = json_object_get_double(value);
+        }
+        if (json_object_object_get_ex(farmer, "successes", &value)) {
+            stats->successes = json_object_get_int(value);
+        }
+        // every success was measured by the tables saved before samples
+        if (json_object_object_get_ex(farmer, "samples", &value)) {
+            stats->samples = json_object_get_int(value);
+        } else {
+            stats->samples = stats->successes;
+        }
+        if (json_object_object_get_ex(farmer, "failures", &value)) {
+            stats->failures = json_object_get_int(value);
+        }
+        if (json_object_object_get_ex(farmer, "consecutiveFailures", &value)) {
+            stats->consecutive_failures = json_object_get_int(value);
+        }
+        if (json_object_object_get_ex(farmer, "updated", &value)) {
+            stats->updated = json_object_get_int64(value);
+        }
+    }
+
+    json_object_put(farmers);
+
+    return status;
+}
+
+int farmer_table_save(farmer_table_t *table)
+{
+    if (!table->path) {
+        return 0;
+    }
+
+    json_object *farmers = json_object_new_array();
+
+    for (int i = 0; i < STORJ_FARMER_TABLE_BUCKETS; i++) {
+        for (farmer_stats_t *s = table->buckets[i]; s; s = s->next) {
+            json_object *farmer = json_object_new_object();
+
+            json_object_object_add(farmer, "nodeID",
+                                   json_object_new_string(s->node_id));
+            json_object_object_add(farmer, "throughput",
+                                   json_object_new_double(s->throughput));
+            json_object_object_add(farmer, "samples",
+                                   json_object_new_int(s->samples));
+            json_object_object_add(farmer, "successes",
+                                   json_object_new_int(s->successes));
+            json_object_object_add(farmer, "failures",
+                                   json_object_new_int(s->failures));
+            json_object_object_add(farmer, "consecutiveFailures",
+                                   json_object_new_int(s->consecutive_failures));
+            json_object_object_add(farmer, "updated",
+                                   json_object_new_int64(s->updated));
+
+            json_object_array_add(farmers, farmer);
+        }
+    }
+
+    int status = json_object_to_file(table->path, farmers);
+
+    json_object_put(farmers);
+
+    return status ? 1 : 0;
+}
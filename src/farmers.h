@@ -0,0 +1,129 @@
+/**
+ * @file farmers.h
+ * @brief Storj farmer performance table.
+ *
+ * Keeps the observed throughput and outcomes of shard transfers with
+ * each farmer of an environment, so that new transfers can avoid the
+ * farmers already known to be slow or unreachable. The table may be
+ * saved to a file to be shared between runs.
+ */
+#ifndef STORJ_FARMERS_H
+#define STORJ_FARMERS_H
+
+#include "storj.h"
+
+#define STORJ_FARMER_TABLE_BUCKETS 256
+// Consecutive failed transfers before a farmer is excluded
+#define STORJ_FARMER_MAX_FAILURES 2
+// Milliseconds before an excluded farmer is tried again
+#define STORJ_FARMER_EXCLUDE_TIME 3600000
+// Bytes per millisecond below which a farmer is excluded
+#define STORJ_FARMER_MIN_THROUGHPUT (STORJ_LOW_SPEED_LIMIT / 1000.0)
+// Smallest transfer measured for the throughput, the time of smaller
+// transfers is mostly the latency of the connection
+#define STORJ_FARMER_MIN_SAMPLE_SIZE 262144
+
+/** @brief The observed performance of one farmer */
+typedef struct storj_farmer_stats {
+    char *node_id;
+    /* moving average of bytes per millisecond of successful transfers */
+    double throughput;
+    /* successful transfers measured for the throughput */
+    uint32_t samples;
+    uint32_t successes;
+    uint32_t failures;
+    /* failures since the last successful transfer */
+    uint32_t consecutive_failures;
+    uint64_t updated;
+    struct storj_farmer_stats *next;
+} farmer_stats_t;
+
+/** @brief A table of farmers by node id, only used from the loop thread */
+typedef struct storj_farmer_table {
+    farmer_stats_t *buckets[STORJ_FARMER_TABLE_BUCKETS];
+    uint32_t total_farmers;
+    /* file the table is saved to, NULL to keep it in memory only */
+    char *path;
+} farmer_table_t;
+
+/**
+ * @brief Create an empty farmer table
+ *
+ * @return A new table or NULL on failure
+ */
+farmer_table_t *farmer_table_new();
+
+/**
+ * @brief Cleanup a farmer table
+ *
+ * @param[in] table The farmer table
+ */
+void farmer_table_destroy(farmer_table_t *table);
+
+/**
+ * @brief Get the performance of a farmer
+ *
+ * @param[in] table The farmer table
+ * @param[in] node_id The node id of the farmer
+ * @return The stats of the farmer or NULL if it has not been seen
+ */
+farmer_stats_t *farmer_table_get(farmer_table_t *table, const char *node_id);
+
+/**
+ * @brief Record the outcome of a shard transfer with a farmer
+ *
+ * @param[in] table The farmer table
+ * @param[in] node_id The node id of the farmer
+ * @param[in] bytes The bytes transferred
+ * @param[in] duration The milliseconds the transfer took
+ * @param[in] success If the transfer completed
+ * @return A non-zero error value on failure and 0 on success.
+ */
+int farmer_table_record(farmer_table_t *table,
+                        const char *node_id,
+                        uint64_t bytes,
+                        uint64_t duration,
+                        bool success);
+
+/**
+ * @brief Check if new transfers should avoid a farmer
+ *
+ * A farmer is avoided when the recent transfers with it have failed, or
+ * were slower than the low speed limit, for a while after the last one.
+ * Transfers smaller than STORJ_FARMER_MIN_SAMPLE_SIZE only count as
+ * successes, and not for the throughput.
+ *
+ * @param[in] stats The stats of the farmer
+ * @param[in] now The current time in milliseconds
+ * @return true if the farmer should be excluded
+ */
+bool farmer_stats_excluded(farmer_stats_t *stats, uint64_t now);
+
+/**
+ * @brief Get the farmers that new transfers should avoid
+ *
+ * @param[in] table The farmer table
+ * @return A comma separated list of node ids, or NULL if there are none
+ */
+char *farmer_table_exclude_list(farmer_table_t *table);
+
+/**
+ * @brief Load a saved farmer table and keep saving to the same file
+ *
+ * A missing file is not an error, it will be created when saved.
+ *
+ * @param[in] table The farmer table
+ * @param[in] path The path of the file
+ * @return A non-zero error value on failure and 0 on success.
+ */
+int farmer_table_load(farmer_table_t *table, const char *path);
+
+/**
+ * @brief Save the farmer table to the file it was loaded from
+ *
+ * @param[in] table The farmer table
+ * @return A non-zero error value on failure and 0 on success.
+ */
+int farmer_table_save(farmer_table_t *table);
+
+#endif /* STORJ_FARMERS_H */
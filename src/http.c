@@ -1,5 +1,149 @@
 #include "http.h"
 
+static void http_share_lock(CURL *handle, curl_lock_data data,
+                            curl_lock_access access, void *userptr)
+{
+    storj_http_pool_t *pool = userptr;
+    uv_mutex_lock(&pool->share_locks[data]);
+}
+
+static void http_share_unlock(CURL *handle, curl_lock_data data,
+                              void *userptr)
+{
+    storj_http_pool_t *pool = userptr;
+    uv_mutex_unlock(&pool->share_locks[data]);
+}
+
+storj_http_pool_t *http_pool_new(uint32_t max_connections)
+{
+    storj_http_pool_t *pool = calloc(1, sizeof(storj_http_pool_t));
+    if (!pool) {
+        return NULL;
+    }
+
+    pool->size = max_connections ? max_connections : STORJ_HTTP_MAX_CONNECTIONS;
+    pool->handles = calloc(pool->size, sizeof(CURL *));
+    if (!pool->handles) {
+        free(pool);
+        return NULL;
+    }
+
+    if (uv_mutex_init(&pool->lock)) {
+        goto error;
+    }
+
+    int i = 0;
+    for (; i < CURL_LOCK_DATA_LAST; i++) {
+        if (uv_mutex_init(&pool->share_locks[i])) {
+            break;
+        }
+    }
+    if (i < CURL_LOCK_DATA_LAST) {
+        while (i-- > 0) {
+            uv_mutex_destroy(&pool->share_locks[i]);
+        }
+        uv_mutex_destroy(&pool->lock);
+        goto error;
+    }
+
+    pool->share = curl_share_init();
+    if (pool->share) {
+        curl_share_setopt(pool->share, CURLSHOPT_LOCKFUNC, http_share_lock);
+        curl_share_setopt(pool->share, CURLSHOPT_UNLOCKFUNC, http_share_unlock);
+        curl_share_setopt(pool->share, CURLSHOPT_USERDATA, pool);
+        curl_share_setopt(pool->share, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+        curl_share_setopt(pool->share, CURLSHOPT_SHARE,
+                          CURL_LOCK_DATA_SSL_SESSION);
+    }
+
+    return pool;
+
+error:
+    free(pool->handles);
+    free(pool);
+    return NULL;
+}
+
+void http_pool_destroy(storj_http_pool_t *pool)
+{
+    if (!pool) {
+        return;
+    }
+
+    for (uint32_t i = 0; i < pool->count; i++) {
+        curl_easy_cleanup(pool->handles[i]);
+    }
+
+    // the share can only be cleaned up once no handle references it
+    if (pool->share) {
+        curl_share_cleanup(pool->share);
+    }
+
+    for (int i = 0; i < CURL_LOCK_DATA_LAST; i++) {
+        uv_mutex_destroy(&pool->share_locks[i]);
+    }
+    uv_mutex_destroy(&pool->lock);
+
+    free(pool->handles);
+    free(pool);
+}
+
+CURL *http_pool_acquire(storj_http_options_t *http_options)
+{
+    storj_http_pool_t *pool = http_options->pool;
+    if (!pool) {
+        return curl_easy_init();
+    }
+
+    CURL *curl = NULL;
+
+    uv_mutex_lock(&pool->lock);
+    if (pool->count > 0) {
+        pool->count--;
+        curl = pool->handles[pool->count];
+        pool->handles[pool->count] = NULL;
+    }
+    uv_mutex_unlock(&pool->lock);
+
+    if (!curl) {
+        curl = curl_easy_init();
+        if (!curl) {
+            return NULL;
+        }
+    }
+
+    // options are cleared when a handle is released, including the share
+    if (pool->share) {
+        curl_easy_setopt(curl, CURLOPT_SHARE, pool->share);
+    }
+
+    return curl;
+}
+
+void http_pool_release(storj_http_options_t *http_options, CURL *curl)
+{
+    storj_http_pool_t *pool = http_options->pool;
+    if (!pool) {
+        curl_easy_cleanup(curl);
+        return;
+    }
+
+    // reset keeps live connections and caches but clears all options
+    curl_easy_reset(curl);
+
+    uv_mutex_lock(&pool->lock);
+    if (pool->count < pool->size) {
+        pool->handles[pool->count] = curl;
+        pool->count++;
+        curl = NULL;
+    }
+    uv_mutex_unlock(&pool->lock);
+
+    if (curl) {
+        curl_easy_cleanup(curl);
+    }
+}
+
 static size_t body_ignore_receive(void *buffer, size_t size, size_t nmemb,
                                   void *userp)
 {
@@ -7,50 +151,187 @@ static size_t body_ignore_receive(void *buffer, size_t size, size_t nmemb,
     return buflen;
 }
 
-static size_t body_shard_send(void *buffer, size_t size, size_t nmemb,
-                              void *userp)
+static void complete_transfer(http_transfer_t *transfer)
 {
-    shard_body_send_t *body = userp;
+    transfer->finish(transfer, transfer->result);
+    transfer->cb(transfer);
 
-    if (*body->canceled) {
-        return CURL_READFUNC_ABORT;
+    http_transfer_free(transfer);
+}
+
+/*
+ * Continue a transfer on the event loop once the block of its body on the
+ * threadpool is done, or complete it if curl is already done with it
+ */
+static void resume_transfer(http_transfer_t *transfer)
+{
+    if (transfer->done) {
+        if (!transfer->working) {
+            complete_transfer(transfer);
+        }
+        return;
     }
 
-    size_t read_bytes = 0;
-    size_t buflen = size * nmemb / AES_BLOCK_SIZE * AES_BLOCK_SIZE;
-    uint8_t clr_txt[buflen];
-    memset_zero(clr_txt, buflen);
+    if (transfer->paused) {
+        transfer->paused = false;
+        curl_easy_pause(transfer->curl, CURLPAUSE_CONT);
+    }
+}
 
-    if (buflen > 0) {
-        if (body->remain < buflen) {
-            buflen = body->remain;
-        }
+/*
+ * Read the next block of the shard into a buffer, and encrypt it in place.
+ * Every block except the last is a multiple of the cipher block size, so
+ * that the counter stays aligned between blocks.
+ */
+static int read_send_block(shard_body_send_t *body, uint8_t *buffer,
+                           size_t *buffered)
+{
+    size_t length = body->buffer_size;
+    if (body->length - body->total_read < length) {
+        length = body->length - body->total_read;
+    }
 
-        // Read shard data from file
-        read_bytes = pread(fileno(body->fd), clr_txt, buflen, body->offset + body->total_sent);
+    size_t total_read = 0;
+    while (total_read < length) {
+        ssize_t read_bytes = pread(fileno(body->fd),
+                                   buffer + total_read,
+                                   length - total_read,
+                                   body->offset + body->total_read + total_read);
         if (read_bytes == -1) {
             body->error_code = errno;
-            return CURL_READFUNC_ABORT;
+            return 1;
         }
 
-        if (body->ctx != NULL) {
-            ctr_crypt(body->ctx->ctx, (nettle_cipher_func *)aes256_encrypt,
-                      AES_BLOCK_SIZE, body->ctx->encryption_ctr, read_bytes,
-                      (uint8_t *)buffer, (uint8_t *)clr_txt);
-        } else {
-            memcpy(buffer, clr_txt, read_bytes);
+        if (read_bytes == 0) {
+            break;
+        }
+
+        total_read += read_bytes;
+    }
+
+    if (body->ctx != NULL) {
+        ctr_crypt(body->ctx->ctx, (nettle_cipher_func *)aes256_encrypt,
+                  AES_BLOCK_SIZE, body->ctx->encryption_ctr, total_read,
+                  buffer, buffer);
+    }
+
+    body->total_read += total_read;
+    *buffered = total_read;
+
+    return 0;
+}
+
+static int fill_send_buffer(shard_body_send_t *body)
+{
+    if (read_send_block(body, body->buffer, &body->buffered)) {
+        return 1;
+    }
+
+    body->buffer_position = 0;
+
+    return 0;
+}
+
+static void read_ahead_send_block(uv_work_t *work)
+{
+    http_transfer_t *transfer = work->data;
+    shard_body_send_t *body = transfer->send_body;
+
+    read_send_block(body, body->next_buffer, &body->next_buffered);
+}
+
+static void after_read_ahead_send_block(uv_work_t *work, int status)
+{
+    http_transfer_t *transfer = work->data;
+
+    transfer->working = false;
+    transfer->send_body->next_ready = true;
+
+    resume_transfer(transfer);
+}
+
+static int queue_read_ahead_send_block(http_transfer_t *transfer)
+{
+    transfer->work.data = transfer;
+    if (uv_queue_work(transfer->loop, &transfer->work,
+                      read_ahead_send_block, after_read_ahead_send_block)) {
+        return 1;
+    }
+    transfer->working = true;
+
+    return 0;
+}
+
+/*
+ * Swap in the block that was read ahead on the threadpool, and start to
+ * read the block after it
+ */
+static size_t next_send_block(http_transfer_t *transfer)
+{
+    shard_body_send_t *body = transfer->send_body;
+
+    if (!body->next_ready) {
+        if (!transfer->working && queue_read_ahead_send_block(transfer)) {
+            return CURL_READFUNC_ABORT;
         }
+        transfer->paused = true;
+        return CURL_READFUNC_PAUSE;
+    }
+
+    if (body->error_code) {
+        return CURL_READFUNC_ABORT;
+    }
 
-        if (ferror(body->fd)) {
+    uint8_t *buffer = body->buffer;
+    body->buffer = body->next_buffer;
+    body->buffered = body->next_buffered;
+    body->buffer_position = 0;
+    body->next_buffer = buffer;
+    body->next_ready = false;
+
+    if (body->total_read < body->length &&
+        queue_read_ahead_send_block(transfer)) {
+        return CURL_READFUNC_ABORT;
+    }
+
+    return 0;
+}
+
+static size_t body_shard_send(void *buffer, size_t size, size_t nmemb,
+                              void *userp)
+{
+    http_transfer_t *transfer = userp;
+    shard_body_send_t *body = transfer->send_body;
+
+    if (*body->canceled) {
+        return CURL_READFUNC_ABORT;
+    }
+
+    if (body->buffer_position == body->buffered && body->remain > 0) {
+        if (transfer->loop) {
+            size_t next = next_send_block(transfer);
+            if (next) {
+                return next;
+            }
+        } else if (fill_send_buffer(body)) {
             return CURL_READFUNC_ABORT;
         }
+    }
+
+    size_t read_bytes = size * nmemb;
+    size_t available = body->buffered - body->buffer_position;
+    if (available < read_bytes) {
+        read_bytes = available;
+    }
 
+    if (read_bytes > 0) {
+        memcpy(buffer, body->buffer + body->buffer_position, read_bytes);
+
+        body->buffer_position += read_bytes;
         body->total_sent += read_bytes;
         body->bytes_since_progress += read_bytes;
 
         body->remain -= read_bytes;
-
-        memset_zero(clr_txt, buflen);
     }
 
     // give progress updates at set interval
@@ -68,43 +349,76 @@ static size_t body_shard_send(void *buffer, size_t size, size_t nmemb,
     return read_bytes;
 }
 
-int put_shard(storj_http_options_t *http_options,
-              char *farmer_id,
-              char *proto,
-              char *host,
-              int port,
-              char *shard_hash,
-              uint64_t shard_total_bytes,
-              FILE *original_file,
-              uint64_t file_position,
-              storj_encryption_ctx_t *ctx,
-              char *token,
-              int *status_code,
-              int *read_code,
-              uv_async_t *progress_handle,
-              bool *canceled)
+static int transfer_progress(void *clientp, curl_off_t dltotal,
+                             curl_off_t dlnow, curl_off_t ultotal,
+                             curl_off_t ulnow)
 {
-    int return_code = 0;
+    http_transfer_t *transfer = clientp;
 
-    CURL *curl = curl_easy_init();
-    if (!curl) {
+    // abort stalled transfers as soon as they are canceled
+    if (transfer->canceled && *transfer->canceled) {
         return 1;
     }
 
+    // mapped bodies are not read by a callback that reports progress
+    shard_body_send_t *body = transfer->send_body;
+    if (body && body->map && body->progress_handle && ulnow > 0 &&
+        ((uint64_t)ulnow - body->total_sent > SHARD_PROGRESS_INTERVAL ||
+         (uint64_t)ulnow == body->length) &&
+        (uint64_t)ulnow > body->total_sent) {
+
+        body->total_sent = ulnow;
+
+        shard_upload_progress_t *progress = body->progress_handle->data;
+        progress->bytes = body->total_sent;
+        uv_async_send(body->progress_handle);
+    }
+
+    return 0;
+}
+
+static http_transfer_t *http_transfer_new(storj_http_options_t *http_options,
+                                          char *farmer_id,
+                                          char *proto,
+                                          char *host,
+                                          int port,
+                                          char *shard_hash,
+                                          uint64_t shard_total_bytes,
+                                          char *token,
+                                          bool *canceled)
+{
+    http_transfer_t *transfer = calloc(1, sizeof(http_transfer_t));
+    if (!transfer) {
+        return NULL;
+    }
+
+    transfer->http_options = http_options;
+    transfer->shard_hash = shard_hash;
+    transfer->shard_total_bytes = shard_total_bytes;
+    transfer->canceled = canceled;
+
+    transfer->curl = http_pool_acquire(http_options);
+    if (!transfer->curl) {
+        free(transfer);
+        return NULL;
+    }
+
+    CURL *curl = transfer->curl;
+
     char query_args[80];
     snprintf(query_args, 80, "?token=%s", token);
 
     int url_len = strlen(proto) + 3 + strlen(host) + 1 + 10 + 8
         + strlen(shard_hash) + strlen(query_args);
-    char *url = calloc(url_len + 1, sizeof(char));
-    if (!url) {
-        return 1;
+    transfer->url = calloc(url_len + 1, sizeof(char));
+    if (!transfer->url) {
+        goto error;
     }
 
-    snprintf(url, url_len, "%s://%s:%i/shards/%s%s", proto, host, port,
-             shard_hash, query_args);
+    snprintf(transfer->url, url_len, "%s://%s:%i/shards/%s%s", proto, host,
+             port, shard_hash, query_args);
 
-    curl_easy_setopt(curl, CURLOPT_URL, url);
+    curl_easy_setopt(curl, CURLOPT_URL, transfer->url);
 
     curl_easy_setopt(curl, CURLOPT_LOW_SPEED_LIMIT,
                      http_options->low_speed_limit);
@@ -124,167 +438,735 @@ int put_shard(storj_http_options_t *http_options,
         curl_easy_setopt(curl, CURLOPT_CAINFO, http_options->cainfo_path);
     }
 
+    curl_easy_setopt(curl, CURLOPT_NOPROGRESS, 0L);
+    curl_easy_setopt(curl, CURLOPT_XFERINFOFUNCTION, transfer_progress);
+    curl_easy_setopt(curl, CURLOPT_XFERINFODATA, (void *)transfer);
+    curl_easy_setopt(curl, CURLOPT_PRIVATE, (void *)transfer);
+
+    // Set the node id header
+    char header[17 + 40 + 1];
+    memset(header, 0, sizeof(header));
+    strcat(header, "x-storj-node-id: ");
+    strncat(header, farmer_id, 40);
+    transfer->header_list = curl_slist_append(transfer->header_list, header);
+    if (!transfer->header_list) {
+        goto error;
+    }
+
+    return transfer;
+
+error:
+    http_transfer_free(transfer);
+    return NULL;
+}
+
+void http_transfer_free(http_transfer_t *transfer)
+{
+    if (transfer->curl) {
+        http_pool_release(transfer->http_options, transfer->curl);
+    }
+
+    if (transfer->header_list) {
+        curl_slist_free_all(transfer->header_list);
+    }
+
+    free(transfer->url);
+
+    if (transfer->send_body) {
+        if (transfer->send_body->buffer) {
+            memset_zero(transfer->send_body->buffer,
+                        transfer->send_body->buffer_size);
+            free(transfer->send_body->buffer);
+        }
+        if (transfer->send_body->next_buffer) {
+            memset_zero(transfer->send_body->next_buffer,
+                        transfer->send_body->buffer_size);
+            free(transfer->send_body->next_buffer);
+        }
+        if (transfer->send_body->map && transfer->send_body->map_size) {
+            unmap_file(transfer->send_body->map,
+                       transfer->send_body->map_size);
+        }
+        free(transfer->send_body);
+    }
+
+    if (transfer->receive_body) {
+        free(transfer->receive_body->buffer);
+        // the next block of memory that is not owned is not a buffer
+        if (!transfer->receive_body->data) {
+            free(transfer->receive_body->next_buffer);
+        }
+        free(transfer->receive_body->sha256_ctx);
+        free(transfer->receive_body);
+    }
+
+    free(transfer);
+}
+
+static void finish_put_shard(http_transfer_t *transfer, int req)
+{
+    shard_body_send_t *shard_body = transfer->send_body;
+
+    if (*transfer->canceled) {
+        transfer->error_status = 1;
+        return;
+    }
+
+    if (req != CURLE_OK) {
+        transfer->error_status = req;
+        return;
+    }
+
+    // set the status code
+    if (shard_body) {
+        transfer->io_code = shard_body->error_code;
+    }
+
+    long int _status_code;
+    curl_easy_getinfo(transfer->curl, CURLINFO_RESPONSE_CODE, &_status_code);
+    transfer->status_code = (int)_status_code;
+
+    // curl sends all of a mapped body when the request succeeds
+    if (shard_body && shard_body->map) {
+        shard_body->total_sent = shard_body->length;
+    }
+
+    // check that total bytes have been sent
+    uint64_t total_sent = shard_body ? shard_body->total_sent : 0;
+    if (total_sent != transfer->shard_total_bytes) {
+        transfer->error_status = 1;
+    }
+}
+
+static http_transfer_t *put_transfer_new(storj_http_options_t *http_options,
+                                         char *farmer_id,
+                                         char *proto,
+                                         char *host,
+                                         int port,
+                                         char *shard_hash,
+                                         uint64_t shard_total_bytes,
+                                         char *token,
+                                         bool *canceled)
+{
+    http_transfer_t *transfer = http_transfer_new(http_options, farmer_id,
+                                                  proto, host, port,
+                                                  shard_hash,
+                                                  shard_total_bytes, token,
+                                                  canceled);
+    if (!transfer) {
+        return NULL;
+    }
+
+    CURL *curl = transfer->curl;
+
+    transfer->finish = finish_put_shard;
+
     curl_easy_setopt(curl, CURLOPT_POST, 1);
 
-    struct curl_slist *header_list = NULL;
-    header_list = curl_slist_append(header_list, "Content-Type: application/octet-stream");
+    transfer->header_list = curl_slist_append(transfer->header_list,
+                                              "Content-Type: application/octet-stream");
+    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, transfer->header_list);
 
-    char *header = calloc(17 + 40 + 1, sizeof(char));
-    if (!header) {
-        return 1;
+    // Ignore any data sent back, we only need to know the status code
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, body_ignore_receive);
+
+    return transfer;
+}
+
+static shard_body_send_t *send_body_new(FILE *original_file,
+                                        uint64_t file_position,
+                                        storj_encryption_ctx_t *ctx,
+                                        uint64_t shard_total_bytes,
+                                        uv_async_t *progress_handle,
+                                        bool *canceled)
+{
+    shard_body_send_t *shard_body = malloc(sizeof(shard_body_send_t));
+    if (!shard_body) {
+        return NULL;
     }
-    strcat(header, "x-storj-node-id: ");
-    strncat(header, farmer_id, 40);
-    header_list = curl_slist_append(header_list, header);
-    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, header_list);
 
-    shard_body_send_t *shard_body = NULL;
+    shard_body->fd = original_file;
+    shard_body->offset = file_position;
+    shard_body->ctx = ctx;
+    shard_body->buffer = NULL;
+    shard_body->buffer_size = 0;
+    shard_body->buffered = 0;
+    shard_body->buffer_position = 0;
+    shard_body->next_buffer = NULL;
+    shard_body->next_buffered = 0;
+    shard_body->next_ready = false;
+    shard_body->length = shard_total_bytes;
+    shard_body->remain = shard_total_bytes;
+    shard_body->total_read = 0;
+    shard_body->total_sent = 0;
+    shard_body->bytes_since_progress = 0;
+    shard_body->progress_handle = progress_handle;
+    shard_body->canceled = canceled;
+    shard_body->error_code = 0;
+    shard_body->map = NULL;
+    shard_body->map_size = 0;
+
+    return shard_body;
+}
 
+http_transfer_t *put_shard_transfer_new(storj_http_options_t *http_options,
+                                        char *farmer_id,
+                                        char *proto,
+                                        char *host,
+                                        int port,
+                                        char *shard_hash,
+                                        uint64_t shard_total_bytes,
+                                        FILE *original_file,
+                                        uint64_t file_position,
+                                        storj_encryption_ctx_t *ctx,
+                                        char *token,
+                                        uv_async_t *progress_handle,
+                                        bool *canceled)
+{
+    http_transfer_t *transfer = put_transfer_new(http_options, farmer_id,
+                                                 proto, host, port,
+                                                 shard_hash,
+                                                 shard_total_bytes, token,
+                                                 canceled);
+    if (!transfer) {
+        return NULL;
+    }
+
+    CURL *curl = transfer->curl;
 
     if (original_file && shard_total_bytes) {
 
-        shard_body = malloc(sizeof(shard_body_send_t));
+        shard_body_send_t *shard_body = send_body_new(original_file,
+                                                      file_position, ctx,
+                                                      shard_total_bytes,
+                                                      progress_handle,
+                                                      canceled);
         if (!shard_body) {
+            http_transfer_free(transfer);
+            return NULL;
+        }
+
+        transfer->send_body = shard_body;
+
+        // Encrypted and parity files can be sent from a mapping of the file
+        uint64_t map_start = 0;
+        if (!ctx) {
+            // only the pages of the shard are mapped
+            map_start = file_position % get_map_granularity();
+            uint64_t map_size = map_start + shard_total_bytes;
+            uint64_t file_size = 0;
+#ifdef _WIN32
+            struct _stati64 st;
+            if (_fstati64(fileno(original_file), &st) == 0) {
+                file_size = st.st_size;
+            }
+#else
+            struct stat st;
+            if (fstat(fileno(original_file), &st) == 0) {
+                file_size = st.st_size;
+            }
+#endif
+            // a mapping past the end of the file can not be read
+            if (file_size >= file_position + shard_total_bytes &&
+                map_size <= SIZE_MAX &&
+                map_file_range(fileno(original_file),
+                               file_position - map_start, map_size,
+                               &shard_body->map, true) == 0) {
+                shard_body->map_size = map_size;
+            } else {
+                shard_body->map = NULL;
+            }
+        }
+
+        if (shard_body->map) {
+            curl_easy_setopt(curl, CURLOPT_POSTFIELDS,
+                             shard_body->map + map_start);
+            curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE_LARGE,
+                             (curl_off_t)shard_total_bytes);
+        } else {
+            shard_body->buffer_size = (http_options->send_buffer_size > 0) ?
+                http_options->send_buffer_size : STORJ_HTTP_SEND_BUFFER_SIZE;
+            if (shard_total_bytes < shard_body->buffer_size) {
+                shard_body->buffer_size = shard_total_bytes;
+            }
+            shard_body->buffer = malloc(shard_body->buffer_size);
+            if (!shard_body->buffer) {
+                http_transfer_free(transfer);
+                return NULL;
+            }
+
+#ifdef POSIX_FADV_SEQUENTIAL
+            // the shard is read once from start to end
+            posix_fadvise(fileno(original_file), file_position,
+                          shard_total_bytes, POSIX_FADV_SEQUENTIAL);
+#endif
+
+            curl_easy_setopt(curl, CURLOPT_READFUNCTION, body_shard_send);
+            curl_easy_setopt(curl, CURLOPT_READDATA, (void *)transfer);
+            curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE_LARGE, (uint64_t)shard_total_bytes);
+        }
+    }
+
+    return transfer;
+}
+
+http_transfer_t *put_shard_data_transfer_new(storj_http_options_t *http_options,
+                                             char *farmer_id,
+                                             char *proto,
+                                             char *host,
+                                             int port,
+                                             char *shard_hash,
+                                             uint64_t shard_total_bytes,
+                                             uint8_t *shard_data,
+                                             char *token,
+                                             uv_async_t *progress_handle,
+                                             bool *canceled)
+{
+    http_transfer_t *transfer = put_transfer_new(http_options, farmer_id,
+                                                 proto, host, port,
+                                                 shard_hash,
+                                                 shard_total_bytes, token,
+                                                 canceled);
+    if (!transfer) {
+        return NULL;
+    }
+
+    shard_body_send_t *shard_body = send_body_new(NULL, 0, NULL,
+                                                  shard_total_bytes,
+                                                  progress_handle,
+                                                  canceled);
+    if (!shard_body) {
+        http_transfer_free(transfer);
+        return NULL;
+    }
+
+    // the data is sent as it is, like a mapping that is not owned
+    shard_body->map = shard_data;
+    transfer->send_body = shard_body;
+
+    curl_easy_setopt(transfer->curl, CURLOPT_POSTFIELDS, shard_data);
+    curl_easy_setopt(transfer->curl, CURLOPT_POSTFIELDSIZE_LARGE,
+                     (curl_off_t)shard_total_bytes);
+
+    return transfer;
+}
+
+int put_shard(storj_http_options_t *http_options,
+              char *farmer_id,
+              char *proto,
+              char *host,
+              int port,
+              char *shard_hash,
+              uint64_t shard_total_bytes,
+              FILE *original_file,
+              uint64_t file_position,
+              storj_encryption_ctx_t *ctx,
+              char *token,
+              int *status_code,
+              int *read_code,
+              uv_async_t *progress_handle,
+              bool *canceled)
+{
+    http_transfer_t *transfer = put_shard_transfer_new(http_options,
+                                                       farmer_id,
+                                                       proto,
+                                                       host,
+                                                       port,
+                                                       shard_hash,
+                                                       shard_total_bytes,
+                                                       original_file,
+                                                       file_position,
+                                                       ctx,
+                                                       token,
+                                                       progress_handle,
+                                                       canceled);
+    if (!transfer) {
+        return 1;
+    }
+
+    transfer->finish(transfer, curl_easy_perform(transfer->curl));
+
+    *status_code = transfer->status_code;
+    *read_code = transfer->io_code;
+
+    int return_code = transfer->error_status;
+
+    http_transfer_free(transfer);
+
+    return return_code;
+}
+
+static int write_shard_data(shard_body_receive_t *body, uint8_t *data,
+                            size_t length)
+{
+    while (length > 0) {
+        ssize_t written = pwrite(fileno(body->destination), data, length,
+                                 body->file_position);
+        if (written <= 0) {
+            body->error_code = (written == -1) ? errno : EIO;
             return 1;
         }
 
-        shard_body->fd = original_file;
-        shard_body->offset = file_position;
-        shard_body->ctx = ctx;
-        shard_body->length = shard_total_bytes;
-        shard_body->remain = shard_total_bytes;
-        shard_body->total_sent = 0;
-        shard_body->bytes_since_progress = 0;
-        shard_body->progress_handle = progress_handle;
-        shard_body->canceled = canceled;
-        shard_body->error_code = 0;
+        data += written;
+        length -= written;
+        body->file_position += written;
+    }
+
+    return 0;
+}
+
+/* if the received bytes that are not hashed yet fill a block */
+static bool received_block_ready(shard_body_receive_t *body)
+{
+    uint64_t pending = body->data ? body->length - body->hashed :
+        body->buffered;
+    uint64_t block = body->data ? SHARD_WRITE_BUFFER_SIZE :
+        body->buffer_size;
+
+    return pending > 0 &&
+        (pending >= block || body->length == body->shard_total_bytes);
+}
+
+static void hash_received_block(uv_work_t *work)
+{
+    http_transfer_t *transfer = work->data;
+    shard_body_receive_t *body = transfer->receive_body;
+
+    sha256_update(body->sha256_ctx, body->next_buffered, body->next_buffer);
+
+    if (!body->data) {
+        write_shard_data(body, body->next_buffer, body->next_buffered);
+    }
+
+    body->hashed += body->next_buffered;
+}
+
+static int queue_received_block(http_transfer_t *transfer);
+
+static void after_hash_received_block(uv_work_t *work, int status)
+{
+    http_transfer_t *transfer = work->data;
+    shard_body_receive_t *body = transfer->receive_body;
+
+    transfer->working = false;
+
+    // the bytes received in the meantime, also once curl is done
+    if (!body->error_code && received_block_ready(body) &&
+        queue_received_block(transfer)) {
+        body->error_code = ENOMEM;
+    }
+
+    resume_transfer(transfer);
+}
+
+/*
+ * Hash and write the received bytes that are not hashed yet on the
+ * threadpool, the buffer is swapped so that curl can receive into it
+ */
+static int queue_received_block(http_transfer_t *transfer)
+{
+    shard_body_receive_t *body = transfer->receive_body;
+
+    if (body->data) {
+        body->next_buffer = body->data + body->hashed;
+        body->next_buffered = body->length - body->hashed;
+    } else {
+        uint8_t *buffer = body->next_buffer;
+        body->next_buffer = body->buffer;
+        body->next_buffered = body->buffered;
+        body->buffer = buffer;
+        body->buffered = 0;
+    }
 
-        curl_easy_setopt(curl, CURLOPT_READFUNCTION, body_shard_send);
-        curl_easy_setopt(curl, CURLOPT_READDATA, (void *)shard_body);
-        curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE_LARGE, (uint64_t)shard_total_bytes);
+    transfer->work.data = transfer;
+    if (uv_queue_work(transfer->loop, &transfer->work,
+                      hash_received_block, after_hash_received_block)) {
+        return 1;
     }
+    transfer->working = true;
 
-    // Ignore any data sent back, we only need to know the status code
-    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, body_ignore_receive);
+    return 0;
+}
 
-    int req = curl_easy_perform(curl);
+static size_t receive_shard_block(http_transfer_t *transfer, void *buffer,
+                                  size_t buflen)
+{
+    shard_body_receive_t *body = transfer->receive_body;
 
-    curl_slist_free_all(header_list);
-    free(header);
+    if (body->error_code) {
+        return CURL_READFUNC_ABORT;
+    }
 
-    if (*canceled) {
-        return_code = 1;
-        goto clean_up;
+    // a full buffer waits for the other buffer on the threadpool
+    if (!body->data && body->buffered + buflen > body->buffer_size) {
+        if (transfer->working) {
+            transfer->paused = true;
+            return CURL_WRITEFUNC_PAUSE;
+        }
+        if (queue_received_block(transfer)) {
+            return CURL_READFUNC_ABORT;
+        }
     }
 
-    if (req != CURLE_OK) {
-        return_code = req;
-        goto clean_up;
+    if (body->data) {
+        memcpy(body->data + body->length, buffer, buflen);
+    } else {
+        memcpy(body->buffer + body->buffered, buffer, buflen);
+        body->buffered += buflen;
     }
 
-    // set the status code
-    if (shard_body && shard_total_bytes) {
-        *read_code = shard_body->error_code;
+    body->length += buflen;
+    body->bytes_since_progress += buflen;
+
+    if (!transfer->working && received_block_ready(body) &&
+        queue_received_block(transfer)) {
+        return CURL_READFUNC_ABORT;
     }
 
-    long int _status_code;
-    curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &_status_code);
-    *status_code = (int)_status_code;
+    return buflen;
+}
 
-    // check that total bytes have been sent
-    if (shard_body->total_sent != shard_total_bytes) {
-        return_code = 1;
-        goto clean_up;
+/*
+ * Hash a chunk directly from the received data, and collect small chunks
+ * to write them in one batch
+ */
+static size_t receive_shard_chunk(shard_body_receive_t *body, void *buffer,
+                                  size_t buflen)
+{
+    sha256_update(body->sha256_ctx, buflen, (uint8_t *)buffer);
+
+    if (body->data) {
+        memcpy(body->data + body->length, buffer, buflen);
     }
 
-clean_up:
+    body->length += buflen;
+    body->bytes_since_progress += buflen;
+
+    bool complete = (body->length == body->shard_total_bytes);
 
-    // clean up memory
-    if (shard_body) {
-        free(shard_body);
+    if (body->data) {
+        // Received into memory, there is nothing to write
+    } else if (body->buffered + buflen <= body->buffer_size) {
+        // Collect small chunks to write them in one batch
+        memcpy(body->buffer + body->buffered, buffer, buflen);
+        body->buffered += buflen;
+
+        if (body->buffered == body->buffer_size || complete) {
+            if (write_shard_data(body, body->buffer, body->buffered)) {
+                return CURL_READFUNC_ABORT;
+            }
+            body->buffered = 0;
+        }
+    } else {
+        // Write the collected data and then the chunk without copying it
+        if (write_shard_data(body, body->buffer, body->buffered)) {
+            return CURL_READFUNC_ABORT;
+        }
+        body->buffered = 0;
+
+        if (write_shard_data(body, buffer, buflen)) {
+            return CURL_READFUNC_ABORT;
+        }
     }
-    free(url);
-    curl_easy_cleanup(curl);
 
-    return return_code;
+    return buflen;
 }
 
 static size_t body_shard_receive(void *buffer, size_t size, size_t nmemb,
                                   void *userp)
 {
     size_t buflen = size * nmemb;
-    shard_body_receive_t *body = (shard_body_receive_t *)userp;
+    http_transfer_t *transfer = userp;
+    shard_body_receive_t *body = transfer->receive_body;
 
     if (*body->canceled) {
         return CURL_READFUNC_ABORT;
     }
 
-    if (body->length + body->tail_position + buflen > body->shard_total_bytes) {
+    if (body->length + buflen > body->shard_total_bytes) {
         return CURL_READFUNC_ABORT;
     }
 
-    // Resize the buffer if necessary
-    if (body->tail_position + buflen > body->tail_length) {
-        body->tail_length = (body->tail_position + buflen) * 2;
-        body->tail = realloc(body->tail, body->tail_length);
+    size_t received = transfer->loop ?
+        receive_shard_block(transfer, buffer, buflen) :
+        receive_shard_chunk(body, buffer, buflen);
+    if (received != buflen) {
+        return received;
+    }
 
-        if (!body->tail) {
-            return CURL_READFUNC_ABORT;
-        }
+    // Give progress updates at set interval
+    if (body->progress_handle &&
+        body->bytes_since_progress > SHARD_PROGRESS_INTERVAL) {
+        shard_download_progress_t *progress = body->progress_handle->data;
+        progress->bytes = body->length;
+        uv_async_send(body->progress_handle);
+        body->bytes_since_progress = 0;
     }
 
-    // Copy buffer to tail
-    memcpy(body->tail + body->tail_position, buffer, buflen);
+    return buflen;
+}
 
-    size_t writelen = body->tail_position + buflen;
-    if (body->length + writelen != body->shard_total_bytes) {
-        writelen = (writelen / AES_BLOCK_SIZE) * AES_BLOCK_SIZE;
-    }
+static void finish_fetch_shard(http_transfer_t *transfer, int req)
+{
+    shard_body_receive_t *body = transfer->receive_body;
 
-    // Update the hash
-    sha256_update(body->sha256_ctx, writelen, (uint8_t *)body->tail);
+    transfer->io_code = body->error_code;
 
-    // Write directly to the file at the correct position
-    if (writelen == pwrite(fileno(body->destination),
-                           body->tail,
-                           writelen,
-                           body->file_position)) {
+    // set the status code
+    long int _status_code;
+    curl_easy_getinfo(transfer->curl, CURLINFO_RESPONSE_CODE, &_status_code);
+    transfer->status_code = (int)_status_code;
 
-        if (writelen == -1) {
-            body->error_code = errno;
-            return CURL_READFUNC_ABORT;
-        }
+    if (req != CURLE_OK) {
+        // TODO include the actual http error code
+        transfer->error_status = STORJ_FARMER_REQUEST_ERROR;
+        return;
+    }
 
-        body->file_position += writelen;
-    } else {
-        // TODO handle error
-        return CURL_READFUNC_ABORT;
+    if (body->length != transfer->shard_total_bytes) {
+        transfer->error_status = STORJ_FARMER_INTEGRITY_ERROR;
+        return;
     }
 
-    body->length += writelen;
-    body->bytes_since_progress += writelen;
+    uint8_t hash_sha256[SHA256_DIGEST_SIZE];
+    sha256_digest(body->sha256_ctx, SHA256_DIGEST_SIZE, hash_sha256);
 
-    // Move any remaining data to the beginning and mark position
-    size_t tailing_size = body->tail_position + buflen - writelen;
-    if (tailing_size > 0) {
-        uint8_t tmp[tailing_size];
-        memcpy(&tmp, body->tail + writelen, tailing_size);
-        memcpy(body->tail, &tmp, tailing_size);
-        body->tail_position = tailing_size;
-    } else {
-        body->tail_position = 0;
+    struct ripemd160_ctx rctx;
+    ripemd160_init(&rctx);
+    ripemd160_update(&rctx, SHA256_DIGEST_SIZE, hash_sha256);
+
+    uint8_t hash_rmd160[RIPEMD160_DIGEST_SIZE];
+    ripemd160_digest(&rctx, RIPEMD160_DIGEST_SIZE, hash_rmd160);
+
+    char hash[RIPEMD160_DIGEST_SIZE * 2 + 1];
+    for (unsigned i = 0; i < RIPEMD160_DIGEST_SIZE; i++) {
+        sprintf(&hash[i*2], "%02x", hash_rmd160[i]);
     }
 
-    // Give progress updates at set interval
-    if (body->progress_handle &&
-        body->bytes_since_progress > SHARD_PROGRESS_INTERVAL) {
+    if (strcmp(transfer->shard_hash, hash) != 0) {
+        transfer->error_status = STORJ_FARMER_INTEGRITY_ERROR;
+        return;
+    }
+
+    // final progress update
+    if (body->progress_handle) {
         shard_download_progress_t *progress = body->progress_handle->data;
-        progress->bytes = body->length;
+        progress->bytes = transfer->shard_total_bytes;
         uv_async_send(body->progress_handle);
-        body->bytes_since_progress = 0;
     }
+}
 
-    return buflen;
+static http_transfer_t *fetch_transfer_new(storj_http_options_t *http_options,
+                                           char *farmer_id,
+                                           char *proto,
+                                           char *host,
+                                           int port,
+                                           char *shard_hash,
+                                           uint64_t shard_total_bytes,
+                                           char *token,
+                                           FILE *destination,
+                                           uint64_t file_position,
+                                           uint8_t *shard_data,
+                                           uv_async_t *progress_handle,
+                                           bool *canceled)
+{
+    http_transfer_t *transfer = http_transfer_new(http_options, farmer_id,
+                                                  proto, host, port,
+                                                  shard_hash,
+                                                  shard_total_bytes, token,
+                                                  canceled);
+    if (!transfer) {
+        return NULL;
+    }
+
+    CURL *curl = transfer->curl;
+
+    transfer->finish = finish_fetch_shard;
+
+    curl_easy_setopt(curl, CURLOPT_HTTPGET, 1);
+    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, transfer->header_list);
+
+    // Set the body handler
+    shard_body_receive_t *body = calloc(1, sizeof(shard_body_receive_t));
+    if (!body) {
+        goto error;
+    }
+    transfer->receive_body = body;
+
+    if (shard_data) {
+        body->data = shard_data;
+        body->buffer_size = 0;
+        body->buffer = NULL;
+    } else {
+        body->data = NULL;
+        body->buffer_size = (shard_total_bytes < SHARD_WRITE_BUFFER_SIZE) ?
+            shard_total_bytes : SHARD_WRITE_BUFFER_SIZE;
+        body->buffer = malloc(body->buffer_size ? body->buffer_size : 1);
+        if (!body->buffer) {
+            goto error;
+        }
+    }
+    body->buffered = 0;
+    body->length = 0;
+    body->progress_handle = progress_handle;
+    body->shard_total_bytes = shard_total_bytes;
+    body->bytes_since_progress = 0;
+    body->canceled = canceled;
+    body->sha256_ctx = malloc(sizeof(struct sha256_ctx));
+    body->error_code = 0;
+    if (!body->sha256_ctx) {
+        goto error;
+    }
+    sha256_init(body->sha256_ctx);
+
+    body->destination = destination;
+    body->file_position = file_position;
+
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, body_shard_receive);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, (void *)transfer);
+
+    return transfer;
+
+error:
+    http_transfer_free(transfer);
+    return NULL;
+}
+
+http_transfer_t *fetch_shard_transfer_new(storj_http_options_t *http_options,
+                                          char *farmer_id,
+                                          char *proto,
+                                          char *host,
+                                          int port,
+                                          char *shard_hash,
+                                          uint64_t shard_total_bytes,
+                                          char *token,
+                                          FILE *destination,
+                                          uint64_t file_position,
+                                          uv_async_t *progress_handle,
+                                          bool *canceled)
+{
+    return fetch_transfer_new(http_options, farmer_id, proto, host, port,
+                              shard_hash, shard_total_bytes, token,
+                              destination, file_position, NULL,
+                              progress_handle, canceled);
+}
+
+http_transfer_t *fetch_shard_data_transfer_new(storj_http_options_t *http_options,
+                                               char *farmer_id,
+                                               char *proto,
+                                               char *host,
+                                               int port,
+                                               char *shard_hash,
+                                               uint64_t shard_total_bytes,
+                                               char *token,
+                                               uint8_t *shard_data,
+                                               uv_async_t *progress_handle,
+                                               bool *canceled)
+{
+    return fetch_transfer_new(http_options, farmer_id, proto, host, port,
+                              shard_hash, shard_total_bytes, token,
+                              NULL, 0, shard_data,
+                              progress_handle, canceled);
 }
 
 /* shard_data must be allocated for shard_total_bytes */
@@ -303,166 +1185,243 @@ int fetch_shard(storj_http_options_t *http_options,
                 uv_async_t *progress_handle,
                 bool *canceled)
 {
-    CURL *curl = curl_easy_init();
-    if (!curl) {
+    http_transfer_t *transfer = fetch_shard_transfer_new(http_options,
+                                                         farmer_id,
+                                                         proto,
+                                                         host,
+                                                         port,
+                                                         shard_hash,
+                                                         shard_total_bytes,
+                                                         token,
+                                                         destination,
+                                                         file_position,
+                                                         progress_handle,
+                                                         canceled);
+    if (!transfer) {
         return 1;
     }
 
-    if (http_options->user_agent) {
-        curl_easy_setopt(curl, CURLOPT_USERAGENT, http_options->user_agent);
-    }
+    transfer->finish(transfer, curl_easy_perform(transfer->curl));
 
-    if (http_options->proxy_url) {
-        curl_easy_setopt(curl, CURLOPT_PROXY, http_options->proxy_url);
-    }
+    *status_code = transfer->status_code;
+    *write_code = transfer->io_code;
 
-    if (http_options->cainfo_path) {
-        curl_easy_setopt(curl, CURLOPT_CAINFO, http_options->cainfo_path);
-    }
+    int error_code = transfer->error_status;
 
-    char query_args[80];
-    snprintf(query_args, 80, "?token=%s", token);
-    int url_len = strlen(proto) + 3 + strlen(host) + 1 + 10
-        + 8 + strlen(shard_hash) + strlen(query_args);
-    char *url = calloc(url_len + 1, sizeof(char));
-    if (!url) {
-        return 1;
+    http_transfer_free(transfer);
+
+    return error_code;
+}
+
+static void check_multi_info(http_multi_t *multi)
+{
+    CURLMsg *message;
+    int pending;
+
+    while ((message = curl_multi_info_read(multi->handle, &pending))) {
+        if (message->msg != CURLMSG_DONE) {
+            continue;
+        }
+
+        CURL *curl = message->easy_handle;
+        int req = message->data.result;
+
+        http_transfer_t *transfer = NULL;
+        curl_easy_getinfo(curl, CURLINFO_PRIVATE, (char **)&transfer);
+
+        curl_multi_remove_handle(multi->handle, curl);
+        multi->active--;
+
+        // a block on the threadpool still uses the body
+        transfer->done = true;
+        transfer->result = req;
+        resume_transfer(transfer);
     }
-    snprintf(url, url_len, "%s://%s:%i/shards/%s%s", proto, host, port,
-             shard_hash, query_args);
+}
 
-    curl_easy_setopt(curl, CURLOPT_URL, url);
-    curl_easy_setopt(curl, CURLOPT_HTTPGET, 1);
+static void close_socket(uv_handle_t *handle)
+{
+    free(handle->data);
+}
 
-    curl_easy_setopt(curl, CURLOPT_LOW_SPEED_LIMIT,
-                     http_options->low_speed_limit);
+static void on_socket_event(uv_poll_t *poll, int status, int events)
+{
+    http_socket_t *socket = poll->data;
+    http_multi_t *multi = socket->multi;
+    int running;
 
-    curl_easy_setopt(curl, CURLOPT_LOW_SPEED_TIME,
-                     http_options->low_speed_time);
+    int flags = 0;
+    if (status < 0) {
+        flags = CURL_CSELECT_ERR;
+    } else {
+        if (events & UV_READABLE) {
+            flags |= CURL_CSELECT_IN;
+        }
+        if (events & UV_WRITABLE) {
+            flags |= CURL_CSELECT_OUT;
+        }
+    }
 
-    // Set the node id header
-    struct curl_slist *node_chunk = NULL;
-    char *header = calloc(17 + 40 + 1, sizeof(char));
-    if (!header) {
-        return 1;
+    curl_multi_socket_action(multi->handle, socket->sockfd, flags, &running);
+
+    check_multi_info(multi);
+}
+
+static int handle_socket(CURL *curl, curl_socket_t sockfd, int action,
+                         void *userp, void *socketp)
+{
+    http_multi_t *multi = userp;
+    http_socket_t *socket = socketp;
+
+    if (action == CURL_POLL_REMOVE) {
+        if (socket) {
+            uv_poll_stop(&socket->poll);
+            uv_close((uv_handle_t *)&socket->poll, close_socket);
+            curl_multi_assign(multi->handle, sockfd, NULL);
+        }
+        return 0;
     }
-    strcat(header, "x-storj-node-id: ");
-    strncat(header, farmer_id, 40);
-    node_chunk = curl_slist_append(node_chunk, header);
-    free(header);
-    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, node_chunk);
 
-    // Set the body handler
-    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, body_shard_receive);
-    shard_body_receive_t *body = malloc(sizeof(shard_body_receive_t));
-    if (!body) {
-        return 1;
+    if (!socket) {
+        socket = malloc(sizeof(http_socket_t));
+        if (!socket) {
+            return -1;
+        }
+        socket->sockfd = sockfd;
+        socket->multi = multi;
+        if (uv_poll_init_socket(multi->loop, &socket->poll, sockfd)) {
+            free(socket);
+            return -1;
+        }
+        socket->poll.data = socket;
+        curl_multi_assign(multi->handle, sockfd, socket);
     }
 
-    body->tail = malloc(BUFSIZ);
-    body->tail_length = BUFSIZ;
-    body->tail_position = 0;
-    body->length = 0;
-    body->progress_handle = progress_handle;
-    body->shard_total_bytes = shard_total_bytes;
-    body->bytes_since_progress = 0;
-    body->canceled = canceled;
-    body->sha256_ctx = malloc(sizeof(struct sha256_ctx));
-    body->error_code = 0;
-    if (!body->sha256_ctx) {
-        return 1;
+    int events = 0;
+    if (action != CURL_POLL_OUT) {
+        events |= UV_READABLE;
+    }
+    if (action != CURL_POLL_IN) {
+        events |= UV_WRITABLE;
     }
-    sha256_init(body->sha256_ctx);
 
-    body->destination = destination;
-    body->file_position = file_position;
-    curl_easy_setopt(curl, CURLOPT_WRITEDATA, (void *)body);
+    uv_poll_start(&socket->poll, events, on_socket_event);
 
-    int req = curl_easy_perform(curl);
+    return 0;
+}
 
-    curl_slist_free_all(node_chunk);
-    free(body->tail);
+static void on_timeout(uv_timer_t *timer)
+{
+    http_multi_t *multi = timer->data;
+    int running;
 
-    // set the status code
-    if (body) {
-        *write_code = body->error_code;
-    }
+    curl_multi_socket_action(multi->handle, CURL_SOCKET_TIMEOUT, 0, &running);
 
+    check_multi_info(multi);
+}
 
-    int error_code = 0;
-    if (req != CURLE_OK) {
-        // TODO include the actual http error code
-        error_code = STORJ_FARMER_REQUEST_ERROR;
+static int start_timeout(CURLM *handle, long timeout_ms, void *userp)
+{
+    http_multi_t *multi = userp;
+
+    if (timeout_ms < 0) {
+        uv_timer_stop(&multi->timeout);
+    } else {
+        // a zero timeout is also run on the next loop iteration
+        uv_timer_start(&multi->timeout, on_timeout, timeout_ms, 0);
     }
 
-    // set the status code
-    long int _status_code;
-    curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &_status_code);
-    *status_code = (int)_status_code;
+    return 0;
+}
 
-    curl_easy_cleanup(curl);
+http_multi_t *http_multi_new(uv_loop_t *loop)
+{
+    http_multi_t *multi = calloc(1, sizeof(http_multi_t));
+    if (!multi) {
+        return NULL;
+    }
 
-    free(url);
+    multi->loop = loop;
 
-    if (error_code) {
-        free(body->sha256_ctx);
-        free(body);
-        return error_code;
+    multi->handle = curl_multi_init();
+    if (!multi->handle) {
+        free(multi);
+        return NULL;
     }
 
-    if (body->length != shard_total_bytes) {
-        free(body->sha256_ctx);
-        free(body);
-        return STORJ_FARMER_INTEGRITY_ERROR;
+    if (uv_timer_init(loop, &multi->timeout)) {
+        curl_multi_cleanup(multi->handle);
+        free(multi);
+        return NULL;
     }
+    multi->timeout.data = multi;
 
-    uint8_t *hash_sha256 = calloc(SHA256_DIGEST_SIZE, sizeof(uint8_t));
-    if (!hash_sha256) {
-        return 1;
-    }
-    sha256_digest(body->sha256_ctx, SHA256_DIGEST_SIZE, hash_sha256);
+    curl_multi_setopt(multi->handle, CURLMOPT_SOCKETFUNCTION, handle_socket);
+    curl_multi_setopt(multi->handle, CURLMOPT_SOCKETDATA, multi);
+    curl_multi_setopt(multi->handle, CURLMOPT_TIMERFUNCTION, start_timeout);
+    curl_multi_setopt(multi->handle, CURLMOPT_TIMERDATA, multi);
 
-    struct ripemd160_ctx rctx;
-    ripemd160_init(&rctx);
-    ripemd160_update(&rctx, SHA256_DIGEST_SIZE, hash_sha256);
+    return multi;
+}
 
-    free(hash_sha256);
+static void close_multi(uv_handle_t *handle)
+{
+    free(handle->data);
+}
 
-    uint8_t *hash_rmd160 = calloc(RIPEMD160_DIGEST_SIZE + 1, sizeof(uint8_t));
-    if (!hash_rmd160) {
-        return 1;
+void http_multi_destroy(http_multi_t *multi)
+{
+    if (!multi) {
+        return;
     }
-    ripemd160_digest(&rctx, RIPEMD160_DIGEST_SIZE, hash_rmd160);
 
-    char *hash = calloc(RIPEMD160_DIGEST_SIZE * 2 + 1, sizeof(char));
-    if (!hash) {
-        return 1;
-    }
-    for (unsigned i = 0; i < RIPEMD160_DIGEST_SIZE; i++) {
-        sprintf(&hash[i*2], "%02x", hash_rmd160[i]);
-    }
+    curl_multi_cleanup(multi->handle);
 
-    free(body->sha256_ctx);
-    free(body);
-    free(hash_rmd160);
+    // the multi is freed once the loop has closed the timer
+    uv_timer_stop(&multi->timeout);
+    uv_close((uv_handle_t *)&multi->timeout, close_multi);
+}
 
-    if (strcmp(shard_hash, hash) != 0) {
-        error_code = STORJ_FARMER_INTEGRITY_ERROR;
+int http_multi_add(http_multi_t *multi,
+                   http_transfer_t *transfer,
+                   http_transfer_cb cb,
+                   void *data)
+{
+    transfer->cb = cb;
+    transfer->data = data;
+    transfer->loop = multi->loop;
+
+    // the other buffer of a body is processed on the threadpool
+    shard_body_send_t *send_body = transfer->send_body;
+    if (send_body && send_body->buffer) {
+        send_body->next_buffer = malloc(send_body->buffer_size);
+        if (!send_body->next_buffer) {
+            return 1;
+        }
     }
 
-    free(hash);
+    shard_body_receive_t *receive_body = transfer->receive_body;
+    if (receive_body && !receive_body->data) {
+        receive_body->next_buffer = malloc(receive_body->buffer_size ?
+                                           receive_body->buffer_size : 1);
+        if (!receive_body->next_buffer) {
+            return 1;
+        }
+    }
 
-    if (error_code) {
-        return error_code;
+    if (curl_multi_add_handle(multi->handle, transfer->curl) != CURLM_OK) {
+        return 1;
     }
 
-    // final progress update
-    if (progress_handle) {
-        shard_download_progress_t *progress = progress_handle->data;
-        progress->bytes = shard_total_bytes;
-        uv_async_send(progress_handle);
+    // the first block is read while curl connects
+    if (send_body && send_body->buffer &&
+        queue_read_ahead_send_block(transfer)) {
+        curl_multi_remove_handle(multi->handle, transfer->curl);
+        return 1;
     }
 
+    multi->active++;
+
     return 0;
 }
 
@@ -492,15 +1451,18 @@ static size_t body_json_receive(void *buffer, size_t size, size_t nmemb,
     size_t buflen = size * nmemb;
     http_body_receive_t *body = (http_body_receive_t *)userp;
 
-    body->data = realloc(body->data, body->length + buflen + 1);
-    if (body->data == NULL) {
-        return 0;
-    }
+    body->length += buflen;
 
-    memcpy(&(body->data[body->length]), buffer, buflen);
+    // Anything after a complete or invalid document is ignored
+    if (body->response || body->failed) {
+        return buflen;
+    }
 
-    body->length += buflen;
-    body->data[body->length] = 0;
+    body->response = json_tokener_parse_ex(body->tokener, buffer, buflen);
+    if (!body->response &&
+        json_tokener_get_error(body->tokener) != json_tokener_continue) {
+        body->failed = true;
+    }
 
     return buflen;
 }
@@ -514,7 +1476,7 @@ int fetch_json(storj_http_options_t *http_options,
                struct json_object **response,
                int *status_code)
 {
-    CURL *curl = curl_easy_init();
+    CURL *curl = http_pool_acquire(http_options);
     if (!curl) {
         return 1;
     }
@@ -572,8 +1534,14 @@ int fetch_json(storj_http_options_t *http_options,
     if (!body) {
         return 1;
     }
-    body->data = NULL;
+    body->tokener = json_tokener_new();
+    if (!body->tokener) {
+        free(body);
+        return 1;
+    }
+    body->response = NULL;
     body->length = 0;
+    body->failed = false;
     curl_easy_setopt(curl, CURLOPT_WRITEDATA, (void *)body);
 
     // Include authentication headers if info is provided
@@ -643,6 +1611,7 @@ int fetch_json(storj_http_options_t *http_options,
     }
 
     int ret = 0;
+    uint64_t start = metrics_now(http_options->metrics);
     int req = curl_easy_perform(curl);
 
     free(url);
@@ -671,15 +1640,22 @@ int fetch_json(storj_http_options_t *http_options,
     curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &_status_code);
     *status_code = (int)_status_code;
 
-    if (body->data && body->length > 0) {
-        *response = json_tokener_parse((char *)body->data);
+    if (body->length > 0 && !body->response && !body->failed) {
+        // terminate a top level value that can only end at end of input
+        body->response = json_tokener_parse_ex(body->tokener, "", 1);
     }
 
+    *response = body->response;
+    body->response = NULL;
+
 cleanup:
-    curl_easy_cleanup(curl);
-    if (body->data) {
-        free(body->data);
+    metrics_request(http_options->metrics, method, path,
+                    req == CURLE_OK ? *status_code : 0, req, start);
+    http_pool_release(http_options, curl);
+    if (body->response) {
+        json_object_put(body->response);
     }
+    json_tokener_free(body->tokener);
     if (body) {
         free(body);
     }
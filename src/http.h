@@ -18,8 +18,10 @@
 #include "storj.h"
 #include "utils.h"
 #include "crypto.h"
+#include "metrics.h"
 
 #define SHARD_PROGRESS_INTERVAL BUFSIZ * 8
+#define SHARD_WRITE_BUFFER_SIZE 524288
 
 /** @brief A structure for sharing download progress state between threads.
  *
@@ -47,12 +49,30 @@ typedef struct {
     void *state;
 } shard_upload_progress_t;
 
+/** @brief A shard body that is read ahead from the file in large blocks,
+ * and encrypted in bulk before it is given to curl.
+ *
+ * On the event loop the next block is read and encrypted on the
+ * threadpool while the current block is sent.
+ */
 typedef struct {
     FILE *fd;
     storj_encryption_ctx_t *ctx;
+    uint8_t *buffer;
+    size_t buffer_size;
+    size_t buffered;
+    size_t buffer_position;
+    uint8_t *next_buffer;
+    size_t next_buffered;
+    bool next_ready;
+    /* already encrypted files are mapped and sent by curl without copying,
+     * the map size is zero for data in memory that is not owned */
+    uint8_t *map;
+    uint64_t map_size;
     uint64_t offset;
     uint64_t length;
     uint64_t remain;
+    uint64_t total_read;
     uint64_t total_sent;
     uint64_t bytes_since_progress;
     uv_async_t *progress_handle;
@@ -60,12 +80,21 @@ typedef struct {
     bool *canceled;
 } shard_body_send_t;
 
+/** @brief A shard body that is hashed as it arrives and written to the
+ * destination in large batches, or copied to memory that is not owned.
+ *
+ * On the event loop the batches are hashed and written on the threadpool
+ * while the next batch is received into the other buffer.
+ */
 typedef struct {
-    uint8_t *tail;
-    size_t tail_position;
-    size_t tail_length;
     uint8_t *data;
-    size_t length;
+    uint8_t *buffer;
+    size_t buffered;
+    size_t buffer_size;
+    uint8_t *next_buffer;
+    size_t next_buffered;
+    uint64_t hashed;
+    uint64_t length;
     size_t bytes_since_progress;
     uint64_t shard_total_bytes;
     uv_async_t *progress_handle;
@@ -76,9 +105,13 @@ typedef struct {
     int error_code;
 } shard_body_receive_t;
 
+/** @brief A JSON response body that is parsed as bytes arrive
+ */
 typedef struct {
-    uint8_t *data;
+    struct json_tokener *tokener;
+    struct json_object *response;
     size_t length;
+    bool failed;
 } http_body_receive_t;
 
 typedef struct {
@@ -86,6 +119,235 @@ typedef struct {
     uint64_t remain;
 } http_body_send_t;
 
+/** @brief A pool of reusable curl easy handles.
+ *
+ * Idle handles are kept on a stack so that later requests can reuse their
+ * live connections, and all handles share the DNS and TLS session caches.
+ * Connections are not shared, since the handles are used from different
+ * threads. The pool may be used from any worker thread.
+ */
+typedef struct storj_http_pool {
+    CURLSH *share;
+    uv_mutex_t share_locks[CURL_LOCK_DATA_LAST];
+    uv_mutex_t lock;
+    CURL **handles;
+    uint32_t size;
+    uint32_t count;
+} storj_http_pool_t;
+
+/**
+ * @brief Create a pool of curl easy handles
+ *
+ * @param[in] max_connections The max number of idle handles to keep
+ * @return A new pool or NULL on failure
+ */
+storj_http_pool_t *http_pool_new(uint32_t max_connections);
+
+/**
+ * @brief Cleanup all idle handles and the share of a pool
+ *
+ * @param[in] pool The pool, no handles may still be in use
+ */
+void http_pool_destroy(storj_http_pool_t *pool);
+
+/**
+ * @brief Take a handle from the pool or create a new one
+ *
+ * Falls back to a plain curl easy handle when the options have no pool.
+ *
+ * @param[in] http_options The HTTP options including the pool
+ * @return A curl easy handle or NULL on failure
+ */
+CURL *http_pool_acquire(storj_http_options_t *http_options);
+
+/**
+ * @brief Return a handle to the pool for reuse
+ *
+ * The handle is reset and kept if the pool has room, otherwise cleaned up.
+ *
+ * @param[in] http_options The HTTP options including the pool
+ * @param[in] curl The handle from http_pool_acquire
+ */
+void http_pool_release(storj_http_options_t *http_options, CURL *curl);
+
+/** @brief A curl multi handle driven by the libuv event loop.
+ *
+ * Sockets are watched with uv_poll_t handles and curl timeouts with a
+ * uv_timer_t, so shard transfers are multiplexed on the loop thread
+ * without blocking threadpool workers.
+ */
+typedef struct storj_http_multi {
+    uv_loop_t *loop;
+    CURLM *handle;
+    uv_timer_t timeout;
+    int active;
+} http_multi_t;
+
+/** @brief A socket watched by a multi handle */
+typedef struct {
+    uv_poll_t poll;
+    curl_socket_t sockfd;
+    http_multi_t *multi;
+} http_socket_t;
+
+typedef struct http_transfer http_transfer_t;
+
+/** @brief A function called on the loop thread when a transfer is done
+ */
+typedef void (*http_transfer_cb)(http_transfer_t *transfer);
+
+/** @brief A shard transfer to or from a farmer.
+ *
+ * The results are set before the callback is called, and the transfer
+ * is freed after the callback returns. On the event loop a transfer that
+ * curl is done with still waits for a block of its body on the threadpool.
+ */
+struct http_transfer {
+    CURL *curl;
+    storj_http_options_t *http_options;
+    char *url;
+    struct curl_slist *header_list;
+    shard_body_send_t *send_body;
+    shard_body_receive_t *receive_body;
+    char *shard_hash;
+    uint64_t shard_total_bytes;
+    bool *canceled;
+    void (*finish)(http_transfer_t *transfer, int req);
+    int status_code;
+    int io_code;
+    int error_status;
+    http_transfer_cb cb;
+    void *data;
+    /* set for transfers on the event loop */
+    uv_loop_t *loop;
+    uv_work_t work;
+    bool working;
+    bool paused;
+    bool done;
+    int result;
+};
+
+/**
+ * @brief Create a multi handle on an event loop
+ *
+ * @param[in] loop The event loop to run transfers on
+ * @return A new multi handle or NULL on failure
+ */
+http_multi_t *http_multi_new(uv_loop_t *loop);
+
+/**
+ * @brief Cleanup a multi handle
+ *
+ * The memory is released once the loop has closed the timer handle, so
+ * the loop has to be run again after this.
+ *
+ * @param[in] multi The multi handle, with no transfers in progress
+ */
+void http_multi_destroy(http_multi_t *multi);
+
+/**
+ * @brief Start a transfer on the event loop
+ *
+ * @param[in] multi The multi handle
+ * @param[in] transfer A transfer from put_shard_transfer_new or
+ * fetch_shard_transfer_new
+ * @param[in] cb The function to call when the transfer is done
+ * @param[in] data User data for the callback
+ * @return A non-zero error value on failure and 0 on success.
+ */
+int http_multi_add(http_multi_t *multi,
+                   http_transfer_t *transfer,
+                   http_transfer_cb cb,
+                   void *data);
+
+/**
+ * @brief Free a transfer that has not been started
+ *
+ * @param[in] transfer The transfer
+ */
+void http_transfer_free(http_transfer_t *transfer);
+
+/**
+ * @brief Prepare sending a shard to a farmer
+ *
+ * The arguments are the same as for put_shard, and must remain valid
+ * until the transfer is done.
+ *
+ * @return A new transfer or NULL on failure
+ */
+http_transfer_t *put_shard_transfer_new(storj_http_options_t *http_options,
+                                        char *farmer_id,
+                                        char *proto,
+                                        char *host,
+                                        int port,
+                                        char *shard_hash,
+                                        uint64_t shard_total_bytes,
+                                        FILE *original_file,
+                                        uint64_t file_position,
+                                        storj_encryption_ctx_t *ctx,
+                                        char *token,
+                                        uv_async_t *progress_handle,
+                                        bool *canceled);
+
+/**
+ * @brief Prepare sending an encrypted shard that is in memory
+ *
+ * @param[in] shard_data The encrypted shard, which must remain valid
+ * until the transfer is done
+ * @return A new transfer or NULL on failure
+ */
+http_transfer_t *put_shard_data_transfer_new(storj_http_options_t *http_options,
+                                             char *farmer_id,
+                                             char *proto,
+                                             char *host,
+                                             int port,
+                                             char *shard_hash,
+                                             uint64_t shard_total_bytes,
+                                             uint8_t *shard_data,
+                                             char *token,
+                                             uv_async_t *progress_handle,
+                                             bool *canceled);
+
+/**
+ * @brief Prepare fetching a shard from a farmer
+ *
+ * The arguments are the same as for fetch_shard, and must remain valid
+ * until the transfer is done.
+ *
+ * @return A new transfer or NULL on failure
+ */
+http_transfer_t *fetch_shard_transfer_new(storj_http_options_t *http_options,
+                                          char *farmer_id,
+                                          char *proto,
+                                          char *host,
+                                          int port,
+                                          char *shard_hash,
+                                          uint64_t shard_total_bytes,
+                                          char *token,
+                                          FILE *destination,
+                                          uint64_t file_position,
+                                          uv_async_t *progress_handle,
+                                          bool *canceled);
+
+/**
+ * @brief Prepare fetching a shard from a farmer into memory
+ *
+ * @param[in] shard_data The memory for the shard, which must remain valid
+ * until the transfer is done
+ * @return A new transfer or NULL on failure
+ */
+http_transfer_t *fetch_shard_data_transfer_new(storj_http_options_t *http_options,
+                                               char *farmer_id,
+                                               char *proto,
+                                               char *host,
+                                               int port,
+                                               char *shard_hash,
+                                               uint64_t shard_total_bytes,
+                                               char *token,
+                                               uint8_t *shard_data,
+                                               uv_async_t *progress_handle,
+                                               bool *canceled);
+
 /**
  * @brief Send a shard to a farmer via an HTTP request
  *
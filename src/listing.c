@@ -0,0 +1,164 @@
+#include "listing.h"
+#include "crypto.h"
+
+static int set_file_meta_from_json(list_files_request_t *req, int i)
+{
+    struct json_object *file;
+    struct json_object *filename;
+    struct json_object *mimetype;
+    struct json_object *size;
+    struct json_object *id;
+    struct json_object *bucket_id;
+    struct json_object *created;
+    struct json_object *hmac;
+    struct json_object *hmac_value;
+    struct json_object *erasure;
+    struct json_object *erasure_type;
+    struct json_object *index;
+
+    file = json_object_array_get_idx(req->response, i);
+
+    json_object_object_get_ex(file, "filename", &filename);
+    json_object_object_get_ex(file, "mimetype", &mimetype);
+    json_object_object_get_ex(file, "size", &size);
+    json_object_object_get_ex(file, "id", &id);
+    json_object_object_get_ex(file, "bucket", &bucket_id);
+    json_object_object_get_ex(file, "created", &created);
+    json_object_object_get_ex(file, "hmac", &hmac);
+    json_object_object_get_ex(hmac, "value", &hmac_value);
+    json_object_object_get_ex(file, "erasure", &erasure);
+    json_object_object_get_ex(erasure, "type", &erasure_type);
+    json_object_object_get_ex(file, "index", &index);
+
+    storj_file_meta_t *file_meta = &req->files[i];
+
+    // All strings are borrowed from the response, except for the
+    // decrypted filename
+    file_meta->created = json_object_get_string(created);
+    file_meta->mimetype = json_object_get_string(mimetype);
+    file_meta->size = json_object_get_int64(size);
+    file_meta->erasure = json_object_get_string(erasure_type);
+    file_meta->index = json_object_get_string(index);
+    file_meta->hmac = json_object_get_string(hmac_value);
+    file_meta->id = json_object_get_string(id);
+    file_meta->bucket_id = json_object_get_string(bucket_id);
+    file_meta->decrypted = false;
+    file_meta->filename = NULL;
+
+    // Attempt to decrypt the filename, otherwise
+    // we will default the filename to the encrypted text.
+    // The decrypted flag will be set to indicate the status
+    // of decryption for alternative display.
+    const char *encrypted_file_name = json_object_get_string(filename);
+    if (!encrypted_file_name) {
+        return 0;
+    }
+    char *decrypted_file_name;
+    int error_status = decrypt_file_name_cached(req->encrypt_options->key_cache,
+                                                req->encrypt_options->mnemonic,
+                                                req->bucket_id,
+                                                encrypted_file_name,
+                                                &decrypted_file_name);
+    if (!error_status) {
+        file_meta->decrypted = true;
+        file_meta->filename = decrypted_file_name;
+    } else if (error_status == STORJ_META_DECRYPTION_ERROR) {
+        file_meta->decrypted = false;
+        file_meta->filename = encrypted_file_name;
+    } else {
+        return STORJ_MEMORY_ERROR;
+    }
+
+    return 0;
+}
+
+static void list_files_batch_worker(uv_work_t *work)
+{
+    list_files_batch_t *batch = work->data;
+
+    for (uint32_t i = batch->start; i < batch->end; i++) {
+        int error_code = set_file_meta_from_json(batch->req, i);
+        if (error_code) {
+            batch->error_code = error_code;
+        }
+    }
+}
+
+static void after_list_files_batch(uv_work_t *work, int status)
+{
+    list_files_batch_t *batch = work->data;
+    list_files_batches_t *batches = batch->batches;
+
+    batches->pending_batches--;
+    if (batches->pending_batches > 0) {
+        return;
+    }
+
+    // all batches have completed, the request continues
+    uv_work_t *request_work = batches->work;
+    list_files_request_t *req = request_work->data;
+    for (uint32_t i = 0; i < batches->total_batches; i++) {
+        if (batches->batch[i].error_code) {
+            req->error_code = batches->batch[i].error_code;
+        }
+    }
+
+    uv_after_work_cb done_cb = batches->done_cb;
+    free(batches->batch);
+    free(batches);
+
+    done_cb(request_work, 0);
+}
+
+int queue_list_files_batches(uv_loop_t *loop,
+                             uv_work_t *work,
+                             uv_after_work_cb done_cb)
+{
+    list_files_request_t *req = work->data;
+
+    uint32_t num_batches = (req->total_files + STORJ_LIST_FILES_BATCH_SIZE - 1) /
+        STORJ_LIST_FILES_BATCH_SIZE;
+    if (num_batches < 1) {
+        done_cb(work, 0);
+        return 0;
+    }
+
+    list_files_batches_t *batches = malloc(sizeof(list_files_batches_t));
+    if (!batches) {
+        return STORJ_MEMORY_ERROR;
+    }
+    batches->batch = calloc(num_batches, sizeof(list_files_batch_t));
+    if (!batches->batch) {
+        free(batches);
+        return STORJ_MEMORY_ERROR;
+    }
+    batches->work = work;
+    batches->done_cb = done_cb;
+    batches->total_batches = num_batches;
+    batches->pending_batches = num_batches;
+
+    for (uint32_t i = 0; i < num_batches; i++) {
+        list_files_batch_t *batch = &batches->batch[i];
+        batch->work.data = batch;
+        batch->batches = batches;
+        batch->req = req;
+        batch->start = i * STORJ_LIST_FILES_BATCH_SIZE;
+        batch->end = batch->start + STORJ_LIST_FILES_BATCH_SIZE;
+        if (batch->end > req->total_files) {
+            batch->end = req->total_files;
+        }
+        batch->error_code = 0;
+    }
+
+    // the last batch to complete calls the done callback
+    for (uint32_t i = 0; i < num_batches; i++) {
+        list_files_batch_t *batch = &batches->batch[i];
+        if (uv_queue_work(loop, &batch->work, list_files_batch_worker,
+                          after_list_files_batch)) {
+            list_files_batch_worker(&batch->work);
+            after_list_files_batch(&batch->work, 0);
+        }
+    }
+
+    return 0;
+}
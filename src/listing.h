@@ -0,0 +1,54 @@
+/**
+ * @file listing.h
+ * @brief Storj file listings.
+ *
+ * The metadata of the listed files is filled from the bridge response in
+ * batches, each queued as work on the threadpool of the loop.
+ */
+#ifndef STORJ_LISTING_H
+#define STORJ_LISTING_H
+
+#include "storj.h"
+
+// Most listed files filled by one work of the threadpool
+#define STORJ_LIST_FILES_BATCH_SIZE 512
+
+/** @brief A batch of listed files filled by one work of the threadpool
+ */
+typedef struct {
+    uv_work_t work;
+    struct list_files_batches *batches;
+    list_files_request_t *req;
+    uint32_t start;
+    uint32_t end;
+    int error_code;
+} list_files_batch_t;
+
+/** @brief The batches of a listing, freed once all have completed
+ */
+typedef struct list_files_batches {
+    uv_work_t *work;
+    uv_after_work_cb done_cb;
+    list_files_batch_t *batch;
+    uint32_t total_batches;
+    uint32_t pending_batches;
+} list_files_batches_t;
+
+/**
+ * @brief Fill the metadata of the listed files on the threadpool
+ *
+ * The files of the request are split into batches of at most
+ * STORJ_LIST_FILES_BATCH_SIZE files. A batch that can't be queued is
+ * filled on the loop thread. An error of any batch is set as the error
+ * code of the request before the done callback is called.
+ *
+ * @param[in] loop The event loop
+ * @param[in] work The work of the request, with the files allocated
+ * @param[in] done_cb Called on the loop thread once all files are filled
+ * @return A non-zero error value on failure and 0 on success.
+ */
+int queue_list_files_batches(uv_loop_t *loop,
+                             uv_work_t *work,
+                             uv_after_work_cb done_cb);
+
+#endif /* STORJ_LISTING_H */
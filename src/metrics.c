@@ -0,0 +1,143 @@
+#include "metrics.h"
+#include "utils.h"
+
+static bool metrics_enabled(const storj_metrics_t *metrics)
+{
+    return metrics &&
+        (metrics->request || metrics->shard || metrics->phase);
+}
+
+uint64_t metrics_now(const storj_metrics_t *metrics)
+{
+    if (!metrics_enabled(metrics)) {
+        return 0;
+    }
+
+    return get_time_milliseconds();
+}
+
+static uint64_t metrics_duration(uint64_t start, uint64_t end)
+{
+    return end > start ? end - start : 0;
+}
+
+static bool is_hex(char c)
+{
+    return (c >= '0' && c <= '9') ||
+        (c >= 'a' && c <= 'f') ||
+        (c >= 'A' && c <= 'F');
+}
+
+void metrics_path_template(const char *path, char *buffer, size_t size)
+{
+    if (!size) {
+        return;
+    }
+
+    size_t len = 0;
+    const char *c = path;
+
+    while (*c && *c != '?' && len + 1 < size) {
+        if (*c == '/') {
+            buffer[len++] = *c++;
+            continue;
+        }
+
+        const char *segment_end = c;
+        bool hex = true;
+        while (*segment_end && *segment_end != '/' && *segment_end != '?') {
+            hex = hex && is_hex(*segment_end);
+            segment_end++;
+        }
+
+        if (hex && segment_end - c >= STORJ_METRICS_ID_MIN_LENGTH) {
+            const char *id = ":id";
+            while (*id && len + 1 < size) {
+                buffer[len++] = *id++;
+            }
+            c = segment_end;
+            continue;
+        }
+
+        while (c < segment_end && len + 1 < size) {
+            buffer[len++] = *c++;
+        }
+    }
+
+    buffer[len] = '\0';
+}
+
+void metrics_request(const storj_metrics_t *metrics,
+                     const char *method,
+                     const char *path,
+                     int status_code,
+                     int error_status,
+                     uint64_t start)
+{
+    if (!metrics || !metrics->request) {
+        return;
+    }
+
+    char path_template[STORJ_METRICS_PATH_SIZE];
+    metrics_path_template(path, path_template, sizeof(path_template));
+
+    storj_request_event_t event = {
+        .method = method,
+        .path = path_template,
+        .status_code = status_code,
+        .error_status = error_status,
+        .start = start,
+        .duration = metrics_duration(start, get_time_milliseconds())
+    };
+
+    metrics->request(&event, metrics->handle);
+}
+
+void metrics_shard(const storj_metrics_t *metrics,
+                   bool upload,
+                   const char *farmer_id,
+                   const char *shard_hash,
+                   uint64_t bytes,
+                   uint64_t start,
+                   uint64_t end,
+                   uint32_t retries,
+                   int error_status)
+{
+    if (!metrics || !metrics->shard) {
+        return;
+    }
+
+    storj_shard_event_t event = {
+        .upload = upload,
+        .farmer_id = farmer_id,
+        .shard_hash = shard_hash,
+        .bytes = bytes,
+        .start = start,
+        .duration = metrics_duration(start, end),
+        .retries = retries,
+        .error_status = error_status
+    };
+
+    metrics->shard(&event, metrics->handle);
+}
+
+void metrics_phase(const storj_metrics_t *metrics,
+                   storj_phase_t phase,
+                   uint64_t bytes,
+                   uint64_t start,
+                   int error_status)
+{
+    if (!metrics || !metrics->phase) {
+        return;
+    }
+
+    storj_phase_event_t event = {
+        .phase = phase,
+        .bytes = bytes,
+        .start = start,
+        .duration = metrics_duration(start, get_time_milliseconds()),
+        .error_status = error_status
+    };
+
+    metrics->phase(&event, metrics->handle);
+}
@@ -0,0 +1,91 @@
+/**
+ * @file metrics.h
+ * @brief Storj timing events.
+ *
+ * Passes the timing of bridge requests, shard transfers and CPU bound
+ * phases to the metrics functions of an environment. Nothing is measured
+ * when the function of an event is not set.
+ */
+#ifndef STORJ_METRICS_H
+#define STORJ_METRICS_H
+
+#include "storj.h"
+
+// Most bytes of a path template
+#define STORJ_METRICS_PATH_SIZE 256
+// Shortest hex segment of a path replaced by ":id"
+#define STORJ_METRICS_ID_MIN_LENGTH 24
+
+/**
+ * @brief Get the start time of an event
+ *
+ * @param[in] metrics The metrics of the environment, or NULL
+ * @return The time in milliseconds, or 0 if no events are received
+ */
+uint64_t metrics_now(const storj_metrics_t *metrics);
+
+/**
+ * @brief Replace the ids of a bridge path, and remove the query
+ *
+ * @param[in] path The path of the request
+ * @param[out] buffer The path template
+ * @param[in] size The size of the buffer
+ */
+void metrics_path_template(const char *path, char *buffer, size_t size);
+
+/**
+ * @brief Pass the timing of a bridge request to the metrics
+ *
+ * @param[in] metrics The metrics of the environment, or NULL
+ * @param[in] method The method of the request
+ * @param[in] path The path of the request
+ * @param[in] status_code The http status, 0 if no response
+ * @param[in] error_status The curl error of the request
+ * @param[in] start The start time from metrics_now
+ */
+void metrics_request(const storj_metrics_t *metrics,
+                     const char *method,
+                     const char *path,
+                     int status_code,
+                     int error_status,
+                     uint64_t start);
+
+/**
+ * @brief Pass the timing of a shard transfer to the metrics
+ *
+ * @param[in] metrics The metrics of the environment, or NULL
+ * @param[in] upload If the shard was uploaded
+ * @param[in] farmer_id The node id of the farmer
+ * @param[in] shard_hash The hash of the shard
+ * @param[in] bytes The bytes transferred
+ * @param[in] start The start time of the transfer in milliseconds
+ * @param[in] end The end time of the transfer in milliseconds
+ * @param[in] retries The earlier failed transfers of the shard
+ * @param[in] error_status The error of the transfer
+ */
+void metrics_shard(const storj_metrics_t *metrics,
+                   bool upload,
+                   const char *farmer_id,
+                   const char *shard_hash,
+                   uint64_t bytes,
+                   uint64_t start,
+                   uint64_t end,
+                   uint32_t retries,
+                   int error_status);
+
+/**
+ * @brief Pass the timing of a CPU bound phase to the metrics
+ *
+ * @param[in] metrics The metrics of the environment, or NULL
+ * @param[in] phase The phase
+ * @param[in] bytes The bytes processed
+ * @param[in] start The start time from metrics_now
+ * @param[in] error_status The error of the phase
+ */
+void metrics_phase(const storj_metrics_t *metrics,
+                   storj_phase_t phase,
+                   uint64_t bytes,
+                   uint64_t start,
+                   int error_status);
+
+#endif /* STORJ_METRICS_H */
@@ -0,0 +1,248 @@
+#include "reports.h"
+
+static void report_entry_free(report_entry_t *entry)
+{
+    free(entry->data_hash);
+    free(entry->reporter_id);
+    free(entry->farmer_id);
+    free(entry->client_id);
+    free(entry->message);
+    free(entry);
+}
+
+static char *strdup_or_empty(const char *str)
+{
+    return strdup(str ? str : "");
+}
+
+report_queue_t *report_queue_new(storj_env_t *env)
+{
+    report_queue_t *queue = calloc(1, sizeof(report_queue_t));
+    if (!queue) {
+        return NULL;
+    }
+
+    queue->env = env;
+
+    return queue;
+}
+
+void report_queue_destroy(report_queue_t *queue)
+{
+    if (!queue) {
+        return;
+    }
+
+    report_entry_t *entry = queue->head;
+    while (entry) {
+        report_entry_t *next = entry->next;
+        report_entry_free(entry);
+        entry = next;
+    }
+
+    free(queue);
+}
+
+static void send_report(report_queue_t *queue, report_entry_t *entry)
+{
+    storj_env_t *env = queue->env;
+
+    struct json_object *body = json_object_new_object();
+
+    json_object_object_add(body, "dataHash",
+                           json_object_new_string(entry->data_hash));
+
+    json_object_object_add(body, "reporterId",
+                           json_object_new_string(entry->reporter_id));
+
+    json_object_object_add(body, "farmerId",
+                           json_object_new_string(entry->farmer_id));
+
+    json_object_object_add(body, "clientId",
+                           json_object_new_string(entry->client_id));
+
+    json_object_object_add(body, "exchangeStart",
+                           json_object_new_int64(entry->start));
+
+    json_object_object_add(body, "exchangeEnd",
+                           json_object_new_int64(entry->end));
+
+    json_object_object_add(body, "exchangeResultCode",
+                           json_object_new_int(entry->code));
+
+    json_object_object_add(body, "exchangeResultMessage",
+                           json_object_new_string(entry->message));
+
+    int status_code = 0;
+
+    // there should be an empty object in response
+    struct json_object *response = NULL;
+    int request_status = fetch_json(env->http_options,
+                                    env->bridge_options, "POST",
+                                    "/reports/exchanges", body,
+                                    true, &response, &status_code);
+
+    if (request_status) {
+        env->log->warn(env->log_options, NULL,
+                       "Send exchange report error: %i", request_status);
+    }
+
+    entry->status_code = status_code;
+
+    // free all memory for body and response
+    json_object_put(response);
+    json_object_put(body);
+}
+
+static void send_report_batch(uv_work_t *work)
+{
+    report_batch_req_t *req = work->data;
+
+    // the handle is returned to the pool between requests, so the same
+    // connection is used for all of the batch
+    for (report_entry_t *entry = req->batch; entry; entry = entry->next) {
+        send_report(req->queue, entry);
+    }
+}
+
+static void queue_send_report_batch(report_queue_t *queue);
+
+static void after_send_report_batch(uv_work_t *work, int status)
+{
+    report_batch_req_t *req = work->data;
+    report_queue_t *queue = req->queue;
+    storj_env_t *env = queue->env;
+
+    queue->sending = false;
+
+    report_entry_t *entry = req->batch;
+    while (entry) {
+        report_entry_t *next = entry->next;
+
+        if (status != UV_ECANCELED) {
+            entry->send_count += 1;
+        }
+
+        if (entry->status_code == 201) {
+            env->log->debug(env->log_options, NULL,
+                            "Successfully sent exchange report for shard %s",
+                            entry->data_hash);
+            queue->total_sent += 1;
+            report_entry_free(entry);
+        } else if (entry->send_count >= STORJ_MAX_REPORT_TRIES) {
+            env->log->warn(env->log_options, NULL,
+                           "Failed to send exchange report for shard %s",
+                           entry->data_hash);
+            queue->total_failed += 1;
+            report_entry_free(entry);
+        } else {
+            // retried with the next batch
+            entry->next = NULL;
+            if (queue->tail) {
+                queue->tail->next = entry;
+            } else {
+                queue->head = entry;
+            }
+            queue->tail = entry;
+            queue->total_queued += 1;
+        }
+
+        entry = next;
+    }
+
+    free(req);
+    free(work);
+
+    queue_send_report_batch(queue);
+}
+
+static void queue_send_report_batch(report_queue_t *queue)
+{
+    if (queue->sending || !queue->head) {
+        return;
+    }
+
+    uv_work_t *work = malloc(sizeof(uv_work_t));
+    if (!work) {
+        return;
+    }
+
+    report_batch_req_t *req = malloc(sizeof(report_batch_req_t));
+    if (!req) {
+        free(work);
+        return;
+    }
+
+    // take up to a batch of reports from the front of the queue
+    report_entry_t *last = queue->head;
+    uint32_t total = 1;
+    while (last->next && total < STORJ_REPORT_BATCH_SIZE) {
+        last = last->next;
+        total += 1;
+    }
+
+    req->queue = queue;
+    req->batch = queue->head;
+
+    queue->head = last->next;
+    if (!queue->head) {
+        queue->tail = NULL;
+    }
+    last->next = NULL;
+    queue->total_queued -= total;
+
+    work->data = req;
+
+    int status = uv_queue_work(queue->env->loop, work,
+                               send_report_batch, after_send_report_batch);
+    if (status) {
+        // put the batch back, it is tried again with the next report
+        last->next = queue->head;
+        queue->head = req->batch;
+        if (!queue->tail) {
+            queue->tail = last;
+        }
+        queue->total_queued += total;
+
+        free(req);
+        free(work);
+        return;
+    }
+
+    queue->sending = true;
+}
+
+int report_queue_add(report_queue_t *queue, storj_exchange_report_t *report)
+{
+    report_entry_t *entry = calloc(1, sizeof(report_entry_t));
+    if (!entry) {
+        return STORJ_MEMORY_ERROR;
+    }
+
+    entry->data_hash = strdup_or_empty(report->data_hash);
+    entry->reporter_id = strdup_or_empty(report->reporter_id);
+    entry->farmer_id = strdup_or_empty(report->farmer_id);
+    entry->client_id = strdup_or_empty(report->client_id);
+    entry->message = strdup_or_empty(report->message);
+    entry->start = report->start;
+    entry->end = report->end;
+    entry->code = report->code;
+
+    if (!entry->data_hash || !entry->reporter_id || !entry->farmer_id ||
+        !entry->client_id || !entry->message) {
+        report_entry_free(entry);
+        return STORJ_MEMORY_ERROR;
+    }
+
+    if (queue->tail) {
+        queue->tail->next = entry;
+    } else {
+        queue->head = entry;
+    }
+    queue->tail = entry;
+    queue->total_queued += 1;
+
+    queue_send_report_batch(queue);
+
+    return 0;
+}
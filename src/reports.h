@@ -0,0 +1,82 @@
+/**
+ * @file reports.h
+ * @brief Storj exchange report queue.
+ *
+ * Exchange reports of all uploads and downloads of an environment are
+ * queued and sent to the bridge in batches, apart from the transfers.
+ */
+#ifndef STORJ_REPORTS_H
+#define STORJ_REPORTS_H
+
+#include "storj.h"
+#include "http.h"
+
+#define STORJ_MAX_REPORT_TRIES 2
+#define STORJ_REPORT_BATCH_SIZE 64
+
+/** @brief A copy of an exchange report, that is owned by the queue so
+ * that the file state can be freed before the report is sent.
+ */
+typedef struct storj_report_entry {
+    char *data_hash;
+    char *reporter_id;
+    char *farmer_id;
+    char *client_id;
+    uint64_t start;
+    uint64_t end;
+    unsigned int code;
+    char *message;
+    unsigned int send_count;
+    int status_code;
+    struct storj_report_entry *next;
+} report_entry_t;
+
+/** @brief The exchange reports waiting to be sent.
+ *
+ * A single worker sends a batch of reports at a time, one after another
+ * on a kept alive connection of the curl handle pool, so that reports
+ * don't compete with the bridge requests of the transfers. The queue is
+ * only modified from the loop thread.
+ */
+typedef struct storj_report_queue {
+    storj_env_t *env;
+    report_entry_t *head;
+    report_entry_t *tail;
+    uint32_t total_queued;
+    uint64_t total_sent;
+    uint64_t total_failed;
+    bool sending;
+} report_queue_t;
+
+/** @brief A structure for sharing a batch of reports with a worker */
+typedef struct {
+    /* queue should not be modified in worker threads */
+    report_queue_t *queue;
+    report_entry_t *batch;
+} report_batch_req_t;
+
+/**
+ * @brief Create an empty report queue
+ *
+ * @param[in] env The environment to send reports with
+ * @return A new queue or NULL on failure
+ */
+report_queue_t *report_queue_new(storj_env_t *env);
+
+/**
+ * @brief Cleanup a report queue and any reports still waiting
+ *
+ * @param[in] queue The queue, with no batch being sent
+ */
+void report_queue_destroy(report_queue_t *queue);
+
+/**
+ * @brief Queue a copy of an exchange report to be sent
+ *
+ * @param[in] queue The report queue
+ * @param[in] report The report, which may be freed once queued
+ * @return A non-zero error value on failure and 0 on success.
+ */
+int report_queue_add(report_queue_t *queue, storj_exchange_report_t *report);
+
+#endif /* STORJ_REPORTS_H */
@@ -314,7 +314,11 @@ static void slow_addmul1(gf *dst1, gf *src1, gf c, uint64_t sz, uint64_t dst_max
     }
 }
 
-# define addmul1 slow_addmul1
+typedef void (*gf_kernel_t)(gf *dst, gf *src, gf c, uint64_t sz,
+                            uint64_t dst_max, uint64_t src_max);
+
+/* selected by fec_init() from gf_backends[] */
+static gf_kernel_t addmul1 = slow_addmul1;
 
 static void addmul(gf *dst, gf *src, gf c, uint64_t sz, uint64_t dst_max, uint64_t src_max)
 {
@@ -356,13 +360,272 @@ static void slow_mul1(gf *dst1, gf *src1, gf c, uint64_t sz, uint64_t dst_max, u
     }
 }
 
-# define mul1 slow_mul1
+static gf_kernel_t mul1 = slow_mul1;
 
 static inline void mul(gf *dst, gf *src, gf c, uint64_t sz, uint64_t dst_max, uint64_t src_max)
 {
     if (c != 0) mul1(dst, src, c, sz, dst_max, src_max); else memset(dst, 0, c);
 }
 
+/*
+ * Vectorized versions of addmul1() and mul1() using the split nibble
+ * technique: c * x == c * (x & 0x0f) ^ c * (x & 0xf0), so both products
+ * can be looked up from two 16 entry tables with a byte shuffle
+ * (PSHUFB on x86, TBL on aarch64), handling 16 or 32 bytes per step.
+ * Bytes past the last full vector fall back to the multiplication table.
+ * Define RS_NO_SIMD to build only the scalar kernels.
+ */
+#if !defined(RS_NO_SIMD) && defined(__GNUC__) && \
+    (defined(__x86_64__) || defined(__i386__))
+#define RS_SIMD_X86 1
+#include <immintrin.h>
+#elif !defined(RS_NO_SIMD) && defined(__aarch64__)
+#define RS_SIMD_NEON 1
+#include <arm_neon.h>
+#endif
+
+#if defined(RS_SIMD_X86) || defined(RS_SIMD_NEON)
+static inline void gf_nibble_tables(gf c, gf *lo, gf *hi)
+{
+    int i;
+    for (i = 0; i < 16; i++) {
+        lo[i] = gf_mul_table[(c << 8) + i];
+        hi[i] = gf_mul_table[(c << 8) + (i << 4)];
+    }
+}
+
+static inline uint64_t gf_kernel_len(uint64_t dst_max, uint64_t src_max)
+{
+    return dst_max < src_max ? dst_max : src_max;
+}
+#endif
+
+#ifdef RS_SIMD_X86
+__attribute__((target("ssse3")))
+static void ssse3_addmul1(gf *dst, gf *src, gf c, uint64_t sz,
+                          uint64_t dst_max, uint64_t src_max)
+{
+    gf lo[16], hi[16];
+    uint64_t len = gf_kernel_len(dst_max, src_max);
+    uint64_t i = 0;
+
+    gf_nibble_tables(c, lo, hi);
+
+    __m128i tlo = _mm_loadu_si128((__m128i *)lo);
+    __m128i thi = _mm_loadu_si128((__m128i *)hi);
+    __m128i mask = _mm_set1_epi8(0x0f);
+
+    for (; i + 16 <= len; i += 16) {
+        __m128i s = _mm_loadu_si128((__m128i *)(src + i));
+        __m128i d = _mm_loadu_si128((__m128i *)(dst + i));
+        __m128i l = _mm_shuffle_epi8(tlo, _mm_and_si128(s, mask));
+        __m128i h = _mm_shuffle_epi8(thi,
+                                     _mm_and_si128(_mm_srli_epi64(s, 4), mask));
+        d = _mm_xor_si128(d, _mm_xor_si128(l, h));
+        _mm_storeu_si128((__m128i *)(dst + i), d);
+    }
+
+    for (; i < len; i++) {
+        dst[i] ^= gf_mul_table[(c << 8) + src[i]];
+    }
+}
+
+__attribute__((target("ssse3")))
+static void ssse3_mul1(gf *dst, gf *src, gf c, uint64_t sz,
+                       uint64_t dst_max, uint64_t src_max)
+{
+    gf lo[16], hi[16];
+    uint64_t len = gf_kernel_len(dst_max, src_max);
+    uint64_t i = 0;
+
+    gf_nibble_tables(c, lo, hi);
+
+    __m128i tlo = _mm_loadu_si128((__m128i *)lo);
+    __m128i thi = _mm_loadu_si128((__m128i *)hi);
+    __m128i mask = _mm_set1_epi8(0x0f);
+
+    for (; i + 16 <= len; i += 16) {
+        __m128i s = _mm_loadu_si128((__m128i *)(src + i));
+        __m128i l = _mm_shuffle_epi8(tlo, _mm_and_si128(s, mask));
+        __m128i h = _mm_shuffle_epi8(thi,
+                                     _mm_and_si128(_mm_srli_epi64(s, 4), mask));
+        _mm_storeu_si128((__m128i *)(dst + i), _mm_xor_si128(l, h));
+    }
+
+    for (; i < len; i++) {
+        dst[i] = gf_mul_table[(c << 8) + src[i]];
+    }
+}
+
+__attribute__((target("avx2")))
+static void avx2_addmul1(gf *dst, gf *src, gf c, uint64_t sz,
+                         uint64_t dst_max, uint64_t src_max)
+{
+    gf lo[16], hi[16];
+    uint64_t len = gf_kernel_len(dst_max, src_max);
+    uint64_t i = 0;
+
+    gf_nibble_tables(c, lo, hi);
+
+    /* vpshufb works per 128 bit lane, so use the table in both lanes */
+    __m256i tlo = _mm256_broadcastsi128_si256(_mm_loadu_si128((__m128i *)lo));
+    __m256i thi = _mm256_broadcastsi128_si256(_mm_loadu_si128((__m128i *)hi));
+    __m256i mask = _mm256_set1_epi8(0x0f);
+
+    for (; i + 32 <= len; i += 32) {
+        __m256i s = _mm256_loadu_si256((__m256i *)(src + i));
+        __m256i d = _mm256_loadu_si256((__m256i *)(dst + i));
+        __m256i l = _mm256_shuffle_epi8(tlo, _mm256_and_si256(s, mask));
+        __m256i h = _mm256_shuffle_epi8(thi,
+                            _mm256_and_si256(_mm256_srli_epi64(s, 4), mask));
+        d = _mm256_xor_si256(d, _mm256_xor_si256(l, h));
+        _mm256_storeu_si256((__m256i *)(dst + i), d);
+    }
+
+    for (; i < len; i++) {
+        dst[i] ^= gf_mul_table[(c << 8) + src[i]];
+    }
+}
+
+__attribute__((target("avx2")))
+static void avx2_mul1(gf *dst, gf *src, gf c, uint64_t sz,
+                      uint64_t dst_max, uint64_t src_max)
+{
+    gf lo[16], hi[16];
+    uint64_t len = gf_kernel_len(dst_max, src_max);
+    uint64_t i = 0;
+
+    gf_nibble_tables(c, lo, hi);
+
+    __m256i tlo = _mm256_broadcastsi128_si256(_mm_loadu_si128((__m128i *)lo));
+    __m256i thi = _mm256_broadcastsi128_si256(_mm_loadu_si128((__m128i *)hi));
+    __m256i mask = _mm256_set1_epi8(0x0f);
+
+    for (; i + 32 <= len; i += 32) {
+        __m256i s = _mm256_loadu_si256((__m256i *)(src + i));
+        __m256i l = _mm256_shuffle_epi8(tlo, _mm256_and_si256(s, mask));
+        __m256i h = _mm256_shuffle_epi8(thi,
+                            _mm256_and_si256(_mm256_srli_epi64(s, 4), mask));
+        _mm256_storeu_si256((__m256i *)(dst + i), _mm256_xor_si256(l, h));
+    }
+
+    for (; i < len; i++) {
+        dst[i] = gf_mul_table[(c << 8) + src[i]];
+    }
+}
+
+static int ssse3_supported(void)
+{
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("ssse3");
+}
+
+static int avx2_supported(void)
+{
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+}
+#endif /* RS_SIMD_X86 */
+
+#ifdef RS_SIMD_NEON
+static void neon_addmul1(gf *dst, gf *src, gf c, uint64_t sz,
+                         uint64_t dst_max, uint64_t src_max)
+{
+    gf lo[16], hi[16];
+    uint64_t len = gf_kernel_len(dst_max, src_max);
+    uint64_t i = 0;
+
+    gf_nibble_tables(c, lo, hi);
+
+    uint8x16_t tlo = vld1q_u8(lo);
+    uint8x16_t thi = vld1q_u8(hi);
+    uint8x16_t mask = vdupq_n_u8(0x0f);
+
+    for (; i + 16 <= len; i += 16) {
+        uint8x16_t s = vld1q_u8(src + i);
+        uint8x16_t l = vqtbl1q_u8(tlo, vandq_u8(s, mask));
+        uint8x16_t h = vqtbl1q_u8(thi, vshrq_n_u8(s, 4));
+        vst1q_u8(dst + i, veorq_u8(vld1q_u8(dst + i), veorq_u8(l, h)));
+    }
+
+    for (; i < len; i++) {
+        dst[i] ^= gf_mul_table[(c << 8) + src[i]];
+    }
+}
+
+static void neon_mul1(gf *dst, gf *src, gf c, uint64_t sz,
+                      uint64_t dst_max, uint64_t src_max)
+{
+    gf lo[16], hi[16];
+    uint64_t len = gf_kernel_len(dst_max, src_max);
+    uint64_t i = 0;
+
+    gf_nibble_tables(c, lo, hi);
+
+    uint8x16_t tlo = vld1q_u8(lo);
+    uint8x16_t thi = vld1q_u8(hi);
+    uint8x16_t mask = vdupq_n_u8(0x0f);
+
+    for (; i + 16 <= len; i += 16) {
+        uint8x16_t s = vld1q_u8(src + i);
+        uint8x16_t l = vqtbl1q_u8(tlo, vandq_u8(s, mask));
+        uint8x16_t h = vqtbl1q_u8(thi, vshrq_n_u8(s, 4));
+        vst1q_u8(dst + i, veorq_u8(l, h));
+    }
+
+    for (; i < len; i++) {
+        dst[i] = gf_mul_table[(c << 8) + src[i]];
+    }
+}
+
+/* Advanced SIMD is mandatory on aarch64 */
+static int neon_supported(void)
+{
+    return 1;
+}
+#endif /* RS_SIMD_NEON */
+
+static int scalar_supported(void)
+{
+    return 1;
+}
+
+typedef struct {
+    const char *name;
+    int (*supported)(void);
+    gf_kernel_t addmul1;
+    gf_kernel_t mul1;
+} gf_backend_t;
+
+/* in order of preference, the scalar kernels must be last */
+static const gf_backend_t gf_backends[] = {
+#ifdef RS_SIMD_X86
+    {"avx2", avx2_supported, avx2_addmul1, avx2_mul1},
+    {"ssse3", ssse3_supported, ssse3_addmul1, ssse3_mul1},
+#endif
+#ifdef RS_SIMD_NEON
+    {"neon", neon_supported, neon_addmul1, neon_mul1},
+#endif
+    {"scalar", scalar_supported, slow_addmul1, slow_mul1}
+};
+
+#define GF_BACKENDS_COUNT (sizeof(gf_backends) / sizeof(gf_backend_t))
+
+static const char *gf_backend_name = "scalar";
+
+static void select_gf_backend(void)
+{
+    unsigned int i;
+    for (i = 0; i < GF_BACKENDS_COUNT; i++) {
+        if (gf_backends[i].supported()) {
+            addmul1 = gf_backends[i].addmul1;
+            mul1 = gf_backends[i].mul1;
+            gf_backend_name = gf_backends[i].name;
+            return;
+        }
+    }
+}
+
 /*
  * invert_mat() takes a matrix and produces its inverse
  * k is the size of the matrix.
@@ -493,6 +756,11 @@ static int fec_initialized = 0;
 
 void fec_init(void)
 {
+    /* the tables don't change, and may be in use by other threads */
+    if (fec_initialized) {
+        return;
+    }
+
     TICK(ticks[0]);
     generate_gf();
     TOCK(ticks[0]);
@@ -501,6 +769,8 @@ void fec_init(void)
     init_mul_table();
     TOCK(ticks[0]);
     DDB(fprintf(stderr, "init_mul_table took %ldus\n", ticks[0]);)
+    select_gf_backend();
+    DDB(fprintf(stderr, "using %s galois field kernels\n", gf_backend_name);)
     fec_initialized = 1;
 }
 
@@ -744,16 +1014,33 @@ void reed_solomon_release(reed_solomon* rs)
     }
 }
 
-int reed_solomon_encode(reed_solomon* rs,
-                        uint8_t** data_blocks,
-                        uint8_t** fec_blocks,
-                        uint64_t block_size,
-                        uint64_t total_bytes)
+/*
+ * Limit a shard max to the column stripe [offset, offset + length), a
+ * shard that ends before the stripe contributes no bytes to it.
+ */
+static inline uint64_t stripe_max(uint64_t max, uint64_t offset, uint64_t length)
+{
+    if (max <= offset) {
+        return 0;
+    }
+    max -= offset;
+    return max < length ? max : length;
+}
+
+static int encode_stripe(reed_solomon* rs,
+                         uint8_t** data_blocks,
+                         uint8_t** fec_blocks,
+                         uint64_t block_size,
+                         uint64_t total_bytes,
+                         uint64_t offset,
+                         uint64_t length)
 {
     assert(NULL != rs && NULL != rs->parity);
 
     uint64_t data_blocks_max[rs->data_shards];
     uint64_t fec_blocks_max[rs->parity_shards];
+    uint8_t *data_stripes[rs->data_shards];
+    uint8_t *fec_stripes[rs->parity_shards];
 
     int c = 0;
 
@@ -765,27 +1052,41 @@ int reed_solomon_encode(reed_solomon* rs,
         if (bytes_remaining < block_size) {
             max = bytes_remaining;
         }
-        data_blocks_max[c] = max;
+        data_blocks_max[c] = stripe_max(max, offset, length);
+        data_stripes[c] = data_blocks[c] + offset;
     }
 
     // All of the parity shards will be the block size
     for (c = 0; c < rs->parity_shards; c++) {
-        fec_blocks_max[c] = block_size;
+        fec_blocks_max[c] = stripe_max(block_size, offset, length);
+        fec_stripes[c] = fec_blocks[c] + offset;
     }
 
-    return code_some_shards(rs->parity, data_blocks, fec_blocks,
-                            rs->data_shards, rs->parity_shards, block_size,
+    return code_some_shards(rs->parity, data_stripes, fec_stripes,
+                            rs->data_shards, rs->parity_shards, length,
                             data_blocks_max, fec_blocks_max);
 }
 
-int reed_solomon_decode(reed_solomon* rs,
-                        uint8_t **data_blocks,
+int reed_solomon_encode(reed_solomon* rs,
+                        uint8_t** data_blocks,
+                        uint8_t** fec_blocks,
                         uint64_t block_size,
-                        uint8_t **dec_fec_blocks,
-                        unsigned int *fec_block_nos,
-                        unsigned int *erased_blocks,
-                        int nr_fec_blocks,
                         uint64_t total_bytes)
+{
+    return encode_stripe(rs, data_blocks, fec_blocks, block_size,
+                         total_bytes, 0, block_size);
+}
+
+static int decode_stripe(reed_solomon* rs,
+                         uint8_t **data_blocks,
+                         uint64_t block_size,
+                         uint8_t **dec_fec_blocks,
+                         unsigned int *fec_block_nos,
+                         unsigned int *erased_blocks,
+                         int nr_fec_blocks,
+                         uint64_t total_bytes,
+                         uint64_t offset,
+                         uint64_t length)
 {
     /* use stack instead of malloc, define a small number of DATA_SHARDS_MAX to save memory */
     gf dataDecodeMatrix[DATA_SHARDS_MAX*DATA_SHARDS_MAX];
@@ -841,15 +1142,16 @@ int reed_solomon_decode(reed_solomon* rs,
             for(c = 0; c < dataShards; c++) {
                 dataDecodeMatrix[subMatrixRow*dataShards + c] = m[i*dataShards + c];
             }
-            subShards[subMatrixRow] = data_blocks[i];
-            subShardsMax[subMatrixRow] = max;
+            subShards[subMatrixRow] = data_blocks[i] + offset;
+            subShardsMax[subMatrixRow] = stripe_max(max, offset, length);
             subMatrixRow++;
         }
     }
 
     for(i = 0; i < nr_fec_blocks && subMatrixRow < dataShards; i++) {
-        subShards[subMatrixRow] = dec_fec_blocks[i];
-        subShardsMax[subMatrixRow] = block_size; /* all fec shards have block_size */
+        subShards[subMatrixRow] = dec_fec_blocks[i] + offset;
+        /* all fec shards have block_size */
+        subShardsMax[subMatrixRow] = stripe_max(block_size, offset, length);
         j = dataShards + fec_block_nos[i];
         for(c = 0; c < dataShards; c++) {
             dataDecodeMatrix[subMatrixRow*dataShards + c] = m[j*dataShards + c]; //use spefic pos of original fec_blocks
@@ -874,25 +1176,55 @@ int reed_solomon_decode(reed_solomon* rs,
             max = remaining;
         }
 
-        outputs[i] = data_blocks[j];
-        outputsMax[i] = max;
+        outputs[i] = data_blocks[j] + offset;
+        outputsMax[i] = stripe_max(max, offset, length);
         memmove(dataDecodeMatrix+i*dataShards, dataDecodeMatrix+j*dataShards, dataShards);
     }
 
     return code_some_shards(dataDecodeMatrix, subShards, outputs,
-                            dataShards, nr_fec_blocks, block_size,
+                            dataShards, nr_fec_blocks, length,
                             subShardsMax, outputsMax);
 }
 
+int reed_solomon_decode(reed_solomon* rs,
+                        uint8_t **data_blocks,
+                        uint64_t block_size,
+                        uint8_t **dec_fec_blocks,
+                        unsigned int *fec_block_nos,
+                        unsigned int *erased_blocks,
+                        int nr_fec_blocks,
+                        uint64_t total_bytes)
+{
+    return decode_stripe(rs, data_blocks, block_size, dec_fec_blocks,
+                         fec_block_nos, erased_blocks, nr_fec_blocks,
+                         total_bytes, 0, block_size);
+}
+
 int reed_solomon_encode2(reed_solomon* rs, uint8_t** data_blocks,
                          uint8_t** fec_blocks, int nr_shards, uint64_t block_size,
                          uint64_t total_bytes)
+{
+    return reed_solomon_encode2_stripe(rs, data_blocks, fec_blocks, nr_shards,
+                                       block_size, total_bytes, 0, block_size);
+}
+
+int reed_solomon_encode2_stripe(reed_solomon* rs, uint8_t** data_blocks,
+                                uint8_t** fec_blocks, int nr_shards,
+                                uint64_t block_size, uint64_t total_bytes,
+                                uint64_t offset, uint64_t length)
 {
     int i, ds = rs->data_shards, ps = rs->parity_shards, ss = rs->shards;
-    i = nr_shards / ss;
+
+    if (offset >= block_size) {
+        return 0;
+    }
+    if (length > block_size - offset) {
+        length = block_size - offset;
+    }
 
     for(i = 0; i < nr_shards; i += ss) {
-        reed_solomon_encode(rs, data_blocks, fec_blocks, block_size, total_bytes);
+        encode_stripe(rs, data_blocks, fec_blocks, block_size, total_bytes,
+                      offset, length);
         data_blocks += ds;
         fec_blocks += ps;
     }
@@ -906,6 +1238,21 @@ int reed_solomon_reconstruct(reed_solomon* rs,
                              int nr_shards,
                              uint64_t block_size,
                              uint64_t total_bytes)
+{
+    return reed_solomon_reconstruct_stripe(rs, data_blocks, fec_blocks, marks,
+                                           nr_shards, block_size, total_bytes,
+                                           0, block_size);
+}
+
+int reed_solomon_reconstruct_stripe(reed_solomon* rs,
+                                    uint8_t** data_blocks,
+                                    uint8_t** fec_blocks,
+                                    uint8_t* marks,
+                                    int nr_shards,
+                                    uint64_t block_size,
+                                    uint64_t total_bytes,
+                                    uint64_t offset,
+                                    uint64_t length)
 {
     uint8_t *dec_fec_blocks[DATA_SHARDS_MAX];
     unsigned int fec_block_nos[DATA_SHARDS_MAX];
@@ -916,6 +1263,13 @@ int reed_solomon_reconstruct(reed_solomon* rs,
     int ps = rs->parity_shards;
     int err = 0;
 
+    if (offset >= block_size) {
+        return 0;
+    }
+    if (length > block_size - offset) {
+        length = block_size - offset;
+    }
+
     n = nr_shards / rs->shards;
     fec_marks = marks + n*ds; //after all data, is't fec marks
 
@@ -939,14 +1293,16 @@ int reed_solomon_reconstruct(reed_solomon* rs,
             }
 
             if(dn == pn) {
-                reed_solomon_decode(rs,
-                                    data_blocks,
-                                    block_size,
-                                    dec_fec_blocks,
-                                    fec_block_nos,
-                                    erased_blocks,
-                                    dn,
-                                    total_bytes);
+                decode_stripe(rs,
+                              data_blocks,
+                              block_size,
+                              dec_fec_blocks,
+                              fec_block_nos,
+                              erased_blocks,
+                              dn,
+                              total_bytes,
+                              offset,
+                              length);
             } else {
                 //error but we continue
                 err = -1;
@@ -960,3 +1316,181 @@ int reed_solomon_reconstruct(reed_solomon* rs,
 
     return err;
 }
+
+reed_solomon_decoder* reed_solomon_decoder_new(reed_solomon* rs,
+                                               uint8_t* marks)
+{
+    gf dataDecodeMatrix[DATA_SHARDS_MAX*DATA_SHARDS_MAX];
+    int ds = rs->data_shards;
+    int ps = rs->parity_shards;
+    int i, c, row;
+
+    reed_solomon_decoder* decoder = RS_CALLOC(1, sizeof(reed_solomon_decoder));
+    if(NULL == decoder) {
+        return NULL;
+    }
+
+    for(i = 0; i < ds; i++) {
+        if(marks[i]) {
+            decoder->erased_blocks[decoder->nr_erased++] = i;
+        }
+    }
+
+    if(0 == decoder->nr_erased) {
+        return decoder;
+    }
+
+    /* the valid data shards, then as many valid parity shards as needed */
+    row = 0;
+    for(i = 0; i < ds + ps && row < ds; i++) {
+        if(marks[i]) {
+            continue;
+        }
+        decoder->input_blocks[row] = i;
+        for(c = 0; c < ds; c++) {
+            dataDecodeMatrix[row*ds + c] = rs->m[i*ds + c];
+        }
+        row++;
+    }
+
+    if(row < ds || invert_mat(dataDecodeMatrix, ds)) {
+        //cannot correct
+        RS_FREE(decoder);
+        return NULL;
+    }
+
+    decoder->matrix = RS_MALLOC(decoder->nr_erased * ds);
+    if(NULL == decoder->matrix) {
+        RS_FREE(decoder);
+        return NULL;
+    }
+
+    for(i = 0; i < decoder->nr_erased; i++) {
+        memcpy(decoder->matrix + i*ds,
+               dataDecodeMatrix + decoder->erased_blocks[i]*ds, ds);
+    }
+
+    return decoder;
+}
+
+void reed_solomon_decoder_release(reed_solomon_decoder* decoder)
+{
+    if(NULL != decoder) {
+        if(NULL != decoder->matrix) {
+            RS_FREE(decoder->matrix);
+        }
+        RS_FREE(decoder);
+    }
+}
+
+int reed_solomon_decoder_reconstruct_stripe(reed_solomon* rs,
+                                            reed_solomon_decoder* decoder,
+                                            uint8_t** data_blocks,
+                                            uint8_t** fec_blocks,
+                                            uint64_t block_size,
+                                            uint64_t total_bytes,
+                                            uint64_t offset,
+                                            uint64_t length)
+{
+    uint8_t* inputs[DATA_SHARDS_MAX];
+    uint64_t inputsMax[DATA_SHARDS_MAX];
+    uint8_t* outputs[DATA_SHARDS_MAX];
+    uint64_t outputsMax[DATA_SHARDS_MAX];
+    int ds = rs->data_shards;
+    int i;
+
+    if(0 == decoder->nr_erased || offset >= block_size) {
+        return 0;
+    }
+    if(length > block_size - offset) {
+        length = block_size - offset;
+    }
+
+    for(i = 0; i < ds; i++) {
+        int b = decoder->input_blocks[i];
+        if(b < ds) {
+            // Determine if the shard has less than block size
+            uint64_t remaining = total_bytes - b * block_size;
+            uint64_t max = block_size;
+            if (remaining < block_size) {
+                max = remaining;
+            }
+            inputs[i] = data_blocks[b] + offset;
+            inputsMax[i] = stripe_max(max, offset, length);
+        } else {
+            /* all fec shards have block_size */
+            inputs[i] = fec_blocks[b - ds] + offset;
+            inputsMax[i] = stripe_max(block_size, offset, length);
+        }
+    }
+
+    for(i = 0; i < decoder->nr_erased; i++) {
+        int b = decoder->erased_blocks[i];
+        uint64_t remaining = total_bytes - b * block_size;
+        uint64_t max = block_size;
+        if (remaining < block_size) {
+            max = remaining;
+        }
+        outputs[i] = data_blocks[b] + offset;
+        outputsMax[i] = stripe_max(max, offset, length);
+    }
+
+    return code_some_shards(decoder->matrix, inputs, outputs,
+                            ds, decoder->nr_erased, length,
+                            inputsMax, outputsMax);
+}
+
+/*
+ * The size of a shard without the zero padding of the file, parity shards
+ * always have block_size.
+ */
+static inline uint64_t block_max(int ds, int b, uint64_t block_size,
+                                 uint64_t total_bytes)
+{
+    uint64_t remaining = total_bytes - b * block_size;
+    if (b < ds && remaining < block_size) {
+        return remaining;
+    }
+    return block_size;
+}
+
+int reed_solomon_decoder_add_stripe(reed_solomon* rs,
+                                    reed_solomon_decoder* decoder,
+                                    int input,
+                                    uint8_t* input_block,
+                                    uint8_t** erased_blocks,
+                                    uint64_t block_size,
+                                    uint64_t total_bytes,
+                                    uint64_t offset,
+                                    uint64_t length)
+{
+    int ds = rs->data_shards;
+    int i;
+
+    if(input < 0 || input >= ds) {
+        return -1;
+    }
+    if(0 == decoder->nr_erased || offset >= block_size) {
+        return 0;
+    }
+    if(length > block_size - offset) {
+        length = block_size - offset;
+    }
+
+    uint64_t inputMax = stripe_max(block_max(ds, decoder->input_blocks[input],
+                                             block_size, total_bytes),
+                                   offset, length);
+
+    for(i = 0; i < decoder->nr_erased; i++) {
+        if(NULL == erased_blocks[i]) {
+            continue;
+        }
+        uint64_t outputMax = stripe_max(block_max(ds, decoder->erased_blocks[i],
+                                                  block_size, total_bytes),
+                                        offset, length);
+        addmul(erased_blocks[i] + offset, input_block + offset,
+               decoder->matrix[i*ds + input], length, outputMax, inputMax);
+    }
+
+    return 0;
+}
@@ -27,8 +27,22 @@ typedef struct _reed_solomon {
     uint8_t* parity;
 } reed_solomon;
 
+/* The decode matrix for a pattern of missing shards, which doesn't change
+ * once created and may be shared between threads */
+typedef struct _reed_solomon_decoder {
+    int nr_erased;
+    /* data shards that are missing, in order */
+    unsigned int erased_blocks[DATA_SHARDS_MAX];
+    /* shards used to repair them, parity shards offset by data_shards */
+    unsigned int input_blocks[DATA_SHARDS_MAX];
+    /* a row of data_shards for each missing data shard */
+    uint8_t* matrix;
+} reed_solomon_decoder;
+
 /**
  * @brief Initializes data structures used for computations in GF.
+ *
+ * Only the first call initializes them.
  */
 void fec_init(void);
 
@@ -80,6 +94,28 @@ int reed_solomon_encode2(reed_solomon* rs, uint8_t** data_blocks,
                          uint8_t** fec_blocks, int nr_shards, uint64_t block_size,
                          uint64_t total_bytes);
 
+/**
+ * @brief Will encode a column stripe of large buffer into parity shards
+ *
+ * Only the bytes in [offset, offset + length) of every shard are read and
+ * written, so that disjoint stripes may be encoded concurrently from
+ * different threads with the same reed solomon instance.
+ *
+ * @param[in] rs
+ * @param[in] data_blocks Data shards
+ * @param[in] fec_blocks Parity shards
+ * @param[in] nr_shards Total number of shards/blocks
+ * @param[in] block_size The size of each shard
+ * @param[in] total_bytes The total size used for zero padding the last shard
+ * @param[in] offset The offset of the stripe within each shard
+ * @param[in] length The length of the stripe
+ * @return A non-zero error value on failure and 0 on success.
+ */
+int reed_solomon_encode2_stripe(reed_solomon* rs, uint8_t** data_blocks,
+                                uint8_t** fec_blocks, int nr_shards,
+                                uint64_t block_size, uint64_t total_bytes,
+                                uint64_t offset, uint64_t length);
+
 /**
  * @brief Will repair missing data in blocks
  *
@@ -96,4 +132,103 @@ int reed_solomon_reconstruct(reed_solomon* rs, uint8_t** data_blocks,
                              uint8_t** fec_blocks, uint8_t* marks,
                              int nr_shards, uint64_t block_size,
                              uint64_t total_bytes);
+
+/**
+ * @brief Will repair missing data in a column stripe of blocks
+ *
+ * Same as reed_solomon_reconstruct, limited to the bytes in
+ * [offset, offset + length) of every shard, disjoint stripes may be
+ * repaired concurrently.
+ *
+ * @param[in] rs
+ * @param[in] data_blocks Data shards
+ * @param[in] fec_blocks Parity shards
+ * @param[in] marks An array with 1 used to mark missing blocks
+ * @param[in] nr_shards Total number of shards/blocks
+ * @param[in] block_size The size of each shard
+ * @param[in] total_bytes The total size used for zero padding the last shard
+ * @param[in] offset The offset of the stripe within each shard
+ * @param[in] length The length of the stripe
+ * @return A non-zero error value on failure and 0 on success.
+ */
+int reed_solomon_reconstruct_stripe(reed_solomon* rs, uint8_t** data_blocks,
+                                    uint8_t** fec_blocks, uint8_t* marks,
+                                    int nr_shards, uint64_t block_size,
+                                    uint64_t total_bytes, uint64_t offset,
+                                    uint64_t length);
+
+/**
+ * @brief Will create the decoder for a pattern of missing shards
+ *
+ * The matrix inversion for the pattern is done once, so that the decoder
+ * can be used for every stripe and file missing the same shards.
+ *
+ * @param[in] rs
+ * @param[in] marks An array of rs->shards with 1 used to mark missing blocks
+ * @return A null value on error or when the blocks can't be repaired
+ */
+reed_solomon_decoder* reed_solomon_decoder_new(reed_solomon* rs,
+                                               uint8_t* marks);
+
+/**
+ * @brief Will free existing decoder
+ *
+ * @param[in] decoder
+ */
+void reed_solomon_decoder_release(reed_solomon_decoder* decoder);
+
+/**
+ * @brief Will repair missing data in a column stripe with a decoder
+ *
+ * Same as reed_solomon_reconstruct_stripe for the missing shards of the
+ * decoder, with one group of rs->shards blocks.
+ *
+ * @param[in] rs
+ * @param[in] decoder The decoder for the missing blocks
+ * @param[in] data_blocks Data shards
+ * @param[in] fec_blocks Parity shards
+ * @param[in] block_size The size of each shard
+ * @param[in] total_bytes The total size used for zero padding the last shard
+ * @param[in] offset The offset of the stripe within each shard
+ * @param[in] length The length of the stripe
+ * @return A non-zero error value on failure and 0 on success.
+ */
+int reed_solomon_decoder_reconstruct_stripe(reed_solomon* rs,
+                                            reed_solomon_decoder* decoder,
+                                            uint8_t** data_blocks,
+                                            uint8_t** fec_blocks,
+                                            uint64_t block_size,
+                                            uint64_t total_bytes,
+                                            uint64_t offset,
+                                            uint64_t length);
+
+/**
+ * @brief Will add one input block of a decoder to the missing blocks
+ *
+ * The missing data in a column stripe is a sum of the input blocks of the
+ * decoder, so the input blocks can be added one at a time in any order,
+ * and don't need to be in memory together. The missing blocks must be
+ * zeroed before the first input block is added.
+ *
+ * @param[in] rs
+ * @param[in] decoder The decoder for the missing blocks
+ * @param[in] input The position of the block in decoder->input_blocks
+ * @param[in] input_block The input block
+ * @param[in] erased_blocks A block for each of decoder->erased_blocks, or
+ * NULL for those not repaired
+ * @param[in] block_size The size of each shard
+ * @param[in] total_bytes The total size used for zero padding the last shard
+ * @param[in] offset The offset of the stripe within each shard
+ * @param[in] length The length of the stripe
+ * @return A non-zero error value on failure and 0 on success.
+ */
+int reed_solomon_decoder_add_stripe(reed_solomon* rs,
+                                    reed_solomon_decoder* decoder,
+                                    int input,
+                                    uint8_t* input_block,
+                                    uint8_t** erased_blocks,
+                                    uint64_t block_size,
+                                    uint64_t total_bytes,
+                                    uint64_t offset,
+                                    uint64_t length);
 #endif
@@ -0,0 +1,224 @@
+#include "scheduler.h"
+
+transfer_scheduler_t *transfer_scheduler_new(uv_loop_t *loop)
+{
+    transfer_scheduler_t *scheduler = calloc(1, sizeof(transfer_scheduler_t));
+    if (!scheduler) {
+        return NULL;
+    }
+
+    if (uv_timer_init(loop, &scheduler->wake_timer)) {
+        free(scheduler);
+        return NULL;
+    }
+    scheduler->wake_timer.data = scheduler;
+
+    return scheduler;
+}
+
+static void close_scheduler(uv_handle_t *handle)
+{
+    free(handle->data);
+}
+
+void transfer_scheduler_destroy(transfer_scheduler_t *scheduler)
+{
+    if (!scheduler) {
+        return;
+    }
+
+    // the scheduler is freed once the loop has closed the timer
+    uv_timer_stop(&scheduler->wake_timer);
+    uv_close((uv_handle_t *)&scheduler->wake_timer, close_scheduler);
+}
+
+static void unlink_slot(transfer_slot_t *slot)
+{
+    transfer_scheduler_t *scheduler = slot->scheduler;
+
+    if (slot->prev) {
+        slot->prev->next = slot->next;
+    } else {
+        scheduler->head = slot->next;
+    }
+
+    if (slot->next) {
+        slot->next->prev = slot->prev;
+    } else {
+        scheduler->tail = slot->prev;
+    }
+
+    slot->prev = NULL;
+    slot->next = NULL;
+}
+
+static void append_slot(transfer_slot_t *slot)
+{
+    transfer_scheduler_t *scheduler = slot->scheduler;
+
+    slot->prev = scheduler->tail;
+    slot->next = NULL;
+
+    if (scheduler->tail) {
+        scheduler->tail->next = slot;
+    } else {
+        scheduler->head = slot;
+    }
+    scheduler->tail = slot;
+}
+
+static void wake_slots(uv_timer_t *timer)
+{
+    transfer_scheduler_t *scheduler = timer->data;
+
+    // only the slots that are waiting now are woken in this turn
+    uint32_t total_slots = scheduler->total_slots;
+    transfer_slot_t *slot = scheduler->head;
+
+    for (uint32_t i = 0; slot && i < total_slots; i++) {
+        transfer_slot_t *next = slot->next;
+
+        if (slot->waiting) {
+            slot->waiting = false;
+            scheduler->total_waiting -= 1;
+
+            // rotate so that the next turn starts with another file
+            unlink_slot(slot);
+            append_slot(slot);
+
+            // the slot may be freed by the wake function
+            slot->wake(slot->data);
+
+            // stop once the budget has been used
+            if (scheduler->total_waiting > 0 &&
+                scheduler->max_shards &&
+                scheduler->shards >= scheduler->max_shards) {
+                break;
+            }
+        }
+
+        slot = next;
+    }
+}
+
+static void queue_wake_slots(transfer_scheduler_t *scheduler)
+{
+    if (scheduler->total_waiting == 0) {
+        return;
+    }
+
+    uv_timer_start(&scheduler->wake_timer, wake_slots, 0, 0);
+}
+
+transfer_slot_t *transfer_slot_new(transfer_scheduler_t *scheduler,
+                                   transfer_wake_cb wake,
+                                   void *data)
+{
+    transfer_slot_t *slot = calloc(1, sizeof(transfer_slot_t));
+    if (!slot) {
+        return NULL;
+    }
+
+    slot->scheduler = scheduler;
+    slot->wake = wake;
+    slot->data = data;
+
+    if (scheduler) {
+        append_slot(slot);
+        scheduler->total_slots += 1;
+    }
+
+    return slot;
+}
+
+void transfer_slot_free(transfer_slot_t *slot)
+{
+    if (!slot) {
+        return;
+    }
+
+    transfer_scheduler_t *scheduler = slot->scheduler;
+
+    if (scheduler) {
+        if (slot->waiting) {
+            scheduler->total_waiting -= 1;
+        }
+
+        // return anything that is still held
+        scheduler->shards -= slot->shards;
+        scheduler->bytes -= slot->bytes;
+
+        unlink_slot(slot);
+        scheduler->total_slots -= 1;
+
+        queue_wake_slots(scheduler);
+    }
+
+    free(slot);
+}
+
+bool transfer_slot_acquire(transfer_slot_t *slot, uint64_t bytes)
+{
+    transfer_scheduler_t *scheduler = slot->scheduler;
+
+    if (!scheduler) {
+        slot->shards += 1;
+        slot->bytes += bytes;
+        return true;
+    }
+
+    bool available = true;
+
+    if (scheduler->max_shards) {
+        uint32_t fair_share = scheduler->max_shards / scheduler->total_slots;
+        if (fair_share == 0) {
+            fair_share = 1;
+        }
+
+        // other files are waiting, so keep to the fair share
+        uint32_t others_waiting = scheduler->total_waiting -
+            (slot->waiting ? 1 : 0);
+
+        if (scheduler->shards >= scheduler->max_shards ||
+            (others_waiting > 0 && slot->shards >= fair_share)) {
+            available = false;
+        }
+    }
+
+    // a shard larger than the budget is still sent on its own
+    if (scheduler->max_bytes && scheduler->bytes > 0 &&
+        scheduler->bytes + bytes > scheduler->max_bytes) {
+        available = false;
+    }
+
+    if (!available) {
+        if (!slot->waiting) {
+            slot->waiting = true;
+            scheduler->total_waiting += 1;
+        }
+        return false;
+    }
+
+    slot->shards += 1;
+    slot->bytes += bytes;
+    scheduler->shards += 1;
+    scheduler->bytes += bytes;
+
+    return true;
+}
+
+void transfer_slot_release(transfer_slot_t *slot, uint64_t bytes)
+{
+    slot->shards -= 1;
+    slot->bytes -= bytes;
+
+    transfer_scheduler_t *scheduler = slot->scheduler;
+    if (!scheduler) {
+        return;
+    }
+
+    scheduler->shards -= 1;
+    scheduler->bytes -= bytes;
+
+    queue_wake_slots(scheduler);
+}
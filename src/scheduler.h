@@ -0,0 +1,109 @@
+/**
+ * @file scheduler.h
+ * @brief Storj transfer scheduler.
+ *
+ * Shares a budget of shard transfers between all uploads and downloads
+ * of an environment.
+ */
+#ifndef STORJ_SCHEDULER_H
+#define STORJ_SCHEDULER_H
+
+#include "storj.h"
+
+/** @brief A function called on the loop thread when a waiting transfer
+ * may try to acquire shards again
+ */
+typedef void (*transfer_wake_cb)(void *data);
+
+/** @brief The share of the budget held by one file transfer.
+ *
+ * A slot is registered for every upload or download state, and counts
+ * the shards that it has in flight.
+ */
+typedef struct storj_transfer_slot {
+    struct storj_transfer_scheduler *scheduler;
+    uint32_t shards;
+    uint64_t bytes;
+    bool waiting;
+    transfer_wake_cb wake;
+    void *data;
+    struct storj_transfer_slot *prev;
+    struct storj_transfer_slot *next;
+} transfer_slot_t;
+
+/** @brief A budget of shard transfers shared by many files.
+ *
+ * While files are waiting for the budget, each file may only keep its
+ * fair share of the shards in flight, otherwise a file may use all of the
+ * budget that is free. Waiting files are woken in turn when shards are
+ * released. The scheduler is only used from the loop thread.
+ */
+typedef struct storj_transfer_scheduler {
+    uint32_t max_shards;
+    uint64_t max_bytes;
+    uint32_t shards;
+    uint64_t bytes;
+    uint32_t total_slots;
+    uint32_t total_waiting;
+    transfer_slot_t *head;
+    transfer_slot_t *tail;
+    uv_timer_t wake_timer;
+} transfer_scheduler_t;
+
+/**
+ * @brief Create a scheduler without limits
+ *
+ * @param[in] loop The event loop to wake waiting transfers on
+ * @return A new scheduler or NULL on failure
+ */
+transfer_scheduler_t *transfer_scheduler_new(uv_loop_t *loop);
+
+/**
+ * @brief Cleanup a scheduler
+ *
+ * The memory is released once the loop has closed the timer handle.
+ *
+ * @param[in] scheduler The scheduler, with no slots registered
+ */
+void transfer_scheduler_destroy(transfer_scheduler_t *scheduler);
+
+/**
+ * @brief Register a new slot for a file transfer
+ *
+ * @param[in] scheduler The scheduler, may be NULL for no limits
+ * @param[in] wake The function to call when the slot may retry
+ * @param[in] data User data for the wake function
+ * @return A new slot or NULL on failure
+ */
+transfer_slot_t *transfer_slot_new(transfer_scheduler_t *scheduler,
+                                   transfer_wake_cb wake,
+                                   void *data);
+
+/**
+ * @brief Unregister and free a slot
+ *
+ * @param[in] slot The slot, with no shards in flight
+ */
+void transfer_slot_free(transfer_slot_t *slot);
+
+/**
+ * @brief Acquire the budget for one shard
+ *
+ * If the budget is not available the slot is marked as waiting, and
+ * the wake function is called later from the event loop.
+ *
+ * @param[in] slot The slot of the file transfer
+ * @param[in] bytes The size of the shard
+ * @return True if the shard may be transferred
+ */
+bool transfer_slot_acquire(transfer_slot_t *slot, uint64_t bytes);
+
+/**
+ * @brief Release the budget of a shard that is done
+ *
+ * @param[in] slot The slot of the file transfer
+ * @param[in] bytes The size given to transfer_slot_acquire
+ */
+void transfer_slot_release(transfer_slot_t *slot, uint64_t bytes);
+
+#endif /* STORJ_SCHEDULER_H */
@@ -2,6 +2,15 @@
 #include "http.h"
 #include "utils.h"
 #include "crypto.h"
+#include "scheduler.h"
+#include "reports.h"
+#include "farmers.h"
+#include "codecs.h"
+#include "cache.h"
+#include "listing.h"
+
+// separates the date of a list files marker from the listed files
+#define LIST_FILES_MARKER_SEPARATOR '|'
 
 static inline void noop() {};
 
@@ -23,9 +32,11 @@ static void create_bucket_request_worker(uv_work_t *work)
     int status_code = 0;
 
     // Encrypt the bucket name
-    if (encrypt_bucket_name(req->encrypt_options->mnemonic,
-                            req->bucket_name,
-                            (char **)&req->encrypted_bucket_name)) {
+    if (encrypt_file_name_cached(req->encrypt_options->key_cache,
+                                 req->encrypt_options->mnemonic,
+                                 BUCKET_NAME_MAGIC,
+                                 req->bucket_name,
+                                 (char **)&req->encrypted_bucket_name)) {
         req->error_code = STORJ_MEMORY_ERROR;
         return;
     }
@@ -107,9 +118,11 @@ static void get_buckets_request_worker(uv_work_t *work)
             continue;
         }
         char *decrypted_name;
-        int error_status = decrypt_bucket_name(req->encrypt_options->mnemonic,
-                                               encrypted_name,
-                                               &decrypted_name);
+        int error_status = decrypt_file_name_cached(req->encrypt_options->key_cache,
+                                                    req->encrypt_options->mnemonic,
+                                                    BUCKET_NAME_MAGIC,
+                                                    encrypted_name,
+                                                    &decrypted_name);
         if (!error_status) {
             bucket->decrypted = true;
             bucket->name = decrypted_name;
@@ -159,9 +172,11 @@ static void get_bucket_request_worker(uv_work_t *work)
     const char *encrypted_name = json_object_get_string(name);
     if (encrypted_name) {
         char *decrypted_name;
-        int error_status = decrypt_bucket_name(req->encrypt_options->mnemonic,
-                                               encrypted_name,
-                                               &decrypted_name);
+        int error_status = decrypt_file_name_cached(req->encrypt_options->key_cache,
+                                                    req->encrypt_options->mnemonic,
+                                                    BUCKET_NAME_MAGIC,
+                                                    encrypted_name,
+                                                    &decrypted_name);
         if (!error_status) {
             req->bucket->decrypted = true;
             req->bucket->name = decrypted_name;
@@ -181,9 +196,11 @@ static void get_bucket_id_request_worker(uv_work_t *work)
 
     // Encrypt the bucket name
     char *encrypted_bucket_name;
-    if (encrypt_bucket_name(req->encrypt_options->mnemonic,
-                            req->bucket_name,
-                            &encrypted_bucket_name)) {
+    if (encrypt_file_name_cached(req->encrypt_options->key_cache,
+                                 req->encrypt_options->mnemonic,
+                                 BUCKET_NAME_MAGIC,
+                                 req->bucket_name,
+                                 &encrypted_bucket_name)) {
         req->error_code = STORJ_MEMORY_ERROR;
         goto cleanup;
     }
@@ -219,6 +236,118 @@ cleanup:
     free(path);
 }
 
+/*
+ * Split a page marker into the created date to list the files after, and
+ * the number of files created after that date that were already listed.
+ */
+static char *parse_list_files_marker(const char *marker, uint32_t *listed)
+{
+    *listed = 0;
+
+    char *after = strdup(marker);
+    if (!after) {
+        return NULL;
+    }
+
+    char *separator = strchr(after, LIST_FILES_MARKER_SEPARATOR);
+    if (!separator) {
+        return after;
+    }
+    *separator = '\0';
+
+    *listed = strtoul(separator + 1, NULL, 10);
+
+    return after;
+}
+
+static const char *file_created(storj_file_meta_t *file)
+{
+    return file->created ? file->created : "";
+}
+
+/*
+ * Drop the files of a page that were listed on earlier pages, and set the
+ * marker of the next page. Files are listed in order of creation, so all
+ * files created before the last file of a page are listed, but more files
+ * created at the same time as the last one may follow on the next page.
+ */
+static int finish_list_files_page(list_files_request_t *req,
+                                  uint32_t num_files)
+{
+    uint32_t listed = 0;
+    char *after = NULL;
+
+    if (req->start_marker) {
+        after = parse_list_files_marker(req->start_marker, &listed);
+        if (!after) {
+            return STORJ_MEMORY_ERROR;
+        }
+    }
+
+    // the files created after the date come in the same order again
+    uint32_t kept = 0;
+    uint32_t skipped = 0;
+    for (uint32_t i = 0; i < req->total_files; i++) {
+        storj_file_meta_t *file = &req->files[i];
+
+        bool dropped = after && after[0] != '\0' &&
+            strcmp(file_created(file), after) <= 0;
+        if (!dropped && skipped < listed) {
+            skipped++;
+            dropped = true;
+        }
+
+        if (dropped || kept == req->page_size) {
+            if (file->decrypted) {
+                free((char *)file->filename);
+            }
+            continue;
+        }
+
+        req->files[kept] = *file;
+        kept++;
+    }
+    req->total_files = kept;
+
+    // a page short of the limit is the last one
+    if (kept == 0 || num_files < req->page_size + listed) {
+        free(after);
+        return 0;
+    }
+
+    const char *last = file_created(&req->files[kept - 1]);
+    uint32_t first_tie = kept - 1;
+    while (first_tie > 0 &&
+           strcmp(file_created(&req->files[first_tie - 1]), last) == 0) {
+        first_tie--;
+    }
+
+    // the files created at the same time as the last one are listed again
+    // after the date before it, or after the same date as this page if
+    // all of the files of this page were created at that time
+    const char *next_after = "";
+    uint32_t next_listed = kept - first_tie;
+    if (first_tie > 0) {
+        next_after = file_created(&req->files[first_tie - 1]);
+    } else {
+        next_after = after ? after : "";
+        next_listed += listed;
+    }
+
+    char *marker = calloc(strlen(next_after) + 12, sizeof(char));
+    if (!marker) {
+        free(after);
+        return STORJ_MEMORY_ERROR;
+    }
+    sprintf(marker, "%s%c%" PRIu32, next_after, LIST_FILES_MARKER_SEPARATOR,
+            next_listed);
+
+    req->next_marker = marker;
+    free(after);
+
+    return 0;
+}
+
 static void list_files_request_worker(uv_work_t *work)
 {
     list_files_request_t *req = work->data;
@@ -236,74 +365,42 @@ static void list_files_request_worker(uv_work_t *work)
         num_files = json_object_array_length(req->response);
     }
 
-    if (num_files > 0) {
-        req->files = malloc(sizeof(storj_file_meta_t) * num_files);
-        req->total_files = num_files;
+    if (num_files <= 0) {
+        return;
     }
 
-    struct json_object *file;
-    struct json_object *filename;
-    struct json_object *mimetype;
-    struct json_object *size;
-    struct json_object *id;
-    struct json_object *bucket_id;
-    struct json_object *created;
-    struct json_object *hmac;
-    struct json_object *hmac_value;
-    struct json_object *erasure;
-    struct json_object *erasure_type;
-    struct json_object *index;
+    req->files = calloc(num_files, sizeof(storj_file_meta_t));
+    if (!req->files) {
+        req->error_code = STORJ_MEMORY_ERROR;
+        return;
+    }
+    req->total_files = num_files;
+}
 
-    for (int i = 0; i < num_files; i++) {
-        file = json_object_array_get_idx(req->response, i);
-
-        json_object_object_get_ex(file, "filename", &filename);
-        json_object_object_get_ex(file, "mimetype", &mimetype);
-        json_object_object_get_ex(file, "size", &size);
-        json_object_object_get_ex(file, "id", &id);
-        json_object_object_get_ex(file, "bucket", &bucket_id);
-        json_object_object_get_ex(file, "created", &created);
-        json_object_object_get_ex(file, "hmac", &hmac);
-        json_object_object_get_ex(hmac, "value", &hmac_value);
-        json_object_object_get_ex(file, "erasure", &erasure);
-        json_object_object_get_ex(erasure, "type", &erasure_type);
-        json_object_object_get_ex(file, "index", &index);
+static void after_list_files_batches(uv_work_t *work, int status)
+{
+    list_files_request_t *req = work->data;
 
-        storj_file_meta_t *file = &req->files[i];
+    if (req->page_size > 0 && !req->error_code) {
+        req->error_code = finish_list_files_page(req, req->total_files);
+    }
 
-        file->created = json_object_get_string(created);
-        file->mimetype = json_object_get_string(mimetype);
-        file->size = json_object_get_int64(size);
-        file->erasure = json_object_get_string(erasure_type);
-        file->index = json_object_get_string(index);
-        file->hmac = json_object_get_string(hmac_value);
-        file->id = json_object_get_string(id);
-        file->bucket_id = json_object_get_string(bucket_id);
-        file->decrypted = false;
-        file->filename = NULL;
-
-        // Attempt to decrypt the filename, otherwise
-        // we will default the filename to the encrypted text.
-        // The decrypted flag will be set to indicate the status
-        // of decryption for alternative display.
-        const char *encrypted_file_name = json_object_get_string(filename);
-        if (!encrypted_file_name) {
-            continue;
-        }
-        char *decrypted_file_name;
-        int error_status = decrypt_file_name(req->encrypt_options->mnemonic,
-                                             req->bucket_id,
-                                             encrypted_file_name,
-                                             &decrypted_file_name);
-        if (!error_status) {
-            file->decrypted = true;
-            file->filename = decrypted_file_name;
-        } else if (error_status == STORJ_META_DECRYPTION_ERROR) {
-            file->decrypted = false;
-            file->filename = strdup(encrypted_file_name);
-        } else {
-            req->error_code = STORJ_MEMORY_ERROR;
-        }
+    req->cb(work, status);
+}
+
+static void after_list_files_request(uv_work_t *work, int status)
+{
+    list_files_request_t *req = work->data;
+
+    // the metadata of the files is filled in batches on the threadpool
+    if (status || req->error_code || !req->total_files) {
+        req->cb(work, status);
+        return;
+    }
+
+    if (queue_list_files_batches(work->loop, work, after_list_files_batches)) {
+        req->error_code = STORJ_MEMORY_ERROR;
+        req->cb(work, status);
     }
 }
 
@@ -361,10 +458,11 @@ static void get_file_info_request_worker(uv_work_t *work)
     const char *encrypted_file_name = json_object_get_string(filename);
     if (encrypted_file_name) {
         char *decrypted_file_name;
-        int error_status = decrypt_file_name(req->encrypt_options->mnemonic,
-                                             req->bucket_id,
-                                             encrypted_file_name,
-                                             &decrypted_file_name);
+        int error_status = decrypt_file_name_cached(req->encrypt_options->key_cache,
+                                                    req->encrypt_options->mnemonic,
+                                                    req->bucket_id,
+                                                    encrypted_file_name,
+                                                    &decrypted_file_name);
         if (!error_status) {
             req->file->decrypted = true;
             req->file->filename = decrypted_file_name;
@@ -383,10 +481,11 @@ static void get_file_id_request_worker(uv_work_t *work)
     int status_code = 0;
 
     char *encrypted_file_name;
-    if (encrypt_file_name(req->encrypt_options->mnemonic,
-                          req->bucket_id,
-                          req->file_name,
-                          &encrypted_file_name)) {
+    if (encrypt_file_name_cached(req->encrypt_options->key_cache,
+                                 req->encrypt_options->mnemonic,
+                                 req->bucket_id,
+                                 req->file_name,
+                                 &encrypted_file_name)) {
         req->error_code = STORJ_MEMORY_ERROR;
         goto cleanup;
     }
@@ -485,6 +584,10 @@ static list_files_request_t *list_files_request_new(
     req->response = NULL;
     req->files = NULL;
     req->total_files = 0;
+    req->page_size = 0;
+    req->start_marker = NULL;
+    req->cb = NULL;
+    req->next_marker = NULL;
     req->error_code = 0;
     req->status_code = 0;
     req->handle = handle;
@@ -894,6 +997,12 @@ STORJ_API struct storj_env *storj_init_env(storj_bridge_options_t *options,
         eo->mnemonic = NULL;
     }
 
+    // keys derived from the mnemonic are cached for the environment
+    eo->key_cache = key_cache_new();
+    if (!eo->key_cache) {
+        return NULL;
+    }
+
     env->encrypt_options = eo;
 
     // Set tmp_path
@@ -944,8 +1053,64 @@ STORJ_API struct storj_env *storj_init_env(storj_bridge_options_t *options,
     } else {
         ho->timeout = STORJ_HTTP_TIMEOUT;
     }
+    ho->max_connections = http_options->max_connections;
+
+    // keep the read ahead buffer a multiple of the cipher block size
+    ho->send_buffer_size = (http_options->send_buffer_size > 0) ?
+        http_options->send_buffer_size : STORJ_HTTP_SEND_BUFFER_SIZE;
+    ho->send_buffer_size -= ho->send_buffer_size % AES_BLOCK_SIZE;
+    if (ho->send_buffer_size < AES_BLOCK_SIZE) {
+        ho->send_buffer_size = AES_BLOCK_SIZE;
+    }
 
+    // nothing is measured until the metrics are set
+    memset(&env->metrics, 0, sizeof(storj_metrics_t));
+    ho->metrics = &env->metrics;
+
+    // the options copied so far are freed with the environment if any of
+    // the members below can't be created
+    ho->pool = NULL;
     env->http_options = ho;
+    env->http_multi = NULL;
+    env->scheduler = NULL;
+    env->reports = NULL;
+    env->farmers = NULL;
+    env->codecs = NULL;
+    env->shard_cache = NULL;
+    env->log = NULL;
+
+    // share connections between all requests of this environment
+    ho->pool = http_pool_new(ho->max_connections);
+    if (!ho->pool) {
+        goto error;
+    }
+
+    env->http_multi = http_multi_new(loop);
+    if (!env->http_multi) {
+        goto error;
+    }
+
+    // there are no limits until they are set
+    env->scheduler = transfer_scheduler_new(loop);
+    if (!env->scheduler) {
+        goto error;
+    }
+
+    // exchange reports are sent apart from the transfers
+    env->reports = report_queue_new(env);
+    if (!env->reports) {
+        goto error;
+    }
+
+    env->farmers = farmer_table_new();
+    if (!env->farmers) {
+        goto error;
+    }
+
+    env->codecs = codec_cache_new();
+    if (!env->codecs) {
+        goto error;
+    }
 
     // setup the log options
     env->log_options = log_options;
@@ -955,7 +1120,7 @@ STORJ_API struct storj_env *storj_init_env(storj_bridge_options_t *options,
 
     storj_log_levels_t *log = malloc(sizeof(storj_log_levels_t));
     if (!log) {
-        return NULL;
+        goto error;
     }
 
     log->debug = (storj_logger_format_fn)noop;
@@ -979,6 +1144,10 @@ STORJ_API struct storj_env *storj_init_env(storj_bridge_options_t *options,
     env->log = log;
 
     return env;
+
+error:
+    storj_destroy_env(env);
+    return NULL;
 }
 
 STORJ_API int storj_destroy_env(storj_env_t *env)
@@ -1041,6 +1210,7 @@ STORJ_API int storj_destroy_env(storj_env_t *env)
         free((char *)env->tmp_path);
     }
 
+    key_cache_destroy(env->encrypt_options->key_cache);
     free(env->encrypt_options);
 
     // free all http options
@@ -1051,6 +1221,16 @@ STORJ_API int storj_destroy_env(storj_env_t *env)
     if (env->http_options->cainfo_path) {
         free((char *)env->http_options->cainfo_path);
     }
+    http_multi_destroy(env->http_multi);
+    transfer_scheduler_destroy(env->scheduler);
+    report_queue_destroy(env->reports);
+    if (env->farmers) {
+        farmer_table_save(env->farmers);
+    }
+    farmer_table_destroy(env->farmers);
+    codec_cache_destroy(env->codecs);
+    shard_cache_destroy(env->shard_cache);
+    http_pool_destroy(env->http_options->pool);
     free(env->http_options);
 
     // free the log levels
@@ -1064,6 +1244,88 @@ STORJ_API int storj_destroy_env(storj_env_t *env)
     return status;
 }
 
+STORJ_API int storj_env_set_transfer_limits(storj_env_t *env,
+                                            storj_transfer_limits_t *limits)
+{
+    if (!env->scheduler) {
+        return 1;
+    }
+
+    env->scheduler->max_shards = limits->max_shards;
+    env->scheduler->max_bytes = limits->max_bytes;
+
+    return 0;
+}
+
+STORJ_API int storj_env_set_farmer_cache(storj_env_t *env, const char *path)
+{
+    if (!env->farmers || !path) {
+        return 1;
+    }
+
+    return farmer_table_load(env->farmers, path);
+}
+
+STORJ_API int storj_env_set_shard_cache(storj_env_t *env,
+                                        const char *path,
+                                        uint64_t max_bytes)
+{
+    char *cache_path = NULL;
+
+    if (path) {
+        cache_path = strdup(path);
+    } else if (env->tmp_path) {
+        size_t len = strlen(env->tmp_path) + 1 +
+            strlen(STORJ_SHARD_CACHE_DIR) + 1;
+        cache_path = calloc(len, sizeof(char));
+        if (cache_path) {
+            snprintf(cache_path, len, "%s%c%s", env->tmp_path, separator(),
+                     STORJ_SHARD_CACHE_DIR);
+        }
+    } else {
+        return 1;
+    }
+
+    if (!cache_path) {
+        return STORJ_MEMORY_ERROR;
+    }
+
+    shard_cache_t *cache = shard_cache_new(env->loop, cache_path, max_bytes);
+    free(cache_path);
+    if (!cache) {
+        return 1;
+    }
+
+    shard_cache_destroy(env->shard_cache);
+    env->shard_cache = cache;
+
+    return 0;
+}
+
+STORJ_API int storj_env_set_metrics(storj_env_t *env,
+                                    storj_metrics_t *metrics)
+{
+    if (!metrics) {
+        return 1;
+    }
+
+    env->metrics = *metrics;
+
+    return 0;
+}
+
+STORJ_API uint64_t storj_shard_size_default(const storj_shard_size_params_t *params)
+{
+    return determine_shard_size(params->file_size, 0);
+}
+
+STORJ_API uint64_t storj_shard_size_throughput(const storj_shard_size_params_t *params)
+{
+    return determine_shard_size_throughput(params->file_size,
+                                           params->parallelism,
+                                           params->rs);
+}
+
 STORJ_API int storj_encrypt_auth(const char *passphrase,
                        const char *bridge_user,
                        const char *bridge_pass,
@@ -1495,18 +1757,79 @@ STORJ_API int storj_bridge_list_files(storj_env_t *env,
     if (!work) {
         return STORJ_MEMORY_ERROR;
     }
-    work->data = list_files_request_new(env->http_options,
-                                        env->bridge_options,
-                                        env->encrypt_options,
-                                        id, "GET", path,
-                                        NULL, true, handle);
+    list_files_request_t *req = list_files_request_new(env->http_options,
+                                                       env->bridge_options,
+                                                       env->encrypt_options,
+                                                       id, "GET", path,
+                                                       NULL, true, handle);
 
-    if (!work->data) {
+    if (!req) {
+        return STORJ_MEMORY_ERROR;
+    }
+    req->cb = cb;
+    work->data = req;
+
+    return uv_queue_work(env->loop, (uv_work_t*) work,
+                         list_files_request_worker, after_list_files_request);
+}
+
+STORJ_API int storj_bridge_list_files_page(storj_env_t *env,
+                                           const char *id,
+                                           const char *start_marker,
+                                           uint32_t page_size,
+                                           void *handle,
+                                           uv_after_work_cb cb)
+{
+    // the files listed after the start date show up again
+    char *after = NULL;
+    uint32_t listed = 0;
+    if (start_marker) {
+        after = parse_list_files_marker(start_marker, &listed);
+        if (!after) {
+            return STORJ_MEMORY_ERROR;
+        }
+    }
+
+    char query_args[96];
+    if (after && after[0] != '\0') {
+        snprintf(query_args, sizeof(query_args), "?startDate=%s&limit=%" PRIu32,
+                 after, page_size + listed);
+    } else {
+        snprintf(query_args, sizeof(query_args), "?limit=%" PRIu32,
+                 page_size + listed);
+    }
+    free(after);
+
+    char *path = str_concat_many(4, "/buckets/", id, "/files", query_args);
+    if (!path) {
         return STORJ_MEMORY_ERROR;
     }
 
+    uv_work_t *work = uv_work_new();
+    if (!work) {
+        return STORJ_MEMORY_ERROR;
+    }
+    list_files_request_t *req = list_files_request_new(env->http_options,
+                                                       env->bridge_options,
+                                                       env->encrypt_options,
+                                                       id, "GET", path,
+                                                       NULL, true, handle);
+
+    if (!req) {
+        return STORJ_MEMORY_ERROR;
+    }
+    req->page_size = page_size;
+    req->cb = cb;
+    if (start_marker) {
+        req->start_marker = strdup(start_marker);
+        if (!req->start_marker) {
+            return STORJ_MEMORY_ERROR;
+        }
+    }
+    work->data = req;
+
     return uv_queue_work(env->loop, (uv_work_t*) work,
-                         list_files_request_worker, cb);
+                         list_files_request_worker, after_list_files_request);
 }
 
 STORJ_API void storj_free_list_files_request(list_files_request_t *req)
@@ -1517,10 +1840,15 @@ STORJ_API void storj_free_list_files_request(list_files_request_t *req)
     free(req->path);
     if (req->files && req->total_files > 0) {
         for (int i = 0; i < req->total_files; i++) {
-            free((char *)req->files[i].filename);
+            // undecrypted filenames are borrowed from the response
+            if (req->files[i].decrypted) {
+                free((char *)req->files[i].filename);
+            }
         }
     }
     free(req->files);
+    free(req->start_marker);
+    free(req->next_marker);
     free(req);
 }
 
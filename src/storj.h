@@ -116,6 +116,8 @@ extern "C" {
 #define STORJ_LOW_SPEED_LIMIT 30720L
 #define STORJ_LOW_SPEED_TIME 20L
 #define STORJ_HTTP_TIMEOUT 60L
+#define STORJ_HTTP_MAX_CONNECTIONS 32
+#define STORJ_HTTP_SEND_BUFFER_SIZE 1048576
 
 typedef struct {
   uint8_t *encryption_ctr;
@@ -150,6 +152,8 @@ typedef struct {
  */
 typedef struct storj_encrypt_options {
     const char *mnemonic;
+    /* seed and bucket keys, created by storj_init_env */
+    struct storj_key_cache *key_cache;
 } storj_encrypt_options_t;
 
 
@@ -165,6 +169,15 @@ typedef struct storj_http_options {
     uint64_t low_speed_limit;
     uint64_t low_speed_time;
     uint64_t timeout;
+    /* max idle handles kept for reuse, zero for the default */
+    uint32_t max_connections;
+    /* bytes read ahead and encrypted for each shard upload, zero for the
+     * default */
+    uint32_t send_buffer_size;
+    /* shared connection pool, created by storj_init_env */
+    struct storj_http_pool *pool;
+    /* metrics of the environment, set by storj_init_env */
+    const struct storj_metrics *metrics;
 } storj_http_options_t;
 
 /** @brief A function signature for logging
@@ -195,6 +208,66 @@ typedef struct storj_log_levels {
     storj_logger_format_fn error;
 } storj_log_levels_t;
 
+/** @brief The CPU bound phases of transfers reported to the metrics
+ */
+typedef enum {
+    STORJ_PHASE_CREATE_ENCRYPTED_FILE = 0,
+    STORJ_PHASE_CREATE_PARITY_SHARDS = 1,
+    STORJ_PHASE_ENCODE_SINGLE_PASS = 2,
+    STORJ_PHASE_PREPARE_FRAME = 3,
+    STORJ_PHASE_RECOVER_SHARDS = 4
+} storj_phase_t;
+
+/** @brief A bridge request, times are in milliseconds
+ */
+typedef struct {
+    const char *method;
+    /* the path with the ids replaced by ":id" */
+    const char *path;
+    int status_code;
+    /* the curl error of the request, zero if a response was received */
+    int error_status;
+    uint64_t start;
+    uint64_t duration;
+} storj_request_event_t;
+
+/** @brief A transfer of a shard with a farmer, times are in milliseconds
+ */
+typedef struct {
+    bool upload;
+    const char *farmer_id;
+    const char *shard_hash;
+    uint64_t bytes;
+    uint64_t start;
+    uint64_t duration;
+    /* earlier failed transfers of the same shard */
+    uint32_t retries;
+    int error_status;
+} storj_shard_event_t;
+
+/** @brief A CPU bound phase of a transfer, times are in milliseconds
+ */
+typedef struct {
+    storj_phase_t phase;
+    uint64_t bytes;
+    uint64_t start;
+    uint64_t duration;
+    int error_status;
+} storj_phase_event_t;
+
+/** @brief Functions receiving the timing events of an environment
+ *
+ * Any of the functions may be NULL, and nothing is measured while all of
+ * them are. Request events are called from worker threads, the others
+ * from the loop thread, so the functions need to be thread safe.
+ */
+typedef struct storj_metrics {
+    void (*request)(const storj_request_event_t *event, void *handle);
+    void (*shard)(const storj_shard_event_t *event, void *handle);
+    void (*phase)(const storj_phase_event_t *event, void *handle);
+    void *handle;
+} storj_metrics_t;
+
 /** @brief A structure for a Storj user environment.
  *
  * This is the highest level structure and holds many commonly used options
@@ -208,8 +281,34 @@ typedef struct storj_env {
     const char *tmp_path;
     uv_loop_t *loop;
     storj_log_levels_t *log;
+    /* shard transfers multiplexed on the loop */
+    struct storj_http_multi *http_multi;
+    /* budget of shard transfers shared by all files */
+    struct storj_transfer_scheduler *scheduler;
+    /* exchange reports waiting to be sent */
+    struct storj_report_queue *reports;
+    /* observed performance of the farmers */
+    struct storj_farmer_table *farmers;
+    /* erasure codecs shared by the transfers */
+    struct storj_codec_cache *codecs;
+    /* shards kept on disk for repeat downloads, NULL if disabled */
+    struct storj_shard_cache *shard_cache;
+    /* receivers of timing events, all NULL to disable */
+    storj_metrics_t metrics;
 } storj_env_t;
 
+/** @brief Limits shared by all uploads and downloads of an environment
+ *
+ * Any number of files may be transferred at once, and the shards in
+ * flight are interleaved fairly between them within these limits.
+ */
+typedef struct {
+    /* shards in flight, zero for no limit */
+    uint32_t max_shards;
+    /* bytes of the shards in flight, zero for no limit */
+    uint64_t max_bytes;
+} storj_transfer_limits_t;
+
 /** @brief A structure for queueing json request work
  */
 typedef struct {
@@ -327,9 +426,17 @@ typedef struct {
     struct json_object *response;
     storj_file_meta_t *files;
     uint32_t total_files;
+    /* zero when all files are listed at once */
+    uint32_t page_size;
+    /* the marker the page was requested with, or NULL */
+    char *start_marker;
+    /* start marker of the next page, or NULL after the last page */
+    char *next_marker;
     int error_code;
     int status_code;
     void *handle;
+    /* called once the metadata of the files is filled */
+    uv_after_work_cb cb;
 } list_files_request_t;
 
 /** @brief A structure for queueing get file info request work
@@ -398,10 +505,55 @@ typedef void (*storj_progress_cb)(double progress,
                                   uint64_t total_bytes,
                                   void *handle);
 
+/** @brief The rate of a transfer, kept from the bytes of its progress
+ * updates, which can be read from the state in the progress callback.
+ */
+typedef struct storj_progress_meter {
+    /* milliseconds between progress callbacks, zero for every update */
+    uint32_t interval;
+    uint64_t last_report;
+    uint64_t sample_time;
+    uint64_t sample_bytes;
+    /* moving average of bytes per second */
+    double rate;
+    /* seconds until the transfer completes at the rate, zero if unknown */
+    uint64_t eta;
+} storj_progress_meter_t;
+
+/** @brief The limit of shards in flight of a transfer, which may be tuned
+ * from the goodput and failures of its shard transfers.
+ *
+ * The limit is raised by one shard after each window in which the goodput
+ * did not drop, and halved after a window with failed or timed out shards.
+ */
+typedef struct storj_concurrency {
+    bool adaptive;
+    uint32_t min;
+    uint32_t max;
+    uint32_t limit;
+    uint64_t window_start;
+    uint64_t window_bytes;
+    uint32_t window_successes;
+    uint32_t window_failures;
+    /* bytes per second of the last window, zero if unknown */
+    double goodput;
+    /* when the limit was last lowered, zero if never */
+    uint64_t decreased;
+} storj_concurrency_t;
+
 /** @brief A function signature for a download complete callback
  */
 typedef void (*storj_finished_download_cb)(int status, FILE *fd, void *handle);
 
+/** @brief A function signature for writing the data of a streamed
+ * download, called from a worker thread with each shard in order.
+ *
+ * Returns non-zero to fail the download.
+ */
+typedef int (*storj_download_write_cb)(const uint8_t *data,
+                                       size_t length,
+                                       void *handle);
+
 /** @brief A function signature for an upload complete callback
  */
 typedef void (*storj_finished_upload_cb)(int error_status, storj_file_meta_t *file, void *handle);
@@ -431,8 +583,30 @@ typedef struct {
     int farmer_port;
     storj_exchange_report_t *report;
     uv_work_t *work;
+    /* the shard in memory until it is written by a streamed download */
+    uint8_t *shard_data;
+    /* the shard was verified from a farmer, and is added to the shard
+     * cache when written by a streamed download */
+    bool cache_fill;
 } storj_pointer_t;
 
+/** @brief The inputs of a shard size policy
+ */
+typedef struct {
+    uint64_t file_size;
+    /* shards that can be pushed at once */
+    uint32_t parallelism;
+    bool rs;
+} storj_shard_size_params_t;
+
+/** @brief A function signature for choosing the shard size of an upload,
+ * called from a worker thread.
+ *
+ * Returns a power of two of at least 2 MiB and at most 4 GiB, or zero to
+ * fail the upload.
+ */
+typedef uint64_t (*storj_shard_size_policy)(const storj_shard_size_params_t *params);
+
 /** @brief A structure for file upload options
  */
 typedef struct {
@@ -440,12 +614,67 @@ typedef struct {
     int push_frame_limit;
     int push_shard_limit;
     bool rs;
+    /* Encrypt, hash and encode parity with one read of the file, without
+     * writing a temporary encrypted copy (only with rs) */
+    bool single_pass;
+    /* Keep a journal of pushed shards in the tmp path, and skip them when
+     * the same file is uploaded again after a failure or cancel */
+    bool resume;
     const char *index;
     const char *bucket_id;
     const char *file_name;
     FILE *fd;
+    /* Milliseconds between progress callbacks, zero for every update */
+    uint32_t progress_interval;
+    /* Tune the shards pushed at once from push_shard_limit, within the
+     * min and max shards, zero for the defaults */
+    bool adaptive_concurrency;
+    uint32_t min_concurrency;
+    uint32_t max_concurrency;
+    /* Choose the shard size, NULL for storj_shard_size_default */
+    storj_shard_size_policy shard_size_policy;
 } storj_upload_opts_t;
 
+/** @brief A structure for file download options
+ */
+typedef struct {
+    const char *bucket_id;
+    const char *file_id;
+    FILE *destination;
+    /* Keep a journal of downloaded shards in the tmp path, and reuse the
+     * shards already in the destination when the download is retried. The
+     * destination must be opened without truncating it (e.g. "r+") */
+    bool resume;
+    /* Pages of pointers requested at once ahead of the shards being
+     * downloaded, zero for the default */
+    uint32_t pointer_window;
+    /* With erasure coding, download parity shards when data shards lag
+     * behind, and stop the slowest shards once the file can be recovered */
+    bool hedge;
+    /* Deliver the file in order while it is downloaded, to the write
+     * callback or else the destination, which may be a pipe. Only a window
+     * of shards is kept in memory, unless a shard is lost and has to be
+     * decoded from all of the others. Resume is not supported */
+    bool stream;
+    storj_download_write_cb write_cb;
+    /* Shards kept in memory ahead of the one being written, zero for the
+     * default */
+    uint32_t stream_window;
+    /* Stream only the bytes of the file from range_offset, and at most
+     * range_length of them or to the end of the file when zero. Only the
+     * shards covering the range are downloaded */
+    bool range;
+    uint64_t range_offset;
+    uint64_t range_length;
+    /* Milliseconds between progress callbacks, zero for every update */
+    uint32_t progress_interval;
+    /* Tune the shards downloaded at once, within the min and max shards,
+     * zero for the defaults */
+    bool adaptive_concurrency;
+    uint32_t min_concurrency;
+    uint32_t max_concurrency;
+} storj_download_opts_t;
+
 /** @brief A structure that keeps state between multiple worker threads,
  * and for referencing a download to apply actions to an in-progress download.
  *
@@ -457,7 +686,10 @@ typedef struct {
  * reference to it, so that once the work is complete the state can be updated.
  */
 typedef struct {
+    /* bytes of the shards counted for the progress, kept as they change */
     uint64_t total_bytes;
+    uint64_t downloaded_bytes;
+    storj_progress_meter_t progress_meter;
     storj_file_meta_t *info;
     bool requesting_info;
     uint32_t info_fail_count;
@@ -467,13 +699,17 @@ typedef struct {
     FILE *destination;
     storj_progress_cb progress_cb;
     storj_finished_download_cb finished_cb;
+    struct storj_transfer_slot *transfer_slot;
     bool finished;
     bool canceled;
     uint64_t shard_size;
     uint32_t total_shards;
     int download_max_concurrency;
+    storj_concurrency_t concurrency;
     uint32_t completed_shards;
     uint32_t resolving_shards;
+    /* shards being copied to the shard cache */
+    uint32_t caching_shards;
     storj_pointer_t *pointers;
     char *excluded_farmer_ids;
     uint32_t total_pointers;
@@ -483,12 +719,35 @@ typedef struct {
     bool truncated;
     bool pointers_completed;
     uint32_t pointer_fail_count;
-    bool requesting_pointers;
+    /* pages of pointers requested ahead of those received, in order */
+    struct storj_pointer_page *pointer_pages;
+    uint32_t pointer_window;
+    uint32_t pointer_page_generation;
+    uint32_t replacing_pointers;
+    bool hedge;
+    uv_timer_t *hedge_timer;
+    bool stream;
+    storj_download_write_cb write_cb;
+    uint32_t stream_window;
+    /* the next data shard to be written by a streamed download */
+    uint32_t stream_position;
+    bool stream_writing;
+    bool stream_recovering;
+    /* the decoding of the lost shards in the window of a stream */
+    struct storj_file_recover *stream_recover;
+    bool range;
+    uint64_t range_offset;
+    uint64_t range_length;
     int error_status;
     bool writing;
     uint8_t *decrypt_key;
     uint8_t *decrypt_ctr;
     const char *hmac;
+    bool resume;
+    bool journal_loaded;
+    char *journal_path;
+    struct download_journal_entry *journal_entries;
+    uint32_t total_journal_entries;
     uint32_t pending_work_count;
     storj_log_levels_t *log;
     void *handle;
@@ -543,8 +802,10 @@ typedef struct {
     uint32_t total_data_shards;
     uint32_t total_parity_shards;
     uint64_t shard_size;
+    /* bytes of the prepared shards, kept as they change */
     uint64_t total_bytes;
     uint64_t uploaded_bytes;
+    storj_progress_meter_t progress_meter;
     char *exclude;
     char *frame_id;
     char *hmac_id;
@@ -559,6 +820,16 @@ typedef struct {
     char *encrypted_file_path;
     FILE *encrypted_file;
     bool creating_encrypted_file;
+    bool single_pass;
+    bool resume;
+    char *journal_path;
+    /* all parity shards were pushed before the upload was resumed, the
+     * remaining data shards are encrypted as they are read */
+    bool parity_completed;
+    /* files of one small shard are encrypted in memory, and prepared while
+     * the bridge requests are made */
+    bool small_object;
+    uint8_t *shard_data;
 
     bool requesting_frame;
     bool completed_upload;
@@ -568,10 +839,14 @@ typedef struct {
     bool canceled;
     bool bucket_verified;
     bool file_verified;
+    bool verifying_bucket;
+    bool verifying_file;
 
     bool progress_finished;
 
     int push_shard_limit;
+    storj_concurrency_t concurrency;
+    storj_shard_size_policy shard_size_policy;
     int push_frame_limit;
     int prepare_frame_limit;
 
@@ -583,6 +858,7 @@ typedef struct {
 
     storj_progress_cb progress_cb;
     storj_finished_upload_cb finished_cb;
+    struct storj_transfer_slot *transfer_slot;
     int error_status;
     storj_log_levels_t *log;
     void *handle;
@@ -615,12 +891,94 @@ STORJ_API storj_env_t *storj_init_env(storj_bridge_options_t *options,
  * This will free all memory for the Storj environment and zero out any memory
  * with sensitive information, such as passwords and encryption keys.
  *
- * The event loop must be closed before this method should be used.
+ * No transfers may still be running on the event loop. The handles of the
+ * environment are closed on the loop, so the loop has to be run once more,
+ * e.g. with uv_run(loop, UV_RUN_DEFAULT), to release them before it is
+ * closed.
  *
  * @param [in] env
  */
 STORJ_API int storj_destroy_env(storj_env_t *env);
 
+/**
+ * @brief Set the limits shared by all transfers of an environment
+ *
+ * @param[in] env The storj environment struct
+ * @param[in] limits The limits for shards in flight
+ * @return A non-zero error value on failure and 0 on success.
+ */
+STORJ_API int storj_env_set_transfer_limits(storj_env_t *env,
+                                            storj_transfer_limits_t *limits);
+
+/**
+ * @brief Keep the observed performance of farmers in a file
+ *
+ * Farmers that have recently failed or been slow are excluded from new
+ * uploads and from pointer replacements of new downloads. The table is
+ * loaded from the file, and saved to it as transfers finish.
+ *
+ * @param[in] env The storj environment struct
+ * @param[in] path The path of the file, which is created if missing
+ * @return A non-zero error value on failure and 0 on success.
+ */
+STORJ_API int storj_env_set_farmer_cache(storj_env_t *env, const char *path);
+
+/**
+ * @brief Keep the shards of downloaded files on disk for repeat downloads
+ *
+ * Shards are named by their hash in the directory, and read from it
+ * instead of the farmers when a file is downloaded again. The least
+ * recently used shards are removed when the cache is full.
+ *
+ * @param[in] env The storj environment struct
+ * @param[in] path The directory of the cache, or NULL for a directory in
+ * the tmp path
+ * @param[in] max_bytes The most bytes of shards kept
+ * @return A non-zero error value on failure and 0 on success.
+ *
+ * Should be set before any downloads of the environment are started.
+ */
+STORJ_API int storj_env_set_shard_cache(storj_env_t *env,
+                                        const char *path,
+                                        uint64_t max_bytes);
+
+/**
+ * @brief Receive the timing events of bridge requests, shard transfers
+ * and CPU bound phases of an environment
+ *
+ * Should be set before any transfers of the environment are started.
+ *
+ * @param[in] env The storj environment struct
+ * @param[in] metrics The functions to call, copied into the environment
+ * @return A non-zero error value on failure and 0 on success.
+ */
+STORJ_API int storj_env_set_metrics(storj_env_t *env,
+                                    storj_metrics_t *metrics);
+
+/**
+ * @brief Choose the shard size from the file size alone
+ *
+ * The shard size is a few powers of two below the file size, so that
+ * files have at most 16 to 32 data shards.
+ *
+ * @param[in] params The upload to choose a shard size for
+ * @return The shard size or zero for an unsupported file size
+ */
+STORJ_API uint64_t storj_shard_size_default(const storj_shard_size_params_t *params);
+
+/**
+ * @brief Choose the shard size that is expected to upload fastest
+ *
+ * Each shard costs the bridge round trips of its frame, pointer and
+ * report besides sending its bytes, and only as many shards as the
+ * parallelism are sent at once. With erasure coding, the padding and
+ * parity of the last shards and the stripes encoded are weighed as well.
+ *
+ * @param[in] params The upload to choose a shard size for
+ * @return The shard size or zero for an unsupported file size
+ */
+STORJ_API uint64_t storj_shard_size_throughput(const storj_shard_size_params_t *params);
+
 /**
  * @brief Will encrypt and write options to disk
  *
@@ -851,6 +1209,31 @@ STORJ_API int storj_bridge_list_files(storj_env_t *env,
                                       void *handle,
                                       uv_after_work_cb cb);
 
+/**
+ * @brief Get one page of the files in a bucket.
+ *
+ * Files are listed in order of creation. The request in the callback has
+ * the next_marker to pass for the following page, which is NULL once the
+ * last page has been listed. The marker holds the date the next page is
+ * listed after and the number of files already listed since, so files
+ * created at the same time across pages are listed exactly once as long
+ * as the bridge lists them in the same order.
+ *
+ * @param[in] env The storj environment struct
+ * @param[in] id The bucket id
+ * @param[in] start_marker The next_marker of the previous page, or NULL
+ * @param[in] page_size The max number of files in the page
+ * @param[in] handle A pointer that will be available in the callback
+ * @param[in] cb A function called with response when complete
+ * @return A non-zero error value on failure and 0 on success.
+ */
+STORJ_API int storj_bridge_list_files_page(storj_env_t *env,
+                                           const char *id,
+                                           const char *start_marker,
+                                           uint32_t page_size,
+                                           void *handle,
+                                           uv_after_work_cb cb);
+
 /**
  * @brief Will free all structs for list files request
  *
@@ -1074,6 +1457,49 @@ STORJ_API storj_download_state_t *storj_bridge_resolve_file(storj_env_t *env,
                                                             storj_progress_cb progress_cb,
                                                             storj_finished_download_cb finished_cb);
 
+/**
+ * @brief Download a file with options
+ *
+ * @param[in] env A pointer to environment
+ * @param[in] opts The options for the download
+ * @param[in] handle A pointer that will be available in the callback
+ * @param[in] progress_cb Function called with progress updates
+ * @param[in] finished_cb Function called when download finished
+ * @return A null value on error, otherwise a download state pointer.
+ */
+STORJ_API storj_download_state_t *storj_bridge_resolve_file_opts(storj_env_t *env,
+                                                                 storj_download_opts_t *opts,
+                                                                 void *handle,
+                                                                 storj_progress_cb progress_cb,
+                                                                 storj_finished_download_cb finished_cb);
+
+/**
+ * @brief Download a range of bytes of a file
+ *
+ * The bytes are written in order to the destination, which may be a pipe,
+ * and only the shards covering the range are downloaded.
+ *
+ * @param[in] env A pointer to environment
+ * @param[in] bucket_id Character array of bucket id
+ * @param[in] file_id Character array of file id
+ * @param[in] destination File descriptor of the destination
+ * @param[in] offset The position of the first byte of the range
+ * @param[in] length The bytes of the range, zero for the rest of the file
+ * @param[in] handle A pointer that will be available in the callback
+ * @param[in] progress_cb Function called with progress updates
+ * @param[in] finished_cb Function called when download finished
+ * @return A null value on error, otherwise a download state pointer.
+ */
+STORJ_API storj_download_state_t *storj_bridge_resolve_file_range(storj_env_t *env,
+                                                                  const char *bucket_id,
+                                                                  const char *file_id,
+                                                                  FILE *destination,
+                                                                  uint64_t offset,
+                                                                  uint64_t length,
+                                                                  void *handle,
+                                                                  storj_progress_cb progress_cb,
+                                                                  storj_finished_download_cb finished_cb);
+
 /**
  * @brief Register a user
  *
@@ -93,13 +93,14 @@ static uv_work_t *shard_meta_work_new(int index, storj_upload_state_t *state)
     }
     req->upload_state = state;
     req->log = state->log;
+    req->shard_data = NULL;
 
     // make sure we switch between parity and data shards files.
     // When using Reed solomon must also read from encrypted file
     // rather than the original file for the data
     if (index + 1 > state->total_data_shards) {
         req->shard_file = state->parity_file;
-    } else if (state->rs) {
+    } else if (reads_encrypted_copy(state)) {
         req->shard_file = state->encrypted_file;
     } else {
         req->shard_file = state->original_file;
@@ -238,12 +239,25 @@ static void cleanup_state(storj_upload_state_t *state)
         return;
     }
 
+    if (farmer_table_save(state->env->farmers)) {
+        state->log->warn(state->env->log_options, state->handle,
+                         "Unable to save farmer table");
+    }
+
     if (state->original_file) {
         fclose(state->original_file);
     }
 
     state->final_callback_called = true;
 
+    if (state->journal_path) {
+        // The journal is kept to resume a failed or canceled upload
+        if (state->completed_upload) {
+            unlink(state->journal_path);
+        }
+        free(state->journal_path);
+    }
+
     if (state->frame_id) {
         free(state->frame_id);
     }
@@ -281,6 +295,10 @@ static void cleanup_state(storj_upload_state_t *state)
         fclose(state->encrypted_file);
     }
 
+    if (state->shard_data) {
+        free(state->shard_data);
+    }
+
     if (state->encrypted_file_path) {
         unlink(state->encrypted_file_path);
         free(state->encrypted_file_path);
@@ -305,6 +323,8 @@ static void cleanup_state(storj_upload_state_t *state)
         free(state->shard);
     }
 
+    transfer_slot_free(state->transfer_slot);
+
     state->finished_cb(state->error_status, state->info, state->handle);
 
     free(state);
@@ -576,13 +596,35 @@ static void free_push_shard_work(uv_handle_t *progress_handle)
     }
 }
 
-static void after_push_shard(uv_work_t *work, int status)
+static void after_push_shard(http_transfer_t *transfer)
 {
+    uv_work_t *work = transfer->data;
     push_shard_request_t *req = work->data;
     storj_upload_state_t *state = req->upload_state;
     uv_handle_t *progress_handle = (uv_handle_t *) &req->progress_handle;
     shard_tracker_t *shard = &state->shard[req->shard_meta_index];
 
+    req->end = get_time_milliseconds();
+
+    if (transfer->io_code != 0) {
+        req->log->error(state->env->log_options, state->handle,
+                        "Put shard read error: %i", transfer->io_code);
+    }
+
+    if (transfer->error_status) {
+        req->error_status = transfer->error_status;
+        req->log->error(state->env->log_options, state->handle,
+                        "Put shard request error code: %i",
+                        transfer->error_status);
+    }
+
+    req->status_code = transfer->status_code;
+
+    if (req->encryption_ctx) {
+        free_encryption_ctx(req->encryption_ctx);
+        req->encryption_ctx = NULL;
+    }
+
     // free the upload progress
     free(progress_handle->data);
 
@@ -590,23 +632,26 @@ static void after_push_shard(uv_work_t *work, int status)
     progress_handle->data = work;
 
     state->pending_work_count -= 1;
-
-    if (status == UV_ECANCELED) {
-        shard->push_shard_request_count = 0;
-        shard->progress = AWAITING_PUSH_FRAME;
-        shard->report->send_status = STORJ_REPORT_NOT_PREPARED;
-        goto clean_variables;
-    }
+    transfer_slot_release(state->transfer_slot, shard->meta->size);
 
     // Update times on exchange report
     shard->report->start = req->start;
     shard->report->end = req->end;
 
-    // Check if we got a 200 status and token
-    if (!req->error_status &&
+    bool pushed = !req->error_status &&
         (req->status_code == 200 ||
          req->status_code == 201 ||
-         req->status_code == 304)) {
+         req->status_code == 304);
+
+    metrics_shard(&state->env->metrics, true,
+                  shard->pointer->farmer_node_id, shard->meta->hash,
+                  pushed ? shard->meta->size : 0, req->start, req->end,
+                  shard->push_shard_request_count,
+                  pushed ? 0 : (req->error_status ?
+                                req->error_status : STORJ_FARMER_REQUEST_ERROR));
+
+    // Check if we got a 200 status and token
+    if (pushed) {
 
         req->log->info(state->env->log_options, state->handle,
                        "Successfully transferred shard index %d",
@@ -617,7 +662,17 @@ static void after_push_shard(uv_work_t *work, int status)
         shard->push_shard_request_count = 0;
 
         // Update the uploaded size outside of the progress async handle
-        shard->uploaded_size = shard->meta->size;
+        set_uploaded_size(state, shard, shard->meta->size);
+
+        farmer_table_record(state->env->farmers,
+                            shard->pointer->farmer_node_id,
+                            shard->meta->size, req->end - req->start, true);
+        concurrency_record(&state->concurrency, shard->meta->size,
+                           req->start, true);
+
+        if (state->resume) {
+            append_upload_journal(state, req->shard_meta_index);
+        }
 
         // Update the exchange report with success
         shard->report->code = STORJ_REPORT_SUCCESS;
@@ -626,6 +681,10 @@ static void after_push_shard(uv_work_t *work, int status)
 
     } else if (!state->canceled){
 
+        farmer_table_record(state->env->farmers,
+                            shard->pointer->farmer_node_id, 0, 0, false);
+        concurrency_record(&state->concurrency, 0, req->start, false);
+
         // Update the exchange report with failure
         shard->report->code = STORJ_REPORT_FAILURE;
         shard->report->message = STORJ_REPORT_UPLOAD_ERROR;
@@ -670,7 +729,7 @@ clean_variables:
     uv_close(progress_handle, free_push_shard_work);
 }
 
-static void push_shard(uv_work_t *work)
+static int push_shard(uv_work_t *work)
 {
     push_shard_request_t *req = work->data;
     storj_upload_state_t *state = req->upload_state;
@@ -681,61 +740,87 @@ static void push_shard(uv_work_t *work)
                    req->shard_meta_index,
                    state->shard[req->shard_meta_index].push_shard_request_count);
 
-    int status_code = 0;
-    int read_code = 0;
-
     req->start = get_time_milliseconds();
 
     uint64_t file_position = req->shard_index * state->shard_size;
 
-    storj_encryption_ctx_t *encryption_ctx = NULL;
-    if (!state->rs) {
-        // Initialize the encryption context
-        encryption_ctx = prepare_encryption_ctx(state->encryption_ctr,
-                                                                        state->encryption_key);
-        if (!encryption_ctx) {
-            state->error_status = STORJ_MEMORY_ERROR;
-            goto clean_variables;
+    // Data shards are encrypted while sending unless there is an
+    // encrypted copy of the file
+    bool encrypt = !reads_encrypted_copy(state) &&
+        req->shard_meta_index < state->total_data_shards;
+
+    http_transfer_t *transfer = NULL;
+
+    if (state->shard_data) {
+        // Small files have been encrypted in memory with the frame
+        transfer = put_shard_data_transfer_new(req->http_options,
+                                               shard->pointer->farmer_node_id,
+                                               "http",
+                                               shard->pointer->farmer_address,
+                                               atoi(shard->pointer->farmer_port),
+                                               shard->meta->hash,
+                                               shard->meta->size,
+                                               state->shard_data,
+                                               shard->pointer->token,
+                                               &req->progress_handle,
+                                               req->canceled);
+    } else {
+        if (encrypt) {
+            // Initialize the encryption context
+            req->encryption_ctx = prepare_encryption_ctx(state->encryption_ctr,
+                                                         state->encryption_key);
+            if (!req->encryption_ctx) {
+                return STORJ_MEMORY_ERROR;
+            }
+            // Increment the iv to proper placement because we may be reading from the middle of the file
+            increment_ctr_aes_iv(req->encryption_ctx->encryption_ctr,
+                                 req->shard_meta_index * state->shard_size);
         }
-        // Increment the iv to proper placement because we may be reading from the middle of the file
-        increment_ctr_aes_iv(encryption_ctx->encryption_ctr, req->shard_meta_index * state->shard_size);
+
+        transfer = put_shard_transfer_new(req->http_options,
+                                          shard->pointer->farmer_node_id,
+                                          "http",
+                                          shard->pointer->farmer_address,
+                                          atoi(shard->pointer->farmer_port),
+                                          shard->meta->hash,
+                                          shard->meta->size,
+                                          req->shard_file,
+                                          file_position,
+                                          req->encryption_ctx,
+                                          shard->pointer->token,
+                                          &req->progress_handle,
+                                          req->canceled);
     }
 
-    int req_status = put_shard(req->http_options,
-                               shard->pointer->farmer_node_id,
-                               "http",
-                               shard->pointer->farmer_address,
-                               atoi(shard->pointer->farmer_port),
-                               shard->meta->hash,
-                               shard->meta->size,
-                               req->shard_file,
-                               file_position,
-                               encryption_ctx,
-                               shard->pointer->token,
-                               &status_code,
-                               &read_code,
-                               &req->progress_handle,
-                               req->canceled);
-
-    if (read_code != 0) {
-        req->log->error(state->env->log_options, state->handle,
-                        "Put shard read error: %i", read_code);
+    if (!transfer) {
+        return STORJ_MEMORY_ERROR;
     }
 
-    if (req_status) {
-        req->error_status = req_status;
-        req->log->error(state->env->log_options, state->handle,
-                        "Put shard request error code: %i", req_status);
+    if (http_multi_add(state->env->http_multi, transfer,
+                       after_push_shard, work)) {
+        http_transfer_free(transfer);
+        return STORJ_QUEUE_ERROR;
     }
 
-    req->end = get_time_milliseconds();
+    return 0;
+}
 
-    req->status_code = status_code;
+static void set_uploaded_size(storj_upload_state_t *state,
+                              shard_tracker_t *shard,
+                              uint64_t uploaded_size)
+{
+    state->uploaded_bytes -= shard->uploaded_size;
+    state->uploaded_bytes += uploaded_size;
+    shard->uploaded_size = uploaded_size;
+}
 
-clean_variables:
-    if (encryption_ctx) {
-        free_encryption_ctx(encryption_ctx);
-    }
+static void set_shard_size(storj_upload_state_t *state,
+                           shard_tracker_t *shard,
+                           uint64_t size)
+{
+    state->total_bytes -= shard->meta->size;
+    state->total_bytes += size;
+    shard->meta->size = size;
 }
 
 static void progress_put_shard(uv_async_t* async)
@@ -745,18 +830,11 @@ static void progress_put_shard(uv_async_t* async)
 
     storj_upload_state_t *state = progress->state;
 
-    state->shard[progress->pointer_index].uploaded_size = progress->bytes;
-
-    uint64_t uploaded_bytes = 0;
-    uint64_t total_bytes = 0;
-
-    for (int i = 0; i < state->total_shards; i++) {
-
-        shard_tracker_t *shard = &state->shard[i];
+    set_uploaded_size(state, &state->shard[progress->pointer_index],
+                      progress->bytes);
 
-        uploaded_bytes += shard->uploaded_size;
-        total_bytes += shard->meta->size;
-    }
+    uint64_t uploaded_bytes = state->uploaded_bytes;
+    uint64_t total_bytes = state->total_bytes;
 
     double total_progress = (double)uploaded_bytes / (double)total_bytes;
 
@@ -764,6 +842,11 @@ static void progress_put_shard(uv_async_t* async)
         return;
     }
 
+    if (!progress_meter_update(&state->progress_meter,
+                               uploaded_bytes, total_bytes)) {
+        return;
+    }
+
     if (uploaded_bytes == total_bytes) {
         state->progress_finished = true;
     }
@@ -778,16 +861,23 @@ static void progress_put_shard(uv_async_t* async)
 
 static void queue_push_shard(storj_upload_state_t *state, int index)
 {
+    // wait for the budget shared with other files
+    if (!transfer_slot_acquire(state->transfer_slot,
+                               state->shard[index].meta->size)) {
+        return;
+    }
+
     uv_work_t *work = uv_work_new();
     if (!work) {
         state->error_status = STORJ_MEMORY_ERROR;
-        return;
+        goto release_slot;
     }
 
     push_shard_request_t *req = malloc(sizeof(push_shard_request_t));
     if (!req) {
+        free(work);
         state->error_status = STORJ_MEMORY_ERROR;
-        return;
+        goto release_slot;
     }
 
     req->http_options = state->env->http_options;
@@ -804,7 +894,7 @@ static void queue_push_shard(storj_upload_state_t *state, int index)
     // rather than the original file for the data
     if (index + 1 > state->total_data_shards) {
         req->shard_file = state->parity_file;
-    } else if (state->rs) {
+    } else if (reads_encrypted_copy(state)) {
         req->shard_file = state->encrypted_file;
     } else {
         req->shard_file = state->original_file;
@@ -814,6 +904,7 @@ static void queue_push_shard(storj_upload_state_t *state, int index)
     req->shard_meta_index = index;
 
     req->status_code = 0;
+    req->encryption_ctx = NULL;
 
     req->canceled = &state->canceled;
 
@@ -822,8 +913,10 @@ static void queue_push_shard(storj_upload_state_t *state, int index)
         malloc(sizeof(shard_upload_progress_t));
 
     if (!progress) {
+        free(req);
+        free(work);
         state->error_status = STORJ_MEMORY_ERROR;
-        return;
+        goto release_slot;
     }
 
     progress->pointer_index = index;
@@ -837,13 +930,23 @@ static void queue_push_shard(storj_upload_state_t *state, int index)
 
     work->data = req;
 
+    // start the upload on the event loop
     state->pending_work_count += 1;
-    int status = uv_queue_work(state->env->loop, (uv_work_t*) work,
-                               push_shard, after_push_shard);
+    int status = push_shard(work);
 
     if (status) {
-        state->error_status = STORJ_QUEUE_ERROR;
-        return;
+        // undo the push, the work is freed once the progress is closed
+        state->pending_work_count -= 1;
+        if (req->encryption_ctx) {
+            free_encryption_ctx(req->encryption_ctx);
+            req->encryption_ctx = NULL;
+        }
+        free(progress);
+        req->progress_handle.data = work;
+        uv_close((uv_handle_t *)&req->progress_handle, free_push_shard_work);
+
+        state->error_status = status;
+        goto release_slot;
     }
 
     state->shard[index].progress = PUSHING_SHARD;
@@ -873,6 +976,13 @@ static void queue_push_shard(storj_upload_state_t *state, int index)
     report->send_count = 0;
 
     state->shard[index].work = work;
+
+    return;
+
+release_slot:
+    // the budget is given back to the other transfers
+    transfer_slot_release(state->transfer_slot,
+                          state->shard[index].meta->size);
 }
 
 static void after_push_frame(uv_work_t *work, int status)
@@ -1261,86 +1371,108 @@ static void queue_push_frame(storj_upload_state_t *state, int index)
     state->shard[index].progress = PUSHING_FRAME;
 }
 
-static void after_prepare_frame(uv_work_t *work, int status)
+/*
+ * Copy the hash, challenges, merkle tree leaves and size of a prepared
+ * shard into the upload state
+ */
+static int set_shard_meta(storj_upload_state_t *state, int index,
+                          shard_meta_t *shard_meta)
 {
-    frame_builder_t *req = work->data;
-    shard_meta_t *shard_meta = req->shard_meta;
-    storj_upload_state_t *state = req->upload_state;
-
-    state->pending_work_count -= 1;
-
-    if (status == UV_ECANCELED) {
-        state->shard[shard_meta->index].progress = AWAITING_PREPARE_FRAME;
-        goto clean_variables;
-    }
-
-    if (req->error_status) {
-        state->error_status = req->error_status;
-        goto clean_variables;
-    }
-
-    /* set the shard_meta to a struct array in the state for later use. */
-
     // Add Hash
-    state->shard[req->shard_meta_index].meta->hash =
+    state->shard[index].meta->hash =
         calloc(RIPEMD160_DIGEST_SIZE * 2 + 1, sizeof(char));
 
-    if (!state->shard[req->shard_meta_index].meta->hash) {
-        state->error_status = STORJ_MEMORY_ERROR;
-        goto clean_variables;
+    if (!state->shard[index].meta->hash) {
+        return 1;
     }
 
-    memcpy(state->shard[req->shard_meta_index].meta->hash,
+    memcpy(state->shard[index].meta->hash,
            shard_meta->hash,
            RIPEMD160_DIGEST_SIZE * 2);
 
-    req->log->info(state->env->log_options, state->handle,
-                  "Shard (%d) hash: %s", req->shard_meta_index,
-                  state->shard[req->shard_meta_index].meta->hash);
+    state->log->info(state->env->log_options, state->handle,
+                  "Shard (%d) hash: %s", index,
+                  state->shard[index].meta->hash);
 
     // Add challenges_as_str
     state->log->debug(state->env->log_options, state->handle,
                       "Challenges for shard index %d",
-                      req->shard_meta_index);
+                      index);
 
     for (int i = 0; i < STORJ_SHARD_CHALLENGES; i++ ) {
-        memcpy(state->shard[req->shard_meta_index].meta->challenges_as_str[i],
+        memcpy(state->shard[index].meta->challenges_as_str[i],
                shard_meta->challenges_as_str[i],
                64);
 
         state->log->debug(state->env->log_options, state->handle,
                           "Shard %d Challenge [%d]: %s",
-                        req->shard_meta_index,
+                        index,
                           i,
-                          state->shard[req->shard_meta_index].meta->challenges_as_str[i]);
+                          state->shard[index].meta->challenges_as_str[i]);
     }
 
     // Add Merkle Tree leaves.
     state->log->debug(state->env->log_options, state->handle,
                       "Tree for shard index %d",
-                      req->shard_meta_index);
+                      index);
 
     for (int i = 0; i < STORJ_SHARD_CHALLENGES; i++ ) {
-        memcpy(state->shard[req->shard_meta_index].meta->tree[i],
+        memcpy(state->shard[index].meta->tree[i],
                shard_meta->tree[i],
                40);
 
         state->log->debug(state->env->log_options, state->handle,
-                          "Shard %d Leaf [%d]: %s", req->shard_meta_index, i,
-                          state->shard[req->shard_meta_index].meta->tree[i]);
+                          "Shard %d Leaf [%d]: %s", index, i,
+                          state->shard[index].meta->tree[i]);
     }
 
     // Add index
-    state->shard[req->shard_meta_index].meta->index = shard_meta->index;
+    state->shard[index].meta->index = shard_meta->index;
 
     // Add size
-    state->shard[req->shard_meta_index].meta->size = shard_meta->size;
+    set_shard_size(state, &state->shard[index], shard_meta->size);
 
     state->log->info(state->env->log_options, state->handle,
                      "Successfully created frame for shard index %d",
-                     req->shard_meta_index);
+                     index);
+
+    state->shard[index].progress = AWAITING_PUSH_FRAME;
+
+    return 0;
+}
+
+static void after_prepare_frame(uv_work_t *work, int status)
+{
+    frame_builder_t *req = work->data;
+    shard_meta_t *shard_meta = req->shard_meta;
+    storj_upload_state_t *state = req->upload_state;
+
+    state->pending_work_count -= 1;
+
+    if (status == UV_ECANCELED) {
+        state->shard[shard_meta->index].progress = AWAITING_PREPARE_FRAME;
+        goto clean_variables;
+    }
+
+    metrics_phase(&state->env->metrics, STORJ_PHASE_PREPARE_FRAME,
+                  shard_meta->size, req->start, req->error_status);
+
+    if (req->error_status) {
+        state->error_status = req->error_status;
+        goto clean_variables;
+    }
+
+    /* set the shard_meta to a struct array in the state for later use. */
+    if (set_shard_meta(state, req->shard_meta_index, shard_meta)) {
+        state->error_status = STORJ_MEMORY_ERROR;
+        goto clean_variables;
+    }
 
-    state->shard[req->shard_meta_index].progress = AWAITING_PUSH_FRAME;
+    // the encrypted data is kept until the shard has been sent
+    if (req->shard_data) {
+        state->shard_data = req->shard_data;
+        req->shard_data = NULL;
+    }
 
 clean_variables:
     queue_next_work(state);
@@ -1348,16 +1480,16 @@ clean_variables:
         shard_meta_cleanup(shard_meta);
     }
 
+    free(req->shard_data);
     free(req);
     free(work);
 }
 
-static void prepare_frame(uv_work_t *work)
+/*
+ * Set random challenges for a shard and allocate the shard hash
+ */
+static int prepare_shard_challenges(shard_meta_t *shard_meta)
 {
-    frame_builder_t *req = work->data;
-    shard_meta_t *shard_meta = req->shard_meta;
-    storj_upload_state_t *state = req->upload_state;
-
     // Set the challenges
     uint8_t buff[32];
     for (int i = 0; i < STORJ_SHARD_CHALLENGES; i++ ) {
@@ -1369,8 +1501,7 @@ static void prepare_frame(uv_work_t *work)
         // Convert the uint8_t challenges to character arrays
         char *challenge_as_str = hex2str(32, buff);
         if (!challenge_as_str) {
-            req->error_status = STORJ_MEMORY_ERROR;
-            goto clean_variables;
+            return 1;
         }
         memcpy(shard_meta->challenges_as_str[i], challenge_as_str, strlen(challenge_as_str));
         free(challenge_as_str);
@@ -1379,30 +1510,153 @@ static void prepare_frame(uv_work_t *work)
     // Hash of the shard_data
     shard_meta->hash = calloc(RIPEMD160_DIGEST_SIZE*2 + 2, sizeof(char));
     if (!shard_meta->hash) {
-        req->error_status = STORJ_MEMORY_ERROR;
-        goto clean_variables;
+        return 1;
     }
 
-    req->log->info(state->env->log_options, state->handle,
-                   "Creating frame for shard index %d",
-                   req->shard_meta_index);
+    return 0;
+}
+
+static void init_shard_hashes(shard_meta_t *shard_meta,
+                              shard_hashes_t *hashes)
+{
+    sha256_init(&hashes->shard_ctx);
+
+    const uint8_t *challenges[STORJ_SHARD_CHALLENGES];
+    for (int i = 0; i < STORJ_SHARD_CHALLENGES; i++ ) {
+        challenges[i] = (uint8_t *)&shard_meta->challenges[i];
+    }
+
+    sha256_lanes_init(&hashes->leaves_ctx, STORJ_SHARD_CHALLENGES,
+                      challenges, 32);
+}
 
+static void update_shard_hashes(shard_hashes_t *hashes, size_t length,
+                                const uint8_t *data)
+{
+    sha256_update(&hashes->shard_ctx, length, data);
+    sha256_lanes_update(&hashes->leaves_ctx, length, data);
+}
+
+/*
+ * Set the shard hash and merkle tree leaves from the sha256 of the
+ * encrypted shard data, and of the data with each challenge
+ */
+static int finish_shard_hashes(shard_meta_t *shard_meta,
+                               shard_hashes_t *hashes)
+{
     // Sha256 of encrypted data for calculating shard has
     uint8_t prehash_sha256[SHA256_DIGEST_SIZE];
 
-    // Initialize context for sha256 of encrypted data
-    struct sha256_ctx shard_hash_ctx;
-    sha256_init(&shard_hash_ctx);
+    sha256_digest(&hashes->shard_ctx, SHA256_DIGEST_SIZE, prehash_sha256);
+
+    uint8_t prehash_ripemd160[RIPEMD160_DIGEST_SIZE];
+    memset_zero(prehash_ripemd160, RIPEMD160_DIGEST_SIZE);
+    ripemd160_of_str(prehash_sha256, SHA256_DIGEST_SIZE, prehash_ripemd160);
+
+    // Shard Hash
+    char *hash = hex2str(RIPEMD160_DIGEST_SIZE, prehash_ripemd160);
+    if (!hash) {
+        return 1;
+    }
+    memcpy(shard_meta->hash, hash, strlen(hash));
+    free(hash);
+
+    // finish first sha256 for the leaves
+    uint8_t preleaf_sha256[STORJ_SHARD_CHALLENGES][SHA256_DIGEST_SIZE];
+    sha256_lanes_digest(&hashes->leaves_ctx, preleaf_sha256);
 
-    // Calculate the merkle tree with challenges
-    struct sha256_ctx first_sha256_for_leaf[STORJ_SHARD_CHALLENGES];
+    uint8_t preleaf_ripemd160[RIPEMD160_DIGEST_SIZE];
+    memset_zero(preleaf_ripemd160, RIPEMD160_DIGEST_SIZE);
+    char leaf[RIPEMD160_DIGEST_SIZE*2 +1];
+    memset(leaf, '\0', RIPEMD160_DIGEST_SIZE*2 +1);
     for (int i = 0; i < STORJ_SHARD_CHALLENGES; i++ ) {
-        sha256_init(&first_sha256_for_leaf[i]);
-        sha256_update(&first_sha256_for_leaf[i], 32, (uint8_t *)&shard_meta->challenges[i]);
+        // ripemd160 result of sha256
+        ripemd160_of_str(preleaf_sha256[i], SHA256_DIGEST_SIZE, preleaf_ripemd160);
+
+        // sha256 and ripemd160 again
+        ripemd160sha256_as_string(preleaf_ripemd160, RIPEMD160_DIGEST_SIZE, leaf);
+
+        memcpy(shard_meta->tree[i], leaf, RIPEMD160_DIGEST_SIZE*2 + 1);
+    }
+
+    return 0;
+}
+
+/*
+ * Read all of a small file into memory and encrypt it in place
+ */
+static int read_small_object(frame_builder_t *req,
+                             storj_encryption_ctx_t *encryption_ctx,
+                             uint64_t *total_read)
+{
+    storj_upload_state_t *state = req->upload_state;
+
+    req->shard_data = malloc(state->file_size);
+    if (!req->shard_data) {
+        req->error_status = STORJ_MEMORY_ERROR;
+        return 1;
+    }
+
+    while (*total_read < state->file_size) {
+        if (state->canceled) {
+            return 1;
+        }
+
+        ssize_t read_bytes = pread(fileno(req->shard_file),
+                                   req->shard_data + *total_read,
+                                   state->file_size - *total_read,
+                                   *total_read);
+
+        if (read_bytes == -1) {
+            req->log->warn(state->env->log_options, state->handle,
+                           "Error reading file: %d",
+                           errno);
+            req->error_status = STORJ_FILE_READ_ERROR;
+            return 1;
+        }
+
+        if (read_bytes == 0) {
+            break;
+        }
+
+        *total_read += read_bytes;
+    }
+
+    ctr_crypt(encryption_ctx->ctx, (nettle_cipher_func *)aes256_encrypt,
+              AES_BLOCK_SIZE, encryption_ctx->encryption_ctr, *total_read,
+              req->shard_data, req->shard_data);
+
+    return 0;
+}
+
+static void prepare_frame(uv_work_t *work)
+{
+    frame_builder_t *req = work->data;
+    shard_meta_t *shard_meta = req->shard_meta;
+    storj_upload_state_t *state = req->upload_state;
+
+    req->start = metrics_now(&state->env->metrics);
+
+    if (prepare_shard_challenges(shard_meta)) {
+        req->error_status = STORJ_MEMORY_ERROR;
+        goto clean_variables;
     }
 
+    req->log->info(state->env->log_options, state->handle,
+                   "Creating frame for shard index %d",
+                   req->shard_meta_index);
+
+    // Initialize context for sha256 of encrypted data, and for
+    // calculating the merkle tree with challenges
+    shard_hashes_t hashes;
+    init_shard_hashes(shard_meta, &hashes);
+
+    // Data shards read from the original file are encrypted
+    bool encrypt = !reads_encrypted_copy(state) &&
+        req->shard_meta_index < state->total_data_shards;
+
     storj_encryption_ctx_t *encryption_ctx = NULL;
-    if (!state->rs) {
+    if (encrypt) {
         // Initialize the encryption context
         encryption_ctx = prepare_encryption_ctx(state->encryption_ctr, state->encryption_key);
         if (!encryption_ctx) {
@@ -1413,6 +1667,24 @@ static void prepare_frame(uv_work_t *work)
         increment_ctr_aes_iv(encryption_ctx->encryption_ctr, req->shard_meta_index * state->shard_size);
     }
 
+    if (state->small_object) {
+        // Read and encrypt the whole file once, it is sent from memory
+        uint64_t total_read = 0;
+        if (read_small_object(req, encryption_ctx, &total_read)) {
+            goto clean_variables;
+        }
+
+        update_shard_hashes(&hashes, total_read, req->shard_data);
+
+        shard_meta->size = total_read;
+
+        if (finish_shard_hashes(shard_meta, &hashes)) {
+            req->error_status = STORJ_MEMORY_ERROR;
+        }
+
+        goto clean_variables;
+    }
+
     uint8_t cphr_txt[AES_BLOCK_SIZE * 256];
     memset_zero(cphr_txt, AES_BLOCK_SIZE * 256);
     char read_data[AES_BLOCK_SIZE * 256];
@@ -1439,7 +1711,7 @@ static void prepare_frame(uv_work_t *work)
 
         total_read += read_bytes;
 
-        if (!state->rs) {
+        if (encrypt) {
             // Encrypt data
             ctr_crypt(encryption_ctx->ctx, (nettle_cipher_func *)aes256_encrypt,
                       AES_BLOCK_SIZE, encryption_ctx->encryption_ctr, read_bytes,
@@ -1449,11 +1721,7 @@ static void prepare_frame(uv_work_t *work)
             memcpy(cphr_txt, read_data, AES_BLOCK_SIZE*256);
         }
 
-        sha256_update(&shard_hash_ctx, read_bytes, cphr_txt);
-
-        for (int i = 0; i < STORJ_SHARD_CHALLENGES; i++ ) {
-            sha256_update(&first_sha256_for_leaf[i], read_bytes, cphr_txt);
-        }
+        update_shard_hashes(&hashes, read_bytes, cphr_txt);
 
         memset_zero(read_data, AES_BLOCK_SIZE * 256);
         memset_zero(cphr_txt, AES_BLOCK_SIZE * 256);
@@ -1462,39 +1730,10 @@ static void prepare_frame(uv_work_t *work)
 
     shard_meta->size = total_read;
 
-    sha256_digest(&shard_hash_ctx, SHA256_DIGEST_SIZE, prehash_sha256);
-
-    uint8_t prehash_ripemd160[RIPEMD160_DIGEST_SIZE];
-    memset_zero(prehash_ripemd160, RIPEMD160_DIGEST_SIZE);
-    ripemd160_of_str(prehash_sha256, SHA256_DIGEST_SIZE, prehash_ripemd160);
-
-    // Shard Hash
-    char *hash = hex2str(RIPEMD160_DIGEST_SIZE, prehash_ripemd160);
-    if (!hash) {
+    if (finish_shard_hashes(shard_meta, &hashes)) {
         req->error_status = STORJ_MEMORY_ERROR;
         goto clean_variables;
     }
-    memcpy(shard_meta->hash, hash, strlen(hash));
-    free(hash);
-
-    uint8_t preleaf_sha256[SHA256_DIGEST_SIZE];
-    memset_zero(preleaf_sha256, SHA256_DIGEST_SIZE);
-    uint8_t preleaf_ripemd160[RIPEMD160_DIGEST_SIZE];
-    memset_zero(preleaf_ripemd160, RIPEMD160_DIGEST_SIZE);
-    char leaf[RIPEMD160_DIGEST_SIZE*2 +1];
-    memset(leaf, '\0', RIPEMD160_DIGEST_SIZE*2 +1);
-    for (int i = 0; i < STORJ_SHARD_CHALLENGES; i++ ) {
-        // finish first sha256 for leaf
-        sha256_digest(&first_sha256_for_leaf[i], SHA256_DIGEST_SIZE, preleaf_sha256);
-
-        // ripemd160 result of sha256
-        ripemd160_of_str(preleaf_sha256, SHA256_DIGEST_SIZE, preleaf_ripemd160);
-
-        // sha256 and ripemd160 again
-        ripemd160sha256_as_string(preleaf_ripemd160, RIPEMD160_DIGEST_SIZE, leaf);
-
-        memcpy(shard_meta->tree[i], leaf, RIPEMD160_DIGEST_SIZE*2 + 1);
-    }
 
 clean_variables:
     if (encryption_ctx) {
@@ -1522,14 +1761,16 @@ static void queue_prepare_frame(storj_upload_state_t *state, int index)
     state->shard[index].progress = PREPARING_FRAME;
 }
 
-static void after_create_encrypted_file(uv_work_t *work, int status)
+static void finish_create_encrypted_file(encrypt_file_req_t *req)
 {
-    encrypt_file_req_t *req = work->data;
     storj_upload_state_t *state = req->upload_state;
 
-    state->pending_work_count -= 1;
     state->create_encrypted_file_count += 1;
 
+    if (req->encrypted_file) {
+        fclose(req->encrypted_file);
+    }
+
     uint64_t encrypted_file_size = 0;
     #ifdef _WIN32
         struct _stati64 st;
@@ -1541,7 +1782,14 @@ static void after_create_encrypted_file(uv_work_t *work, int status)
         encrypted_file_size = st.st_size;
     #endif
 
-    if (req->error_status != 0 || state->file_size != encrypted_file_size) {
+    if (req->error_status == 0 && state->file_size != encrypted_file_size) {
+        req->error_status = STORJ_FILE_ENCRYPTION_ERROR;
+    }
+
+    metrics_phase(&state->env->metrics, STORJ_PHASE_CREATE_ENCRYPTED_FILE,
+                  state->file_size, req->start, req->error_status);
+
+    if (req->error_status != 0) {
         state->log->warn(state->env->log_options, state->handle,
                        "Failed to encrypt data.");
 
@@ -1560,85 +1808,201 @@ static void after_create_encrypted_file(uv_work_t *work, int status)
 
     state->creating_encrypted_file = false;
 
-clean_variables:
     queue_next_work(state);
-    free(work->data);
-    free(work);
+    free(req);
 }
 
-static void create_encrypted_file(uv_work_t *work)
+static void after_encrypt_file_segment(uv_work_t *work, int status)
 {
-    encrypt_file_req_t *req = work->data;
-    storj_upload_state_t *state = req->upload_state;
+    encrypt_segment_req_t *segment_req = work->data;
+    encrypt_file_req_t *req = segment_req->encrypt_req;
 
-    state->log->info(state->env->log_options, state->handle, "Encrypting file...");
+    req->upload_state->pending_work_count -= 1;
 
-    // Initialize the encryption context
-    storj_encryption_ctx_t *encryption_ctx = prepare_encryption_ctx(state->encryption_ctr,
-                                                                    state->encryption_key);
-    if (!encryption_ctx) {
-        state->error_status = STORJ_MEMORY_ERROR;
-        goto clean_variables;
+    if (status != 0) {
+        req->error_status = STORJ_QUEUE_ERROR;
+    } else if (segment_req->error_status) {
+        req->error_status = segment_req->error_status;
     }
 
-    uint8_t cphr_txt[AES_BLOCK_SIZE * 256];
-    memset_zero(cphr_txt, AES_BLOCK_SIZE * 256);
-    char read_data[AES_BLOCK_SIZE * 256];
-    memset_zero(read_data, AES_BLOCK_SIZE * 256);
-    unsigned long int read_bytes = 0;
-    unsigned long int written_bytes = 0;
-    uint64_t total_read = 0;
+    req->completed_segments += 1;
 
-    FILE *encrypted_file = fopen(state->encrypted_file_path, "w+");
+    // All of the segments are joined before the file is used
+    if (req->completed_segments == req->total_segments) {
+        finish_create_encrypted_file(req);
+    }
 
-    if (encrypted_file == NULL) {
-      state->log->error(state->env->log_options, state->handle,
-                     "Can't create file for encrypted data [%s]",
-                     state->encrypted_file_path);
-        goto clean_variables;
+    free(segment_req);
+    free(work);
+}
+
+static void encrypt_file_segment(uv_work_t *work)
+{
+    encrypt_segment_req_t *segment_req = work->data;
+    encrypt_file_req_t *req = segment_req->encrypt_req;
+    storj_upload_state_t *state = req->upload_state;
+
+    uint8_t *buffer = malloc(STORJ_CRYPT_BUFFER_SIZE);
+    if (!buffer) {
+        segment_req->error_status = STORJ_MEMORY_ERROR;
+        return;
     }
 
-    do {
+    uint64_t position = segment_req->offset;
+    uint64_t end = segment_req->offset + segment_req->length;
+
+    while (position < end) {
         if (state->canceled) {
+            segment_req->error_status = STORJ_TRANSFER_CANCELED;
             goto clean_variables;
         }
 
-        read_bytes = pread(fileno(state->original_file),
-                           read_data, AES_BLOCK_SIZE * 256,
-                           total_read);
-
-        if (read_bytes == -1) {
-            state->log->warn(state->env->log_options, state->handle,
-                           "Error reading file: %d",
-                           errno);
-            req->error_status = STORJ_FILE_READ_ERROR;
-            goto clean_variables;
+        size_t length = STORJ_CRYPT_BUFFER_SIZE;
+        if (length > end - position) {
+            length = end - position;
         }
 
-        // Encrypt data
-        ctr_crypt(encryption_ctx->ctx, (nettle_cipher_func *)aes256_encrypt,
-                  AES_BLOCK_SIZE, encryption_ctx->encryption_ctr, read_bytes,
-                  (uint8_t *)cphr_txt, (uint8_t *)read_data);
+        // Fill the whole buffer, so that the next one starts at a
+        // multiple of the block size again
+        size_t read_bytes = 0;
+        while (read_bytes < length) {
+            ssize_t result = pread(fileno(state->original_file),
+                                   buffer + read_bytes, length - read_bytes,
+                                   position + read_bytes);
+            if (result == -1 && errno == EINTR) {
+                continue;
+            }
 
-        written_bytes = pwrite(fileno(encrypted_file), cphr_txt, read_bytes, total_read);
+            // the segment is within the file, it can't end early
+            if (result <= 0) {
+                state->log->warn(state->env->log_options, state->handle,
+                               "Error reading file: %d",
+                               result ? errno : EIO);
+                segment_req->error_status = STORJ_FILE_READ_ERROR;
+                goto clean_variables;
+            }
 
-        memset_zero(read_data, AES_BLOCK_SIZE * 256);
-        memset_zero(cphr_txt, AES_BLOCK_SIZE * 256);
+            read_bytes += result;
+        }
 
-        total_read += read_bytes;
+        // Each buffer starts at a multiple of the block size, so the
+        // counter can be derived from its position
+        if (ctr_crypt_segment(state->encryption_key, state->encryption_ctr,
+                              position, read_bytes, buffer, buffer)) {
+            segment_req->error_status = STORJ_FILE_ENCRYPTION_ERROR;
+            goto clean_variables;
+        }
+
+        ssize_t written_bytes = pwrite(fileno(req->encrypted_file), buffer,
+                                       read_bytes, position);
 
-        if (written_bytes != read_bytes) {
+        if (written_bytes < 0 || (size_t)written_bytes != read_bytes) {
+            segment_req->error_status = STORJ_FILE_WRITE_ERROR;
             goto clean_variables;
         }
 
-    } while(total_read < state->file_size && read_bytes > 0);
+        position += read_bytes;
+    }
 
 clean_variables:
-    if (encrypted_file) {
-        fclose(encrypted_file);
+    memset_zero(buffer, STORJ_CRYPT_BUFFER_SIZE);
+    free(buffer);
+}
+
+static void queue_encrypt_file_segments(encrypt_file_req_t *req)
+{
+    storj_upload_state_t *state = req->upload_state;
+
+    req->total_segments = 0;
+    req->completed_segments = 0;
+
+    uint64_t offset = 0;
+    while (!req->error_status && offset < state->file_size) {
+        uint64_t length = state->file_size - offset;
+        if (length > STORJ_CRYPT_SEGMENT_SIZE) {
+            length = STORJ_CRYPT_SEGMENT_SIZE;
+        }
+
+        uv_work_t *work = uv_work_new();
+        encrypt_segment_req_t *segment_req =
+            malloc(sizeof(encrypt_segment_req_t));
+        if (!work || !segment_req) {
+            free(work);
+            free(segment_req);
+            req->error_status = STORJ_MEMORY_ERROR;
+            break;
+        }
+
+        segment_req->encrypt_req = req;
+        segment_req->offset = offset;
+        segment_req->length = length;
+        segment_req->error_status = 0;
+        work->data = segment_req;
+
+        int status = uv_queue_work(state->env->loop, (uv_work_t*) work,
+                                   encrypt_file_segment,
+                                   after_encrypt_file_segment);
+        if (status) {
+            free(work);
+            free(segment_req);
+            req->error_status = STORJ_QUEUE_ERROR;
+            break;
+        }
+
+        state->pending_work_count += 1;
+        req->total_segments += 1;
+        offset += length;
     }
-    if (encryption_ctx) {
-        free_encryption_ctx(encryption_ctx);
+
+    // Nothing left to join
+    if (req->total_segments == 0) {
+        finish_create_encrypted_file(req);
+    }
+}
+
+static void after_create_encrypted_file(uv_work_t *work, int status)
+{
+    encrypt_file_req_t *req = work->data;
+    storj_upload_state_t *state = req->upload_state;
+
+    state->pending_work_count -= 1;
+
+    if (status != 0) {
+        req->error_status = STORJ_QUEUE_ERROR;
+    }
+
+    if (req->error_status || state->canceled) {
+        finish_create_encrypted_file(req);
+    } else {
+        queue_encrypt_file_segments(req);
+    }
+
+    free(work);
+}
+
+static void create_encrypted_file(uv_work_t *work)
+{
+    encrypt_file_req_t *req = work->data;
+    storj_upload_state_t *state = req->upload_state;
+
+    req->start = metrics_now(&state->env->metrics);
+
+    state->log->info(state->env->log_options, state->handle, "Encrypting file...");
+
+    req->encrypted_file = fopen(state->encrypted_file_path, "w+");
+
+    if (req->encrypted_file == NULL) {
+      state->log->error(state->env->log_options, state->handle,
+                     "Can't create file for encrypted data [%s]",
+                     state->encrypted_file_path);
+        req->error_status = STORJ_FILE_WRITE_ERROR;
+        return;
+    }
+
+    // The segments are written at their positions of the sized file
+    if (state->file_size > 0 &&
+        allocatefile(fileno(req->encrypted_file), state->file_size)) {
+        req->error_status = STORJ_FILE_WRITE_ERROR;
     }
 }
 
@@ -1650,9 +2014,14 @@ static void queue_create_encrypted_file(storj_upload_state_t *state)
         return;
     }
 
-    state->pending_work_count += 1;
+    encrypt_file_req_t *req = calloc(1, sizeof(encrypt_file_req_t));
+    if (!req) {
+        free(work);
+        state->error_status = STORJ_MEMORY_ERROR;
+        return;
+    }
 
-    encrypt_file_req_t *req = malloc(sizeof(encrypt_file_req_t));
+    state->pending_work_count += 1;
 
     req->error_status = 0;
     req->upload_state = state;
@@ -1694,6 +2063,10 @@ static void after_request_frame_id(uv_work_t *work, int status)
 
         state->frame_id = req->frame_id;
 
+        if (state->resume) {
+            write_upload_journal(state);
+        }
+
     } else if (state->frame_request_count == 6) {
         state->error_status = STORJ_BRIDGE_FRAME_ERROR;
     }
@@ -1786,15 +2159,19 @@ static void queue_request_frame_id(storj_upload_state_t *state)
     state->requesting_frame = true;
 }
 
-static void after_create_parity_shards(uv_work_t *work, int status)
+static void after_finish_parity_shards(uv_work_t *work, int status)
 {
     parity_shard_req_t *req = work->data;
     storj_upload_state_t *state = req->upload_state;
 
     state->pending_work_count -= 1;
 
+    metrics_phase(&state->env->metrics, STORJ_PHASE_CREATE_PARITY_SHARDS,
+                  req->parity_size, req->start,
+                  status ? STORJ_QUEUE_ERROR : req->error_status);
+
     // TODO: Check if file was created
-    if (req->error_status != 0) {
+    if (req->error_status != 0 || status != 0) {
         state->log->warn(state->env->log_options, state->handle,
                        "Failed to create parity shards");
 
@@ -1813,108 +2190,274 @@ static void after_create_parity_shards(uv_work_t *work, int status)
 
     }
 
-clean_variables:
     queue_next_work(state);
     free(work->data);
     free(work);
 }
 
+static void finish_parity_shards(uv_work_t *work)
+{
+    parity_shard_req_t *req = work->data;
+
+    if (req->data_blocks) {
+        free(req->data_blocks);
+    }
+
+    if (req->fec_blocks) {
+        free(req->fec_blocks);
+    }
+
+    if (req->map) {
+        unmap_file(req->map, req->upload_state->file_size);
+    }
+
+    if (req->map_parity) {
+        unmap_file(req->map_parity, req->parity_size);
+    }
+
+    if (req->parity_file) {
+        fclose(req->parity_file);
+    }
+
+    if (req->encrypted_file) {
+        fclose(req->encrypted_file);
+    }
+}
+
+static void queue_finish_parity_shards(parity_shard_req_t *req)
+{
+    storj_upload_state_t *state = req->upload_state;
+
+    uv_work_t *work = uv_work_new();
+    if (!work) {
+        // the blocks, maps and files are released on the loop instead
+        uv_work_t cleanup = { .data = req };
+        finish_parity_shards(&cleanup);
+        free(req);
+
+        state->error_status = STORJ_MEMORY_ERROR;
+        queue_next_work(state);
+        return;
+    }
+
+    state->pending_work_count += 1;
+    work->data = req;
+
+    int status = uv_queue_work(state->env->loop, (uv_work_t*) work,
+                               finish_parity_shards, after_finish_parity_shards);
+
+    if (status) {
+        state->pending_work_count -= 1;
+        finish_parity_shards(work);
+        free(req);
+        free(work);
+
+        state->error_status = STORJ_QUEUE_ERROR;
+        queue_next_work(state);
+    }
+}
+
+static void after_encode_parity_stripe(uv_work_t *work, int status)
+{
+    parity_stripe_req_t *stripe_req = work->data;
+    parity_shard_req_t *req = stripe_req->parity_req;
+    storj_upload_state_t *state = req->upload_state;
+
+    state->pending_work_count -= 1;
+
+    if (status != 0 || state->canceled) {
+        req->error_status = 1;
+    }
+
+    req->completed_stripes += 1;
+
+    // All of the stripes are joined before the parity file is used
+    if (req->completed_stripes == req->total_stripes) {
+        queue_finish_parity_shards(req);
+    }
+
+    free(stripe_req);
+    free(work);
+}
+
+static void encode_parity_stripe(uv_work_t *work)
+{
+    parity_stripe_req_t *stripe_req = work->data;
+    parity_shard_req_t *req = stripe_req->parity_req;
+    storj_upload_state_t *state = req->upload_state;
+
+    if (state->canceled) {
+        return;
+    }
+
+    reed_solomon_encode2_stripe(req->rs, req->data_blocks, req->fec_blocks,
+                                state->total_shards, state->shard_size,
+                                state->file_size, stripe_req->offset,
+                                stripe_req->length);
+}
+
+static void queue_encode_parity_stripes(parity_shard_req_t *req)
+{
+    storj_upload_state_t *state = req->upload_state;
+
+    req->stripe_size = determine_stripe_size(state->shard_size);
+    req->total_stripes = 0;
+    req->completed_stripes = 0;
+
+    state->log->debug(state->env->log_options, state->handle,
+                      "Encoding parity shards in stripes of %" PRIu64 " bytes",
+                      req->stripe_size);
+
+    uint64_t offset = 0;
+    while (offset < state->shard_size) {
+        uint64_t length = state->shard_size - offset;
+        if (length > req->stripe_size) {
+            length = req->stripe_size;
+        }
+
+        uv_work_t *work = uv_work_new();
+        parity_stripe_req_t *stripe_req = malloc(sizeof(parity_stripe_req_t));
+        if (!work || !stripe_req) {
+            free(work);
+            free(stripe_req);
+            req->error_status = 1;
+            break;
+        }
+
+        stripe_req->parity_req = req;
+        stripe_req->offset = offset;
+        stripe_req->length = length;
+        work->data = stripe_req;
+
+        int status = uv_queue_work(state->env->loop, (uv_work_t*) work,
+                                   encode_parity_stripe,
+                                   after_encode_parity_stripe);
+        if (status) {
+            free(work);
+            free(stripe_req);
+            req->error_status = 1;
+            break;
+        }
+
+        state->pending_work_count += 1;
+        req->total_stripes += 1;
+        offset += length;
+    }
+
+    // Nothing left to join, release the mappings immediately
+    if (req->total_stripes == 0) {
+        queue_finish_parity_shards(req);
+    }
+}
+
+static void after_create_parity_shards(uv_work_t *work, int status)
+{
+    parity_shard_req_t *req = work->data;
+    storj_upload_state_t *state = req->upload_state;
+
+    state->pending_work_count -= 1;
+
+    if (status != 0 || req->error_status != 0 || state->canceled) {
+        req->error_status = 1;
+        queue_finish_parity_shards(req);
+    } else {
+        queue_encode_parity_stripes(req);
+    }
+
+    free(work);
+}
+
 static void create_parity_shards(uv_work_t *work)
 {
     parity_shard_req_t *req = work->data;
     storj_upload_state_t *state = req->upload_state;
 
+    req->start = metrics_now(&state->env->metrics);
+
     state->log->info(state->env->log_options, state->handle,
                    "Creating parity shards");
 
-    // ???
-    fec_init();
-
-    uint8_t **data_blocks = NULL;
-    uint8_t **fec_blocks = NULL;
-
-    uint8_t *map = NULL;
     int status = 0;
 
-    FILE *encrypted_file = fopen(state->encrypted_file_path, "r");
+    req->encrypted_file = fopen(state->encrypted_file_path, "r");
 
-    if (!encrypted_file) {
+    if (!req->encrypted_file) {
         req->error_status = 1;
         state->log->error(state->env->log_options, state->handle,
                           "Unable to open encrypted file");
-        goto clean_variables;
+        return;
     }
 
-    status = map_file(fileno(encrypted_file), state->file_size, &map, true);
+    status = map_file(fileno(req->encrypted_file), state->file_size,
+                      &req->map, true);
 
     if (status) {
         req->error_status = 1;
         state->log->error(state->env->log_options, state->handle,
                           "Could not create mmap original file: %d", status);
-        goto clean_variables;
+        return;
     }
 
-    uint64_t parity_size = state->total_shards * state->shard_size - state->file_size;
+    req->parity_size = state->total_shards * state->shard_size - state->file_size;
 
     // determine parity shard location
-    char *tmp_folder = NULL;
     if (!state->parity_file_path) {
         req->error_status = 1;
         state->log->error(state->env->log_options, state->handle,
                           "No temp folder set for parity shards");
-        goto clean_variables;
+        return;
     }
 
-    FILE *parity_file = fopen(state->parity_file_path, "w+");
-    if (!parity_file) {
+    req->parity_file = fopen(state->parity_file_path, "w+");
+    if (!req->parity_file) {
         req->error_status = 1;
         state->log->error(state->env->log_options, state->handle,
                           "Could not open parity file [%s]", state->parity_file_path);
-        goto clean_variables;
+        return;
     }
 
-    int falloc_status = allocatefile(fileno(parity_file), parity_size);
+    int falloc_status = allocatefile(fileno(req->parity_file), req->parity_size);
 
     if (falloc_status) {
         req->error_status = 1;
         state->log->error(state->env->log_options, state->handle,
                           "Could not allocate space for mmap parity " \
                           "shard file: %i", falloc_status);
-        goto clean_variables;
+        return;
     }
 
-    uint8_t *map_parity = NULL;
-    status = map_file(fileno(parity_file), parity_size, &map_parity, false);
+    status = map_file(fileno(req->parity_file), req->parity_size,
+                      &req->map_parity, false);
 
     if (status) {
         req->error_status = 1;
         state->log->error(state->env->log_options, state->handle,
                        "Could not create mmap parity shard file: %d", status);
-        goto clean_variables;
+        return;
     }
 
-    data_blocks = (uint8_t**)malloc(state->total_data_shards * sizeof(uint8_t *));
-    if (!data_blocks) {
+    req->data_blocks = (uint8_t**)malloc(state->total_data_shards * sizeof(uint8_t *));
+    if (!req->data_blocks) {
         req->error_status = 1;
         state->log->error(state->env->log_options, state->handle,
                        "memory error: unable to malloc");
-        goto clean_variables;
+        return;
     }
 
     for (int i = 0; i < state->total_data_shards; i++) {
-        data_blocks[i] = map + i * state->shard_size;
+        req->data_blocks[i] = req->map + i * state->shard_size;
     }
 
-    fec_blocks = (uint8_t**)malloc(state->total_parity_shards * sizeof(uint8_t *));
-    if (!fec_blocks) {
+    req->fec_blocks = (uint8_t**)malloc(state->total_parity_shards * sizeof(uint8_t *));
+    if (!req->fec_blocks) {
         req->error_status = 1;
         state->log->error(state->env->log_options, state->handle,
                        "memory error: unable to malloc");
-        goto clean_variables;
+        return;
     }
 
     for (int i = 0; i < state->total_parity_shards; i++) {
-        fec_blocks[i] = map_parity + i * state->shard_size;
+        req->fec_blocks[i] = req->map_parity + i * state->shard_size;
     }
 
     state->log->debug(state->env->log_options, state->handle,
@@ -1926,40 +2469,15 @@ static void create_parity_shards(uv_work_t *work)
                       state->shard_size,
                       state->file_size);
 
-
-    reed_solomon *rs = reed_solomon_new(state->total_data_shards,
-                                        state->total_parity_shards);
-    reed_solomon_encode2(rs, data_blocks, fec_blocks, state->total_shards,
-                         state->shard_size, state->file_size);
-    reed_solomon_release(rs);
-
-clean_variables:
-    if (data_blocks) {
-        free(data_blocks);
-    }
-
-    if (fec_blocks) {
-        free(fec_blocks);
-    }
-
-    if (tmp_folder) {
-        free(tmp_folder);
-    }
-
-    if (map) {
-        unmap_file(map, state->file_size);
-    }
-
-    if (map_parity) {
-        unmap_file(map_parity, parity_size);
-    }
-
-    if (parity_file) {
-        fclose(parity_file);
-    }
-
-    if (encrypted_file) {
-        fclose(encrypted_file);
+    // the codec is owned by the cache of the environment
+    req->rs = codec_cache_get(state->env->codecs,
+                              state->total_data_shards,
+                              state->total_parity_shards);
+    if (!req->rs) {
+        req->error_status = 1;
+        state->log->error(state->env->log_options, state->handle,
+                       "memory error: unable to create reed solomon");
+        return;
     }
 }
 
@@ -1972,9 +2490,14 @@ static void queue_create_parity_shards(storj_upload_state_t *state)
         return;
     }
 
-    state->pending_work_count += 1;
+    parity_shard_req_t *req = calloc(1, sizeof(parity_shard_req_t));
+    if (!req) {
+        free(work);
+        state->error_status = STORJ_MEMORY_ERROR;
+        return;
+    }
 
-    parity_shard_req_t *req = malloc(sizeof(parity_shard_req_t));
+    state->pending_work_count += 1;
 
     req->error_status = 0;
     req->upload_state = state;
@@ -1990,128 +2513,318 @@ static void queue_create_parity_shards(storj_upload_state_t *state)
     state->awaiting_parity_shards = false;
 }
 
-static void after_send_exchange_report(uv_work_t *work, int status)
+static void after_encode_single_pass(uv_work_t *work, int status)
+{
+    single_pass_req_t *req = work->data;
+    storj_upload_state_t *state = req->upload_state;
+
+    state->pending_work_count -= 1;
+
+    metrics_phase(&state->env->metrics, STORJ_PHASE_ENCODE_SINGLE_PASS,
+                  state->file_size, req->start,
+                  status ? STORJ_QUEUE_ERROR : req->error_status);
+
+    if (status != 0) {
+        state->error_status = STORJ_QUEUE_ERROR;
+    } else if (req->error_status != 0) {
+        state->log->warn(state->env->log_options, state->handle,
+                         "Failed to encode file in a single pass");
+
+        state->error_status = req->error_status;
+    } else if (!state->canceled) {
+        state->log->info(state->env->log_options, state->handle,
+                         "Successfully created parity shards and frames");
+
+        for (int i = 0; i < state->total_shards; i++) {
+            // Shards from a resumed upload already have their meta
+            if (state->shard[i].progress == COMPLETED_PUSH_SHARD) {
+                continue;
+            }
+            if (set_shard_meta(state, i, req->shard_meta[i])) {
+                state->error_status = STORJ_MEMORY_ERROR;
+                break;
+            }
+        }
+
+        state->parity_file = fopen(state->parity_file_path, "r");
+
+        if (!state->parity_file) {
+            state->error_status = STORJ_FILE_READ_ERROR;
+        }
+    }
+
+    queue_next_work(state);
+
+    for (int i = 0; i < state->total_shards; i++) {
+        if (req->shard_meta[i]) {
+            shard_meta_cleanup(req->shard_meta[i]);
+        }
+    }
+    free(req->shard_meta);
+    free(req);
+    free(work);
+}
+
+/*
+ * Read the original file once in chunks of the same offset from every data
+ * shard. Each chunk is encrypted in memory, added to the hashes of its
+ * shard, and encoded into the parity chunks which are hashed and written to
+ * the parity file. The encrypted data is not stored; data shards are
+ * encrypted again from the original file when they are pushed.
+ */
+static void encode_single_pass(uv_work_t *work)
 {
-    shard_send_report_t *req = work->data;
+    single_pass_req_t *req = work->data;
+    storj_upload_state_t *state = req->upload_state;
 
-    req->state->pending_work_count -= 1;
+    req->start = metrics_now(&state->env->metrics);
+
+    uint32_t data_shards = state->total_data_shards;
+    uint32_t parity_shards = state->total_parity_shards;
+    uint32_t total_shards = state->total_shards;
+    uint64_t chunk_size = STORJ_SINGLE_PASS_CHUNK_SIZE;
+
+    reed_solomon *rs = NULL;
+    FILE *parity_file = NULL;
+    uint8_t *buffer = NULL;
+    uint8_t **data_blocks = NULL;
+    uint8_t **fec_blocks = NULL;
+    shard_hashes_t *hashes = NULL;
+    storj_encryption_ctx_t **encryption_ctx = NULL;
+
+    state->log->info(state->env->log_options, state->handle,
+                     "Encrypting and creating parity shards...");
+
+    if (chunk_size > state->shard_size) {
+        chunk_size = state->shard_size;
+    }
+
+    rs = codec_cache_get(state->env->codecs, data_shards, parity_shards);
+    buffer = malloc(total_shards * chunk_size);
+    data_blocks = calloc(data_shards, sizeof(uint8_t *));
+    fec_blocks = calloc(parity_shards, sizeof(uint8_t *));
+    hashes = calloc(total_shards, sizeof(shard_hashes_t));
+    encryption_ctx = calloc(data_shards, sizeof(storj_encryption_ctx_t *));
+
+    if (!rs || !buffer || !data_blocks || !fec_blocks || !hashes ||
+        !encryption_ctx) {
+        req->error_status = STORJ_MEMORY_ERROR;
+        goto clean_variables;
+    }
+
+    for (int i = 0; i < data_shards; i++) {
+        data_blocks[i] = buffer + i * chunk_size;
+    }
+
+    for (int i = 0; i < parity_shards; i++) {
+        fec_blocks[i] = buffer + (data_shards + i) * chunk_size;
+    }
+
+    for (int i = 0; i < total_shards; i++) {
+        shard_meta_t *shard_meta = shard_meta_new();
+        if (!shard_meta) {
+            req->error_status = STORJ_MEMORY_ERROR;
+            goto clean_variables;
+        }
+        req->shard_meta[i] = shard_meta;
+
+        shard_meta->is_parity = (i + 1 > data_shards) ? true : false;
+        shard_meta->index = (i + 1 > data_shards) ? i - data_shards : i;
+
+        if (prepare_shard_challenges(shard_meta)) {
+            req->error_status = STORJ_MEMORY_ERROR;
+            goto clean_variables;
+        }
+
+        init_shard_hashes(shard_meta, &hashes[i]);
+    }
+
+    // Each data shard keeps its own counter, positioned at its first byte
+    for (int i = 0; i < data_shards; i++) {
+        encryption_ctx[i] = prepare_encryption_ctx(state->encryption_ctr,
+                                                   state->encryption_key);
+        if (!encryption_ctx[i]) {
+            req->error_status = STORJ_MEMORY_ERROR;
+            goto clean_variables;
+        }
+        increment_ctr_aes_iv(encryption_ctx[i]->encryption_ctr,
+                             i * state->shard_size);
+    }
 
-    if (status == UV_ECANCELED) {
-        req->report->send_count = 0;
-        req->report->send_status = STORJ_REPORT_AWAITING_SEND;
+    uint64_t parity_size = parity_shards * state->shard_size;
 
+    parity_file = fopen(state->parity_file_path, "w+");
+    if (!parity_file) {
+        req->error_status = STORJ_FILE_PARITY_ERROR;
+        state->log->error(state->env->log_options, state->handle,
+                          "Could not open parity file [%s]",
+                          state->parity_file_path);
         goto clean_variables;
     }
 
-    req->report->send_count += 1;
-
-    if (req->status_code == 201) {
-        req->state->env->log->info(req->state->env->log_options,
-                        req->state->handle,
-                         "Successfully sent exchange report for shard %d",
-                         req->report->pointer_index);
-
-        req->report->send_status = STORJ_REPORT_NOT_PREPARED; // report has been sent
-    } else if (req->report->send_count == 6) {
-        req->report->send_status = STORJ_REPORT_NOT_PREPARED; // report failed retries
-    } else {
-        req->report->send_status = STORJ_REPORT_AWAITING_SEND; // reset report back to unsent
+    int falloc_status = allocatefile(fileno(parity_file), parity_size);
+    if (falloc_status) {
+        req->error_status = STORJ_FILE_PARITY_ERROR;
+        state->log->error(state->env->log_options, state->handle,
+                          "Could not allocate space for parity " \
+                          "shard file: %i", falloc_status);
+        goto clean_variables;
     }
 
-clean_variables:
-    queue_next_work(req->state);
-    free(work->data);
-    free(work);
+    int original_fd = fileno(state->original_file);
+    int parity_fd = fileno(parity_file);
 
-}
+    for (uint64_t offset = 0; offset < state->shard_size; offset += chunk_size) {
+        if (state->canceled) {
+            goto clean_variables;
+        }
 
-static void send_exchange_report(uv_work_t *work)
-{
-    shard_send_report_t *req = work->data;
-    storj_upload_state_t *state = req->state;
+        uint64_t length = state->shard_size - offset;
+        if (length > chunk_size) {
+            length = chunk_size;
+        }
 
-    struct json_object *body = json_object_new_object();
+        for (int i = 0; i < data_shards; i++) {
+            uint64_t position = i * state->shard_size + offset;
+            uint64_t expected = 0;
+            if (position < state->file_size) {
+                expected = state->file_size - position;
+                expected = (expected > length) ? length : expected;
+            }
 
-    json_object_object_add(body, "dataHash",
-                           json_object_new_string(req->report->data_hash));
+            uint64_t total_read = 0;
+            while (total_read < expected) {
+                ssize_t read_bytes = pread(original_fd,
+                                           data_blocks[i] + total_read,
+                                           expected - total_read,
+                                           position + total_read);
+                if (read_bytes <= 0) {
+                    state->log->warn(state->env->log_options, state->handle,
+                                     "Error reading file: %d", errno);
+                    req->error_status = STORJ_FILE_READ_ERROR;
+                    goto clean_variables;
+                }
+                total_read += read_bytes;
+            }
 
-    json_object_object_add(body, "reporterId",
-                           json_object_new_string(req->report->reporter_id));
+            // Encrypt data
+            ctr_crypt(encryption_ctx[i]->ctx,
+                      (nettle_cipher_func *)aes256_encrypt,
+                      AES_BLOCK_SIZE, encryption_ctx[i]->encryption_ctr,
+                      expected, data_blocks[i], data_blocks[i]);
 
-    json_object_object_add(body, "farmerId",
-                           json_object_new_string(req->report->farmer_id));
+            // Bytes past the end of the file are encoded as zeros
+            memset(data_blocks[i] + expected, 0, chunk_size - expected);
 
-    json_object_object_add(body, "clientId",
-                           json_object_new_string(req->report->client_id));
+            update_shard_hashes(&hashes[i], expected, data_blocks[i]);
 
-    json_object_object_add(body, "exchangeStart",
-                           json_object_new_int64(req->report->start));
+            req->shard_meta[i]->size += expected;
+        }
 
-    json_object_object_add(body, "exchangeEnd",
-                           json_object_new_int64(req->report->end));
+        reed_solomon_encode(rs, data_blocks, fec_blocks, length,
+                            data_shards * length);
 
-    json_object_object_add(body, "exchangeResultCode",
-                           json_object_new_int(req->report->code));
+        for (int i = 0; i < parity_shards; i++) {
+            int s = data_shards + i;
 
-    json_object_object_add(body, "exchangeResultMessage",
-                           json_object_new_string(req->report->message));
+            if (pwrite(parity_fd, fec_blocks[i], length,
+                       i * state->shard_size + offset) != length) {
+                req->error_status = STORJ_FILE_PARITY_ERROR;
+                goto clean_variables;
+            }
 
-    int status_code = 0;
+            update_shard_hashes(&hashes[s], length, fec_blocks[i]);
 
-    // there should be an empty object in response
-    struct json_object *response = NULL;
-    int request_status = fetch_json(req->http_options,
-                                    req->options, "POST",
-                                    "/reports/exchanges", body,
-                                    true, &response, &status_code);
+            req->shard_meta[s]->size += length;
+        }
+    }
 
+    for (int i = 0; i < total_shards; i++) {
+        if (finish_shard_hashes(req->shard_meta[i], &hashes[i])) {
+            req->error_status = STORJ_MEMORY_ERROR;
+            goto clean_variables;
+        }
+    }
 
-    if (request_status) {
-        state->log->warn(state->env->log_options, state->handle,
-                         "Send exchange report error: %i", request_status);
+clean_variables:
+    if (parity_file) {
+        fclose(parity_file);
     }
 
-    req->status_code = status_code;
+    if (buffer) {
+        memset_zero(buffer, total_shards * chunk_size);
+        free(buffer);
+    }
 
-    // free all memory for body and response
-    json_object_put(response);
-    json_object_put(body);
+    if (encryption_ctx) {
+        for (int i = 0; i < data_shards; i++) {
+            if (encryption_ctx[i]) {
+                free_encryption_ctx(encryption_ctx[i]);
+            }
+        }
+        free(encryption_ctx);
+    }
+
+    free(data_blocks);
+    free(fec_blocks);
+    free(hashes);
 }
 
-static void queue_send_exchange_report(storj_upload_state_t *state, int index)
+static void queue_encode_single_pass(storj_upload_state_t *state)
 {
-    if (state->shard[index].report->send_count == 6) {
+    uv_work_t *work = uv_work_new();
+    if (!work) {
+        state->error_status = STORJ_MEMORY_ERROR;
         return;
     }
 
-    state->env->log->info(state->env->log_options, state->handle,
-                   "Sending exchange report for Shard index %d... (retry: %d)",
-                   index,
-                  state->shard[index].report->send_count);
-
-    shard_tracker_t *shard = &state->shard[index];
-
-    uv_work_t *work = malloc(sizeof(uv_work_t));
-    assert(work != NULL);
+    single_pass_req_t *req = malloc(sizeof(single_pass_req_t));
+    if (!req) {
+        free(work);
+        state->error_status = STORJ_MEMORY_ERROR;
+        return;
+    }
 
-    shard_send_report_t *req = malloc(sizeof(shard_send_report_t));
+    req->shard_meta = calloc(state->total_shards, sizeof(shard_meta_t *));
+    if (!req->shard_meta) {
+        free(req);
+        free(work);
+        state->error_status = STORJ_MEMORY_ERROR;
+        return;
+    }
 
-    req->http_options = state->env->http_options;
-    req->options = state->env->bridge_options;
-    req->status_code = 0;
-    req->report = shard->report;
-    req->report->send_status = STORJ_REPORT_SENDING;
-    req->state = state;
-    req->pointer_index = index;
+    state->pending_work_count += 1;
 
+    req->error_status = 0;
+    req->upload_state = state;
     work->data = req;
 
-    state->pending_work_count += 1;
     int status = uv_queue_work(state->env->loop, (uv_work_t*) work,
-                               send_exchange_report, after_send_exchange_report);
+                               encode_single_pass, after_encode_single_pass);
+
     if (status) {
         state->error_status = STORJ_QUEUE_ERROR;
     }
+
+    state->awaiting_parity_shards = false;
+}
+
+static void queue_send_exchange_report(storj_upload_state_t *state, int index)
+{
+    shard_tracker_t *shard = &state->shard[index];
+
+    state->env->log->info(state->env->log_options, state->handle,
+                          "Queue exchange report for Shard index %d",
+                          index);
+
+    // the report is copied and sent apart from the upload, which does
+    // not wait for it
+    if (report_queue_add(state->env->reports, shard->report)) {
+        state->error_status = STORJ_MEMORY_ERROR;
+        return;
+    }
+
+    shard->report->send_status = STORJ_REPORT_NOT_PREPARED;
 }
 
 static void verify_bucket_id_callback(uv_work_t *work_req, int status)
@@ -2124,6 +2837,7 @@ static void verify_bucket_id_callback(uv_work_t *work_req, int status)
 
     state->pending_work_count -= 1;
     state->bucket_verify_count += 1;
+    state->verifying_bucket = false;
 
     if (req->status_code == 200) {
         state->bucket_verified = true;
@@ -2155,6 +2869,7 @@ clean_variables:
 static void queue_verify_bucket_id(storj_upload_state_t *state)
 {
     state->pending_work_count += 1;
+    state->verifying_bucket = true;
     storj_bridge_get_bucket(state->env, state->bucket_id, state, verify_bucket_id_callback);
 }
 
@@ -2166,6 +2881,7 @@ static void verify_file_name_callback(uv_work_t *work_req, int status)
 
     state->pending_work_count -= 1;
     state->file_verify_count += 1;
+    state->verifying_file = false;
 
     if (req->status_code == 404) {
         state->file_verified = true;
@@ -2216,6 +2932,7 @@ static void verify_file_name(uv_work_t *work)
 static void queue_verify_file_name(storj_upload_state_t *state)
 {
     state->pending_work_count += 1;
+    state->verifying_file = true;
 
     CURL *curl = curl_easy_init();
     if (!curl) {
@@ -2306,7 +3023,29 @@ static void queue_push_frame_and_shard(storj_upload_state_t *state)
             check_in_progress(state, PUSHING_SHARD) < state->push_shard_limit) {
             queue_push_shard(state, index);
         }
+
+        if (state->error_status) {
+            break;
+        }
+    }
+
+}
+
+static void wake_upload_state(void *data)
+{
+    queue_next_work((storj_upload_state_t *)data);
+}
+
+static void update_concurrency(storj_upload_state_t *state)
+{
+    if (!concurrency_update(&state->concurrency, get_time_milliseconds())) {
+        return;
     }
+
+    state->push_shard_limit = state->concurrency.limit;
+
+    state->log->debug(state->env->log_options, state->handle,
+                      "Push shard limit: %d", state->push_shard_limit);
 }
 
 static void queue_next_work(storj_upload_state_t *state)
@@ -2330,15 +3069,31 @@ static void queue_next_work(storj_upload_state_t *state)
         return cleanup_state(state);
     }
 
-    // Verify bucket_id is exists
-    if (!state->bucket_verified) {
-        queue_verify_bucket_id(state);
-        goto finish_up;
-    }
+    update_concurrency(state);
+
+    // Verify that the bucket_id exists and that the file name doesn't
+    // exist, both requests are independent and are made at once
+    if (!state->bucket_verified || !state->file_verified) {
+        if (!state->bucket_verified && !state->verifying_bucket) {
+            queue_verify_bucket_id(state);
+        }
+
+        if (!state->file_verified && !state->verifying_file) {
+            queue_verify_file_name(state);
+        }
+
+        // Small files don't wait for the verify requests, the frame is
+        // requested and the shard prepared in the meantime
+        if (state->small_object) {
+            if (!state->frame_id && !state->requesting_frame) {
+                queue_request_frame_id(state);
+            }
+
+            if (state->shard[0].progress == AWAITING_PREPARE_FRAME) {
+                queue_prepare_frame(state, 0);
+            }
+        }
 
-    // Verify that the file name doesn't exist
-    if (!state->file_verified) {
-        queue_verify_file_name(state);
         goto finish_up;
     }
 
@@ -2347,7 +3102,21 @@ static void queue_next_work(storj_upload_state_t *state)
         goto finish_up;
     }
 
-    if (state->rs) {
+    // The parity shards of a resumed upload that were all pushed are not
+    // encoded again, the frames of the data shards are prepared as
+    // without parity
+    if (state->rs && state->single_pass && !state->parity_completed) {
+        // Encrypt, hash and create parity shards in one pass
+        if (state->awaiting_parity_shards) {
+            queue_encode_single_pass(state);
+            goto finish_up;
+        }
+
+        // Frames for every shard are prepared by the same pass
+        if (!state->parity_file) {
+            goto finish_up;
+        }
+    } else if (state->rs && !state->parity_completed) {
         if (!state->encrypted_file) {
             queue_create_encrypted_file(state);
             goto finish_up;
@@ -2385,6 +3154,11 @@ static void queue_next_work(storj_upload_state_t *state)
     // pointer to change values.
     if (state->frame_id) {
         queue_push_frame_and_shard(state);
+
+        // a push that failed to start has no work to finish the upload
+        if (state->error_status) {
+            return cleanup_state(state);
+        }
     }
 
 finish_up:
@@ -2432,8 +3206,20 @@ static void prepare_upload_state(uv_work_t *work)
     }
 
     // Set Shard calculations
-    state->shard_size = determine_shard_size(state->file_size, 0);
-    if (!state->shard_size || state->shard_size == 0) {
+    storj_shard_size_params_t shard_size_params = {
+        .file_size = state->file_size,
+        .parallelism = state->push_shard_limit,
+        .rs = state->rs
+    };
+
+    // more shards than the environment allows would not be pushed at once
+    uint32_t max_shards = state->env->scheduler->max_shards;
+    if (max_shards && max_shards < shard_size_params.parallelism) {
+        shard_size_params.parallelism = max_shards;
+    }
+
+    state->shard_size = state->shard_size_policy(&shard_size_params);
+    if (!state->shard_size || state->shard_size > MAX_SHARD_SIZE) {
         state->error_status = STORJ_FILE_SIZE_ERROR;
         return;
     }
@@ -2442,6 +3228,15 @@ static void prepare_upload_state(uv_work_t *work)
     state->total_parity_shards = (state->rs) ? ceil((double)state->total_data_shards * 2.0 / 3.0) : 0;
     state->total_shards = state->total_data_shards + state->total_parity_shards;
 
+    // any policy may choose a shard size too small to be encoded
+    if (state->rs && state->total_shards > DATA_SHARDS_MAX) {
+        state->error_status = STORJ_FILE_SIZE_ERROR;
+        return;
+    }
+
+    state->small_object = !state->rs && state->total_shards == 1 &&
+        state->file_size > 0 && state->file_size <= STORJ_SMALL_OBJECT_SIZE;
+
     int tracker_calloc_amount = state->total_shards * sizeof(shard_tracker_t);
     state->shard = malloc(tracker_calloc_amount);
     if (!state->shard) {
@@ -2474,18 +3269,40 @@ static void prepare_upload_state(uv_work_t *work)
         state->shard[i].work = NULL;
     }
 
-    if (encrypt_file_name(state->env->encrypt_options->mnemonic,
-                          state->bucket_id,
-                          state->file_name,
-                          (char **)&state->encrypted_file_name)) {
+    if (encrypt_file_name_cached(state->env->encrypt_options->key_cache,
+                                 state->env->encrypt_options->mnemonic,
+                                 state->bucket_id,
+                                 state->file_name,
+                                 (char **)&state->encrypted_file_name)) {
         state->error_status = STORJ_MEMORY_ERROR;
         return;
     }
 
     uint8_t *index = NULL;
     char *key_as_str = NULL;
+    char journal_index[SHA256_DIGEST_SIZE * 2 + 1];
+    bool resumed = false;
 
-    if (state->index) {
+    if (state->resume && state->env->tmp_path) {
+        state->journal_path = create_tmp_name(state, ".journal");
+        if (!state->journal_path) {
+            state->error_status = STORJ_MEMORY_ERROR;
+            goto cleanup;
+        }
+        resumed = (load_upload_journal(state, journal_index) == 0);
+        if (state->error_status) {
+            goto cleanup;
+        }
+    }
+
+    if (resumed) {
+        // Use the same index, so that the key and completed shards match
+        index = str2hex(strlen(journal_index), journal_index);
+        if (!index) {
+            state->error_status = STORJ_MEMORY_ERROR;
+            goto cleanup;
+        }
+    } else if (state->index) {
         index = str2hex(strlen(state->index), (char *)state->index);
         if (!index) {
             state->error_status = STORJ_MEMORY_ERROR;
@@ -2516,10 +3333,11 @@ static void prepare_upload_state(uv_work_t *work)
         goto cleanup;
     }
 
-    int key_status = generate_file_key(state->env->encrypt_options->mnemonic,
-                                       state->bucket_id,
-                                       index_as_str,
-                                       &key_as_str);
+    int key_status = generate_file_key_cached(state->env->encrypt_options->key_cache,
+                                              state->env->encrypt_options->mnemonic,
+                                              state->bucket_id,
+                                              index_as_str,
+                                              &key_as_str);
     if (key_status) {
         switch (key_status) {
             case 2:
@@ -2548,7 +3366,11 @@ static void prepare_upload_state(uv_work_t *work)
 
     if (state->rs) {
         state->parity_file_path = create_tmp_name(state, ".parity");
-        state->encrypted_file_path = create_tmp_name(state, ".crypt");
+
+        // Encrypted copy of the file is not needed with a single pass
+        if (!state->single_pass) {
+            state->encrypted_file_path = create_tmp_name(state, ".crypt");
+        }
     }
 
 
@@ -2602,6 +3424,223 @@ char *create_tmp_name(storj_upload_state_t *state, char *extension)
     return path;
 }
 
+/*
+ * Data shards are read from the encrypted copy of the file with reed
+ * solomon, unless they are encrypted by a single pass or the parity is
+ * not encoded again.
+ */
+static bool reads_encrypted_copy(storj_upload_state_t *state)
+{
+    return state->rs && !state->single_pass && !state->parity_completed;
+}
+
+static uint64_t expected_shard_size(storj_upload_state_t *state, int index)
+{
+    if (index < state->total_data_shards - 1 ||
+        index >= state->total_data_shards) {
+        return state->shard_size;
+    }
+
+    return state->file_size - index * state->shard_size;
+}
+
+/*
+ * Get the inode and modification time of the original file, so that a
+ * journal is not used for a file that changed while keeping its size.
+ */
+static int get_original_file_stamp(storj_upload_state_t *state,
+                                   uint64_t *inode, int64_t *mtime)
+{
+    #ifdef _WIN32
+        struct _stati64 st;
+        if (_fstati64(fileno(state->original_file), &st)) {
+            return 1;
+        }
+    #else
+        struct stat st;
+        if (fstat(fileno(state->original_file), &st)) {
+            return 1;
+        }
+    #endif
+
+    *inode = st.st_ino;
+    *mtime = st.st_mtime;
+
+    return 0;
+}
+
+/*
+ * The journal is a text file next to the other temporary files of the
+ * upload. The header describes the file and the frame, and a line is
+ * appended for every shard once it has been pushed. Only the index is
+ * written, the encryption key is derived from it again with the mnemonic.
+ */
+static int load_upload_journal(storj_upload_state_t *state, char *index)
+{
+    int status = 1;
+    unsigned int version = 0;
+    uint64_t file_size = 0;
+    uint64_t shard_size = 0;
+    uint32_t total_data_shards = 0;
+    uint32_t total_parity_shards = 0;
+    uint64_t inode = 0;
+    int64_t mtime = 0;
+    uint64_t file_inode = 0;
+    int64_t file_mtime = 0;
+    char frame_id[STORJ_UPLOAD_JOURNAL_MAX_FRAME_ID + 1];
+
+    if (get_original_file_stamp(state, &file_inode, &file_mtime)) {
+        return 1;
+    }
+
+    FILE *fd = fopen(state->journal_path, "r");
+    if (!fd) {
+        return 1;
+    }
+
+    if (fscanf(fd, "storj-upload-journal %u\n", &version) != 1 ||
+        version != STORJ_UPLOAD_JOURNAL_VERSION) {
+        goto cleanup;
+    }
+
+    if (fscanf(fd, "size %"SCNu64" %"SCNu64" %"SCNu32" %"SCNu32"\n",
+               &file_size, &shard_size,
+               &total_data_shards, &total_parity_shards) != 4 ||
+        file_size != state->file_size ||
+        shard_size != state->shard_size ||
+        total_data_shards != state->total_data_shards ||
+        total_parity_shards != state->total_parity_shards) {
+        goto cleanup;
+    }
+
+    // The shards of a file that was modified since are not the same
+    if (fscanf(fd, "file %"SCNu64" %"SCNd64"\n", &inode, &mtime) != 2 ||
+        inode != file_inode || mtime != file_mtime) {
+        state->log->warn(state->env->log_options, state->handle,
+                         "Not resuming upload of a modified file");
+        goto cleanup;
+    }
+
+    if (fscanf(fd, "index %64s\n", index) != 1 ||
+        strlen(index) != SHA256_DIGEST_SIZE * 2) {
+        goto cleanup;
+    }
+
+    // An index given with the options must be the same
+    if (state->index && strcmp(state->index, index) != 0) {
+        goto cleanup;
+    }
+
+    if (fscanf(fd, "frame %64s\n", frame_id) != 1) {
+        goto cleanup;
+    }
+
+    state->frame_id = strdup(frame_id);
+    if (!state->frame_id) {
+        state->error_status = STORJ_MEMORY_ERROR;
+        goto cleanup;
+    }
+
+    state->log->info(state->env->log_options, state->handle,
+                     "Resuming upload with frame id: %s", state->frame_id);
+
+    int shard_index = 0;
+    char hash[RIPEMD160_DIGEST_SIZE * 2 + 1];
+    uint64_t size = 0;
+
+    // A line that was not completely written is not used
+    while (fscanf(fd, "shard %d %40s %"SCNu64"\n",
+                  &shard_index, hash, &size) == 3) {
+
+        if (shard_index < 0 || shard_index >= state->total_shards ||
+            strlen(hash) != RIPEMD160_DIGEST_SIZE * 2 ||
+            size != expected_shard_size(state, shard_index)) {
+            continue;
+        }
+
+        shard_tracker_t *shard = &state->shard[shard_index];
+        if (shard->progress == COMPLETED_PUSH_SHARD) {
+            continue;
+        }
+
+        shard->meta->hash = strdup(hash);
+        if (!shard->meta->hash) {
+            state->error_status = STORJ_MEMORY_ERROR;
+            goto cleanup;
+        }
+        shard->meta->index = shard_index;
+        set_shard_size(state, shard, size);
+        set_uploaded_size(state, shard, size);
+        shard->progress = COMPLETED_PUSH_SHARD;
+        state->completed_shards += 1;
+    }
+
+    state->log->info(state->env->log_options, state->handle,
+                     "Resumed upload has %d of %d shards completed",
+                     state->completed_shards, state->total_shards);
+
+    state->parity_completed = state->total_parity_shards > 0;
+    for (int i = state->total_data_shards; i < state->total_shards; i++) {
+        if (state->shard[i].progress != COMPLETED_PUSH_SHARD) {
+            state->parity_completed = false;
+        }
+    }
+
+    status = 0;
+
+cleanup:
+    fclose(fd);
+
+    return status;
+}
+
+static void write_upload_journal(storj_upload_state_t *state)
+{
+    uint64_t inode = 0;
+    int64_t mtime = 0;
+    if (get_original_file_stamp(state, &inode, &mtime)) {
+        state->log->warn(state->env->log_options, state->handle,
+                         "Unable to write upload journal: %s",
+                         state->journal_path);
+        return;
+    }
+
+    FILE *fd = fopen(state->journal_path, "w");
+    if (!fd) {
+        state->log->warn(state->env->log_options, state->handle,
+                         "Unable to write upload journal: %s",
+                         state->journal_path);
+        return;
+    }
+
+    fprintf(fd, "storj-upload-journal %u\n", STORJ_UPLOAD_JOURNAL_VERSION);
+    fprintf(fd, "size %"PRIu64" %"PRIu64" %"PRIu32" %"PRIu32"\n",
+            state->file_size, state->shard_size,
+            state->total_data_shards, state->total_parity_shards);
+    fprintf(fd, "file %"PRIu64" %"PRId64"\n", inode, mtime);
+    fprintf(fd, "index %s\n", state->index);
+    fprintf(fd, "frame %s\n", state->frame_id);
+
+    fclose(fd);
+}
+
+static void append_upload_journal(storj_upload_state_t *state, int index)
+{
+    shard_meta_t *meta = state->shard[index].meta;
+
+    FILE *fd = fopen(state->journal_path, "a");
+    if (!fd) {
+        state->log->warn(state->env->log_options, state->handle,
+                         "Unable to write upload journal: %s",
+                         state->journal_path);
+        return;
+    }
+
+    fprintf(fd, "shard %d %s %"PRIu64"\n", index, meta->hash, meta->size);
+
+    fclose(fd);
+}
+
 STORJ_API int storj_bridge_store_file_cancel(storj_upload_state_t *state)
 {
     if (state->canceled) {
@@ -2612,15 +3651,8 @@ STORJ_API int storj_bridge_store_file_cancel(storj_upload_state_t *state)
 
     state->error_status = STORJ_TRANSFER_CANCELED;
 
-    // loop over all shards, and cancel any that are queued to be uploaded
-    // any uploads that are in-progress will monitor the state->canceled
-    // status and exit when set to true
-    for (int i = 0; i < state->total_shards; i++) {
-        shard_tracker_t *shard = &state->shard[i];
-        if (shard->progress == PUSHING_SHARD) {
-            uv_cancel((uv_req_t *)shard->work);
-        }
-    }
+    // uploads that are in-progress on the event loop will monitor the
+    // state->canceled status and abort when set to true
 
     return 0;
 }
@@ -2661,7 +3693,10 @@ STORJ_API storj_upload_state_t *storj_bridge_store_file(storj_env_t *env,
     state->shard_size = 0;
     state->total_bytes = 0;
     state->uploaded_bytes = 0;
-    state->exclude = NULL;
+    memset(&state->progress_meter, 0, sizeof(storj_progress_meter_t));
+    state->progress_meter.interval = opts->progress_interval;
+    // avoid the farmers already known to be slow or unreachable
+    state->exclude = farmer_table_exclude_list(env->farmers);
     state->frame_id = NULL;
     state->hmac_id = NULL;
     state->encryption_key = NULL;
@@ -2676,6 +3711,10 @@ STORJ_API storj_upload_state_t *storj_bridge_store_file(storj_env_t *env,
     state->encrypted_file = NULL;
     state->encrypted_file_path = NULL;
     state->creating_encrypted_file = false;
+    state->single_pass = state->rs && opts->single_pass;
+    state->parity_completed = false;
+    state->resume = opts->resume;
+    state->journal_path = NULL;
 
     state->requesting_frame = false;
     state->completed_upload = false;
@@ -2685,10 +3724,20 @@ STORJ_API storj_upload_state_t *storj_bridge_store_file(storj_env_t *env,
     state->canceled = false;
     state->bucket_verified = false;
     state->file_verified = false;
+    state->verifying_bucket = false;
+    state->verifying_file = false;
+    state->small_object = false;
+    state->shard_data = NULL;
 
     state->progress_finished = false;
 
     state->push_shard_limit = (opts->push_shard_limit > 0) ? (opts->push_shard_limit) : PUSH_SHARD_LIMIT;
+    concurrency_init(&state->concurrency, opts->adaptive_concurrency,
+                     state->push_shard_limit, opts->min_concurrency,
+                     opts->max_concurrency);
+    state->push_shard_limit = state->concurrency.limit;
+    state->shard_size_policy = opts->shard_size_policy ?
+        opts->shard_size_policy : storj_shard_size_default;
     state->push_frame_limit = (opts->push_frame_limit > 0) ? (opts->push_frame_limit) : PUSH_FRAME_LIMIT;
     state->prepare_frame_limit = (opts->prepare_frame_limit > 0) ? (opts->prepare_frame_limit) : PREPARE_FRAME_LIMIT;
 
@@ -2706,6 +3755,13 @@ STORJ_API storj_upload_state_t *storj_bridge_store_file(storj_env_t *env,
     state->shard = NULL;
     state->pending_work_count = 0;
 
+    state->transfer_slot = transfer_slot_new(env->scheduler,
+                                             wake_upload_state, state);
+    if (!state->transfer_slot) {
+        free(state);
+        return NULL;
+    }
+
     uv_work_t *work = uv_work_new();
     work->data = state;
 
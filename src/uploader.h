@@ -11,10 +11,20 @@
 #include "utils.h"
 #include "crypto.h"
 #include "rs.h"
+#include "scheduler.h"
+#include "reports.h"
+#include "farmers.h"
+#include "codecs.h"
+#include "metrics.h"
 
 #define STORJ_NULL -1
-#define STORJ_MAX_REPORT_TRIES 2
 #define STORJ_MAX_PUSH_FRAME_COUNT 6
+#define STORJ_SINGLE_PASS_CHUNK_SIZE AES_BLOCK_SIZE * 4096
+#define STORJ_UPLOAD_JOURNAL_VERSION 2
+#define STORJ_UPLOAD_JOURNAL_MAX_FRAME_ID 64
+
+// Files up to this size are uploaded as one shard from memory
+#define STORJ_SMALL_OBJECT_SIZE MIN_SHARD_SIZE
 
 typedef enum {
     CANCELED = 0,
@@ -43,21 +53,67 @@ typedef struct {
     int shard_meta_index;
     // Either parity file pointer or original file
     FILE *shard_file;
+    // The encrypted data of a small object
+    uint8_t *shard_data;
     storj_log_levels_t *log;
+    uint64_t start;
 } frame_builder_t;
 
 typedef struct {
     int error_status;
     /* state should not be modified in worker threads */
     storj_upload_state_t *upload_state;
+
+    // Shared by the stripe workers, only modified before and after them
+    reed_solomon *rs;
+    FILE *encrypted_file;
+    FILE *parity_file;
+    uint8_t *map;
+    uint8_t *map_parity;
+    uint64_t parity_size;
+    uint8_t **data_blocks;
+    uint8_t **fec_blocks;
+    uint64_t stripe_size;
+    uint32_t total_stripes;
+    uint32_t completed_stripes;
+    uint64_t start;
 } parity_shard_req_t;
 
+typedef struct {
+    /* parity request should not be modified in worker threads */
+    parity_shard_req_t *parity_req;
+    uint64_t offset;
+    uint64_t length;
+} parity_stripe_req_t;
+
 typedef struct {
     int error_status;
     /* state should not be modified in worker threads */
     storj_upload_state_t *upload_state;
+    /* shared by the segment workers, which write at their positions */
+    FILE *encrypted_file;
+    uint32_t total_segments;
+    uint32_t completed_segments;
+    uint64_t start;
 } encrypt_file_req_t;
 
+typedef struct {
+    /* encrypt request should not be modified in worker threads */
+    encrypt_file_req_t *encrypt_req;
+    uint64_t offset;
+    uint64_t length;
+    int error_status;
+} encrypt_segment_req_t;
+
+typedef struct {
+    int error_status;
+    /* state should not be modified in worker threads */
+    storj_upload_state_t *upload_state;
+    // Prepared meta for every data and parity shard
+    shard_meta_t **shard_meta;
+    uint64_t start;
+} single_pass_req_t;
+
 typedef struct {
     storj_http_options_t *http_options;
     storj_bridge_options_t *options;
@@ -67,6 +123,7 @@ typedef struct {
     int shard_index;
     int shard_meta_index;
     FILE *shard_file;
+    storj_encryption_ctx_t *encryption_ctx;
     uv_async_t progress_handle;
     uint64_t start;
     uint64_t end;
@@ -116,15 +173,16 @@ typedef struct {
   storj_log_levels_t *log;
 } post_to_bucket_request_t;
 
+/** @brief The hashes of a shard, which are updated together with each
+ * chunk of the encrypted shard.
+ *
+ * The leaf of each challenge is the hash of the challenge and the shard,
+ * those are hashed in lanes that share the work of every block.
+ */
 typedef struct {
-    uint32_t pointer_index;
-    storj_http_options_t *http_options;
-    storj_bridge_options_t *options;
-    int status_code;
-    storj_exchange_report_t *report;
-    /* state should not be modified in worker threads */
-    storj_upload_state_t *state;
-} shard_send_report_t;
+    struct sha256_ctx shard_ctx;
+    sha256_lanes_ctx_t leaves_ctx;
+} shard_hashes_t;
 
 static farmer_pointer_t *farmer_pointer_new();
 static shard_meta_t *shard_meta_new();
@@ -140,12 +198,28 @@ static int prepare_encryption_key(storj_upload_state_t *state,
 static int check_in_progress(storj_upload_state_t *state, int status);
 char *create_tmp_name(storj_upload_state_t *state, char *extension);
 
+static uint64_t expected_shard_size(storj_upload_state_t *state, int index);
+static bool reads_encrypted_copy(storj_upload_state_t *state);
+static int get_original_file_stamp(storj_upload_state_t *state,
+                                   uint64_t *inode, int64_t *mtime);
+static int load_upload_journal(storj_upload_state_t *state, char *index);
+static void write_upload_journal(storj_upload_state_t *state);
+static void append_upload_journal(storj_upload_state_t *state, int index);
+
 static void shard_meta_cleanup(shard_meta_t *shard_meta);
 static void pointer_cleanup(farmer_pointer_t *farmer_pointer);
 static void cleanup_state(storj_upload_state_t *state);
+static void set_uploaded_size(storj_upload_state_t *state,
+                              shard_tracker_t *shard,
+                              uint64_t uploaded_size);
+static void set_shard_size(storj_upload_state_t *state,
+                           shard_tracker_t *shard,
+                           uint64_t size);
 static void free_encryption_ctx(storj_encryption_ctx_t *ctx);
 
+static void update_concurrency(storj_upload_state_t *state);
 static void queue_next_work(storj_upload_state_t *state);
+static void wake_upload_state(void *data);
 
 static void queue_request_frame_id(storj_upload_state_t *state);
 static void queue_prepare_frame(storj_upload_state_t *state, int index);
@@ -154,24 +228,41 @@ static void queue_push_shard(storj_upload_state_t *state, int index);
 static void queue_create_bucket_entry(storj_upload_state_t *state);
 static void queue_send_exchange_report(storj_upload_state_t *state, int index);
 static void queue_create_encrypted_file(storj_upload_state_t *state);
+static void queue_encrypt_file_segments(encrypt_file_req_t *req);
+static void queue_create_parity_shards(storj_upload_state_t *state);
+static void queue_encode_single_pass(storj_upload_state_t *state);
+static void queue_encode_parity_stripes(parity_shard_req_t *req);
+static void queue_finish_parity_shards(parity_shard_req_t *req);
 
 static void request_token(uv_work_t *work);
 static void request_frame_id(uv_work_t *work);
 static void prepare_frame(uv_work_t *work);
+static int read_small_object(frame_builder_t *req,
+                             storj_encryption_ctx_t *encryption_ctx,
+                             uint64_t *total_read);
 static void push_frame(uv_work_t *work);
-static void push_shard(uv_work_t *work);
+static int push_shard(uv_work_t *work);
 static void create_bucket_entry(uv_work_t *work);
-static void send_exchange_report(uv_work_t *work);
 static void create_encrypted_file(uv_work_t *work);
+static void encrypt_file_segment(uv_work_t *work);
+static void create_parity_shards(uv_work_t *work);
+static void encode_single_pass(uv_work_t *work);
+static void encode_parity_stripe(uv_work_t *work);
+static void finish_parity_shards(uv_work_t *work);
 
 static void after_request_token(uv_work_t *work, int status);
 static void after_request_frame_id(uv_work_t *work, int status);
 static void after_prepare_frame(uv_work_t *work, int status);
 static void after_push_frame(uv_work_t *work, int status);
-static void after_push_shard(uv_work_t *work, int status);
+static void after_push_shard(http_transfer_t *transfer);
 static void after_create_bucket_entry(uv_work_t *work, int status);
-static void after_send_exchange_report(uv_work_t *work, int status);
 static void after_create_encrypted_file(uv_work_t *work, int status);
+static void after_encrypt_file_segment(uv_work_t *work, int status);
+static void finish_create_encrypted_file(encrypt_file_req_t *req);
+static void after_create_parity_shards(uv_work_t *work, int status);
+static void after_encode_single_pass(uv_work_t *work, int status);
+static void after_encode_parity_stripe(uv_work_t *work, int status);
+static void after_finish_parity_shards(uv_work_t *work, int status);
 
 static void queue_verify_bucket_id(storj_upload_state_t *state);
 static void queue_verify_file_id(storj_upload_state_t *state);
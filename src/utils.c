@@ -1,4 +1,6 @@
 #include "utils.h"
+#include "rs.h"
+#include "storj.h"
 
 char *hex2str(size_t length, uint8_t *data)
 {
@@ -179,6 +181,152 @@ uint64_t get_time_milliseconds() {
     return milliseconds;
 }
 
+bool progress_meter_update(struct storj_progress_meter *meter,
+                           uint64_t bytes,
+                           uint64_t total_bytes)
+{
+    uint64_t now = get_time_milliseconds();
+
+    if (!meter->sample_time) {
+        meter->sample_time = now;
+        meter->sample_bytes = bytes;
+    } else if (now - meter->sample_time >= STORJ_PROGRESS_SAMPLE_TIME) {
+        // bytes may go back when a shard is retried
+        double sample = 0;
+        if (bytes > meter->sample_bytes) {
+            sample = (double)(bytes - meter->sample_bytes) * 1000.0 /
+                (double)(now - meter->sample_time);
+        }
+
+        // recent samples weigh more than older ones
+        if (meter->rate == 0) {
+            meter->rate = sample;
+        } else {
+            meter->rate = meter->rate * 0.75 + sample * 0.25;
+        }
+
+        meter->sample_time = now;
+        meter->sample_bytes = bytes;
+    }
+
+    meter->eta = 0;
+    if (meter->rate > 0 && total_bytes > bytes) {
+        meter->eta = (uint64_t)((double)(total_bytes - bytes) / meter->rate) + 1;
+    }
+
+    // the completed progress is always reported
+    if (meter->interval && bytes < total_bytes &&
+        meter->last_report && now - meter->last_report < meter->interval) {
+        return false;
+    }
+
+    meter->last_report = now;
+
+    return true;
+}
+
+void concurrency_init(struct storj_concurrency *concurrency,
+                      bool adaptive,
+                      uint32_t limit,
+                      uint32_t min,
+                      uint32_t max)
+{
+    memset(concurrency, 0, sizeof(storj_concurrency_t));
+
+    concurrency->adaptive = adaptive;
+    concurrency->min = min ? min : STORJ_CONCURRENCY_MIN;
+    concurrency->max = max ? max : STORJ_CONCURRENCY_MAX;
+    if (concurrency->max < concurrency->min) {
+        concurrency->max = concurrency->min;
+    }
+
+    concurrency->limit = limit;
+
+    // a fixed limit is used as given
+    if (!adaptive) {
+        return;
+    }
+
+    if (concurrency->limit < concurrency->min) {
+        concurrency->limit = concurrency->min;
+    }
+    if (concurrency->limit > concurrency->max) {
+        concurrency->limit = concurrency->max;
+    }
+}
+
+void concurrency_record(struct storj_concurrency *concurrency,
+                        uint64_t bytes,
+                        uint64_t start,
+                        bool success)
+{
+    if (success) {
+        concurrency->window_successes += 1;
+        concurrency->window_bytes += bytes;
+    } else if (start >= concurrency->decreased) {
+        concurrency->window_failures += 1;
+    }
+}
+
+static void concurrency_next_window(struct storj_concurrency *concurrency,
+                                    uint64_t now)
+{
+    concurrency->window_start = now;
+    concurrency->window_bytes = 0;
+    concurrency->window_successes = 0;
+    concurrency->window_failures = 0;
+}
+
+bool concurrency_update(struct storj_concurrency *concurrency, uint64_t now)
+{
+    if (!concurrency->adaptive) {
+        return false;
+    }
+
+    if (!concurrency->window_start) {
+        concurrency_next_window(concurrency, now);
+        return false;
+    }
+
+    uint32_t limit = concurrency->limit;
+
+    if (concurrency->window_failures) {
+        // back off at once, the goodput of the next window is measured
+        // from the lower limit
+        limit /= 2;
+        if (limit < concurrency->min) {
+            limit = concurrency->min;
+        }
+
+        concurrency->goodput = 0;
+        concurrency->decreased = now;
+        concurrency_next_window(concurrency, now);
+
+    } else if (now - concurrency->window_start >= STORJ_CONCURRENCY_WINDOW &&
+               concurrency->window_successes) {
+
+        double goodput = (double)concurrency->window_bytes * 1000.0 /
+            (double)(now - concurrency->window_start);
+
+        // keep probing for more bandwidth while it isn't lost by doing so
+        if (goodput >= concurrency->goodput * 0.95 &&
+            limit < concurrency->max) {
+            limit += 1;
+        }
+
+        concurrency->goodput = goodput;
+        concurrency_next_window(concurrency, now);
+    }
+
+    if (limit == concurrency->limit) {
+        return false;
+    }
+
+    concurrency->limit = limit;
+
+    return true;
+}
+
 void memset_zero(void *v, size_t n)
 {
 #ifdef _WIN32
@@ -223,6 +371,98 @@ uint64_t determine_shard_size(uint64_t file_size, int accumulator)
     return determine_shard_size(file_size, ++accumulator);
 }
 
+uint64_t determine_shard_size_throughput(uint64_t file_size,
+                                         uint32_t parallelism,
+                                         bool rs)
+{
+    if (file_size <= 0) {
+        return 0;
+    }
+
+    if (parallelism < 1) {
+        parallelism = 1;
+    }
+
+    uint64_t best_size = 0;
+    double best_cost = 0;
+
+    for (int hops = 0; shard_size(hops) <= MAX_SHARD_SIZE; hops++) {
+        uint64_t size = shard_size(hops);
+
+        uint64_t data_shards = ceil((double)file_size / size);
+        uint64_t parity_shards = rs ? ceil((double)data_shards * 2.0 / 3.0) : 0;
+        uint64_t total_shards = data_shards + parity_shards;
+        uint64_t rounds = ceil((double)total_shards / parallelism);
+
+        // reed solomon encodes at most DATA_SHARDS_MAX shards
+        if (rs && total_shards > DATA_SHARDS_MAX) {
+            continue;
+        }
+
+        double cost = (double)rounds * (size + SHARD_OVERHEAD_BYTES);
+
+        if (rs) {
+            uint64_t stripes = size / determine_stripe_size(size);
+            cost += (double)total_shards * stripes * STRIPE_OVERHEAD_BYTES /
+                parallelism;
+        }
+
+        if (!best_size || cost <= best_cost) {
+            best_size = size;
+            best_cost = cost;
+        }
+
+        // larger shards would only be padded
+        if (size >= file_size) {
+            break;
+        }
+    }
+
+    return best_size;
+}
+
+uint64_t determine_stripe_size(uint64_t shard_size)
+{
+    uint64_t stripe_size = shard_size / MIN_STRIPES_PER_SHARD;
+
+    if (stripe_size > MAX_STRIPE_SIZE) {
+        stripe_size = MAX_STRIPE_SIZE;
+    }
+
+    if (stripe_size < MIN_STRIPE_SIZE) {
+        stripe_size = MIN_STRIPE_SIZE;
+    }
+
+    return stripe_size;
+}
+
+int get_cpu_count()
+{
+#ifdef _WIN32
+    SYSTEM_INFO si;
+    GetSystemInfo(&si);
+    int count = si.dwNumberOfProcessors;
+#else
+    int count = sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+
+    return (count > 0) ? count : 1;
+}
+
+uint64_t get_map_granularity()
+{
+#ifdef _WIN32
+    SYSTEM_INFO si;
+    GetSystemInfo(&si);
+    uint64_t granularity = si.dwAllocationGranularity;
+#else
+    long page_size = sysconf(_SC_PAGESIZE);
+    uint64_t granularity = (page_size > 0) ? page_size : 4096;
+#endif
+
+    return granularity;
+}
+
 #ifdef _WIN32
 ssize_t pread(int fd, void *buf, size_t count, uint64_t offset)
 {
@@ -347,6 +587,12 @@ int unmap_file(uint8_t *map, uint64_t filesize)
 }
 
 int map_file(int fd, uint64_t filesize, uint8_t **map, bool read_only)
+{
+    return map_file_range(fd, 0, filesize, map, read_only);
+}
+
+int map_file_range(int fd, uint64_t offset, uint64_t length, uint8_t **map,
+                   bool read_only)
 {
     int status = 0;
 #ifdef _WIN32
@@ -365,7 +611,8 @@ int map_file(int fd, uint64_t filesize, uint8_t **map, bool read_only)
 
     prot = read_only ? FILE_MAP_READ : FILE_MAP_WRITE;
 
-    *map = MapViewOfFileEx(mh, prot, 0, 0, filesize, NULL);
+    *map = MapViewOfFileEx(mh, prot, (DWORD)(offset >> 32),
+                           (DWORD)(offset & 0xFFFFFFFF), length, NULL);
     if (!*map) {
         status = GetLastError();
         goto win_finished;
@@ -375,7 +622,8 @@ win_finished:
     CloseHandle(mh);
 #else
     int prot = read_only ? PROT_READ : PROT_READ | PROT_WRITE;
-    *map = (uint8_t *)mmap(NULL, filesize, prot, MAP_SHARED, fd, 0);
+    *map = (uint8_t *)mmap(NULL, length, prot, MAP_SHARED, fd,
+                           (off_t)offset);
     if (*map == MAP_FAILED) {
         status = errno;
     }
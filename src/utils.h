@@ -37,6 +37,13 @@ ssize_t pwrite(int fd, const void *buf, size_t count, uint64_t offset);
 #define MAX_SHARD_SIZE 4294967296 // 4Gb
 #define MIN_SHARD_SIZE 2097152 // 2Mb
 #define SHARD_MULTIPLES_BACK 4
+// Bytes a shard could send in the time of its bridge round trips
+#define SHARD_OVERHEAD_BYTES 8388608 // 8Mb
+// Bytes a stripe could send in the time to queue and encode it
+#define STRIPE_OVERHEAD_BYTES 16384 // 16Kb
+#define MAX_STRIPE_SIZE 1048576 // 1Mb
+#define MIN_STRIPE_SIZE 65536 // 64Kb
+#define MIN_STRIPES_PER_SHARD 8
 
 int allocatefile(int fd, uint64_t length);
 
@@ -66,12 +73,138 @@ uint64_t shard_size(int hops);
 
 uint64_t get_time_milliseconds();
 
+#define STORJ_PROGRESS_SAMPLE_TIME 1000
+
+struct storj_progress_meter;
+
+/**
+ * @brief Update the rate of a transfer with its progress
+ *
+ * @param[in] meter The progress meter of the transfer
+ * @param[in] bytes The bytes transferred
+ * @param[in] total_bytes The bytes of the transfer
+ * @return true if the progress callback is due
+ */
+bool progress_meter_update(struct storj_progress_meter *meter,
+                           uint64_t bytes,
+                           uint64_t total_bytes);
+
+#define STORJ_CONCURRENCY_WINDOW 2000
+#define STORJ_CONCURRENCY_MIN 1
+#define STORJ_CONCURRENCY_MAX 128
+
+struct storj_concurrency;
+
+/**
+ * @brief Start the shard limit of a transfer
+ *
+ * The limit is kept within the min and max when adaptive, and used as
+ * given otherwise.
+ *
+ * @param[in] concurrency The concurrency of the transfer
+ * @param[in] adaptive If the limit is tuned from the shard transfers
+ * @param[in] limit The initial limit of shards in flight
+ * @param[in] min The lowest limit, zero for the default
+ * @param[in] max The highest limit, zero for the default
+ */
+void concurrency_init(struct storj_concurrency *concurrency,
+                      bool adaptive,
+                      uint32_t limit,
+                      uint32_t min,
+                      uint32_t max);
+
+/**
+ * @brief Record the outcome of a shard transfer in the current window
+ *
+ * Failures of shards started before the limit was last lowered are
+ * ignored, they were caused by the limit that has already been lowered.
+ *
+ * @param[in] concurrency The concurrency of the transfer
+ * @param[in] bytes The bytes of a completed shard
+ * @param[in] start The time the shard transfer started in milliseconds
+ * @param[in] success If the shard completed, false for errors and timeouts
+ */
+void concurrency_record(struct storj_concurrency *concurrency,
+                        uint64_t bytes,
+                        uint64_t start,
+                        bool success);
+
+/**
+ * @brief Adjust the shard limit once the current window is over
+ *
+ * @param[in] concurrency The concurrency of the transfer
+ * @param[in] now The current time in milliseconds
+ * @return true if the limit has changed
+ */
+bool concurrency_update(struct storj_concurrency *concurrency, uint64_t now);
+
 void memset_zero(void *v, size_t n);
 
 uint64_t determine_shard_size(uint64_t file_size, int accumulator);
 
+/**
+ * @brief Determine the shard size that is expected to upload fastest
+ *
+ * Every shard size from MIN_SHARD_SIZE to the file size is weighed by
+ * the rounds of parallel shards needed to send the file, each costing a
+ * shard and SHARD_OVERHEAD_BYTES. With erasure coding, all of the data
+ * and parity shards are sent, and every stripe encoded costs
+ * STRIPE_OVERHEAD_BYTES spread over the parallel shards, and the data and
+ * parity shards can't be more than DATA_SHARDS_MAX. The largest of the
+ * cheapest shard sizes is used.
+ *
+ * @param[in] file_size The size of the file
+ * @param[in] parallelism The shards that can be pushed at once
+ * @param[in] rs If parity shards are encoded
+ * @return The shard size or zero for an unsupported file size
+ */
+uint64_t determine_shard_size_throughput(uint64_t file_size,
+                                         uint32_t parallelism,
+                                         bool rs);
+
+/**
+ * @brief Determine the column stripe size for erasure coding
+ *
+ * Reed solomon encoding and recovery is split into independent stripes
+ * of the same byte range across every shard so that the work can be
+ * spread over the thread pool. Stripes are at most MAX_STRIPE_SIZE and
+ * small shards are split into at least MIN_STRIPES_PER_SHARD stripes.
+ *
+ * @param[in] shard_size The size of each shard
+ * @return The stripe size in bytes
+ */
+uint64_t determine_stripe_size(uint64_t shard_size);
+
+/**
+ * @brief Get the number of online processors
+ *
+ * @return The processor count, at least one
+ */
+int get_cpu_count();
+
+/**
+ * @brief Get the alignment of the offset of a file mapping
+ *
+ * @return The page size, or the allocation granularity on windows
+ */
+uint64_t get_map_granularity();
+
 int unmap_file(uint8_t *map, uint64_t filesize);
 
 int map_file(int fd, uint64_t filesize, uint8_t **map, bool read_only);
 
+/**
+ * @brief Map a range of a file
+ *
+ * @param[in] fd The file descriptor
+ * @param[in] offset The start of the range, a multiple of
+ * get_map_granularity
+ * @param[in] length The length of the range
+ * @param[out] map The mapping, unmapped with unmap_file and the length
+ * @param[in] read_only If the mapping may not be written
+ * @return A non-zero error value on failure and 0 on success.
+ */
+int map_file_range(int fd, uint64_t offset, uint64_t length, uint8_t **map,
+                   bool read_only);
+
 #endif /* STORJ_UTILS_H */
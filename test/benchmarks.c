@@ -0,0 +1,1051 @@
+#include <getopt.h>
+#include <limits.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "storjtests.h"
+#include "../src/rs.h"
+
+#define BENCH_BRIDGE_PORT 8091
+#define BENCH_FARMER_PORT 8092
+#define BENCH_BUCKET_ID "368be0816766b28fd5f43af5"
+#define BENCH_FILE_ID "998960317b6725a3f8080c2b"
+#define BENCH_MNEMONIC "abandon abandon abandon abandon abandon abandon abandon abandon abandon abandon abandon about"
+// Size of the shards and buffers of the microbenchmarks
+#define BENCH_BLOCK_SIZE 1048576
+#define BENCH_BUFFER_SIZE 16777216
+// Chunk hashed at once by prepare_frame
+#define BENCH_FRAME_CHUNK_SIZE (AES_BLOCK_SIZE * 256)
+
+typedef struct {
+    const char *filter;
+    bool micro;
+    bool macro;
+    /* milliseconds each microbenchmark is repeated for */
+    uint32_t min_time;
+    /* bytes of the uploaded files */
+    uint64_t file_size;
+    /* milliseconds added to every request of the mock servers */
+    uint32_t latency;
+    /* shards in flight of the transfers */
+    uint32_t concurrency;
+    uint32_t iterations;
+    const char *shard_size_policy;
+} bench_options_t;
+
+typedef struct {
+    uint64_t *values;
+    uint32_t length;
+    uint32_t size;
+} bench_samples_t;
+
+/** @brief The events of the transfers, requests are added from worker
+ * threads */
+typedef struct {
+    uv_mutex_t lock;
+    bench_samples_t requests;
+    bench_samples_t shards;
+    uint64_t phases[STORJ_PHASE_RECOVER_SHARDS + 1];
+    uint32_t failed_requests;
+    uint32_t failed_shards;
+} bench_metrics_t;
+
+typedef struct {
+    bool finished;
+    int error_status;
+} bench_transfer_t;
+
+static bench_options_t options = {
+    .filter = NULL,
+    .micro = true,
+    .macro = true,
+    .min_time = 1000,
+    .file_size = 67108864,
+    .latency = 0,
+    .concurrency = 4,
+    .iterations = 3,
+    .shard_size_policy = "default"
+};
+
+static char *folder = "/tmp";
+static int failures = 0;
+
+static storj_bridge_options_t bridge_options = {
+    .proto = "http",
+    .host  = "localhost",
+    .port  = BENCH_BRIDGE_PORT,
+    .user  = USER,
+    .pass  = PASS
+};
+
+static storj_encrypt_options_t encrypt_options = {
+    .mnemonic = BENCH_MNEMONIC
+};
+
+static storj_http_options_t http_options = {
+    .user_agent = "storj-benchmarks",
+    .low_speed_limit = 0,
+    .low_speed_time = 0,
+    .timeout = 0
+};
+
+static storj_log_options_t log_options = {
+    .level = 0
+};
+
+static const char *phase_names[] = {
+    "create_encrypted_file",
+    "create_parity_shards",
+    "encode_single_pass",
+    "prepare_frame",
+    "recover_shards"
+};
+
+static bool selected(const char *name)
+{
+    return !options.filter || strstr(name, options.filter);
+}
+
+static void fill_random(uint8_t *data, uint64_t length, uint64_t seed)
+{
+    // xorshift, the contents only need to not be uniform
+    uint64_t x = seed | 1;
+    for (uint64_t i = 0; i < length; i++) {
+        x ^= x << 13;
+        x ^= x >> 7;
+        x ^= x << 17;
+        data[i] = (uint8_t)x;
+    }
+}
+
+static void samples_add(bench_samples_t *samples, uint64_t value)
+{
+    if (samples->length == samples->size) {
+        uint32_t size = samples->size ? samples->size * 2 : 64;
+        uint64_t *values = realloc(samples->values, size * sizeof(uint64_t));
+        if (!values) {
+            return;
+        }
+        samples->values = values;
+        samples->size = size;
+    }
+
+    samples->values[samples->length++] = value;
+}
+
+static int compare_values(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *)a;
+    uint64_t y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+static uint64_t samples_percentile(bench_samples_t *samples, double percentile)
+{
+    if (!samples->length) {
+        return 0;
+    }
+
+    uint32_t index = (uint32_t)(percentile * (samples->length - 1) + 0.5);
+    return samples->values[index];
+}
+
+/* The count and distribution of samples, which are sorted */
+static json_object *samples_to_json(bench_samples_t *samples)
+{
+    qsort(samples->values, samples->length, sizeof(uint64_t), compare_values);
+
+    json_object *obj = json_object_new_object();
+    json_object_object_add(obj, "count", json_object_new_int(samples->length));
+    json_object_object_add(obj, "min",
+        json_object_new_int64(samples_percentile(samples, 0)));
+    json_object_object_add(obj, "p50",
+        json_object_new_int64(samples_percentile(samples, 0.5)));
+    json_object_object_add(obj, "p95",
+        json_object_new_int64(samples_percentile(samples, 0.95)));
+    json_object_object_add(obj, "p99",
+        json_object_new_int64(samples_percentile(samples, 0.99)));
+    json_object_object_add(obj, "max",
+        json_object_new_int64(samples_percentile(samples, 1)));
+
+    return obj;
+}
+
+/* Print a result as one line of json, the params object is added to it */
+static void print_result(const char *name,
+                         json_object *params,
+                         uint64_t iterations,
+                         uint64_t bytes,
+                         uint64_t elapsed_ns,
+                         json_object *result)
+{
+    if (!result) {
+        result = json_object_new_object();
+    }
+
+    double seconds = (double)elapsed_ns / 1e9;
+
+    json_object_object_add(result, "name", json_object_new_string(name));
+    json_object_object_add(result, "params", params);
+    json_object_object_add(result, "iterations",
+                           json_object_new_int64(iterations));
+    json_object_object_add(result, "bytes", json_object_new_int64(bytes));
+    json_object_object_add(result, "seconds", json_object_new_double(seconds));
+    json_object_object_add(result, "ns_per_op",
+        json_object_new_double(iterations ? elapsed_ns / (double)iterations : 0));
+    json_object_object_add(result, "mb_per_second",
+        json_object_new_double(seconds > 0 ?
+                               iterations * bytes / 1048576.0 / seconds : 0));
+
+    printf("%s\n", json_object_to_json_string(result));
+    fflush(stdout);
+
+    json_object_put(result);
+}
+
+typedef void (*bench_fn)(void *data);
+
+/* Repeat a function for the min time, after once to warm up */
+static uint64_t run_micro(bench_fn fn, void *data, uint64_t *iterations)
+{
+    fn(data);
+
+    uint64_t min_ns = (uint64_t)options.min_time * 1000000;
+    uint64_t start = uv_hrtime();
+    uint64_t elapsed = 0;
+    *iterations = 0;
+
+    do {
+        fn(data);
+        *iterations += 1;
+        elapsed = uv_hrtime() - start;
+    } while (elapsed < min_ns);
+
+    return elapsed;
+}
+
+typedef struct {
+    reed_solomon *rs;
+    uint8_t *buffer;
+    uint8_t **data_blocks;
+    uint8_t **fec_blocks;
+    uint8_t *marks;
+    reed_solomon_decoder *decoder;
+    int total_shards;
+    uint64_t total_bytes;
+} bench_rs_t;
+
+static void bench_rs_encode(void *data)
+{
+    bench_rs_t *b = data;
+    reed_solomon_encode2(b->rs, b->data_blocks, b->fec_blocks,
+                         b->total_shards, BENCH_BLOCK_SIZE, b->total_bytes);
+}
+
+static void bench_rs_reconstruct(void *data)
+{
+    bench_rs_t *b = data;
+    reed_solomon_reconstruct(b->rs, b->data_blocks, b->fec_blocks, b->marks,
+                             b->total_shards, BENCH_BLOCK_SIZE, b->total_bytes);
+}
+
+static void bench_rs_decoder(void *data)
+{
+    bench_rs_t *b = data;
+    reed_solomon_decoder_reconstruct_stripe(b->rs, b->decoder, b->data_blocks,
+                                            b->fec_blocks, BENCH_BLOCK_SIZE,
+                                            b->total_bytes, 0,
+                                            BENCH_BLOCK_SIZE);
+}
+
+static json_object *rs_params(int data_shards, int parity_shards, int erasures)
+{
+    json_object *params = json_object_new_object();
+    json_object_object_add(params, "data_shards",
+                           json_object_new_int(data_shards));
+    json_object_object_add(params, "parity_shards",
+                           json_object_new_int(parity_shards));
+    json_object_object_add(params, "block_size",
+                           json_object_new_int(BENCH_BLOCK_SIZE));
+    if (erasures >= 0) {
+        json_object_object_add(params, "erasures",
+                               json_object_new_int(erasures));
+    }
+    return params;
+}
+
+static void run_rs(int data_shards, int parity_shards)
+{
+    bench_rs_t b;
+    memset(&b, 0, sizeof(bench_rs_t));
+
+    b.total_shards = data_shards + parity_shards;
+    b.total_bytes = (uint64_t)data_shards * BENCH_BLOCK_SIZE;
+    b.rs = reed_solomon_new(data_shards, parity_shards);
+    b.buffer = malloc((uint64_t)b.total_shards * BENCH_BLOCK_SIZE);
+    b.data_blocks = calloc(data_shards, sizeof(uint8_t *));
+    b.fec_blocks = calloc(parity_shards, sizeof(uint8_t *));
+    b.marks = calloc(b.total_shards, sizeof(uint8_t));
+    if (!b.rs || !b.buffer || !b.data_blocks || !b.fec_blocks || !b.marks) {
+        fprintf(stderr, "Failed to setup rs benchmark\n");
+        failures += 1;
+        goto cleanup;
+    }
+
+    for (int i = 0; i < data_shards; i++) {
+        b.data_blocks[i] = b.buffer + (uint64_t)i * BENCH_BLOCK_SIZE;
+    }
+    for (int i = 0; i < parity_shards; i++) {
+        b.fec_blocks[i] =
+            b.buffer + (uint64_t)(data_shards + i) * BENCH_BLOCK_SIZE;
+    }
+    fill_random(b.buffer, b.total_bytes, data_shards);
+
+    uint64_t iterations = 0;
+    uint64_t elapsed = 0;
+
+    // the parity is needed to reconstruct
+    bench_rs_encode(&b);
+
+    if (selected("rs_encode")) {
+        elapsed = run_micro(bench_rs_encode, &b, &iterations);
+        print_result("rs_encode", rs_params(data_shards, parity_shards, -1),
+                     iterations, b.total_bytes, elapsed, NULL);
+    }
+
+    // the fewest and the most shards that can be lost
+    int erasure_counts[2] = {1, parity_shards};
+
+    for (int e = 0; e < 2; e++) {
+        int erasures = erasure_counts[e];
+        if (e > 0 && erasures == erasure_counts[0]) {
+            break;
+        }
+
+        memset(b.marks, 0, b.total_shards);
+        for (int i = 0; i < erasures; i++) {
+            b.marks[i] = 1;
+        }
+
+        if (selected("rs_reconstruct")) {
+            elapsed = run_micro(bench_rs_reconstruct, &b, &iterations);
+            print_result("rs_reconstruct",
+                         rs_params(data_shards, parity_shards, erasures),
+                         iterations, b.total_bytes, elapsed, NULL);
+        }
+
+        b.decoder = reed_solomon_decoder_new(b.rs, b.marks);
+        if (b.decoder && selected("rs_decoder_reconstruct")) {
+            elapsed = run_micro(bench_rs_decoder, &b, &iterations);
+            print_result("rs_decoder_reconstruct",
+                         rs_params(data_shards, parity_shards, erasures),
+                         iterations, b.total_bytes, elapsed, NULL);
+        }
+        reed_solomon_decoder_release(b.decoder);
+        b.decoder = NULL;
+    }
+
+cleanup:
+    if (b.rs) {
+        reed_solomon_release(b.rs);
+    }
+    free(b.buffer);
+    free(b.data_blocks);
+    free(b.fec_blocks);
+    free(b.marks);
+}
+
+typedef struct {
+    uint8_t key[SHA256_DIGEST_SIZE];
+    uint8_t iv[AES_BLOCK_SIZE];
+    uint8_t challenges[STORJ_SHARD_CHALLENGES][32];
+    uint8_t *buffer;
+} bench_crypto_t;
+
+static void bench_aes_ctr(void *data)
+{
+    bench_crypto_t *b = data;
+    ctr_crypt_segment(b->key, b->iv, 0, BENCH_BUFFER_SIZE,
+                      b->buffer, b->buffer);
+}
+
+/* The hashes of a shard as they are made by prepare_frame */
+static void bench_frame_hashes(void *data)
+{
+    bench_crypto_t *b = data;
+
+    struct sha256_ctx shard_ctx;
+    sha256_lanes_ctx_t leaves_ctx;
+    const uint8_t *challenges[STORJ_SHARD_CHALLENGES];
+    for (int i = 0; i < STORJ_SHARD_CHALLENGES; i++) {
+        challenges[i] = b->challenges[i];
+    }
+
+    sha256_init(&shard_ctx);
+    sha256_lanes_init(&leaves_ctx, STORJ_SHARD_CHALLENGES, challenges, 32);
+
+    for (uint64_t i = 0; i < BENCH_BUFFER_SIZE; i += BENCH_FRAME_CHUNK_SIZE) {
+        sha256_update(&shard_ctx, BENCH_FRAME_CHUNK_SIZE, b->buffer + i);
+        sha256_lanes_update(&leaves_ctx, BENCH_FRAME_CHUNK_SIZE, b->buffer + i);
+    }
+
+    uint8_t shard_digest[SHA256_DIGEST_SIZE];
+    uint8_t shard_hash[RIPEMD160_DIGEST_SIZE];
+    sha256_digest(&shard_ctx, SHA256_DIGEST_SIZE, shard_digest);
+    ripemd160_of_str(shard_digest, SHA256_DIGEST_SIZE, shard_hash);
+
+    uint8_t preleaves[STORJ_SHARD_CHALLENGES][SHA256_DIGEST_SIZE];
+    sha256_lanes_digest(&leaves_ctx, preleaves);
+
+    uint8_t preleaf[RIPEMD160_DIGEST_SIZE];
+    char leaf[RIPEMD160_DIGEST_SIZE * 2 + 1];
+    for (int i = 0; i < STORJ_SHARD_CHALLENGES; i++) {
+        ripemd160_of_str(preleaves[i], SHA256_DIGEST_SIZE, preleaf);
+        ripemd160sha256_as_string(preleaf, RIPEMD160_DIGEST_SIZE, leaf);
+    }
+}
+
+static void run_crypto()
+{
+    bench_crypto_t b;
+    fill_random(b.key, sizeof(b.key), 1);
+    fill_random(b.iv, sizeof(b.iv), 2);
+    fill_random((uint8_t *)b.challenges, sizeof(b.challenges), 3);
+
+    b.buffer = malloc(BENCH_BUFFER_SIZE);
+    if (!b.buffer) {
+        fprintf(stderr, "Failed to setup crypto benchmark\n");
+        failures += 1;
+        return;
+    }
+    fill_random(b.buffer, BENCH_BUFFER_SIZE, 4);
+
+    uint64_t iterations = 0;
+    uint64_t elapsed = 0;
+
+    if (selected("aes256_ctr")) {
+        elapsed = run_micro(bench_aes_ctr, &b, &iterations);
+        print_result("aes256_ctr", json_object_new_object(),
+                     iterations, BENCH_BUFFER_SIZE, elapsed, NULL);
+    }
+
+    if (selected("frame_hashes")) {
+        json_object *params = json_object_new_object();
+        json_object_object_add(params, "chunk_size",
+                               json_object_new_int(BENCH_FRAME_CHUNK_SIZE));
+        json_object_object_add(params, "challenges",
+                               json_object_new_int(STORJ_SHARD_CHALLENGES));
+        elapsed = run_micro(bench_frame_hashes, &b, &iterations);
+        print_result("frame_hashes", params,
+                     iterations, BENCH_BUFFER_SIZE, elapsed, NULL);
+    }
+
+    free(b.buffer);
+}
+
+typedef struct {
+    storj_key_cache_t *cache;
+    char *encrypted_name;
+} bench_file_name_t;
+
+static void bench_decrypt_file_name(void *data)
+{
+    bench_file_name_t *b = data;
+    char *name = NULL;
+    decrypt_file_name(BENCH_MNEMONIC, BENCH_BUCKET_ID, b->encrypted_name,
+                      &name);
+    free(name);
+}
+
+static void bench_decrypt_file_name_cached(void *data)
+{
+    bench_file_name_t *b = data;
+    char *name = NULL;
+    decrypt_file_name_cached(b->cache, BENCH_MNEMONIC, BENCH_BUCKET_ID,
+                             b->encrypted_name, &name);
+    free(name);
+}
+
+static void run_file_names()
+{
+    bench_file_name_t b;
+    b.cache = key_cache_new();
+    b.encrypted_name = NULL;
+
+    if (!b.cache || encrypt_file_name(BENCH_MNEMONIC, BENCH_BUCKET_ID,
+                                      "storj-benchmark.data",
+                                      &b.encrypted_name)) {
+        fprintf(stderr, "Failed to setup file name benchmark\n");
+        failures += 1;
+        goto cleanup;
+    }
+
+    uint64_t iterations = 0;
+    uint64_t elapsed = 0;
+
+    if (selected("decrypt_file_name")) {
+        elapsed = run_micro(bench_decrypt_file_name, &b, &iterations);
+        print_result("decrypt_file_name", json_object_new_object(),
+                     iterations, 0, elapsed, NULL);
+    }
+
+    if (selected("decrypt_file_name_cached")) {
+        elapsed = run_micro(bench_decrypt_file_name_cached, &b, &iterations);
+        print_result("decrypt_file_name_cached", json_object_new_object(),
+                     iterations, 0, elapsed, NULL);
+    }
+
+cleanup:
+    free(b.encrypted_name);
+    key_cache_destroy(b.cache);
+}
+
+static void run_microbenchmarks()
+{
+    fec_init();
+
+    int geometries[][2] = {{2, 1}, {4, 2}, {14, 4}, {28, 8}, {64, 32}};
+    for (int i = 0; i < sizeof(geometries) / sizeof(geometries[0]); i++) {
+        run_rs(geometries[i][0], geometries[i][1]);
+    }
+
+    run_crypto();
+    run_file_names();
+}
+
+/* Called once at the start of every request of the mock servers */
+static void *inject_latency(void *cls,
+                            const char *uri,
+                            struct MHD_Connection *connection)
+{
+    if (options.latency) {
+        usleep(options.latency * 1000);
+    }
+
+    return NULL;
+}
+
+/* The mock farmer, which stores shards of any hash for uploads of any
+ * size */
+static int bench_farmer_server(void *cls,
+                               struct MHD_Connection *connection,
+                               const char *url,
+                               const char *method,
+                               const char *version,
+                               const char *upload_data,
+                               size_t *upload_data_size,
+                               void **con_cls)
+{
+    if (0 != strcmp(method, "POST")) {
+        return mock_farmer_shard_server(cls, connection, url, method, version,
+                                        upload_data, upload_data_size,
+                                        con_cls);
+    }
+
+    if (NULL == *con_cls) {
+        *con_cls = (void *)connection;
+        return MHD_YES;
+    }
+
+    if (*upload_data_size != 0) {
+        *upload_data_size = 0;
+        return MHD_YES;
+    }
+
+    char *page = "";
+    struct MHD_Response *response =
+        MHD_create_response_from_buffer(strlen(page), (void *) page,
+                                        MHD_RESPMEM_PERSISTENT);
+    if (!response) {
+        return MHD_NO;
+    }
+
+    int ret = MHD_queue_response(connection, MHD_HTTP_OK, response);
+    MHD_destroy_response(response);
+
+    return ret;
+}
+
+static void bench_request_completed(void *cls,
+                                    struct MHD_Connection *connection,
+                                    void **con_cls,
+                                    enum MHD_RequestTerminationCode toe)
+{
+    *con_cls = NULL;
+}
+
+static void record_request(const storj_request_event_t *event, void *handle)
+{
+    bench_metrics_t *metrics = handle;
+
+    uv_mutex_lock(&metrics->lock);
+    samples_add(&metrics->requests, event->duration);
+    if (event->error_status || event->status_code >= 400) {
+        metrics->failed_requests += 1;
+    }
+    uv_mutex_unlock(&metrics->lock);
+}
+
+static void record_shard(const storj_shard_event_t *event, void *handle)
+{
+    bench_metrics_t *metrics = handle;
+
+    uv_mutex_lock(&metrics->lock);
+    samples_add(&metrics->shards, event->duration);
+    if (event->error_status) {
+        metrics->failed_shards += 1;
+    }
+    uv_mutex_unlock(&metrics->lock);
+}
+
+static void record_phase(const storj_phase_event_t *event, void *handle)
+{
+    bench_metrics_t *metrics = handle;
+
+    uv_mutex_lock(&metrics->lock);
+    metrics->phases[event->phase] += event->duration;
+    uv_mutex_unlock(&metrics->lock);
+}
+
+static storj_env_t *bench_env_new(bench_metrics_t *metrics)
+{
+    storj_env_t *env = storj_init_env(&bridge_options,
+                                      &encrypt_options,
+                                      &http_options,
+                                      &log_options);
+    if (!env) {
+        return NULL;
+    }
+
+    storj_metrics_t env_metrics = {
+        .request = record_request,
+        .shard = record_shard,
+        .phase = record_phase,
+        .handle = metrics
+    };
+    storj_env_set_metrics(env, &env_metrics);
+
+    storj_transfer_limits_t limits = {
+        .max_shards = options.concurrency,
+        .max_bytes = 0
+    };
+    storj_env_set_transfer_limits(env, &limits);
+
+    return env;
+}
+
+/* The events of all iterations of a transfer, with the duration of each */
+static json_object *metrics_to_json(bench_metrics_t *metrics,
+                                    bench_samples_t *durations,
+                                    uint32_t iterations)
+{
+    json_object *result = json_object_new_object();
+
+    json_object_object_add(result, "duration_ms", samples_to_json(durations));
+    json_object_object_add(result, "request_ms",
+                           samples_to_json(&metrics->requests));
+    json_object_object_add(result, "shard_ms",
+                           samples_to_json(&metrics->shards));
+    json_object_object_add(result, "failed_requests",
+                           json_object_new_int(metrics->failed_requests));
+    json_object_object_add(result, "failed_shards",
+                           json_object_new_int(metrics->failed_shards));
+
+    // the mean of each phase per transfer
+    json_object *phases = json_object_new_object();
+    for (int i = 0; i <= STORJ_PHASE_RECOVER_SHARDS; i++) {
+        if (metrics->phases[i]) {
+            json_object_object_add(phases, phase_names[i],
+                json_object_new_double(metrics->phases[i] /
+                                       (double)iterations));
+        }
+    }
+    json_object_object_add(result, "phase_ms", phases);
+
+    return result;
+}
+
+static json_object *macro_params()
+{
+    json_object *params = json_object_new_object();
+    json_object_object_add(params, "latency_ms",
+                           json_object_new_int(options.latency));
+    json_object_object_add(params, "concurrency",
+                           json_object_new_int(options.concurrency));
+    return params;
+}
+
+static void store_file_finished(int error_status,
+                                storj_file_meta_t *file,
+                                void *handle)
+{
+    bench_transfer_t *transfer = handle;
+    transfer->finished = true;
+    transfer->error_status = error_status;
+
+    storj_free_uploaded_file_info(file);
+}
+
+static void resolve_file_finished(int status, FILE *fd, void *handle)
+{
+    bench_transfer_t *transfer = handle;
+    transfer->finished = true;
+    transfer->error_status = status;
+
+    fclose(fd);
+}
+
+static void transfer_progress(double progress,
+                              uint64_t transferred_bytes,
+                              uint64_t total_bytes,
+                              void *handle)
+{
+}
+
+static int create_upload_file(const char *path, uint64_t size)
+{
+    FILE *fp = fopen(path, "w+");
+    if (!fp) {
+        return 1;
+    }
+
+    uint8_t *buffer = malloc(BENCH_BLOCK_SIZE);
+    if (!buffer) {
+        fclose(fp);
+        return 1;
+    }
+
+    int status = 0;
+    uint64_t written = 0;
+    while (written < size) {
+        uint64_t length = size - written;
+        if (length > BENCH_BLOCK_SIZE) {
+            length = BENCH_BLOCK_SIZE;
+        }
+        fill_random(buffer, length, written + 1);
+        if (fwrite(buffer, 1, length, fp) != length) {
+            status = 1;
+            break;
+        }
+        written += length;
+    }
+
+    free(buffer);
+    fclose(fp);
+
+    return status;
+}
+
+/* Upload a file once, returns the milliseconds it took or 0 on failure */
+static uint64_t store_file(bench_metrics_t *metrics, const char *path)
+{
+    storj_env_t *env = bench_env_new(metrics);
+    if (!env) {
+        return 0;
+    }
+
+    bench_transfer_t transfer = {false, 0};
+
+    storj_upload_opts_t upload_opts = {
+        .bucket_id = BENCH_BUCKET_ID,
+        .file_name = "storj-benchmark-upload.data",
+        .fd = fopen(path, "r"),
+        .rs = true,
+        .push_shard_limit = options.concurrency,
+        .shard_size_policy = strcmp(options.shard_size_policy, "throughput") ?
+            storj_shard_size_default : storj_shard_size_throughput
+    };
+
+    uint64_t start = uv_hrtime();
+
+    storj_upload_state_t *state = storj_bridge_store_file(env,
+                                                          &upload_opts,
+                                                          &transfer,
+                                                          transfer_progress,
+                                                          store_file_finished);
+    if (state) {
+        uv_run(env->loop, UV_RUN_DEFAULT);
+    }
+
+    uint64_t duration = (uv_hrtime() - start) / 1000000;
+
+    if (upload_opts.fd) {
+        fclose(upload_opts.fd);
+    }
+    storj_destroy_env(env);
+
+    if (!state || !transfer.finished || transfer.error_status) {
+        fprintf(stderr, "Upload failed: %s\n",
+                storj_strerror(transfer.error_status));
+        return 0;
+    }
+
+    return duration ? duration : 1;
+}
+
+/* Download the file of the mock bridge once, returns the milliseconds it
+ * took or 0 on failure */
+static uint64_t resolve_file(bench_metrics_t *metrics,
+                             const char *path,
+                             uint64_t *bytes)
+{
+    storj_env_t *env = bench_env_new(metrics);
+    if (!env) {
+        return 0;
+    }
+
+    bench_transfer_t transfer = {false, 0};
+
+    storj_download_opts_t download_opts = {
+        .bucket_id = BENCH_BUCKET_ID,
+        .file_id = BENCH_FILE_ID,
+        .destination = fopen(path, "w+"),
+        // kept at the limit, since it can't go beyond the min and max
+        .adaptive_concurrency = true,
+        .min_concurrency = options.concurrency,
+        .max_concurrency = options.concurrency
+    };
+    if (!download_opts.destination) {
+        storj_destroy_env(env);
+        return 0;
+    }
+
+    uint64_t start = uv_hrtime();
+
+    storj_download_state_t *state =
+        storj_bridge_resolve_file_opts(env, &download_opts, &transfer,
+                                       transfer_progress,
+                                       resolve_file_finished);
+    if (state) {
+        uv_run(env->loop, UV_RUN_DEFAULT);
+    } else {
+        fclose(download_opts.destination);
+    }
+
+    uint64_t duration = (uv_hrtime() - start) / 1000000;
+
+    storj_destroy_env(env);
+
+    if (!state || !transfer.finished || transfer.error_status) {
+        fprintf(stderr, "Download failed: %s\n",
+                storj_strerror(transfer.error_status));
+        return 0;
+    }
+
+    struct stat st;
+    *bytes = stat(path, &st) == 0 ? st.st_size : 0;
+
+    return duration ? duration : 1;
+}
+
+static void run_transfers(const char *name, bool upload)
+{
+    char path[PATH_MAX];
+    snprintf(path, sizeof(path), "%s/storj-benchmark-%s.data", folder,
+             upload ? "upload" : "download");
+
+    if (upload && create_upload_file(path, options.file_size)) {
+        fprintf(stderr, "Could not create upload file: %s\n", path);
+        failures += 1;
+        return;
+    }
+
+    bench_metrics_t metrics;
+    memset(&metrics, 0, sizeof(bench_metrics_t));
+    uv_mutex_init(&metrics.lock);
+
+    bench_samples_t durations;
+    memset(&durations, 0, sizeof(bench_samples_t));
+
+    uint64_t bytes = upload ? options.file_size : 0;
+    uint64_t elapsed_ms = 0;
+
+    // once to warm up the servers and connections, without its events
+    bench_metrics_t warmup;
+    memset(&warmup, 0, sizeof(bench_metrics_t));
+    uv_mutex_init(&warmup.lock);
+    uint64_t duration = upload ? store_file(&warmup, path) :
+        resolve_file(&warmup, path, &bytes);
+    free(warmup.requests.values);
+    free(warmup.shards.values);
+    uv_mutex_destroy(&warmup.lock);
+
+    for (uint32_t i = 0; duration && i < options.iterations; i++) {
+        duration = upload ? store_file(&metrics, path) :
+            resolve_file(&metrics, path, &bytes);
+        samples_add(&durations, duration);
+        elapsed_ms += duration;
+    }
+
+    if (!duration) {
+        failures += 1;
+    } else {
+        json_object *params = macro_params();
+        if (upload) {
+            json_object_object_add(params, "shard_size_policy",
+                json_object_new_string(options.shard_size_policy));
+        }
+
+        json_object *result = metrics_to_json(&metrics, &durations,
+                                              options.iterations);
+        print_result(name, params, options.iterations, bytes,
+                     elapsed_ms * 1000000, result);
+    }
+
+    unlink(path);
+    free(durations.values);
+    free(metrics.requests.values);
+    free(metrics.shards.values);
+    uv_mutex_destroy(&metrics.lock);
+}
+
+static void run_macrobenchmarks()
+{
+    struct MHD_Daemon *bridge = MHD_start_daemon(MHD_USE_THREAD_PER_CONNECTION,
+                                                 BENCH_BRIDGE_PORT,
+                                                 NULL,
+                                                 NULL,
+                                                 &mock_bridge_server,
+                                                 NULL,
+                                                 MHD_OPTION_URI_LOG_CALLBACK,
+                                                 &inject_latency,
+                                                 NULL,
+                                                 MHD_OPTION_END);
+
+    struct MHD_Daemon *farmer = MHD_start_daemon(MHD_USE_THREAD_PER_CONNECTION,
+                                                 BENCH_FARMER_PORT,
+                                                 NULL,
+                                                 NULL,
+                                                 &bench_farmer_server,
+                                                 NULL,
+                                                 MHD_OPTION_URI_LOG_CALLBACK,
+                                                 &inject_latency,
+                                                 NULL,
+                                                 MHD_OPTION_NOTIFY_COMPLETED,
+                                                 &bench_request_completed,
+                                                 NULL,
+                                                 MHD_OPTION_END);
+
+    if (!bridge || !farmer) {
+        fprintf(stderr, "Could not start mock servers.\n");
+        failures += 1;
+        goto cleanup;
+    }
+
+    if (selected("store_file")) {
+        run_transfers("store_file", true);
+    }
+
+    if (selected("resolve_file")) {
+        run_transfers("resolve_file", false);
+    }
+
+cleanup:
+    if (bridge) {
+        MHD_stop_daemon(bridge);
+    }
+    if (farmer) {
+        MHD_stop_daemon(farmer);
+    }
+    free_farmer_data();
+}
+
+static void usage()
+{
+    printf("usage: benchmarks [options]\n\n"
+           "Prints one json object per line for each benchmark.\n\n"
+           "options:\n"
+           "  -f, --filter <name>        only run benchmarks with the name\n"
+           "  -m, --micro                only run the microbenchmarks\n"
+           "  -M, --macro                only run the transfers\n"
+           "  -t, --min-time <ms>        time of each microbenchmark (%u)\n"
+           "  -s, --size <bytes>         size of the uploaded files (%llu)\n"
+           "  -l, --latency <ms>         latency added to every request (%u)\n"
+           "  -c, --concurrency <n>      shards in flight (%u)\n"
+           "  -n, --iterations <n>       transfers of each kind (%u)\n"
+           "  -p, --shard-size-policy <default|throughput>\n"
+           "                             shard size of the uploads\n"
+           "  -h, --help                 output usage information\n",
+           options.min_time, (unsigned long long)options.file_size,
+           options.latency, options.concurrency, options.iterations);
+}
+
+int main(int argc, char **argv)
+{
+    static struct option cmd_options[] = {
+        {"filter", required_argument, 0, 'f'},
+        {"micro", no_argument, 0, 'm'},
+        {"macro", no_argument, 0, 'M'},
+        {"min-time", required_argument, 0, 't'},
+        {"size", required_argument, 0, 's'},
+        {"latency", required_argument, 0, 'l'},
+        {"concurrency", required_argument, 0, 'c'},
+        {"iterations", required_argument, 0, 'n'},
+        {"shard-size-policy", required_argument, 0, 'p'},
+        {"help", no_argument, 0, 'h'},
+        {0, 0, 0, 0}
+    };
+
+    int c;
+    int index = 0;
+
+    while ((c = getopt_long(argc, argv, "f:mMt:s:l:c:n:p:h",
+                            cmd_options, &index)) != -1) {
+        switch (c) {
+            case 'f':
+                options.filter = optarg;
+                break;
+            case 'm':
+                options.macro = false;
+                break;
+            case 'M':
+                options.micro = false;
+                break;
+            case 't':
+                options.min_time = strtoul(optarg, NULL, 10);
+                break;
+            case 's':
+                options.file_size = strtoull(optarg, NULL, 10);
+                break;
+            case 'l':
+                options.latency = strtoul(optarg, NULL, 10);
+                break;
+            case 'c':
+                options.concurrency = strtoul(optarg, NULL, 10);
+                break;
+            case 'n':
+                options.iterations = strtoul(optarg, NULL, 10);
+                break;
+            case 'p':
+                options.shard_size_policy = optarg;
+                break;
+            case 'h':
+                usage();
+                return 0;
+            default:
+                usage();
+                return 1;
+        }
+    }
+
+    if (!options.iterations || !options.concurrency || !options.file_size ||
+        (strcmp(options.shard_size_policy, "default") != 0 &&
+         strcmp(options.shard_size_policy, "throughput") != 0)) {
+        usage();
+        return 1;
+    }
+
+    if (getenv("TMPDIR")) {
+        folder = getenv("TMPDIR");
+    }
+
+    if (options.micro) {
+        run_microbenchmarks();
+    }
+
+    if (options.macro) {
+        run_macrobenchmarks();
+    }
+
+    return failures ? 1 : 0;
+}
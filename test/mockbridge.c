@@ -70,6 +70,7 @@ int mock_bridge_server(void *cls,
 
     char *page = "Not Found";
     int status_code = MHD_HTTP_NOT_FOUND;
+    json_object *listed = NULL;
 
     int ret;
 
@@ -100,6 +101,36 @@ int mock_bridge_server(void *cls,
                 page = get_response_string(responses, "listfiles");
                 status_code = MHD_HTTP_OK;
             }
+        } else if (0 == strcmp(url, "/buckets/4b4e0a3d7f1c2e5a9b8c6d01/files")) {
+            if (check_auth(user, pass, &status_code, page)) {
+                // the files created after the start date, like the bridge
+                const char *start_date = MHD_lookup_connection_value(connection,
+                                                                     MHD_GET_ARGUMENT_KIND,
+                                                                     "startDate");
+                const char *limit = MHD_lookup_connection_value(connection,
+                                                                MHD_GET_ARGUMENT_KIND,
+                                                                "limit");
+                json_object *files = NULL;
+                json_object_object_get_ex(responses, "listfilespages", &files);
+                int total_files = json_object_array_length(files);
+                int max_files = limit ? atoi(limit) : total_files;
+
+                listed = json_object_new_array();
+                for (int i = 0; i < total_files &&
+                         json_object_array_length(listed) < max_files; i++) {
+                    json_object *file = json_object_array_get_idx(files, i);
+                    json_object *created = NULL;
+                    json_object_object_get_ex(file, "created", &created);
+                    if (start_date &&
+                        strcmp(json_object_get_string(created), start_date) <= 0) {
+                        continue;
+                    }
+                    json_object_array_add(listed, json_object_get(file));
+                }
+
+                page = (char *)json_object_to_json_string(listed);
+                status_code = MHD_HTTP_OK;
+            }
         } else if (0 == strcmp(url, "/buckets/368be0816766b28fd5f43af5/files/998960317b6725a3f8080c2b/info")) {
             if (check_auth(user, pass, &status_code, page)) {
                 page = get_response_string(responses, "getfileinfo");
@@ -263,6 +294,9 @@ int mock_bridge_server(void *cls,
         free(pass);
     }
     free(user);
+    if (listed) {
+        json_object_put(listed);
+    }
     json_object_put(responses);
     json_object_put(responses_info);
 
@@ -1,6 +1,7 @@
 #include <nettle/aes.h>
 #include <nettle/ctr.h>
 #include <nettle/ctr.h>
+#include <pthread.h>
 
 #include "storjtests.h"
 #include "../src/rs.h"
@@ -9,6 +10,27 @@ static int e_count = 0;
 static int i_count = 0;
 static char* data = NULL;
 
+// Shard pushes after the limit fail, none fail with a negative limit
+static int push_limit = -1;
+static int push_count = 0;
+static pthread_mutex_t push_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+void mock_farmer_fail_pushes(int limit)
+{
+    pthread_mutex_lock(&push_mutex);
+    push_limit = limit;
+    push_count = 0;
+    pthread_mutex_unlock(&push_mutex);
+}
+
+// The shard the farmers no longer have, or NULL
+static const char *lost_shard = NULL;
+
+void mock_farmer_lose_shard(const char *shard_hash)
+{
+    lost_shard = shard_hash;
+}
+
 static void setup_test_farmer_data(int shard_bytes, int shard_bytes_sent)
 {
     // check if data already setu
@@ -198,6 +220,16 @@ int mock_farmer_shard_server(void *cls,
             printf("url: %s\n", url);
         }
 
+        if (status_code == MHD_HTTP_OK && 0 == strncmp(url, "/shards/", 8)) {
+            pthread_mutex_lock(&push_mutex);
+            if (push_limit >= 0 && push_count >= push_limit) {
+                status_code = MHD_HTTP_INTERNAL_SERVER_ERROR;
+            } else {
+                push_count += 1;
+            }
+            pthread_mutex_unlock(&push_mutex);
+        }
+
         char *page = "";
         response = MHD_create_response_from_buffer(strlen(page),
                                                    (void *) page,
@@ -225,7 +257,10 @@ int mock_farmer_shard_server(void *cls,
 
         int ret;
 
-        if (0 == strcmp(url, "/shards/269e72f24703be80bbb10499c91dc9b2022c4dc3")) {
+        if (lost_shard && 0 == strncmp(url, "/shards/", 8) &&
+            0 == strcmp(url + 8, lost_shard)) {
+            // not found
+        } else if (0 == strcmp(url, "/shards/269e72f24703be80bbb10499c91dc9b2022c4dc3")) {
             page = calloc(shard_bytes + 1, sizeof(char));
             memcpy(page, data + shard_bytes * 0, shard_bytes);
             status_code = MHD_HTTP_OK;
@@ -1,10 +1,22 @@
 #include <microhttpd.h>
 #include <assert.h>
+#include <dirent.h>
+#include <utime.h>
 
 #include "../src/storj.h"
 #include "../src/bip39.h"
 #include "../src/utils.h"
 #include "../src/crypto.h"
+#include "../src/rs.h"
+#include "../src/http.h"
+#include "../src/scheduler.h"
+#include "../src/reports.h"
+#include "../src/farmers.h"
+#include "../src/codecs.h"
+#include "../src/cache.h"
+#include "../src/metrics.h"
+#include "../src/listing.h"
+#include "../src/cli_callback.h"
 
 #include "mockbridge.json.h"
 #include "mockbridgeinfo.json.h"
@@ -37,5 +49,7 @@ int mock_farmer_shard_server(void *cls,
 
 struct MHD_Daemon *start_farmer_server();
 void free_farmer_data();
+void mock_farmer_fail_pushes(int limit);
+void mock_farmer_lose_shard(const char *shard_hash);
 
 int create_test_file(char *file);
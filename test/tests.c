@@ -191,6 +191,66 @@ void check_list_files(uv_work_t *work_req, int status)
     free(work_req);
 }
 
+void check_list_files_page(uv_work_t *work_req, int status)
+{
+    assert(status == 0);
+    list_files_request_t *req = work_req->data;
+    assert(req->handle == NULL);
+    assert(req->response != NULL);
+    assert(req->page_size == 2);
+    assert(req->total_files == 2);
+
+    // a full page continues after the date before the last file
+    assert(req->next_marker != NULL);
+    assert(strcmp(req->next_marker,
+                  "2016-10-12T14:40:21.259Z|1") == 0);
+
+    pass("storj_bridge_list_files_page");
+
+    storj_free_list_files_request(req);
+    free(work_req);
+}
+
+#define LIST_PAGES_MAX_FILES 8
+
+typedef struct {
+    storj_env_t *env;
+    char ids[LIST_PAGES_MAX_FILES][25];
+    int total_files;
+    int total_pages;
+    bool failed;
+} list_pages_check_t;
+
+static void check_list_files_pages(uv_work_t *work_req, int status)
+{
+    list_files_request_t *req = work_req->data;
+    list_pages_check_t *check = req->handle;
+
+    check->total_pages++;
+    if (status != 0 || req->error_code || req->total_files > req->page_size) {
+        check->failed = true;
+    }
+
+    for (uint32_t i = 0; i < req->total_files; i++) {
+        if (check->total_files == LIST_PAGES_MAX_FILES) {
+            check->failed = true;
+            break;
+        }
+        snprintf(check->ids[check->total_files], 25, "%s", req->files[i].id);
+        check->total_files++;
+    }
+
+    if (req->next_marker && check->total_pages < LIST_PAGES_MAX_FILES &&
+        storj_bridge_list_files_page(check->env, req->bucket_id,
+                                     req->next_marker, req->page_size,
+                                     check, check_list_files_pages)) {
+        check->failed = true;
+    }
+
+    storj_free_list_files_request(req);
+    free(work_req);
+}
+
 void check_list_files_badauth(uv_work_t *work_req, int status)
 {
     assert(status == 0);
@@ -586,6 +646,362 @@ int test_upload()
     return 0;
 }
 
+// hashes of the shards pushed by an upload
+#define SINGLE_PASS_MAX_SHARDS 32
+static char single_pass_hashes[SINGLE_PASS_MAX_SHARDS][41];
+static int single_pass_total_hashes = 0;
+static int single_pass_status = 0;
+
+static void add_single_pass_shard_event(const storj_shard_event_t *event,
+                                        void *handle)
+{
+    if (!event->upload || event->error_status || !event->shard_hash ||
+        single_pass_total_hashes == SINGLE_PASS_MAX_SHARDS) {
+        return;
+    }
+
+    snprintf(single_pass_hashes[single_pass_total_hashes], 41, "%s",
+             event->shard_hash);
+    single_pass_total_hashes += 1;
+}
+
+static void check_store_file_single_pass(int error_code,
+                                         storj_file_meta_t *file,
+                                         void *handle)
+{
+    single_pass_status = error_code;
+    storj_free_uploaded_file_info(file);
+}
+
+static int compare_shard_hashes(const void *a, const void *b)
+{
+    return strcmp((const char *)a, (const char *)b);
+}
+
+/*
+ * Upload the file with reed solomon, and get the sorted hashes of the
+ * pushed shards.
+ */
+static int upload_shard_hashes(char *file, char *file_name, bool single_pass,
+                               char hashes[][41], int *total_hashes)
+{
+    storj_env_t *env = storj_init_env(&bridge_options,
+                                      &encrypt_options,
+                                      &http_options,
+                                      &log_options);
+    assert(env != NULL);
+
+    storj_metrics_t metrics = {
+        .shard = add_single_pass_shard_event
+    };
+    storj_env_set_metrics(env, &metrics);
+
+    storj_upload_opts_t upload_opts = {
+        .index = "d2891da46d9c3bf42ad619ceddc1b6621f83e6cb74e6b6b6bc96bdbfaefb8692",
+        .bucket_id = "368be0816766b28fd5f43af5",
+        .file_name = file_name,
+        .fd = fopen(file, "r"),
+        .rs = true,
+        .single_pass = single_pass
+    };
+
+    single_pass_total_hashes = 0;
+    single_pass_status = -1;
+    storj_upload_state_t *state = storj_bridge_store_file(env,
+                                                          &upload_opts,
+                                                          NULL,
+                                                          NULL,
+                                                          check_store_file_single_pass);
+    if (!state || state->error_status != 0) {
+        return 1;
+    }
+
+    int status = uv_run(env->loop, UV_RUN_DEFAULT);
+    storj_destroy_env(env);
+
+    qsort(single_pass_hashes, single_pass_total_hashes, 41,
+          compare_shard_hashes);
+    memcpy(hashes, single_pass_hashes, sizeof(single_pass_hashes));
+    *total_hashes = single_pass_total_hashes;
+
+    return status || single_pass_status;
+}
+
+int test_upload_single_pass()
+{
+    char *file_name = "storj-test-upload.data";
+    int len = strlen(folder) + strlen(file_name);
+    char *file = calloc(len + 1, sizeof(char));
+    strcpy(file, folder);
+    strcat(file, file_name);
+    file[len] = '\0';
+
+    create_test_upload_file(file);
+
+    // the shard hashes are of the encrypted data and parity shards
+    char two_pass[SINGLE_PASS_MAX_SHARDS][41];
+    char single_pass[SINGLE_PASS_MAX_SHARDS][41];
+    int total_two_pass = 0;
+    int total_single_pass = 0;
+
+    int status = upload_shard_hashes(file, file_name, false,
+                                     two_pass, &total_two_pass);
+    status = status || upload_shard_hashes(file, file_name, true,
+                                           single_pass, &total_single_pass);
+
+    bool equal = total_two_pass > 0 && total_two_pass == total_single_pass;
+    for (int i = 0; equal && i < total_two_pass; i++) {
+        equal = strcmp(two_pass[i], single_pass[i]) == 0;
+    }
+
+    if (status || !equal) {
+        fail("test_upload_single_pass");
+    } else {
+        pass("test_upload_single_pass");
+    }
+
+    free(file);
+
+    return 0;
+}
+
+// shards of the journal of a transfer, and the transfers of them when resumed
+#define RESUME_JOURNAL_MAX 32
+static char resume_journal[RESUME_JOURNAL_MAX][41];
+static int resume_total_journal = 0;
+static uint32_t resume_transferred = 0;
+static uint32_t resume_repeated = 0;
+static int resume_status = 0;
+
+static void count_resume_shard_event(const storj_shard_event_t *event,
+                                     void *handle)
+{
+    for (int i = 0; i < resume_total_journal; i++) {
+        if (strcmp(event->shard_hash, resume_journal[i]) == 0) {
+            resume_repeated += 1;
+        }
+    }
+
+    if (!event->error_status) {
+        resume_transferred += 1;
+    }
+}
+
+static void check_store_file_resume(int error_code, storj_file_meta_t *file,
+                                    void *handle)
+{
+    resume_status = error_code;
+    storj_free_uploaded_file_info(file);
+}
+
+/*
+ * Upload the file, with the shard pushes after push_limit failed by the
+ * farmer, or none if negative.
+ */
+static int resume_upload(char *tmp_path, char *file, char *file_name,
+                         int push_limit)
+{
+    setenv("STORJ_TEMP", tmp_path, 1);
+    storj_env_t *env = storj_init_env(&bridge_options,
+                                      &encrypt_options,
+                                      &http_options,
+                                      &log_options);
+    assert(env != NULL);
+    unsetenv("STORJ_TEMP");
+
+    storj_metrics_t metrics = {
+        .shard = count_resume_shard_event
+    };
+    storj_env_set_metrics(env, &metrics);
+
+    storj_upload_opts_t upload_opts = {
+        .index = "d2891da46d9c3bf42ad619ceddc1b6621f83e6cb74e6b6b6bc96bdbfaefb8692",
+        .bucket_id = "368be0816766b28fd5f43af5",
+        .file_name = file_name,
+        .fd = fopen(file, "r"),
+        .rs = true,
+        .resume = true
+    };
+
+    mock_farmer_fail_pushes(push_limit);
+    resume_transferred = 0;
+    resume_status = -1;
+    storj_upload_state_t *state = storj_bridge_store_file(env,
+                                                          &upload_opts,
+                                                          NULL,
+                                                          NULL,
+                                                          check_store_file_resume);
+    if (!state || state->error_status != 0) {
+        mock_farmer_fail_pushes(-1);
+        return 1;
+    }
+
+    int status = uv_run(env->loop, UV_RUN_DEFAULT);
+    mock_farmer_fail_pushes(-1);
+    storj_destroy_env(env);
+
+    return status;
+}
+
+/*
+ * Read the shard hashes of the journal in the tmp path, and count the
+ * journals that are left.
+ */
+static int read_upload_journal(char *tmp_path)
+{
+    int journals = 0;
+    resume_total_journal = 0;
+
+    DIR *dir = opendir(tmp_path);
+    struct dirent *entry;
+    while (dir && (entry = readdir(dir)) != NULL) {
+        if (!strstr(entry->d_name, ".journal")) {
+            continue;
+        }
+        journals += 1;
+
+        char journal_path[1024];
+        snprintf(journal_path, sizeof(journal_path), "%s/%s",
+                 tmp_path, entry->d_name);
+        FILE *journal = fopen(journal_path, "r");
+        if (!journal) {
+            continue;
+        }
+
+        // the lines of the header are not shards
+        char line[256];
+        while (fgets(line, sizeof(line), journal)) {
+            int index;
+            uint64_t size;
+            if (resume_total_journal < RESUME_JOURNAL_MAX &&
+                sscanf(line, "shard %d %40s %"SCNu64,
+                       &index, resume_journal[resume_total_journal],
+                       &size) == 3) {
+                resume_total_journal += 1;
+            }
+        }
+
+        fclose(journal);
+    }
+    if (dir) {
+        closedir(dir);
+    }
+
+    return journals;
+}
+
+int test_upload_resume()
+{
+    // use an empty tmp path to look for the journal between the uploads
+    char *tmp_name = "storj-test-resume";
+    int tmp_len = strlen(folder) + strlen(tmp_name);
+    char *tmp_path = calloc(tmp_len + 1, sizeof(char));
+    strcpy(tmp_path, folder);
+    strcat(tmp_path, tmp_name);
+    mkdir(tmp_path, 0700);
+
+    char *file_name = "storj-test-upload.data";
+    int len = strlen(folder) + strlen(file_name);
+    char *file = calloc(len + 1, sizeof(char));
+    strcpy(file, folder);
+    strcat(file, file_name);
+    file[len] = '\0';
+
+    create_test_upload_file(file);
+
+    // the farmer fails the pushes after a few shards
+    resume_total_journal = 0;
+    if (resume_upload(tmp_path, file, file_name, 3) ||
+        resume_status == 0 || resume_status == -1) {
+        fail("storj_bridge_store_file(resume)");
+        printf("\t\tfirst upload status: %d\n", resume_status);
+        return 1;
+    }
+
+    // the journal keeps the shards pushed before the failure
+    if (read_upload_journal(tmp_path) != 1 || resume_total_journal != 3) {
+        fail("storj_bridge_store_file(resume)");
+        printf("\t\tjournaled shards: %d\n", resume_total_journal);
+        return 1;
+    }
+
+    // the journaled shards are not pushed again, and the journal is
+    // removed once the upload has completed
+    resume_repeated = 0;
+    int status = resume_upload(tmp_path, file, file_name, -1);
+    int remaining = read_upload_journal(tmp_path);
+
+    if (status == 0 && resume_status == 0 && resume_repeated == 0 &&
+        remaining == 0) {
+        pass("storj_bridge_store_file(resume)");
+    } else {
+        fail("storj_bridge_store_file(resume)");
+        printf("\t\tstatus: %d pushed shards again: %" PRIu32 "\n",
+               resume_status, resume_repeated);
+    }
+
+    rmdir(tmp_path);
+    free(tmp_path);
+    free(file);
+
+    return 0;
+}
+
+int test_upload_resume_modified()
+{
+    char *tmp_name = "storj-test-resume-modified";
+    int tmp_len = strlen(folder) + strlen(tmp_name);
+    char *tmp_path = calloc(tmp_len + 1, sizeof(char));
+    strcpy(tmp_path, folder);
+    strcat(tmp_path, tmp_name);
+    mkdir(tmp_path, 0700);
+
+    char *file_name = "storj-test-upload.data";
+    int len = strlen(folder) + strlen(file_name);
+    char *file = calloc(len + 1, sizeof(char));
+    strcpy(file, folder);
+    strcat(file, file_name);
+    file[len] = '\0';
+
+    create_test_upload_file(file);
+
+    resume_total_journal = 0;
+    if (resume_upload(tmp_path, file, file_name, 3) ||
+        read_upload_journal(tmp_path) != 1 || resume_total_journal != 3) {
+        fail("storj_bridge_store_file(resume modified)");
+        return 1;
+    }
+
+    // the file keeps its size, but was modified since the journal
+    struct stat st;
+    stat(file, &st);
+    struct utimbuf times = {
+        .actime = st.st_atime,
+        .modtime = st.st_mtime - 60
+    };
+    utime(file, &times);
+
+    // all of the journaled shards are pushed again
+    resume_repeated = 0;
+    int status = resume_upload(tmp_path, file, file_name, -1);
+    int remaining = read_upload_journal(tmp_path);
+
+    if (status == 0 && resume_status == 0 && resume_repeated == 3 &&
+        remaining == 0) {
+        pass("storj_bridge_store_file(resume modified)");
+    } else {
+        fail("storj_bridge_store_file(resume modified)");
+        printf("\t\tstatus: %d pushed shards again: %" PRIu32 "\n",
+               resume_status, resume_repeated);
+    }
+
+    rmdir(tmp_path);
+    free(tmp_path);
+    free(file);
+
+    return 0;
+}
+
 int test_upload_cancel()
 {
 
@@ -703,55 +1119,478 @@ int test_download_null_mnemonic()
     return _test_download(&encrypt_options_null_mnemonic, check_resolve_file_null_mnemonic);
 }
 
-int test_download_cancel()
+typedef struct {
+    FILE *expected;
+    uint64_t bytes;
+    bool matches;
+} stream_check_t;
+
+static int check_stream_write(const uint8_t *data, size_t length, void *handle)
 {
+    stream_check_t *check = handle;
 
-    // initialize event loop and environment
+    uint8_t *expected = malloc(length);
+    if (!expected ||
+        fread(expected, 1, length, check->expected) != length ||
+        memcmp(expected, data, length) != 0) {
+        check->matches = false;
+    }
+    free(expected);
+
+    check->bytes += length;
+
+    return 0;
+}
+
+static void check_stream_progress(double progress,
+                                  uint64_t downloaded_bytes,
+                                  uint64_t total_bytes,
+                                  void *handle)
+{
+    assert(handle != NULL);
+}
+
+void check_resolve_file_stream(int status, FILE *fd, void *handle)
+{
+    stream_check_t *check = handle;
+
+    // the whole file is written in order
+    if (status || !check->matches || check->bytes == 0 ||
+        fgetc(check->expected) != EOF) {
+        fail("storj_bridge_resolve_file_stream");
+        printf("Download failed: %s\n", storj_strerror(status));
+    } else {
+        pass("storj_bridge_resolve_file_stream");
+    }
+
+    fclose(check->expected);
+}
+
+int test_download_stream()
+{
     storj_env_t *env = storj_init_env(&bridge_options,
                                       &encrypt_options,
                                       &http_options,
                                       &log_options);
     assert(env != NULL);
 
-    // resolve file
-    char *download_file = calloc(strlen(folder) + 33 + 1, sizeof(char));
+    // compare with the file from the download test
+    char *download_file = calloc(strlen(folder) + 24 + 1, sizeof(char));
     strcpy(download_file, folder);
-    strcat(download_file, "storj-test-download-canceled.data");
-    FILE *download_fp = fopen(download_file, "w+");
+    strcat(download_file, "storj-test-download.data");
 
-    char *bucket_id = "368be0816766b28fd5f43af5";
-    char *file_id = "998960317b6725a3f8080c2b";
+    stream_check_t check = {
+        .expected = fopen(download_file, "r"),
+        .bytes = 0,
+        .matches = true
+    };
+    free(download_file);
+    assert(check.expected != NULL);
 
-    storj_download_state_t *state = storj_bridge_resolve_file(env,
-                                                              bucket_id,
-                                                              file_id,
-                                                              download_fp,
-                                                              NULL,
-                                                              check_resolve_file_progress,
-                                                              check_resolve_file_cancel);
+    storj_download_opts_t download_opts = {
+        .bucket_id = "368be0816766b28fd5f43af5",
+        .file_id = "998960317b6725a3f8080c2b",
+        .destination = NULL,
+        .stream = true,
+        .write_cb = check_stream_write,
+        .stream_window = 1
+    };
+
+    storj_download_state_t *state = storj_bridge_resolve_file_opts(env,
+                                                                   &download_opts,
+                                                                   &check,
+                                                                   check_stream_progress,
+                                                                   check_resolve_file_stream);
 
     if (!state || state->error_status != 0) {
         return 1;
     }
 
-    // process the loop one at a time so that we can do other things while
-    // the loop is processing, such as cancel the download
-    int count = 0;
-    bool more;
-    int status = 0;
-    do {
-        more = uv_run(env->loop, UV_RUN_ONCE);
-        if (more == false) {
-            more = uv_loop_alive(env->loop);
-            if (uv_run(env->loop, UV_RUN_NOWAIT) != 0) {
-                more = true;
-            }
-        }
+    if (uv_run(env->loop, UV_RUN_DEFAULT)) {
+        return 1;
+    }
 
-        count++;
+    storj_destroy_env(env);
 
-        if (count == 100) {
-            status = storj_bridge_resolve_file_cancel(state);
+    return 0;
+}
+
+typedef struct {
+    const char *shard_hash;
+    uint32_t fetched;
+} shard_fetch_count_t;
+
+static void count_shard_fetches(const storj_shard_event_t *event, void *handle)
+{
+    shard_fetch_count_t *counts = handle;
+
+    for (int i = 0; counts[i].shard_hash; i++) {
+        if (strcmp(event->shard_hash, counts[i].shard_hash) == 0) {
+            counts[i].fetched += 1;
+        }
+    }
+}
+
+int test_download_stream_recover()
+{
+    storj_env_t *env = storj_init_env(&bridge_options,
+                                      &encrypt_options,
+                                      &http_options,
+                                      &log_options);
+    assert(env != NULL);
+
+    // the first two shards are written before the third is lost
+    shard_fetch_count_t counts[] = {
+        {"269e72f24703be80bbb10499c91dc9b2022c4dc3", 0},
+        {"17416a592487d7b1b74c100448c8296122d8aff8", 0},
+        {NULL, 0}
+    };
+    storj_metrics_t metrics = {
+        .shard = count_shard_fetches,
+        .handle = counts
+    };
+    storj_env_set_metrics(env, &metrics);
+    mock_farmer_lose_shard("83cf5eaf2311a1ae9699772d9bafbb3e369a41cc");
+
+    // compare with the file from the download test
+    char *download_file = calloc(strlen(folder) + 24 + 1, sizeof(char));
+    strcpy(download_file, folder);
+    strcat(download_file, "storj-test-download.data");
+
+    stream_check_t check = {
+        .expected = fopen(download_file, "r"),
+        .bytes = 0,
+        .matches = true
+    };
+    free(download_file);
+    assert(check.expected != NULL);
+
+    storj_download_opts_t download_opts = {
+        .bucket_id = "368be0816766b28fd5f43af5",
+        .file_id = "998960317b6725a3f8080c2b",
+        .destination = NULL,
+        .stream = true,
+        .write_cb = check_stream_write,
+        .stream_window = 1
+    };
+
+    storj_download_state_t *state = storj_bridge_resolve_file_opts(env,
+                                                                   &download_opts,
+                                                                   &check,
+                                                                   check_stream_progress,
+                                                                   check_resolve_file_stream);
+
+    if (!state || state->error_status != 0) {
+        mock_farmer_lose_shard(NULL);
+        return 1;
+    }
+
+    if (uv_run(env->loop, UV_RUN_DEFAULT)) {
+        mock_farmer_lose_shard(NULL);
+        return 1;
+    }
+
+    mock_farmer_lose_shard(NULL);
+    storj_destroy_env(env);
+
+    // the lost shard is decoded without the written shards
+    if (counts[0].fetched == 1 && counts[1].fetched == 1) {
+        pass("storj_bridge_resolve_file_stream(recover)");
+    } else {
+        fail("storj_bridge_resolve_file_stream(recover)");
+        printf("\t\tfetched written shards: %" PRIu32 " %" PRIu32 "\n",
+               counts[0].fetched, counts[1].fetched);
+    }
+
+    return 0;
+}
+
+void check_resolve_file_range(int status, FILE *fd, void *handle)
+{
+    stream_check_t *check = handle;
+
+    // only the bytes of the range are written
+    if (status || !check->matches || check->bytes != 16777216) {
+        fail("storj_bridge_resolve_file_range");
+        printf("Download failed: %s\n", storj_strerror(status));
+    } else {
+        pass("storj_bridge_resolve_file_range");
+    }
+
+    fclose(check->expected);
+}
+
+int test_download_range()
+{
+    storj_env_t *env = storj_init_env(&bridge_options,
+                                      &encrypt_options,
+                                      &http_options,
+                                      &log_options);
+    assert(env != NULL);
+
+    // compare with the file from the download test
+    char *download_file = calloc(strlen(folder) + 24 + 1, sizeof(char));
+    strcpy(download_file, folder);
+    strcat(download_file, "storj-test-download.data");
+
+    stream_check_t check = {
+        .expected = fopen(download_file, "r"),
+        .bytes = 0,
+        .matches = true
+    };
+    free(download_file);
+    assert(check.expected != NULL);
+
+    // a shard of bytes starting within the second shard
+    uint64_t offset = 16777216 + 1000;
+    fseek(check.expected, offset, SEEK_SET);
+
+    storj_download_opts_t download_opts = {
+        .bucket_id = "368be0816766b28fd5f43af5",
+        .file_id = "998960317b6725a3f8080c2b",
+        .destination = NULL,
+        .write_cb = check_stream_write,
+        .range = true,
+        .range_offset = offset,
+        .range_length = 16777216
+    };
+
+    storj_download_state_t *state = storj_bridge_resolve_file_opts(env,
+                                                                   &download_opts,
+                                                                   &check,
+                                                                   check_stream_progress,
+                                                                   check_resolve_file_range);
+
+    if (!state || state->error_status != 0) {
+        return 1;
+    }
+
+    if (uv_run(env->loop, UV_RUN_DEFAULT)) {
+        return 1;
+    }
+
+    storj_destroy_env(env);
+
+    return 0;
+}
+
+static void check_resolve_file_resume(int status, FILE *fd, void *handle)
+{
+    fclose(fd);
+    resume_status = status;
+}
+
+/*
+ * Download the file to the destination, canceling the download once
+ * cancel_after shards have been fetched, or never if zero.
+ */
+static int resume_download(char *tmp_path, char *download_file,
+                           const char *mode, uint32_t cancel_after)
+{
+    setenv("STORJ_TEMP", tmp_path, 1);
+    storj_env_t *env = storj_init_env(&bridge_options,
+                                      &encrypt_options,
+                                      &http_options,
+                                      &log_options);
+    assert(env != NULL);
+    unsetenv("STORJ_TEMP");
+
+    storj_metrics_t metrics = {
+        .shard = count_resume_shard_event
+    };
+    storj_env_set_metrics(env, &metrics);
+
+    storj_download_opts_t download_opts = {
+        .bucket_id = "368be0816766b28fd5f43af5",
+        .file_id = "998960317b6725a3f8080c2b",
+        .destination = fopen(download_file, mode),
+        .resume = true
+    };
+
+    resume_transferred = 0;
+    resume_status = -1;
+    storj_download_state_t *state = storj_bridge_resolve_file_opts(env,
+                                                                   &download_opts,
+                                                                   NULL,
+                                                                   NULL,
+                                                                   check_resolve_file_resume);
+
+    if (!state || state->error_status != 0) {
+        return 1;
+    }
+
+    bool canceled = false;
+    bool more;
+    do {
+        more = uv_run(env->loop, UV_RUN_ONCE);
+        if (more == false) {
+            more = uv_loop_alive(env->loop);
+            if (uv_run(env->loop, UV_RUN_NOWAIT) != 0) {
+                more = true;
+            }
+        }
+
+        if (cancel_after && !canceled && resume_transferred >= cancel_after) {
+            storj_bridge_resolve_file_cancel(state);
+            canceled = true;
+        }
+    } while (more == true);
+
+    storj_destroy_env(env);
+
+    return 0;
+}
+
+/*
+ * Read the shard hashes of the journal in the tmp path, and count the
+ * journals that are left.
+ */
+static int read_download_journal(char *tmp_path)
+{
+    int journals = 0;
+    resume_total_journal = 0;
+
+    DIR *dir = opendir(tmp_path);
+    struct dirent *entry;
+    while (dir && (entry = readdir(dir)) != NULL) {
+        if (!strstr(entry->d_name, ".download")) {
+            continue;
+        }
+        journals += 1;
+
+        char journal_path[1024];
+        snprintf(journal_path, sizeof(journal_path), "%s/%s",
+                 tmp_path, entry->d_name);
+        FILE *journal = fopen(journal_path, "r");
+        unsigned int version = 0;
+        if (!journal) {
+            continue;
+        }
+
+        if (fscanf(journal, "storj-download-journal %u\n", &version) == 1) {
+            uint32_t index;
+            uint64_t offset;
+            uint64_t size;
+            while (resume_total_journal < RESUME_JOURNAL_MAX &&
+                   fscanf(journal,
+                          "shard %"SCNu32" %"SCNu64" %"SCNu64" %40s\n",
+                          &index, &offset, &size,
+                          resume_journal[resume_total_journal]) == 4) {
+                resume_total_journal += 1;
+            }
+        }
+
+        fclose(journal);
+    }
+    if (dir) {
+        closedir(dir);
+    }
+
+    return journals;
+}
+
+int test_download_resume()
+{
+    // use an empty tmp path to look for the journal between the downloads
+    char *tmp_name = "storj-test-resume";
+    int tmp_len = strlen(folder) + strlen(tmp_name);
+    char *tmp_path = calloc(tmp_len + 1, sizeof(char));
+    strcpy(tmp_path, folder);
+    strcat(tmp_path, tmp_name);
+    mkdir(tmp_path, 0700);
+
+    char *download_file = calloc(strlen(folder) + 31 + 1, sizeof(char));
+    strcpy(download_file, folder);
+    strcat(download_file, "storj-test-download-resume.data");
+
+    // the first download is canceled after a few shards
+    resume_total_journal = 0;
+    if (resume_download(tmp_path, download_file, "w+", 2) ||
+        resume_status != STORJ_TRANSFER_CANCELED) {
+        fail("storj_bridge_resolve_file_opts(resume)");
+        printf("\t\tfirst download status: %d\n", resume_status);
+        return 1;
+    }
+
+    // the journal keeps the shards written before the cancel
+    if (read_download_journal(tmp_path) != 1 || resume_total_journal < 2) {
+        fail("storj_bridge_resolve_file_opts(resume)");
+        printf("\t\tjournaled shards: %d\n", resume_total_journal);
+        return 1;
+    }
+
+    // the journaled shards are not fetched again, and the journal is
+    // removed once the download has completed
+    resume_repeated = 0;
+    int status = resume_download(tmp_path, download_file, "r+", 0);
+    int remaining = read_download_journal(tmp_path);
+
+    if (status == 0 && resume_status == 0 && resume_repeated == 0 &&
+        remaining == 0) {
+        pass("storj_bridge_resolve_file_opts(resume)");
+    } else {
+        fail("storj_bridge_resolve_file_opts(resume)");
+        printf("\t\tstatus: %d refetched shards: %" PRIu32 "\n",
+               resume_status, resume_repeated);
+    }
+
+    unlink(download_file);
+    rmdir(tmp_path);
+    free(tmp_path);
+    free(download_file);
+
+    return 0;
+}
+
+int test_download_cancel()
+{
+
+    // initialize event loop and environment
+    storj_env_t *env = storj_init_env(&bridge_options,
+                                      &encrypt_options,
+                                      &http_options,
+                                      &log_options);
+    assert(env != NULL);
+
+    // resolve file
+    char *download_file = calloc(strlen(folder) + 33 + 1, sizeof(char));
+    strcpy(download_file, folder);
+    strcat(download_file, "storj-test-download-canceled.data");
+    FILE *download_fp = fopen(download_file, "w+");
+
+    char *bucket_id = "368be0816766b28fd5f43af5";
+    char *file_id = "998960317b6725a3f8080c2b";
+
+    storj_download_state_t *state = storj_bridge_resolve_file(env,
+                                                              bucket_id,
+                                                              file_id,
+                                                              download_fp,
+                                                              NULL,
+                                                              check_resolve_file_progress,
+                                                              check_resolve_file_cancel);
+
+    if (!state || state->error_status != 0) {
+        return 1;
+    }
+
+    // process the loop one at a time so that we can do other things while
+    // the loop is processing, such as cancel the download
+    int count = 0;
+    bool more;
+    int status = 0;
+    do {
+        more = uv_run(env->loop, UV_RUN_ONCE);
+        if (more == false) {
+            more = uv_loop_alive(env->loop);
+            if (uv_run(env->loop, UV_RUN_NOWAIT) != 0) {
+                more = true;
+            }
+        }
+
+        count++;
+
+        if (count == 100) {
+            status = storj_bridge_resolve_file_cancel(state);
             assert(status == 0);
         }
 
@@ -764,6 +1603,109 @@ int test_download_cancel()
     return 0;
 }
 
+typedef struct {
+    cli_api_t *cli_api;
+    int max_in_flight;
+    bool done;
+} cli_files_check_t;
+
+static void check_cli_files_in_flight(const storj_shard_event_t *event,
+                                      void *handle)
+{
+    cli_files_check_t *check = handle;
+
+    if (check->cli_api->files_in_flight > check->max_in_flight) {
+        check->max_in_flight = check->cli_api->files_in_flight;
+    }
+}
+
+static void check_cli_files_done(cli_api_t *cli_api)
+{
+    cli_files_check_t *check = cli_api->handle;
+    check->done = true;
+}
+
+int test_download_files()
+{
+    storj_env_t *env = storj_init_env(&bridge_options,
+                                      &encrypt_options,
+                                      &http_options,
+                                      &log_options);
+    assert(env != NULL);
+
+    // two files fit the shards in flight
+    storj_transfer_limits_t limits = {
+        .max_shards = 2,
+        .max_bytes = 0
+    };
+    storj_env_set_transfer_limits(env, &limits);
+
+    storj_file_meta_t files[3];
+    char file_names[3][32];
+    memset(files, 0, sizeof(files));
+    for (int i = 0; i < 3; i++) {
+        snprintf(file_names[i], sizeof(file_names[i]),
+                 "storj-test-download-%d.data", i);
+        files[i].id = "998960317b6725a3f8080c2b";
+        files[i].filename = file_names[i];
+
+        char path[1024];
+        snprintf(path, sizeof(path), "%s%s", folder, file_names[i]);
+        unlink(path);
+    }
+
+    cli_api_t cli_api;
+    memset(&cli_api, 0, sizeof(cli_api));
+    cli_files_check_t check = {
+        .cli_api = &cli_api,
+        .max_in_flight = 0,
+        .done = false
+    };
+
+    // the files as listed by the download-files command
+    cli_api.env = env;
+    cli_api.files = files;
+    strcpy(cli_api.bucket_id, "368be0816766b28fd5f43af5");
+    cli_api.file_path = folder;
+    cli_api.total_files = 3;
+    cli_api.xfer_count = 0;
+    cli_api.excp_cmd_resp = "list-files-resp";
+    cli_api.rcvd_cmd_resp = "list-files-resp";
+    cli_api.next_cmd_req = "download-files-req";
+    cli_api.final_cmd_req = NULL;
+    cli_api.handle = &check;
+    cli_api.done_cb = check_cli_files_done;
+
+    storj_metrics_t metrics = {
+        .shard = check_cli_files_in_flight,
+        .handle = &check
+    };
+    storj_env_set_metrics(env, &metrics);
+
+    queue_next_cmd_req(&cli_api);
+    int started = cli_api.files_in_flight;
+
+    while (!check.done && uv_run(env->loop, UV_RUN_ONCE));
+
+    if (uv_run(env->loop, UV_RUN_DEFAULT)) {
+        return 1;
+    }
+
+    storj_destroy_env(env);
+
+    // the files are downloaded at once within the limits
+    if (check.done && cli_api.error_status == 0 && started == 2 &&
+        check.max_in_flight == 2 && cli_api.files_in_flight == 0) {
+        pass("cli_download_files");
+    } else {
+        fail("cli_download_files");
+        printf("\t\tstarted: %d, most in flight: %d, status: %d\n",
+               started, check.max_in_flight, cli_api.error_status);
+    }
+
+    return 0;
+}
+
 int test_api_badauth()
 {
     // initialize event loop and environment
@@ -797,6 +1739,169 @@ int test_api_badauth()
     return 0;
 }
 
+int test_list_files_pages()
+{
+    storj_env_t *env = storj_init_env(&bridge_options,
+                                      &encrypt_options,
+                                      &http_options,
+                                      &log_options);
+    assert(env != NULL);
+
+    // three files are created at the same time, across the first page
+    list_pages_check_t check = {0};
+    check.env = env;
+    int status = storj_bridge_list_files_page(env, "4b4e0a3d7f1c2e5a9b8c6d01",
+                                              NULL, 2, &check,
+                                              check_list_files_pages);
+    assert(status == 0);
+
+    if (uv_run(env->loop, UV_RUN_DEFAULT)) {
+        return 1;
+    }
+
+    bool unique = true;
+    for (int i = 0; i < check.total_files; i++) {
+        for (int j = i + 1; j < check.total_files; j++) {
+            if (strcmp(check.ids[i], check.ids[j]) == 0) {
+                unique = false;
+            }
+        }
+    }
+
+    if (check.failed || !unique || check.total_files != 5 ||
+        check.total_pages != 3) {
+        fail("test_list_files_pages");
+    } else {
+        pass("test_list_files_pages");
+    }
+
+    storj_destroy_env(env);
+
+    return 0;
+}
+
+static void check_list_files_batches(uv_work_t *work, int status)
+{
+    list_files_request_t *req = work->data;
+    int *done = req->handle;
+
+    *done += 1;
+}
+
+int test_list_files_batches()
+{
+    // one file past the first batch
+    uint32_t total_files = STORJ_LIST_FILES_BATCH_SIZE + 1;
+    const char *bucket_id = "368be0816766b28fd5f43af5";
+
+    char *encrypted_name = NULL;
+    assert(encrypt_file_name(encrypt_options.mnemonic, bucket_id,
+                             "last.txt", &encrypted_name) == 0);
+
+    struct json_object *response = json_object_new_array();
+    for (uint32_t i = 0; i < total_files; i++) {
+        char id[25];
+        snprintf(id, sizeof(id), "%024" PRIu32, i);
+        struct json_object *file = json_object_new_object();
+        json_object_object_add(file, "id", json_object_new_string(id));
+        if (i == total_files - 1) {
+            json_object_object_add(file, "filename",
+                                   json_object_new_string(encrypted_name));
+        }
+        json_object_array_add(response, file);
+    }
+    free(encrypted_name);
+
+    int done = 0;
+    list_files_request_t req = {0};
+    req.encrypt_options = &encrypt_options;
+    req.bucket_id = bucket_id;
+    req.response = response;
+    req.files = calloc(total_files, sizeof(storj_file_meta_t));
+    req.total_files = total_files;
+    req.handle = &done;
+
+    uv_work_t work;
+    work.data = &req;
+
+    uv_loop_t *loop = uv_default_loop();
+    int status = queue_list_files_batches(loop, &work,
+                                          check_list_files_batches);
+    assert(status == 0);
+    uv_run(loop, UV_RUN_DEFAULT);
+
+    bool filled = true;
+    for (uint32_t i = 0; i < total_files; i++) {
+        char id[25];
+        snprintf(id, sizeof(id), "%024" PRIu32, i);
+        if (!req.files[i].id || strcmp(req.files[i].id, id) != 0) {
+            filled = false;
+        }
+    }
+
+    storj_file_meta_t *last = &req.files[total_files - 1];
+    if (done != 1 || req.error_code || !filled || !last->decrypted ||
+        strcmp(last->filename, "last.txt") != 0) {
+        fail("test_list_files_batches");
+    } else {
+        pass("test_list_files_batches");
+    }
+
+    if (last->decrypted) {
+        free((char *)last->filename);
+    }
+    free(req.files);
+    json_object_put(response);
+
+    return 0;
+}
+
+int test_report_queue()
+{
+    // initialize event loop and environment
+    storj_env_t *env = storj_init_env(&bridge_options,
+                                      &encrypt_options,
+                                      &http_options,
+                                      &log_options);
+    assert(env != NULL);
+
+    storj_exchange_report_t report = {
+        .data_hash = "269e72f24703be80bbb10499c91dc9b2022c4dc3",
+        .reporter_id = USER,
+        .farmer_id = "abc",
+        .client_id = USER,
+        .start = 1,
+        .end = 2,
+        .code = STORJ_REPORT_SUCCESS,
+        .message = STORJ_REPORT_SHARD_DOWNLOADED
+    };
+
+    // reports queued while a batch is sent are sent with the next one
+    int failed = 0;
+    for (int i = 0; i < 3; i++) {
+        if (report_queue_add(env->reports, &report)) {
+            failed = 1;
+        }
+    }
+
+    // run all queued events
+    if (uv_run(env->loop, UV_RUN_DEFAULT)) {
+        return 1;
+    }
+
+    report_queue_t *queue = env->reports;
+    if (failed || queue->total_sent != 3 || queue->head ||
+        queue->total_queued != 0 || queue->sending) {
+        fail("test_report_queue");
+    } else {
+        pass("test_report_queue");
+    }
+
+    storj_destroy_env(env);
+
+    return 0;
+}
+
 int test_api()
 {
     // initialize event loop and environment
@@ -842,6 +1947,11 @@ int test_api()
                                      check_list_files);
     assert(status == 0);
 
+    // list the first page of files in a bucket
+    status = storj_bridge_list_files_page(env, bucket_id, NULL, 2, NULL,
+                                          check_list_files_page);
+    assert(status == 0);
+
     // get file id
     status = storj_bridge_get_file_id(env, bucket_id, "storj-test-download.data",
                                       NULL, check_get_file_id);
@@ -1240,6 +2350,68 @@ int test_generate_file_key()
     return 0;
 }
 
+int test_key_cache()
+{
+    char *mnemonic = "abandon abandon abandon abandon abandon abandon abandon abandon abandon abandon abandon about";
+    char *bucket_id = "0123456789ab0123456789ab";
+    char *index = "150589c9593bbebc0e795d8c4fa97304b42c110d9f0095abfac644763beca66e";
+    char *expected_bucket_key = "b2464469e364834ad21e24c64f637c39083af5067693605c84e259447644f6f6";
+    char *expected_file_key = "bb3552fc2e16d24a147af4b2d163e3164e6dbd04bbc45fc1c3eab69f384337e9";
+
+    storj_key_cache_t *cache = key_cache_new();
+    char *bucket_key = calloc(DETERMINISTIC_KEY_SIZE + 1, sizeof(char));
+    char *file_key = calloc(DETERMINISTIC_KEY_SIZE + 1, sizeof(char));
+    char *encrypted_name = NULL;
+    char *expected_encrypted_name = NULL;
+    char *decrypted_name = NULL;
+
+    int failed = 0;
+
+    // the second lookup is served from the cache
+    for (int i = 0; i < 2; i++) {
+        memset(bucket_key, 0, DETERMINISTIC_KEY_SIZE + 1);
+        if (generate_bucket_key_cached(cache, mnemonic, bucket_id, &bucket_key) ||
+            strcmp(expected_bucket_key, bucket_key) != 0) {
+            failed = 1;
+        }
+    }
+
+    if (generate_file_key_cached(cache, mnemonic, bucket_id, index, &file_key) ||
+        strcmp(expected_file_key, file_key) != 0) {
+        failed = 1;
+    }
+
+    if (encrypt_file_name_cached(cache, mnemonic, bucket_id, "samplefile.txt",
+                                 &encrypted_name) ||
+        encrypt_file_name(mnemonic, bucket_id, "samplefile.txt",
+                          &expected_encrypted_name) ||
+        strcmp(expected_encrypted_name, encrypted_name) != 0) {
+        failed = 1;
+    }
+
+    if (!encrypted_name ||
+        decrypt_file_name_cached(cache, mnemonic, bucket_id, encrypted_name,
+                                 &decrypted_name) ||
+        strcmp("samplefile.txt", decrypted_name) != 0) {
+        failed = 1;
+    }
+
+    key_cache_destroy(cache);
+    free(bucket_key);
+    free(file_key);
+    free(encrypted_name);
+    free(expected_encrypted_name);
+    free(decrypted_name);
+
+    if (failed) {
+        fail("test_key_cache");
+    } else {
+        pass("test_key_cache");
+    }
+
+    return 0;
+}
+
 int test_str2hex()
 {
     char *data = "632442ba2e5f28a3a4e68dcb0b45d1d8f097d5b47479d74e2259055aa25a08aa";
@@ -1381,7 +2553,121 @@ int test_determine_shard_size()
         return 1;
     }
 
-    pass("test_determine_shard_size");
+    pass("test_determine_shard_size");
+
+    return 0;
+}
+
+int test_sha256_lanes()
+{
+    uint8_t data[1000];
+    for (int i = 0; i < sizeof(data); i++) {
+        data[i] = (uint8_t)(i * 7);
+    }
+
+    uint8_t prefixes[STORJ_SHA256_LANES][32];
+    const uint8_t *lane_prefixes[STORJ_SHA256_LANES];
+    for (int l = 0; l < STORJ_SHA256_LANES; l++) {
+        memset(prefixes[l], l + 1, 32);
+        lane_prefixes[l] = prefixes[l];
+    }
+
+    // updates of any size give the same hash as separate contexts
+    size_t lengths[] = {0, 1, 31, 32, 55, 64, 100, 1000};
+
+    for (int t = 0; t < sizeof(lengths) / sizeof(size_t); t++) {
+        sha256_lanes_ctx_t ctx;
+        if (sha256_lanes_init(&ctx, STORJ_SHA256_LANES, lane_prefixes, 32)) {
+            fail("test_sha256_lanes");
+            return 1;
+        }
+
+        size_t position = 0;
+        size_t chunk = 1;
+        while (position < lengths[t]) {
+            size_t length = lengths[t] - position;
+            if (length > chunk) {
+                length = chunk;
+            }
+            sha256_lanes_update(&ctx, length, data + position);
+            position += length;
+            chunk = chunk * 3 + 1;
+        }
+
+        uint8_t digests[STORJ_SHA256_LANES][SHA256_DIGEST_SIZE];
+        sha256_lanes_digest(&ctx, digests);
+
+        for (int l = 0; l < STORJ_SHA256_LANES; l++) {
+            struct sha256_ctx expected_ctx;
+            sha256_init(&expected_ctx);
+            sha256_update(&expected_ctx, 32, prefixes[l]);
+            sha256_update(&expected_ctx, lengths[t], data);
+
+            uint8_t expected[SHA256_DIGEST_SIZE];
+            sha256_digest(&expected_ctx, SHA256_DIGEST_SIZE, expected);
+
+            if (memcmp(expected, digests[l], SHA256_DIGEST_SIZE) != 0) {
+                fail("test_sha256_lanes");
+                return 1;
+            }
+        }
+    }
+
+    pass("test_sha256_lanes");
+
+    return 0;
+}
+
+int test_ctr_crypt_segment()
+{
+    uint8_t key[SHA256_DIGEST_SIZE];
+    memset(key, 0x42, SHA256_DIGEST_SIZE);
+    uint8_t iv[AES_BLOCK_SIZE] = {0,0,0,0,0,0,0,0,0,0,0,0,0,0,0xff,0xf0};
+
+    uint8_t data[AES_BLOCK_SIZE * 100 + 5];
+    for (int i = 0; i < sizeof(data); i++) {
+        data[i] = (uint8_t)i;
+    }
+
+    uint8_t expected[sizeof(data)];
+    struct aes256_ctx ctx;
+    uint8_t ctr[AES_BLOCK_SIZE];
+    memcpy(ctr, iv, AES_BLOCK_SIZE);
+    aes256_set_encrypt_key(&ctx, key);
+    ctr_crypt(&ctx, (nettle_cipher_func *)aes256_encrypt, AES_BLOCK_SIZE,
+              ctr, sizeof(data), expected, data);
+
+    // segments in reverse order give the same result as a single pass
+    uint8_t result[sizeof(data)];
+    uint64_t segment = AES_BLOCK_SIZE * 7;
+    uint64_t offset = (sizeof(data) / segment) * segment;
+    while (true) {
+        uint64_t length = sizeof(data) - offset;
+        if (length > segment) {
+            length = segment;
+        }
+        if (ctr_crypt_segment(key, iv, offset, length,
+                              result + offset, data + offset)) {
+            fail("test_ctr_crypt_segment");
+            return 1;
+        }
+        if (offset == 0) {
+            break;
+        }
+        offset -= segment;
+    }
+
+    if (memcmp(expected, result, sizeof(data)) != 0) {
+        fail("test_ctr_crypt_segment");
+        return 1;
+    }
+
+    if (!ctr_crypt_segment(key, iv, 3, 1, result, data)) {
+        fail("test_ctr_crypt_segment");
+        return 1;
+    }
+
+    pass("test_ctr_crypt_segment");
 
     return 0;
 }
@@ -1598,6 +2884,43 @@ int test_memory_mapping()
     }
 
     fclose(fp2);
+
+    // a range is mapped from the start of the page of a position
+    FILE *fp3 = fopen(file, "r");
+    if (!fp3) {
+        printf("failed open.\n");
+        return 1;
+    }
+
+    uint64_t position = filesize / 2 + 1;
+    uint64_t map_start = position % get_map_granularity();
+    uint8_t expected = 0;
+    uint8_t *map3 = NULL;
+    if (pread(fileno(fp3), &expected, 1, position) != 1) {
+        fail("test_memory_mapping(6)");
+        return 1;
+    }
+
+    error = map_file_range(fileno(fp3), position - map_start, map_start + 1,
+                           &map3, true);
+    if (error) {
+        printf("failed to map file range: %i\n", error);
+        fail("test_memory_mapping(7)");
+        return 1;
+    }
+
+    if (map3[map_start] != expected) {
+        fail("test_memory_mapping(8)");
+    }
+
+    error = unmap_file(map3, map_start + 1);
+    if (error) {
+        printf("failed to unmap file: %d", error);
+        fail("test_memory_mapping(9)");
+        return error;
+    }
+
+    fclose(fp3);
     free(file);
 
     pass("test_memory_mapping");
@@ -1633,6 +2956,564 @@ int test_str_replace()
     return 0;
 }
 
+int test_http_pool()
+{
+    storj_http_options_t options = {
+        .user_agent = "storj-test"
+    };
+
+    options.pool = http_pool_new(1);
+    if (!options.pool) {
+        fail("test_http_pool");
+        return 0;
+    }
+
+    int failed = 0;
+
+    CURL *first = http_pool_acquire(&options);
+    CURL *second = http_pool_acquire(&options);
+    if (!first || !second || first == second) {
+        failed = 1;
+    }
+
+    // only one idle handle is kept, the other is cleaned up
+    http_pool_release(&options, first);
+    http_pool_release(&options, second);
+    if (options.pool->count != 1) {
+        failed = 1;
+    }
+
+    CURL *reused = http_pool_acquire(&options);
+    if (reused != first || options.pool->count != 0) {
+        failed = 1;
+    }
+    http_pool_release(&options, reused);
+
+    http_pool_destroy(options.pool);
+
+    if (failed) {
+        fail("test_http_pool");
+    } else {
+        pass("test_http_pool");
+    }
+
+    return 0;
+}
+
+static void wake_test_slot(void *data)
+{
+    int *woken = data;
+    *woken += 1;
+}
+
+int test_transfer_scheduler()
+{
+    uv_loop_t *loop = uv_default_loop();
+
+    transfer_scheduler_t *scheduler = transfer_scheduler_new(loop);
+    if (!scheduler) {
+        fail("test_transfer_scheduler");
+        return 0;
+    }
+    scheduler->max_shards = 2;
+
+    int first_woken = 0;
+    int second_woken = 0;
+    transfer_slot_t *first = transfer_slot_new(scheduler, wake_test_slot,
+                                               &first_woken);
+    transfer_slot_t *second = transfer_slot_new(scheduler, wake_test_slot,
+                                                &second_woken);
+
+    int failed = 0;
+
+    // the first file may use all of the budget that is free
+    if (!transfer_slot_acquire(first, 10) ||
+        !transfer_slot_acquire(first, 10)) {
+        failed = 1;
+    }
+
+    // the second file waits for the budget
+    if (transfer_slot_acquire(second, 10) || !second->waiting) {
+        failed = 1;
+    }
+
+    // while the second file waits the first keeps to its fair share
+    transfer_slot_release(first, 10);
+    if (transfer_slot_acquire(first, 10)) {
+        failed = 1;
+    }
+
+    // the waiting files are woken on the loop and may then acquire
+    uv_run(loop, UV_RUN_NOWAIT);
+    if (second_woken != 1) {
+        failed = 1;
+    }
+    if (!transfer_slot_acquire(second, 10) || scheduler->shards != 2) {
+        failed = 1;
+    }
+
+    transfer_slot_release(first, 10);
+    transfer_slot_release(second, 10);
+    transfer_slot_free(first);
+    transfer_slot_free(second);
+
+    if (scheduler->shards != 0 || scheduler->bytes != 0 ||
+        scheduler->total_slots != 0) {
+        failed = 1;
+    }
+
+    transfer_scheduler_destroy(scheduler);
+    uv_run(loop, UV_RUN_DEFAULT);
+
+    if (failed) {
+        fail("test_transfer_scheduler");
+    } else {
+        pass("test_transfer_scheduler");
+    }
+
+    return 0;
+}
+
+int test_farmer_table()
+{
+    farmer_table_t *table = farmer_table_new();
+    if (!table) {
+        fail("test_farmer_table");
+        return 0;
+    }
+
+    int failed = 0;
+
+    if (farmer_table_get(table, "farmer") != NULL) {
+        failed = 1;
+    }
+
+    farmer_table_record(table, "farmer", 1000000, 10, true);
+    farmer_table_record(table, "farmer", 1000000, 100, true);
+    farmer_table_record(table, "farmer", 0, 0, false);
+    farmer_table_record(table, "other", 0, 0, false);
+
+    farmer_stats_t *stats = farmer_table_get(table, "farmer");
+
+    // recent transfers weigh a quarter of the average
+    if (!stats || stats->successes != 2 || stats->failures != 1 ||
+        stats->samples != 2 || stats->throughput != 77500.0) {
+        failed = 1;
+    }
+
+    // the latency of a small transfer is not counted as slow
+    farmer_table_record(table, "small", 4096, 200, true);
+    stats = farmer_table_get(table, "small");
+    if (!stats || stats->successes != 1 || stats->samples != 0) {
+        failed = 1;
+    }
+
+    if (table->total_farmers != 3) {
+        failed = 1;
+    }
+
+    // a farmer is excluded after failing again
+    char *exclude = farmer_table_exclude_list(table);
+    if (exclude) {
+        failed = 1;
+    }
+    farmer_table_record(table, "other", 0, 0, false);
+    exclude = farmer_table_exclude_list(table);
+    if (!exclude || strcmp(exclude, "other") != 0) {
+        failed = 1;
+    }
+    free(exclude);
+
+    // the table is kept between runs
+    char *file_name = "farmers.json";
+    char *path = calloc(strlen(folder) + strlen(file_name) + 1, sizeof(char));
+    strcpy(path, folder);
+    strcat(path, file_name);
+    unlink(path);
+
+    if (farmer_table_load(table, path) || farmer_table_save(table)) {
+        failed = 1;
+    }
+    farmer_table_destroy(table);
+
+    table = farmer_table_new();
+    if (farmer_table_load(table, path)) {
+        failed = 1;
+    }
+    stats = farmer_table_get(table, "other");
+    if (!stats || stats->consecutive_failures != 2 ||
+        table->total_farmers != 3) {
+        failed = 1;
+    }
+    exclude = farmer_table_exclude_list(table);
+    if (!exclude || strcmp(exclude, "other") != 0) {
+        failed = 1;
+    }
+    free(exclude);
+
+    unlink(path);
+    free(path);
+    farmer_table_destroy(table);
+
+    if (failed) {
+        fail("test_farmer_table");
+    } else {
+        pass("test_farmer_table");
+    }
+
+    return 0;
+}
+
+int test_codec_cache()
+{
+    codec_cache_t *cache = codec_cache_new();
+    if (!cache) {
+        fail("test_codec_cache");
+        return 1;
+    }
+
+    // a codec for each geometry
+    reed_solomon *rs = codec_cache_get(cache, 10, 4);
+    reed_solomon *other = codec_cache_get(cache, 4, 2);
+    if (!rs || !other || rs == other || rs != codec_cache_get(cache, 10, 4)) {
+        fail("test_codec_cache");
+        codec_cache_destroy(cache);
+        return 1;
+    }
+
+    // a decoder for each pattern of missing shards
+    uint8_t marks[14] = {0};
+    marks[3] = 1;
+    marks[12] = 1;
+    bool owned = true;
+    reed_solomon_decoder *decoder = codec_cache_get_decoder(cache, rs, marks,
+                                                            &owned);
+    if (!decoder || owned || decoder->nr_erased != 1 ||
+        decoder != codec_cache_get_decoder(cache, rs, marks, &owned)) {
+        fail("test_codec_cache");
+        codec_cache_destroy(cache);
+        return 1;
+    }
+
+    // shards that can't be repaired
+    memset(marks, 1, 5);
+    if (codec_cache_get_decoder(cache, rs, marks, &owned)) {
+        fail("test_codec_cache");
+        codec_cache_destroy(cache);
+        return 1;
+    }
+
+    codec_cache_destroy(cache);
+
+    pass("test_codec_cache");
+
+    return 0;
+}
+
+int test_shard_cache()
+{
+    char path[1024];
+    snprintf(path, sizeof(path), "%sstorj-test-shards", folder);
+
+    // remove the shards of a previous run
+    shard_cache_destroy(shard_cache_new(uv_default_loop(), path, 0));
+
+    shard_cache_t *cache = shard_cache_new(uv_default_loop(), path, 6000);
+    if (!cache) {
+        fail("test_shard_cache");
+        return 1;
+    }
+
+    uint8_t data[4096];
+    uint8_t other_data[4096];
+    memset(data, 'a', sizeof(data));
+    memset(other_data, 'b', sizeof(other_data));
+
+    char hash[RIPEMD160_DIGEST_SIZE * 2 + 1] = {0};
+    char other_hash[RIPEMD160_DIGEST_SIZE * 2 + 1] = {0};
+    ripemd160sha256_as_string(data, sizeof(data), hash);
+    ripemd160sha256_as_string(other_data, sizeof(other_data), other_hash);
+
+    // a shard is read back as it was written
+    uint8_t read_data[4096];
+    int write_status = shard_cache_write(cache, hash, sizeof(data),
+                                         NULL, 0, data);
+    int read_status = shard_cache_read(cache, hash, sizeof(data),
+                                       NULL, 0, read_data);
+
+    if (write_status || read_status ||
+        memcmp(data, read_data, sizeof(data)) != 0 ||
+        !shard_cache_contains(cache, hash, sizeof(data)) ||
+        shard_cache_contains(cache, hash, 10)) {
+        fail("test_shard_cache");
+        shard_cache_destroy(cache);
+        return 1;
+    }
+
+    // the least recently used shard is removed for a new one
+    FILE *source = tmpfile();
+    pwrite(fileno(source), other_data, sizeof(other_data), 100);
+    write_status = shard_cache_write(cache, other_hash, sizeof(other_data),
+                                     source, 100, NULL);
+    fclose(source);
+
+    if (write_status || shard_cache_contains(cache, hash, sizeof(data)) ||
+        !shard_cache_contains(cache, other_hash, sizeof(other_data))) {
+        fail("test_shard_cache");
+        shard_cache_destroy(cache);
+        return 1;
+    }
+
+    // a shard that doesn't match its hash is removed
+    char shard_path[1100];
+    snprintf(shard_path, sizeof(shard_path), "%s/%s", path, other_hash);
+    FILE *shard_file = fopen(shard_path, "r+");
+    fputc('c', shard_file);
+    fclose(shard_file);
+
+    FILE *destination = tmpfile();
+    read_status = shard_cache_read(cache, other_hash, sizeof(other_data),
+                                   destination, 0, NULL);
+    fclose(destination);
+
+    if (read_status != STORJ_FILE_INTEGRITY_ERROR ||
+        shard_cache_contains(cache, other_hash, sizeof(other_data)) ||
+        cache->total_entries != 0 || cache->total_bytes != 0) {
+        fail("test_shard_cache");
+        shard_cache_destroy(cache);
+        return 1;
+    }
+
+    shard_cache_destroy(cache);
+
+    pass("test_shard_cache");
+
+    return 0;
+}
+
+int test_progress_meter()
+{
+    storj_progress_meter_t meter;
+    memset(&meter, 0, sizeof(storj_progress_meter_t));
+    meter.interval = 60000;
+
+    // the first update is reported, and the next ones after the interval
+    bool first = progress_meter_update(&meter, 0, 10000);
+    bool second = progress_meter_update(&meter, 1000, 10000);
+
+    // a sample of 2000 bytes in two seconds
+    meter.sample_time -= 2000;
+    meter.sample_bytes = 0;
+    bool third = progress_meter_update(&meter, 2000, 10000);
+
+    // the completed progress is always reported
+    bool last = progress_meter_update(&meter, 10000, 10000);
+
+    if (!first || second || third || !last) {
+        fail("test_progress_meter");
+        return 1;
+    }
+
+    if (meter.rate < 900 || meter.rate > 1100 || meter.eta != 0) {
+        fail("test_progress_meter");
+        return 1;
+    }
+
+    pass("test_progress_meter");
+
+    return 0;
+}
+
+int test_shard_size_policy()
+{
+    storj_shard_size_params_t params = {
+        .file_size = 134217729,
+        .parallelism = 64,
+        .rs = false
+    };
+
+    // the default only depends on the file size
+    if (storj_shard_size_default(&params) != 16777216) {
+        fail("test_shard_size_policy");
+        return 1;
+    }
+
+    // mid-size files are split to be pushed in parallel
+    if (storj_shard_size_throughput(&params) != 4194304) {
+        fail("test_shard_size_policy");
+        return 1;
+    }
+
+    // fewer parallel shards need fewer, larger shards
+    params.file_size = 1073741824;
+    params.rs = true;
+    uint64_t parallel_size = storj_shard_size_throughput(&params);
+    params.parallelism = 4;
+    uint64_t serial_size = storj_shard_size_throughput(&params);
+
+    if (parallel_size != 33554432 || serial_size != 67108864) {
+        fail("test_shard_size_policy");
+        return 1;
+    }
+
+    // large files have larger shards, so that the data and parity shards
+    // can be encoded
+    uint64_t large_sizes[] = {10000000000ULL, 40000000000ULL};
+    uint32_t parallelisms[] = {64, 128};
+    uint64_t expected_sizes[] = {268435456, 134217728, 1073741824, 536870912};
+
+    for (int i = 0; i < 4; i++) {
+        params.file_size = large_sizes[i / 2];
+        params.parallelism = parallelisms[i % 2];
+        uint64_t size = storj_shard_size_throughput(&params);
+        uint64_t data_shards = size ? ceil((double)params.file_size / size) : 0;
+        uint64_t total_shards = data_shards + ceil((double)data_shards * 2.0 / 3.0);
+
+        if (size != expected_sizes[i] || total_shards > DATA_SHARDS_MAX) {
+            fail("test_shard_size_policy");
+            printf("\t\tfile size: %" PRIu64 " shard size: %" PRIu64 "\n",
+                   params.file_size, size);
+            return 1;
+        }
+    }
+
+    // small files have one shard, and empty files none
+    params.parallelism = 4;
+    params.file_size = 1000;
+    uint64_t small_size = storj_shard_size_throughput(&params);
+    params.file_size = 0;
+    uint64_t empty_size = storj_shard_size_throughput(&params);
+
+    if (small_size != 2097152 || empty_size != 0) {
+        fail("test_shard_size_policy");
+        return 1;
+    }
+
+    pass("test_shard_size_policy");
+
+    return 0;
+}
+
+int test_concurrency()
+{
+    storj_concurrency_t concurrency;
+    concurrency_init(&concurrency, true, 8, 2, 9);
+
+    // the first window starts with the first update
+    concurrency_update(&concurrency, 10000);
+
+    // goodput that does not drop raises the limit by one
+    concurrency_record(&concurrency, 1000, 10000, true);
+    bool raised = concurrency_update(&concurrency, 12000);
+    concurrency_record(&concurrency, 1000, 12000, true);
+    concurrency_update(&concurrency, 14000);
+    concurrency_record(&concurrency, 1000, 14000, true);
+    bool at_max = concurrency_update(&concurrency, 16000);
+
+    if (!raised || at_max || concurrency.limit != 9) {
+        fail("test_concurrency");
+        return 1;
+    }
+
+    // a burst of failures of shards started before lowering the limit
+    // lowers it once
+    concurrency_record(&concurrency, 0, 15000, false);
+    concurrency_update(&concurrency, 16001);
+    concurrency_record(&concurrency, 0, 15000, false);
+    concurrency_update(&concurrency, 16002);
+    concurrency_record(&concurrency, 0, 15500, false);
+    concurrency_update(&concurrency, 16003);
+
+    if (concurrency.limit != 4) {
+        fail("test_concurrency");
+        printf("\t\tlimit: %u\n", concurrency.limit);
+        return 1;
+    }
+
+    // failures of shards started after it lower it again, not below the min
+    concurrency_record(&concurrency, 0, 16100, false);
+    concurrency_update(&concurrency, 17000);
+    concurrency_record(&concurrency, 0, 17100, false);
+    concurrency_update(&concurrency, 18000);
+
+    if (concurrency.limit != 2) {
+        fail("test_concurrency");
+        printf("\t\tlimit: %u\n", concurrency.limit);
+        return 1;
+    }
+
+    // a fixed limit is used as given and never changed
+    storj_concurrency_t fixed;
+    concurrency_init(&fixed, false, 200, 0, 0);
+    concurrency_record(&fixed, 0, 10000, false);
+    concurrency_update(&fixed, 10000);
+    if (concurrency_update(&fixed, 20000) || fixed.limit != 200) {
+        fail("test_concurrency");
+        return 1;
+    }
+
+    pass("test_concurrency");
+
+    return 0;
+}
+
+static void count_shard_event(const storj_shard_event_t *event, void *handle)
+{
+    uint64_t *bytes = handle;
+    *bytes += event->bytes;
+}
+
+int test_metrics()
+{
+    char path[STORJ_METRICS_PATH_SIZE];
+
+    // ids are replaced and the query is removed
+    metrics_path_template("/buckets/368be0816766b28fd5f43af5/files/"
+                          "998960317b6725a3f8080c2b/info?skip=10",
+                          path, sizeof(path));
+    if (strcmp(path, "/buckets/:id/files/:id/info") != 0) {
+        fail("test_metrics");
+        printf("\t\tpath: %s\n", path);
+        return 1;
+    }
+
+    metrics_path_template("/frames/abc", path, sizeof(path));
+    if (strcmp(path, "/frames/abc") != 0) {
+        fail("test_metrics");
+        printf("\t\tpath: %s\n", path);
+        return 1;
+    }
+
+    // nothing is measured without functions
+    storj_metrics_t disabled = {0};
+    if (metrics_now(&disabled) != 0 || metrics_now(NULL) != 0) {
+        fail("test_metrics");
+        return 1;
+    }
+    metrics_phase(&disabled, STORJ_PHASE_PREPARE_FRAME, 100, 0, 0);
+
+    uint64_t bytes = 0;
+    storj_metrics_t metrics = {
+        .shard = count_shard_event,
+        .handle = &bytes
+    };
+    if (metrics_now(&metrics) == 0) {
+        fail("test_metrics");
+        return 1;
+    }
+    metrics_shard(&metrics, true, "farmer", "hash", 1024, 1000, 1500, 0, 0);
+    metrics_request(&metrics, "GET", "/buckets", 200, 0, 1000);
+
+    if (bytes != 1024) {
+        fail("test_metrics");
+        return 1;
+    }
+
+    pass("test_metrics");
+
+    return 0;
+}
+
 // Test Bridge Server
 struct MHD_Daemon *start_test_server()
 {
@@ -1669,17 +3550,28 @@ int main(void)
     printf("Test Suite: API\n");
     test_api();
     test_api_badauth();
+    test_list_files_pages();
+    test_list_files_batches();
+    test_report_queue();
     printf("\n");
 
     printf("Test Suite: Uploads\n");
     test_upload();
+    test_upload_single_pass();
+    test_upload_resume();
+    test_upload_resume_modified();
     test_upload_cancel();
     printf("\n");
 
     printf("Test Suite: Downloads\n");
     test_download();
     test_download_null_mnemonic();
+    test_download_resume();
+    test_download_stream();
+    test_download_stream_recover();
+    test_download_range();
     test_download_cancel();
+    test_download_files();
     printf("\n");
 
     printf("Test Suite: BIP39\n");
@@ -1696,7 +3588,10 @@ int main(void)
     printf("Test Suite: Crypto\n");
     test_generate_bucket_key();
     test_generate_file_key();
+    test_key_cache();
     test_increment_ctr_aes_iv();
+    test_sha256_lanes();
+    test_ctr_crypt_segment();
     test_read_write_encrypted_file();
     test_meta_encryption();
     printf("\n");
@@ -1706,8 +3601,17 @@ int main(void)
     test_hex2str();
     test_get_time_milliseconds();
     test_determine_shard_size();
+    test_shard_size_policy();
     test_memory_mapping();
     test_str_replace();
+    test_http_pool();
+    test_transfer_scheduler();
+    test_farmer_table();
+    test_codec_cache();
+    test_shard_cache();
+    test_progress_meter();
+    test_concurrency();
+    test_metrics();
 
     int num_failed = tests_ran - test_status;
     printf(KGRN "\nPASSED: %i" RESET, test_status);
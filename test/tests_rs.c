@@ -81,6 +81,45 @@ void test_galois(void) {
     assert(galExp(13,7) == 43);
 }
 
+void test_gf_backends(void) {
+    unsigned int b;
+    int c, i;
+    uint64_t len;
+    gf src[1031], dst[1031], expect[1031], orig[1031];
+
+    printf("%s:\n", __FUNCTION__);
+
+    for(i = 0; i < sizeof(src); i++) {
+        src[i] = (gf)rand();
+        orig[i] = (gf)rand();
+    }
+
+    for(b = 0; b < GF_BACKENDS_COUNT; b++) {
+        if(!gf_backends[b].supported()) {
+            printf("  %s: not supported\n", gf_backends[b].name);
+            continue;
+        }
+        printf("  %s\n", gf_backends[b].name);
+
+        for(c = 0; c < 256; c++) {
+            /* odd and unaligned lengths to cover the scalar tails */
+            for(len = 1; len < sizeof(src); len += 97) {
+                memcpy(dst, orig, sizeof(dst));
+                memcpy(expect, orig, sizeof(expect));
+                gf_backends[b].addmul1(dst + 1, src + 3, c, len, len, len + 2);
+                slow_addmul1(expect + 1, src + 3, c, len, len, len + 2);
+                assert(0 == memcmp(dst, expect, sizeof(dst)));
+
+                memcpy(dst, orig, sizeof(dst));
+                memcpy(expect, orig, sizeof(expect));
+                gf_backends[b].mul1(dst + 2, src + 1, c, len, len + 5, len);
+                slow_mul1(expect + 2, src + 1, c, len, len + 5, len);
+                assert(0 == memcmp(dst, expect, sizeof(dst)));
+            }
+        }
+    }
+}
+
 void test_sub_matrix(void) {
     int r, c, ptr, nrows = 10, ncols = 20;
     gf* m1 = (gf*)RS_MALLOC(nrows * ncols);
@@ -489,6 +528,137 @@ void test_encoding(void) {
     assert(0 == err);
 }
 
+void test_stripes(void) {
+    int ds = 10, ps = 4, i;
+    uint64_t block_size = 1000, stripe = 97, offset;
+    uint64_t total_bytes = block_size * (ds - 1) + 500;
+    reed_solomon *rs;
+    gf *data = calloc(ds, block_size);
+    gf *orig = calloc(ds, block_size);
+    gf *fec = calloc(ps, block_size);
+    gf *fec_stripes = calloc(ps, block_size);
+    gf *data_blocks[ds], *fec_blocks[ps], *fec_stripe_blocks[ps];
+    uint8_t marks[ds + ps];
+
+    printf("%s:\n", __FUNCTION__);
+
+    for(i = 0; i < total_bytes; i++) {
+        orig[i] = (gf)rand();
+    }
+    memcpy(data, orig, ds * block_size);
+
+    for(i = 0; i < ds; i++) {
+        data_blocks[i] = data + i * block_size;
+    }
+    for(i = 0; i < ps; i++) {
+        fec_blocks[i] = fec + i * block_size;
+        fec_stripe_blocks[i] = fec_stripes + i * block_size;
+    }
+
+    rs = reed_solomon_new(ds, ps);
+
+    // encoding in stripes gives the same parity as in one pass
+    reed_solomon_encode2(rs, data_blocks, fec_blocks, ds + ps,
+                         block_size, total_bytes);
+    for(offset = 0; offset < block_size; offset += stripe) {
+        reed_solomon_encode2_stripe(rs, data_blocks, fec_stripe_blocks,
+                                    ds + ps, block_size, total_bytes,
+                                    offset, stripe);
+    }
+    assert(0 == memcmp(fec, fec_stripes, ps * block_size));
+
+    // lose three data shards, including the partial last shard
+    memset(marks, 0, sizeof(marks));
+    marks[1] = marks[4] = marks[ds - 1] = 1;
+    marks[ds + 2] = 1;
+    memset(data_blocks[1], 0, block_size);
+    memset(data_blocks[4], 0, block_size);
+    memset(data_blocks[ds - 1], 0, block_size);
+
+    for(offset = 0; offset < block_size; offset += stripe) {
+        assert(0 == reed_solomon_reconstruct_stripe(rs, data_blocks, fec_blocks,
+                                                    marks, ds + ps, block_size,
+                                                    total_bytes, offset, stripe));
+    }
+    assert(0 == memcmp(data, orig, ds * block_size));
+
+    reed_solomon_release(rs);
+    free(data);
+    free(orig);
+    free(fec);
+    free(fec_stripes);
+}
+
+void test_decoder(void) {
+    int ds = 10, ps = 4, i;
+    uint64_t block_size = 1000, stripe = 97, offset;
+    uint64_t total_bytes = block_size * (ds - 1) + 500;
+    reed_solomon *rs;
+    reed_solomon_decoder *decoder;
+    gf *data = calloc(ds, block_size);
+    gf *orig = calloc(ds, block_size);
+    gf *fec = calloc(ps, block_size);
+    gf *data_blocks[ds], *fec_blocks[ps];
+    uint8_t marks[ds + ps];
+
+    printf("%s:\n", __FUNCTION__);
+
+    for(i = 0; i < total_bytes; i++) {
+        orig[i] = (gf)rand();
+    }
+    memcpy(data, orig, ds * block_size);
+
+    for(i = 0; i < ds; i++) {
+        data_blocks[i] = data + i * block_size;
+    }
+    for(i = 0; i < ps; i++) {
+        fec_blocks[i] = fec + i * block_size;
+    }
+
+    rs = reed_solomon_new(ds, ps);
+    reed_solomon_encode2(rs, data_blocks, fec_blocks, ds + ps,
+                         block_size, total_bytes);
+
+    // nothing to repair
+    memset(marks, 0, sizeof(marks));
+    decoder = reed_solomon_decoder_new(rs, marks);
+    assert(NULL != decoder && 0 == decoder->nr_erased);
+    reed_solomon_decoder_release(decoder);
+
+    // the same decoder repairs every stripe and another copy of the data
+    marks[0] = marks[5] = marks[ds - 1] = 1;
+    marks[ds + 1] = 1;
+    decoder = reed_solomon_decoder_new(rs, marks);
+    assert(NULL != decoder && 3 == decoder->nr_erased);
+
+    for(i = 0; i < 2; i++) {
+        memset(data_blocks[0], 0, block_size);
+        memset(data_blocks[5], 0, block_size);
+        memset(data_blocks[ds - 1], 0, block_size);
+
+        for(offset = 0; offset < block_size; offset += stripe) {
+            assert(0 == reed_solomon_decoder_reconstruct_stripe(rs, decoder,
+                                                                data_blocks,
+                                                                fec_blocks,
+                                                                block_size,
+                                                                total_bytes,
+                                                                offset,
+                                                                stripe));
+        }
+        assert(0 == memcmp(data, orig, total_bytes));
+    }
+    reed_solomon_decoder_release(decoder);
+
+    // more missing shards than parity shards can't be repaired
+    marks[1] = marks[2] = 1;
+    assert(NULL == reed_solomon_decoder_new(rs, marks));
+
+    reed_solomon_release(rs);
+    free(data);
+    free(orig);
+    free(fec);
+}
+
 void test_reconstruct(void) {
 #define FEC_START (10*6)
     printf("%s:\n", __FUNCTION__);
@@ -849,6 +1019,7 @@ int main(void) {
     fec_init();
 
     test_galois();
+    test_gf_backends();
     test_sub_matrix();
     test_multiply();
     test_inverse();
@@ -856,6 +1027,8 @@ int main(void) {
     test_one_decoding();
     test_encoding();
     test_reconstruct();
+    test_stripes();
+    test_decoder();
     printf("reach here means test all ok\n");
 
     benchmarkEncode();